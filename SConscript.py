@@ -19,6 +19,8 @@ hcheaders = Split("""
 	src/THcRawShowerHit.h src/THcAerogel.h src/THcAerogelHit.h src/THcCherenkov.h src/THcCherenkovHit.h
         src/THcGlobals.h src/THcDCTrack.h src/THcFormula.h
         src/THcRaster.h src/THcRasteredBeam.h src/THcRasterRawHit.h
+        src/THcPedestalTracker.h src/THcReconMatrix.h src/THcDecodeGraph.h src/THcTaskPool.h src/THcApparatusGroup.h
+        src/THcRun.h src/THcProfiler.h src/THcSimDecoder.h src/THcOutputCompare.h src/THcPrefilter.h src/THcEventIndex.h src/THcShowerGainCalib.h src/THcSymSolver.h src/THcHodoTimeCalib.h src/THcHitCache.h src/THcHitCacheRun.h src/THcCalibDriver.h src/THcDCResidualCalib.h
 	src/HallC_LinkDef.h
 	""")
 pbaseenv.RootCint(roothcdict,hcheaders)
@@ -30,4 +32,6 @@ print ('LIBS = %s\n' % pbaseenv.subst('$LIBS'))
 
 analyzer = pbaseenv.Program(target = 'hcana', source = 'src/main.o')
 pbaseenv.Install('./bin',analyzer)
+bench = pbaseenv.Program(target = 'hcbench', source = 'src/hcbench.o')
+pbaseenv.Install('./bin',bench)
 pbaseenv.Alias('install',['./bin'])
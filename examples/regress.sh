@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# Output regression check and throughput benchmark.
+#
+#   REF_HCANA=/path/to/reference/hcana ./regress.sh [nevents]
+#       Replay the first nevents (default 20000) events of run 50017
+#       with the reference build into regress_ref.root (the golden
+#       output), then with the candidate build (HCANA, default hcana)
+#       into regress_cand.root, and compare the variables of output.def
+#       event by event with the tolerances of regress_tolerances.def.
+#
+#   ./regress.sh [nevents]
+#       Without REF_HCANA, compare against the existing regress_ref.root.
+#
+# Prints the replay rate of both builds and the first divergences, and
+# exits with status 1 if the outputs differ.
+
+HCANA=${HCANA:-hcana}
+NEVENTS=${1:-20000}
+
+replay() {
+    local hcana=$1 out=$2
+    local start=$(date +%s.%N)
+    ${hcana} -b -q "regress_replay.C(\"${out}\",${NEVENTS})" > ${out%.root}.log 2>&1
+    local end=$(date +%s.%N)
+    echo "${end} - ${start}" | bc
+}
+
+if [ -n "${REF_HCANA}" ]; then
+    tref=$(replay ${REF_HCANA} regress_ref.root)
+elif [ ! -f regress_ref.root ]; then
+    echo "No regress_ref.root: set REF_HCANA to the reference hcana"
+    exit 2
+fi
+tcand=$(replay ${HCANA} regress_cand.root)
+
+printf "%-10s %10s %12s\n" build seconds events/s
+if [ -n "${tref}" ]; then
+    printf "%-10s %10.1f %12.0f\n" reference ${tref} $(echo "${NEVENTS} / ${tref}" | bc -l)
+fi
+printf "%-10s %10.1f %12.0f\n" candidate ${tcand} $(echo "${NEVENTS} / ${tcand}" | bc -l)
+if [ -n "${tref}" ]; then
+    printf "speedup %.2f\n" $(echo "${tref} / ${tcand}" | bc -l)
+fi
+
+${HCANA} -b -q regress_compare.C
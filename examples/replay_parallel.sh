@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Event parallel replay of hodtest_parallel.C.
+#
+#   ./replay_parallel.sh [nworkers]
+#       Run nworkers hcana processes, each on its slice of the event
+#       range, and merge their output into hodtest.root.
+#
+#   ./replay_parallel.sh --scaling
+#       Scaling benchmark: replay with 1, 2, 4, 8 and 16 workers and
+#       print the wall time and speedup for each.
+#
+#   ./replay_parallel.sh --check [nworkers]
+#       Regression check: replay serially into hodtest_serial.root, then
+#       with nworkers workers, and compare the merged output with the
+#       serial one (regress_compare.C).  Every value must agree exactly,
+#       pedestals included.  Exits with status 1 if they differ.
+#
+# The event index of the run file is built first (index_run.C), so that
+# each worker seeks directly to its part of the run.
+
+HCANA=${HCANA:-hcana}
+RUNFILE=${RUNFILE:-daq04_50017.log.0}
+
+${HCANA} -b -q "index_run.C(\"${RUNFILE}\")" > index.log 2>&1
+
+replay() {
+    local n=$1
+    rm -f hodtest_w*.root
+    for ((i=0; i<n; i++)); do
+	${HCANA} -b -q "hodtest_parallel.C(${i},${n})" > replay_w${i}.log 2>&1 &
+    done
+    wait
+    ${HCANA} -b -q "merge_workers.C(\"hodtest.root\",${n})" > merge.log 2>&1
+}
+
+if [ "$1" == "--check" ]; then
+    ${HCANA} -b -q "hodtest_parallel.C(0,1)" > replay_serial.log 2>&1
+    mv hodtest.root hodtest_serial.root
+    replay ${2:-4}
+    ${HCANA} -b -q "regress_compare.C(\"hodtest_serial.root\",\"hodtest.root\",\"output.def\",\"\")"
+    exit $?
+elif [ "$1" == "--scaling" ]; then
+    printf "%8s %10s %8s\n" workers seconds speedup
+    for n in 1 2 4 8 16; do
+	start=$(date +%s.%N)
+	replay ${n}
+	end=$(date +%s.%N)
+	t=$(echo "${end} - ${start}" | bc)
+	if [ ${n} -eq 1 ]; then t1=${t}; fi
+	printf "%8d %10.1f %8.2f\n" ${n} ${t} $(echo "${t1} / ${t}" | bc -l)
+    done
+else
+    replay ${1:-4}
+fi
@@ -50,8 +50,8 @@ class THcShTrack {
 
   Double_t GetP() {return P*1000.;}      //MeV
 
-  Float_t Ycor(Double_t);         // coord. corection for single PMT module
-  Float_t Ycor(Double_t, Int_t);  // coord. correction for double PMT module
+  static Float_t Ycor(Double_t);         // coord. corection for single PMT module
+  static Float_t Ycor(Double_t, Int_t);  // coord. correction for double PMT module
 
   // Coordinate correction constants from hcana.param.
   //
@@ -96,6 +96,7 @@ void THcShTrack::Reset(Double_t p,
   Xp = xp;
   Y = y;
   Yp =yp;
+  for (THcShHitIt i = Hits.begin(); i != Hits.end(); ++i) delete *i;
   Hits.clear();
 };
 
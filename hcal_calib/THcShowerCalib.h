@@ -4,17 +4,19 @@
 #include "THcShTrack.h"
 #include "TH1F.h"
 #include "TH2F.h"
-#include "TVectorD.h"
-#include "TMatrixD.h"
-#include "TDecompLU.h"
+#include "THcSymSolver.h"
 #include "TMath.h"
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <cstring>
 
 #include "TROOT.h"
 #include "TFile.h"
 #include "TTree.h"
+#include "TSystem.h"
+#include "TThread.h"
+#include "TStopwatch.h"
 
 #define D_CALO_FP 338.69    //distance from FP to the calorimeter face
 
@@ -23,6 +25,13 @@ using namespace std;
 //
 // HMS Shower Counter calibration class.
 //
+// Init reads the calibration tree once, only the branches needed, into a
+// compact in-memory copy: per event the track parameters, dP and the
+// hits with a signal (fEvents, fHits).  The other steps sweep this copy
+// instead of the tree.  ComposeVMs splits the events between threads
+// (SetNThreads, the number of CPUs by default), each accumulating its own
+// partial sums of e0, qe, q0 and Q, which are added in order at the end.
+//
 
 class THcShowerCalib {
 
@@ -39,6 +48,7 @@ class THcShowerCalib {
   void FillHEcal();
   void SaveAlphas();
   void SaveRawData();
+  void SetNThreads(Int_t n) {fNThreads = n;}
 
   TH1F* hEunc;
   TH1F* hEuncSel;
@@ -69,16 +79,59 @@ class THcShowerCalib {
 
   UInt_t fHitCount[THcShTrack::fNpmts];
 
+  // In-memory copy of the calibration data.
+
+  struct ShEvent {
+    Double_t P;        // track momentum, GeV
+    Double_t X, Xp;    // at the calorimeter face
+    Double_t Y, Yp;
+    Double_t delta;    // H.tr.tg_dp
+    Double_t Enorm0;   // Edep/P with the initial gains
+    UInt_t first;      // first hit in fHits
+    UInt_t nhits;
+  };
+  struct ShHit {
+    Double_t adc_pos;  // pedestal subtracted ADC signals
+    Double_t adc_neg;
+    UInt_t nb;         // block number
+  };
+  vector<ShEvent> fEvents;
+  vector<ShHit> fHits;
+
+  // Partial sums of ComposeVMs over the events [first,last).
+
+  struct VMSums {
+    THcShowerCalib* calib;
+    UInt_t first, last;
+    UInt_t nev;
+    Double_t e0;
+    Double_t qe[THcShTrack::fNpmts];
+    Double_t q0[THcShTrack::fNpmts];
+    Double_t Q[THcShTrack::fNpmts][THcShTrack::fNpmts];   // upper triangle
+    UInt_t hitcount[THcShTrack::fNpmts];
+  };
+
+  Int_t fNThreads;
+
+  void LoadTracks();
+  Double_t SetEs(const ShEvent& ev, const Double_t* alpha,
+		 Double_t* epos, Double_t* eneg) const;
+  void AccumulateVMs(VMSums& sums) const;
+  static void* VMThread(void* arg);
+
 };
 
 //------------------------------------------------------------------------------
 
-THcShowerCalib::THcShowerCalib() {};
+THcShowerCalib::THcShowerCalib() {
+  fNThreads = 0;
+};
 
 //------------------------------------------------------------------------------
 
 THcShowerCalib::THcShowerCalib(Int_t RunNumber) {
   fRunNumber = RunNumber;
+  fNThreads = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -98,12 +151,21 @@ void THcShowerCalib::SaveRawData() {
   ofstream fout;
   fout.open("hcal_calib.raw_data",ios::out);
 
-  THcShTrack trk;
+  Double_t epos[THcShTrack::fNblks];
+  Double_t eneg[THcShTrack::fNblks];
+
+  // Same format as THcShTrack::Print.
 
   for (UInt_t ientry=0; ientry<fNentries; ientry++) {
-    ReadShRawTrack(trk, ientry);
-    trk.SetEs(falphaC);
-    trk.Print(fout);
+    const ShEvent& ev = fEvents[ientry];
+    SetEs(ev, falphaC, epos, eneg);
+    fout << ev.P << " " << ev.X << " " << ev.Xp << " " << ev.Y << " "
+	 << ev.Yp << " " << ev.nhits << endl;
+    for (UInt_t i=0; i<ev.nhits; i++) {
+      const ShHit& hit = fHits[ev.first+i];
+      fout << hit.adc_pos << " " << hit.adc_neg << " " << epos[i] << " "
+	   << eneg[i] << " " << hit.nb << endl;
+    }
   }
 
   fout.close();
@@ -168,10 +230,130 @@ void THcShowerCalib::Init() {
     falpha1[ipmt] = 1.;
   }
 
+  // Read the tree into memory.
+
+  LoadTracks();
+
 };
 
 //------------------------------------------------------------------------------
 
+void THcShowerCalib::LoadTracks() {
+
+  //
+  // Read all entries of the tree into fEvents and fHits, in one pass
+  // reading only the calorimeter and track branches used.
+  //
+
+  TStopwatch timer;
+
+  static const char* const cols[THcShTrack::fNcols] =
+    {"1pr", "2ta", "3ta", "4ta"};
+
+  Double_t adc_pos[THcShTrack::fNcols][THcShTrack::fNrows];
+  Double_t adc_neg[THcShTrack::fNcols][THcShTrack::fNrows];
+  Double_t H_tr_p, H_tr_x, H_tr_xp, H_tr_y, H_tr_yp, H_tr_tg_dp;
+
+  fTree->SetBranchStatus("*",0);
+
+  for (UInt_t k=0; k<THcShTrack::fNcols; k++) {
+    TString name = Form("H.cal.%s.apos_p",cols[k]);
+    fTree->SetBranchStatus(name,1);
+    fTree->SetBranchAddress(name,adc_pos[k]);
+    name = Form("H.cal.%s.aneg_p",cols[k]);
+    fTree->SetBranchStatus(name,1);
+    fTree->SetBranchAddress(name,adc_neg[k]);
+  }
+
+  const Int_t ntr = 6;
+  const char* trnames[ntr] = {"H.tr.x", "H.tr.y", "H.tr.th", "H.tr.ph",
+			      "H.tr.p", "H.tr.tg_dp"};
+  Double_t* traddr[ntr] = {&H_tr_x, &H_tr_y, &H_tr_xp, &H_tr_yp,
+			   &H_tr_p, &H_tr_tg_dp};
+  for (Int_t i=0; i<ntr; i++) {
+    fTree->SetBranchStatus(trnames[i],1);
+    fTree->SetBranchAddress(trnames[i],traddr[i]);
+  }
+
+  fEvents.clear();
+  fHits.clear();
+  fEvents.reserve(fNentries);
+
+  for (UInt_t ientry=0; ientry<fNentries; ientry++) {
+
+    fTree->GetEntry(ientry);
+
+    ShEvent ev;
+    ev.P = H_tr_p;
+    ev.X = H_tr_x+D_CALO_FP*H_tr_xp;
+    ev.Xp = H_tr_xp;
+    ev.Y = H_tr_y+D_CALO_FP*H_tr_yp;
+    ev.Yp = H_tr_yp;
+    ev.delta = H_tr_tg_dp;
+    ev.Enorm0 = 0.;
+    ev.first = fHits.size();
+
+    for (UInt_t j=0; j<THcShTrack::fNrows; j++) {
+      for (UInt_t k=0; k<THcShTrack::fNcols; k++) {
+	if (adc_pos[k][j]>0. || adc_neg[k][j]>0.) {
+	  ShHit hit;
+	  hit.adc_pos = adc_pos[k][j];
+	  hit.adc_neg = adc_neg[k][j];
+	  hit.nb = j+1 + k*THcShTrack::fNrows;
+	  fHits.push_back(hit);
+	}
+      }
+    }
+
+    ev.nhits = fHits.size() - ev.first;
+    fEvents.push_back(ev);
+  }
+
+  fTree->ResetBranchAddresses();
+  fTree->SetBranchStatus("*",1);
+
+  cout << "LoadTracks: " << fEvents.size() << " events, " << fHits.size()
+       << " hits read in " << timer.RealTime() << " s" << endl;
+}
+
+//------------------------------------------------------------------------------
+
+Double_t THcShowerCalib::SetEs(const ShEvent& ev, const Double_t* alpha,
+			       Double_t* epos, Double_t* eneg) const {
+
+  // Energy depositions of the hits of event ev seen from the positive and
+  // negative sides, with gain constants alpha, as THcShTrack::SetEs.
+  // Returns the energy deposition normalized to the track momentum.
+
+  Double_t sum = 0.;
+
+  for (UInt_t i=0; i<ev.nhits; i++) {
+
+    const ShHit& hit = fHits[ev.first+i];
+    UInt_t nblk = hit.nb;
+
+    Int_t ncol=(nblk-1)/THcShTrack::fNrows+1;
+    Double_t yh=ev.Y+ev.Yp*(ncol-0.5)*THcShTrack::fZbl;
+    Double_t ep, en;
+    if (nblk <= THcShTrack::fNnegs) {
+      ep = hit.adc_pos*THcShTrack::Ycor(yh,0)*alpha[nblk-1];
+      en = hit.adc_neg*THcShTrack::Ycor(yh,1)*alpha[THcShTrack::fNblks+nblk-1];
+    }
+    else {
+      ep = hit.adc_pos*THcShTrack::Ycor(yh)*alpha[nblk-1];
+      en = 0.;
+    };
+
+    if (epos) epos[i] = ep;
+    if (eneg) eneg[i] = en;
+    sum += ep + en;
+  }
+
+  return sum/ev.P/1000.;
+}
+
+//------------------------------------------------------------------------------
+
 void THcShowerCalib::CalcThresholds() {
 
   // Calculate +/-3 RMS thresholds on the uncalibrated total energy
@@ -182,17 +364,14 @@ void THcShowerCalib::CalcThresholds() {
   // histogram, establish +/-3 * RMS thresholds.
 
   Int_t nev = 0;
-  THcShTrack trk;
 
   for (UInt_t ientry=0; ientry<fNentries; ientry++) {
 
-    ReadShRawTrack(trk, ientry);
-
-    //    trk.Print(cout);
-    //    getchar();
+    ShEvent& ev = fEvents[ientry];
 
-    trk.SetEs(falpha0);             //Use initial gain constants here.
-    Double_t Enorm = trk.Enorm();
+    //Use initial gain constants here, save for ComposeVMs.
+    Double_t Enorm = SetEs(ev, falpha0, 0, 0);
+    ev.Enorm0 = Enorm;
 
     nev++;
     //    cout << "CalcThreshods: nev=" << nev << "  Enorm=" << Enorm << endl;
@@ -231,92 +410,17 @@ void THcShowerCalib::CalcThresholds() {
 void THcShowerCalib::ReadShRawTrack(THcShTrack &trk, UInt_t ientry) {
 
   //
-  // Set a Shower track event from ntuple ientry.
+  // Set a Shower track event from entry ientry of the ntuple, as read
+  // into memory by Init.
   //
 
-  // Declaration of leaves types
-
-  // Calorimeter ADC signals.
-
-  Double_t        H_cal_1pr_aneg_p[THcShTrack::fNrows];
-  Double_t        H_cal_1pr_apos_p[THcShTrack::fNrows];
-
-  Double_t        H_cal_2ta_aneg_p[THcShTrack::fNrows];
-  Double_t        H_cal_2ta_apos_p[THcShTrack::fNrows];
-
-  Double_t        H_cal_3ta_aneg_p[THcShTrack::fNrows];
-  Double_t        H_cal_3ta_apos_p[THcShTrack::fNrows];
+  const ShEvent& ev = fEvents[ientry];
 
-  Double_t        H_cal_4ta_aneg_p[THcShTrack::fNrows];
-  Double_t        H_cal_4ta_apos_p[THcShTrack::fNrows];
+  trk.Reset(ev.P, ev.X, ev.Xp, ev.Y, ev.Yp);
 
-  // Track parameters.
-
-  Double_t        H_tr_p;
-  Double_t        H_tr_x;   //X FP
-  Double_t        H_tr_xp;
-  Double_t        H_tr_y;   //Y FP
-  Double_t        H_tr_yp;
-
-  // Set branch addresses.
-
-  fTree->SetBranchAddress("H.cal.1pr.aneg_p",H_cal_1pr_aneg_p);
-  fTree->SetBranchAddress("H.cal.1pr.apos_p",H_cal_1pr_apos_p);
-
-  fTree->SetBranchAddress("H.cal.2ta.aneg_p",H_cal_2ta_aneg_p);
-  fTree->SetBranchAddress("H.cal.2ta.apos_p",H_cal_2ta_apos_p);
-
-  fTree->SetBranchAddress("H.cal.3ta.aneg_p",H_cal_3ta_aneg_p);
-  fTree->SetBranchAddress("H.cal.3ta.apos_p",H_cal_3ta_apos_p);
-
-  fTree->SetBranchAddress("H.cal.4ta.aneg_p",H_cal_4ta_aneg_p);
-  fTree->SetBranchAddress("H.cal.4ta.apos_p",H_cal_4ta_apos_p);
-
-  fTree->SetBranchAddress("H.tr.x",&H_tr_x);
-  fTree->SetBranchAddress("H.tr.y",&H_tr_y);
-  fTree->SetBranchAddress("H.tr.th",&H_tr_xp);
-  fTree->SetBranchAddress("H.tr.ph",&H_tr_yp);
-  fTree->SetBranchAddress("H.tr.p",&H_tr_p);
-
-  fTree->GetEntry(ientry);
-
-  trk.Reset(H_tr_p, H_tr_x+D_CALO_FP*H_tr_xp, H_tr_xp,
-	    H_tr_y+D_CALO_FP*H_tr_yp, H_tr_yp);
-
-  for (UInt_t j=0; j<THcShTrack::fNrows; j++) {
-    for (UInt_t k=0; k<THcShTrack::fNcols; k++) {
-
-      Double_t adc_pos, adc_neg;
-
-      switch (k) {
-      case 0 : 
-	adc_pos = H_cal_1pr_apos_p[j];
-	adc_neg = H_cal_1pr_aneg_p[j];
-	break;
-      case 1 : 
-	adc_pos = H_cal_2ta_apos_p[j];
-	adc_neg = H_cal_2ta_aneg_p[j];
-	break;
-      case 2 : 
-	adc_pos = H_cal_3ta_apos_p[j];
-	adc_neg = H_cal_3ta_aneg_p[j];
-	break;
-      case 3 : 
-	adc_pos = H_cal_4ta_apos_p[j];
-	adc_neg = H_cal_4ta_aneg_p[j];
-	break;
-      default:
-	cout << "*** ReadShRawTrack: column number k=" << k
-	     << " out of range! ***" << endl;
-      };
-
-      UInt_t nb = j+1 + k*THcShTrack::fNrows;
-
-      if (adc_pos>0. || adc_neg>0.) {
-	trk.AddHit(adc_pos, adc_neg, 0., 0., nb);
-      }
-
-    }
+  for (UInt_t i=0; i<ev.nhits; i++) {
+    const ShHit& hit = fHits[ev.first+i];
+    trk.AddHit(hit.adc_pos, hit.adc_neg, 0., 0., hit.nb);
   }
 
 }
@@ -329,88 +433,65 @@ void THcShowerCalib::ComposeVMs() {
   // Fill in vectors and matrixes for the gain constant calculations.
   //
 
-  fNev = 0;
-  THcShTrack trk;
+  TStopwatch timer;
 
-  // Loop over the shower track events in the ntuples.
+  // Split the events between threads, each with its own partial sums.
 
-  for (UInt_t ientry=0; ientry<fNentries; ientry++) {
-
-    ReadShRawTrack(trk, ientry);
-
-    // Set energy depositions with default gains.
-    // Calculate normalized to the track momentum total energy deposition,
-    // check it against the thresholds.
-
-    trk.SetEs(falpha0);
-    Double_t Enorm = trk.Enorm();
-    if (Enorm>fLoThr && Enorm<fHiThr) {
-
-      trk.SetEs(falpha1);   // Set energies with unit gains for now.
-      // trk.Print(cout);
-
-      fe0 += trk.GetP();    // Accumulate track momenta.
-
-      vector<pmt_hit> pmt_hit_list;     // Container to save PMT hits
-
-      // Loop over hits.
-
-      for (UInt_t i=0; i<trk.GetNhits(); i++) {
-
-	THcShHit* hit = trk.GetHit(i);
-	// hit->Print(cout);
-
-	UInt_t nb = hit->GetBlkNumber();
-
-	// Fill the qe and q0 vectors (for positive side PMT).
-
-	fqe[nb-1] += hit->GetEpos() * trk.GetP();
-	fq0[nb-1] += hit->GetEpos();
-
-	// Save the PMT hit.
-
-	pmt_hit_list.push_back( pmt_hit{hit->GetEpos(), nb} );
-
-	fHitCount[nb-1]++;   //Accrue the hit counter.
-
-	// Do same for the negative side PMTs.
-
-	if (nb <= THcShTrack::fNnegs) {
-	  fqe[THcShTrack::fNblks+nb-1] += hit->GetEneg() * trk.GetP();
-	  fq0[THcShTrack::fNblks+nb-1] += hit->GetEneg();
-
-	  pmt_hit_list.push_back(pmt_hit{hit->GetEneg(),
-		THcShTrack::fNblks+nb} );
-
-	  fHitCount[THcShTrack::fNblks+nb-1]++;
-	};
-
-      }      //over hits
-
-      // Fill in the correlation matrix Q by retrieving the PMT hits.
-
-      for (vector<pmt_hit>::iterator i=pmt_hit_list.begin();
-	   i < pmt_hit_list.end(); i++) {
-
-	UInt_t ic = (*i).channel;
-	Double_t is = (*i).signal;
-
-	for (vector<pmt_hit>::iterator j=i;
-	     j < pmt_hit_list.end(); j++) {
-
-	  UInt_t jc = (*j).channel;
-	  Double_t js = (*j).signal;
+  Int_t nthreads = fNThreads;
+  if (nthreads <= 0) {
+    SysInfo_t info;
+    nthreads = (gSystem->GetSysInfo(&info) == 0 && info.fCpus > 0) ?
+      info.fCpus : 1;
+  }
+  if (nthreads > (Int_t)fNentries/1000+1) nthreads = fNentries/1000+1;
+
+  vector<VMSums*> sums(nthreads);
+  for (Int_t t=0; t<nthreads; t++) {
+    sums[t] = new VMSums;
+    memset(sums[t], 0, sizeof(VMSums));
+    sums[t]->calib = this;
+    sums[t]->first = (ULong64_t)fNentries*t/nthreads;
+    sums[t]->last = (ULong64_t)fNentries*(t+1)/nthreads;
+  }
 
-	  fQ[ic-1][jc-1] += is*js;
-	  if (jc != ic) fQ[jc-1][ic-1] += is*js;
-	}
-      }
+  if (nthreads == 1)
+    AccumulateVMs(*sums[0]);
+  else {
+    TThread::Initialize();
+    vector<TThread*> threads(nthreads);
+    for (Int_t t=0; t<nthreads; t++) {
+      threads[t] = new TThread(VMThread, sums[t]);
+      threads[t]->Run();
+    }
+    for (Int_t t=0; t<nthreads; t++) {
+      threads[t]->Join();
+      delete threads[t];
+    }
+  }
 
-      fNev++;
+  // Add up the partial sums, in order, and fill in the lower triangle
+  // of Q.
 
-    };   // if within the thresholds
+  fNev = 0;
+  for (Int_t t=0; t<nthreads; t++) {
+    VMSums* s = sums[t];
+    fNev += s->nev;
+    fe0 += s->e0;
+    for (UInt_t i=0; i<THcShTrack::fNpmts; i++) {
+      fqe[i] += s->qe[i];
+      fq0[i] += s->q0[i];
+      fHitCount[i] += s->hitcount[i];
+      for (UInt_t j=i; j<THcShTrack::fNpmts; j++)
+	fQ[i][j] += s->Q[i][j];
+    }
+    delete s;
+  }
+  for (UInt_t i=0; i<THcShTrack::fNpmts; i++)
+    for (UInt_t j=0; j<i; j++)
+      fQ[i][j] = fQ[j][i];
 
-  };     // over entries
+  cout << "ComposeVMs: " << fNev << " events within thresholds, "
+       << nthreads << " threads, " << timer.RealTime() << " s" << endl;
 
   // Take averages.
 
@@ -449,18 +530,98 @@ void THcShowerCalib::ComposeVMs() {
 
 //------------------------------------------------------------------------------
 
+void* THcShowerCalib::VMThread(void* arg) {
+  VMSums* sums = static_cast<VMSums*>(arg);
+  sums->calib->AccumulateVMs(*sums);
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void THcShowerCalib::AccumulateVMs(VMSums& sums) const {
+
+  //
+  // Accumulate the sums for the vectors and matrix over the events
+  // [sums.first,sums.last) within the thresholds.  Only the upper
+  // triangle of Q is filled.
+  //
+
+  Double_t epos[THcShTrack::fNblks];
+  Double_t eneg[THcShTrack::fNblks];
+  Double_t signal[THcShTrack::fNpmts];   // PMT hits of the event
+  UInt_t channel[THcShTrack::fNpmts];
+
+  for (UInt_t ientry=sums.first; ientry<sums.last; ientry++) {
+
+    const ShEvent& ev = fEvents[ientry];
+
+    // Normalized energy deposition with the default gains, checked
+    // against the thresholds.
+
+    if (!(ev.Enorm0>fLoThr && ev.Enorm0<fHiThr)) continue;
+
+    SetEs(ev, falpha1, epos, eneg);   // Set energies with unit gains for now.
+
+    Double_t P = ev.P*1000.;
+    sums.e0 += P;                     // Accumulate track momenta.
+
+    UInt_t npmt = 0;
+
+    for (UInt_t i=0; i<ev.nhits; i++) {
+
+      UInt_t nb = fHits[ev.first+i].nb;
+
+      // Fill the qe and q0 vectors (for positive side PMT).
+
+      sums.qe[nb-1] += epos[i] * P;
+      sums.q0[nb-1] += epos[i];
+      sums.hitcount[nb-1]++;
+      signal[npmt] = epos[i];
+      channel[npmt++] = nb-1;
+
+      // Do same for the negative side PMTs.
+
+      if (nb <= THcShTrack::fNnegs) {
+	UInt_t ic = THcShTrack::fNblks+nb-1;
+	sums.qe[ic] += eneg[i] * P;
+	sums.q0[ic] += eneg[i];
+	sums.hitcount[ic]++;
+	signal[npmt] = eneg[i];
+	channel[npmt++] = ic;
+      }
+
+    }
+
+    // The correlation matrix Q from the PMT hits.
+
+    for (UInt_t i=0; i<npmt; i++) {
+      for (UInt_t j=i; j<npmt; j++) {
+	UInt_t ic = TMath::Min(channel[i],channel[j]);
+	UInt_t jc = TMath::Max(channel[i],channel[j]);
+	sums.Q[ic][jc] += signal[i]*signal[j];
+      }
+    }
+
+    sums.nev++;
+  }
+
+}
+
+//------------------------------------------------------------------------------
+
 void THcShowerCalib::SolveAlphas() {
 
   //
-  // Solve for the sought calibration constants, by use of the Root
-  // matrix algebra package.
+  // Solve for the sought calibration constants. The symmetric matrix Q
+  // is kept packed and factorized once (LDL^T) for both right hand sides.
   //
 
-  TMatrixD Q(THcShTrack::fNpmts,THcShTrack::fNpmts);
-  TVectorD q0(THcShTrack::fNpmts);
-  TVectorD qe(THcShTrack::fNpmts);
-  TVectorD au(THcShTrack::fNpmts);
-  TVectorD ac(THcShTrack::fNpmts);
+  const UInt_t npmts = THcShTrack::fNpmts;
+  THcSymSolver Q(npmts);
+  vector<Double_t> q0(npmts);
+  vector<Double_t> qe(npmts);
+  vector<Double_t> au(npmts);
+  vector<Double_t> ac(npmts);
   Bool_t ok;
 
   cout << "Solving Alphas..." << endl;
@@ -489,13 +650,13 @@ void THcShowerCalib::SolveAlphas() {
     cout << setw(6) << fHitCount[j++] << ",";
   cout << endl;
 
-  // Initialize the vectors and the matrix of the Root algebra package.
+  // Initialize the vectors and the matrix of the solver.
 
-  for (UInt_t i=0; i<THcShTrack::fNpmts; i++) {
+  for (UInt_t i=0; i<npmts; i++) {
     q0[i] = fq0[i];
     qe[i] = fqe[i];
-    for (UInt_t k=0; k<THcShTrack::fNpmts; k++) {
-      Q[i][k] = fQ[i][k];
+    for (UInt_t k=i; k<npmts; k++) {
+      Q(i,k) = fQ[i][k];
     }
   }
 
@@ -513,9 +674,8 @@ void THcShowerCalib::SolveAlphas() {
 	     << fHitCount[i] << ", q0=" << q0[i] << ", qe=" << qe[i];
 
 	for (UInt_t k=0; k<THcShTrack::fNpmts; k++) {
-	  if (Q[i][k] !=0. || Q[k][i] !=0.)
-	    cout << ", Q[" << i << "," << k << "]=" << Q[i][k]
-		 << ", Q[" << k << "," << i << "]=" << Q[k][i];
+	  if (Q(i,k) !=0.)
+	    cout << ", Q[" << i << "," << k << "]=" << Q(i,k);
 	}
 
 	cout << " ***" << endl;
@@ -547,51 +707,53 @@ void THcShowerCalib::SolveAlphas() {
 	   << " hits, will not be calibrated." << endl;
       q0[i] = 0.;
       qe[i] = 0.;
-      for (UInt_t k=0; k<THcShTrack::fNpmts; k++) {
-	Q[i][k] = 0.;
-	Q[k][i] = 0.;
+      for (UInt_t k=0; k<npmts; k++) {
+	Q(i,k) = 0.;
       }
-      Q[i][i] = 1.;
+      Q(i,i) = 1.;
     }
 
   }
 
-  // Declare LU decomposition method for the correlation matrix Q.
-
-  TDecompLU lu(Q);
-  Double_t d1,d2;
-  lu.Det(d1,d2);
-  cout << "cond:" << lu.Condition() << endl;
-  cout << "det :" << d1*TMath::Power(2.,d2) << endl;
-  cout << "tol :" << lu.GetTol() << endl;
+  // Factorize the correlation matrix Q.
+
+  ok = Q.Factorize();
+  Int_t sign;
+  Double_t logdet = Q.LogDet(sign);
+  cout << "cond:" << Q.Condition() << endl;
+  cout << "det :" << (sign<0 ? "-" : "") << "10^" << logdet << endl;
+  if (!ok) {
+    cout << "*** SolveAlphas: singular correlation matrix, no constants ***"
+	 << endl;
+    return;
+  }
 
   // Solve equation Q x au = qe for the 'unconstrained' calibration (gain)
   // constants au.
 
-  au = lu.Solve(qe,ok);
-  cout << "au: ok=" << ok << endl;
-  //  au.Print();
+  ok = Q.Solve(qe,au);
+  cout << "au: ok=" << ok << ", residual=" << Q.GetResidual() << endl;
 
   // Find the sought 'constrained' calibration constants next.
 
-  Double_t t1 = fe0 - au * q0;         // temporary variable.
+  Double_t t1 = fe0;                   // temporary variable.
+  for (UInt_t i=0; i<npmts; i++) t1 -= au[i] * q0[i];
   //  cout << "t1 =" << t1 << endl;
 
-  TVectorD Qiq0(THcShTrack::fNpmts);   // an intermittent result
-  Qiq0 = lu.Solve(q0,ok);
-  cout << "Qiq0: ok=" << ok << endl;
-  //  Qiq0.Print();
+  vector<Double_t> Qiq0(npmts);        // an intermittent result
+  ok = Q.Solve(q0,Qiq0);
+  cout << "Qiq0: ok=" << ok << ", residual=" << Q.GetResidual() << endl;
 
-  Double_t t2 = q0 * Qiq0;             // another temporary variable
+  Double_t t2 = 0.;                    // another temporary variable
+  for (UInt_t i=0; i<npmts; i++) t2 += q0[i] * Qiq0[i];
   //  cout << "t2 =" << t2 << endl;
 
-  ac = (t1/t2) *Qiq0 + au;             // the sought gain constants
-  //  cout << "ac:" << endl;
-  //  ac.Print();
+  for (UInt_t i=0; i<npmts; i++)
+    ac[i] = (t1/t2) * Qiq0[i] + au[i]; // the sought gain constants
 
   // Assign the gain arrays.
 
-  for (UInt_t i=0; i<THcShTrack::fNpmts; i++) {
+  for (UInt_t i=0; i<npmts; i++) {
     falphaU[i] = au[i];
     falphaC[i] = ac[i];
   }
@@ -612,22 +774,17 @@ void THcShowerCalib::FillHEcal() {
 
   Int_t nev = 0;
 
-  THcShTrack trk;
-
   for (UInt_t ientry=0; ientry<fNentries; ientry++) {
 
-    ReadShRawTrack(trk, ientry);
-    //    trk.Print(cout);
+    const ShEvent& ev = fEvents[ientry];
 
-    trk.SetEs(falphaC);          // use the 'constrained' calibration constants
-    Double_t P = trk.GetP();
-    Double_t Enorm = trk.Enorm();
+    // use the 'constrained' calibration constants
+    Double_t Enorm = SetEs(ev, falphaC, 0, 0);
+    Double_t P = ev.P*1000.;
 
     hEcal->Fill(Enorm);
 
-    Double_t delta;
-    fTree->SetBranchAddress("H.tr.tg_dp",&delta);
-    hDPvsEcal->Fill(Enorm,delta,1.);
+    hDPvsEcal->Fill(Enorm,ev.delta,1.);
 
     output << Enorm*P/1000. << " " << P/1000. << endl;
 
@@ -51,5 +51,23 @@
 #pragma link C++ class THcRaster+;
 #pragma link C++ class THcRasteredBeam+;
 #pragma link C++ class THcRasterRawHit+;
+#pragma link C++ class THcPedestalTracker+;
+#pragma link C++ class THcReconMatrix+;
+#pragma link C++ class THcDecodeGraph+;
+#pragma link C++ class THcTaskPool+;
+#pragma link C++ class THcApparatusGroup+;
+#pragma link C++ class THcRun+;
+#pragma link C++ class THcProfiler+;
+#pragma link C++ class THcSimDecoder+;
+#pragma link C++ class THcOutputCompare+;
+#pragma link C++ class THcPrefilter+;
+#pragma link C++ class THcEventIndex+;
+#pragma link C++ class THcShowerGainCalib+;
+#pragma link C++ class THcSymSolver+;
+#pragma link C++ class THcHodoTimeCalib+;
+#pragma link C++ class THcHitCache+;
+#pragma link C++ class THcHitCacheRun+;
+#pragma link C++ class THcCalibDriver+;
+#pragma link C++ class THcDCResidualCalib+;
 
 #endif
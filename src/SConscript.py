@@ -25,10 +25,28 @@ THcRawShowerHit.cxx \
 THcAerogel.cxx THcAerogelHit.cxx \
 THcCherenkov.cxx THcCherenkovHit.cxx \
 THcFormula.cxx \
-THcRaster.cxx THcRasteredBeam.cxx THcRasterRawHit.cxx
+THcRaster.cxx THcRasteredBeam.cxx THcRasterRawHit.cxx \
+THcPedestalTracker.cxx \
+THcReconMatrix.cxx \
+THcDecodeGraph.cxx \
+THcTaskPool.cxx THcApparatusGroup.cxx \
+THcRun.cxx \
+THcProfiler.cxx \
+THcSimDecoder.cxx \
+THcOutputCompare.cxx \
+THcPrefilter.cxx \
+THcEventIndex.cxx \
+THcShowerGainCalib.cxx \
+THcSymSolver.cxx \
+THcHodoTimeCalib.cxx \
+THcHitCache.cxx \
+THcHitCacheRun.cxx \
+THcCalibDriver.cxx \
+THcDCResidualCalib.cxx
 """)
 
 pbaseenv.Object('main.C')
+pbaseenv.Object('hcbench.C')
 
 sotarget = 'HallC'
 
@@ -10,6 +10,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "THcAerogel.h"
+#include "THcProfiler.h"
 #include "TClonesArray.h"
 #include "THcSignalHit.h"
 #include "THaEvData.h"
@@ -26,6 +27,7 @@
 #include "TMath.h"
 
 #include "THaTrackProj.h"
+#include "THcPedestalTracker.h"
 
 #include <cstring>
 #include <cstdio>
@@ -93,12 +95,7 @@ void THcAerogel::InitArrays()
   fNegPedMean = NULL;
   fPosNpe = NULL;
   fNegNpe = NULL;
-  fPosPedSum = NULL;
-  fPosPedSum2 = NULL;
-  fPosPedCount = NULL;
-  fNegPedSum = NULL;
-  fNegPedSum2 = NULL;
-  fNegPedCount = NULL;
+  fPedestals = NULL;
   fPosPed = NULL;
   fPosSig = NULL;
   fPosThresh = NULL;
@@ -123,12 +120,7 @@ void THcAerogel::DeleteArrays()
   delete [] fNegPedMean; fNegPedMean = NULL;
   delete [] fPosNpe; fPosNpe = NULL;
   delete [] fNegNpe; fNegNpe = NULL;
-  delete [] fPosPedSum; fPosPedSum = NULL;
-  delete [] fPosPedSum2; fPosPedSum2 = NULL;
-  delete [] fPosPedCount; fPosPedCount = NULL;
-  delete [] fNegPedSum; fNegPedSum = NULL;
-  delete [] fNegPedSum2; fNegPedSum2 = NULL;
-  delete [] fNegPedCount; fNegPedCount = NULL;
+  delete fPedestals; fPedestals = NULL;
   delete [] fPosPed; fPosPed = NULL;
   delete [] fPosSig; fPosSig = NULL;
   delete [] fPosThresh; fPosThresh = NULL;
@@ -204,8 +196,10 @@ Int_t THcAerogel::ReadDatabase( const TDatime& date )
     {"aero_neg_ped_limit", fNegPedLimit, kInt, (UInt_t) fNelem},
     {"aero_pos_ped_mean", fPosPedMean, kDouble, (UInt_t) fNelem,optional},
     {"aero_neg_ped_mean", fNegPedMean, kDouble, (UInt_t) fNelem,optional},
+    {"aero_ped_window", &fPedWindow, kInt, 0, optional},
     {0}
   };
+  fPedWindow = 0;		// Default if not defined
   gHcParms->LoadParmValues((DBRequest*)&list,prefix);
 
   fIsInit = true;
@@ -254,6 +248,7 @@ Int_t THcAerogel::DefineVariables( EMode mode )
     {"ntdc_pos_hits", "Number of Positive Tube Hits", "fNTDCPosHits"},
     {"ntdc_neg_hits", "Number of Negative Tube Hits", "fNTDCNegHits"},
     {"ngood_hits", "Total number of good hits", "fNGoodHits"},
+    {"nrawhits", "Number of raw hits after decode", "fNRawHits"},
     { 0 }
   };
 
@@ -300,10 +295,12 @@ void THcAerogel::Clear(Option_t* opt)
 //_____________________________________________________________________________
 Int_t THcAerogel::Decode( const THaEvData& evdata )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kDecode);
+
   // Get the Hall C style hitlist (fRawHitList) for this event
   fNhits = DecodeToHitList(evdata);
 
-  if(gHaCuts->Result("Pedestal_event")) {
+  if(IsPedestalEvent()) {
 
     AccumulatePedestals(fRawHitList);
 
@@ -365,6 +362,8 @@ Int_t THcAerogel::ApplyCorrections( void )
 //_____________________________________________________________________________
 Int_t THcAerogel::CoarseProcess( TClonesArray&  ) //tracks
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseProcess);
+
   
   for(Int_t ihit=0; ihit < fNhits; ihit++) {
     THcAerogelHit* hit = (THcAerogelHit *) fRawHitList->At(ihit);
@@ -469,6 +468,7 @@ Int_t THcAerogel::CoarseProcess( TClonesArray&  ) //tracks
 //_____________________________________________________________________________
 Int_t THcAerogel::FineProcess( TClonesArray& tracks )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kFineProcess);
 
   return 0;
 }
@@ -476,31 +476,24 @@ Int_t THcAerogel::FineProcess( TClonesArray& tracks )
 //_____________________________________________________________________________
 void THcAerogel::InitializePedestals( )
 {
-  fNPedestalEvents = 0;
   fMinPeds = 500; 		// In engine, this is set in parameter file
-  fPosPedSum = new Int_t [fNelem];
-  fPosPedSum2 = new Int_t [fNelem];
-  fPosPedLimit = new Int_t [fNelem];
-  fPosPedCount = new Int_t [fNelem];
-  fNegPedSum = new Int_t [fNelem];
-  fNegPedSum2 = new Int_t [fNelem];
-  fNegPedLimit = new Int_t [fNelem];
-  fNegPedCount = new Int_t [fNelem];
+
+  // Pedestal limits from the parameter file.
+  std::vector<Int_t> limits(2*fNelem);
+  for(Int_t i=0;i<fNelem;i++) {
+    limits[i] = fPosPedLimit[i];
+    limits[fNelem+i] = fNegPedLimit[i];
+  }
+
+  delete fPedestals;
+  fPedestals = new THcPedestalTracker(2*fNelem);
+  fPedestals->Init(fMinPeds, &limits[0]);
+  fPedestals->SetWindow(fPedWindow);
 
   fPosPed = new Double_t [fNelem];
   fNegPed = new Double_t [fNelem];
   fPosThresh = new Double_t [fNelem];
   fNegThresh = new Double_t [fNelem];
-  for(Int_t i=0;i<fNelem;i++) {
-    fPosPedSum[i] = 0;
-    fPosPedSum2[i] = 0;
-    fPosPedLimit[i] = 1000;	// In engine, this are set in parameter file
-    fPosPedCount[i] = 0;
-    fNegPedSum[i] = 0;
-    fNegPedSum2[i] = 0;
-    fNegPedLimit[i] = 1000;	// In engine, this are set in parameter file
-    fNegPedCount[i] = 0;
-  }
 
   fPosNpe = new Double_t [fNelem];
   fNegNpe = new Double_t [fNelem];
@@ -521,26 +514,12 @@ void THcAerogel::AccumulatePedestals(TClonesArray* rawhits)
     Int_t element = hit->fCounter - 1;
     Int_t adcpos = hit->fADC_pos;
     Int_t adcneg = hit->fADC_pos;
-    if(adcpos <= fPosPedLimit[element]) {
-      fPosPedSum[element] += adcpos;
-      fPosPedSum2[element] += adcpos*adcpos;
-      fPosPedCount[element]++;
-      if(fPosPedCount[element] == fMinPeds/5) {
-	fPosPedLimit[element] = 100 + fPosPedSum[element]/fPosPedCount[element];
-      }
-    }
-    if(adcneg <= fNegPedLimit[element]) {
-      fNegPedSum[element] += adcneg;
-      fNegPedSum2[element] += adcneg*adcneg;
-      fNegPedCount[element]++;
-      if(fNegPedCount[element] == fMinPeds/5) {
-	fNegPedLimit[element] = 100 + fNegPedSum[element]/fNegPedCount[element];
-      }
-    }
+    fPedestals->Fill(element, adcpos);
+    fPedestals->Fill(fNelem+element, adcneg);
     ihit++;
   }
 
-  fNPedestalEvents++;
+  fPedestals->EndEvent();
 
   return;
 }
@@ -551,14 +530,16 @@ void THcAerogel::CalculatePedestals( )
   // Use the accumulated pedestal data to calculate pedestals
   // Later add check to see if pedestals have drifted ("Danger Will Robinson!")
   //  cout << "Plane: " << fPlaneNum << endl;
+  fPedestals->Calculate();
+
   for(Int_t i=0; i<fNelem;i++) {
     
     // Positive tubes
-    fPosPed[i] = ((Double_t) fPosPedSum[i]) / TMath::Max(1, fPosPedCount[i]);
+    fPosPed[i] = fPedestals->GetPed(i);
     fPosThresh[i] = fPosPed[i] + 15;
 
     // Negative tubes
-    fNegPed[i] = ((Double_t) fNegPedSum[i]) / TMath::Max(1, fNegPedCount[i]);
+    fNegPed[i] = fPedestals->GetPed(fNelem+i);
     fNegThresh[i] = fNegPed[i] + 15;
 
     //    cout << i+1 << " " << fPosPed[i] << " " << fNegPed[i] << endl;
@@ -568,10 +549,10 @@ void THcAerogel::CalculatePedestals( )
     // pedestal events.  (So that pedestals are sensible even if the pedestal events were
     // not acquired.)
     if(fMinPeds > 0) {
-      if(fPosPedCount[i] > fMinPeds) {
+      if(fPedestals->GetCount(i) > fMinPeds) {
 	fPosPedMean[i] = fPosPed[i];
       }
-      if(fNegPedCount[i] > fMinPeds) {
+      if(fPedestals->GetCount(fNelem+i) > fMinPeds) {
 	fNegPedMean[i] = fNegPed[i];
       }
     }
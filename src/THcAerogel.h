@@ -12,6 +12,8 @@
 #include "THcHitList.h"
 #include "THcAerogelHit.h"
 
+class THcPedestalTracker;
+
 class THcAerogel : public THaNonTrackingDetector, public THcHitList {
 
  public:
@@ -73,16 +75,12 @@ class THcAerogel : public THaNonTrackingDetector, public THcHitList {
   TClonesArray* fNegADCHits;
 
   // Pedestals
-  Int_t fNPedestalEvents;
   Int_t fMinPeds;
-  Int_t *fPosPedSum;		/* Accumulators for pedestals */
-  Int_t *fPosPedSum2;
+  Int_t fPedWindow;		/* Running pedestal window, 0 = whole run */
   Int_t *fPosPedLimit;
-  Int_t *fPosPedCount;
-  Int_t *fNegPedSum;
-  Int_t *fNegPedSum2;
   Int_t *fNegPedLimit;
-  Int_t *fNegPedCount;
+  THcPedestalTracker* fPedestals; /* Pedestal accumulator, positive tubes
+				     first, then negative */
 
   Double_t *fPosPed;
   Double_t *fPosSig;
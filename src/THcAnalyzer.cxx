@@ -19,18 +19,101 @@
 // Hall C has their own analyzer class because some things are bound to
 // be different.
 //
+// Event parallel replay: SetWorker(i,n) makes Process analyze only the
+// i-th of n contiguous slices of the run's event range (set with
+// THaRunBase::SetEventRange), writing to GetWorkerFileName(outfile,i).
+// Running n such processes and merging with MergeWorkerOutput gives the
+// output of the whole range in event order.  So that every worker has
+// the pedestals a serial replay has at the start of its slice, a worker
+// first analyzes the pedestal events (type SetPedestalEvtype, default 4)
+// of the range before its slice as a lead-in, without output and
+// post-processing; all other events before the slice are skipped.
+//
+// The workers are processes, not threads of one process, because podd
+// processes events with objects a process has only one of: THaAnalyzer
+// allows a single instance, every analysis object defines its variables
+// by name in gHaVars, where THaOutput, the cuts and the formulas find
+// them at Init, and the cut results are kept in the THaCut objects of
+// gHaCuts.  A second set of apparatus could neither define its variables
+// under the names the output definition and the cuts use, nor evaluate
+// the cuts without overwriting the results of the first.
+//
+// If the run is a THcRun with an event index (THcRun::UseIndex, built by
+// Process in worker mode if the run has none), Process seeks to the first
+// event of the event range instead of reading all events before it, and
+// worker mode splits the range into pieces of equal size in bytes, each
+// read from its own offset.  The lead-in of a worker is then only the
+// pedestal events before its slice, read one by one (THcRun::SetLeadIn).
+// The event range may be open ended.  Ranges count events as set with
+// SetCountMode.
+//
+// Within an event, SetApparatusThreads(n) runs the stages of the Hall C
+// spectrometers (e.g. HMS and SOS) concurrently on n threads (see
+// THcApparatusGroup); the cuts of each stage are still evaluated after
+// all apparatus have run it.
+//
+// EnableProfiling() times each stage of every Hall C spectrometer and
+// hit list detector (see THcProfiler).  The table is printed at the end
+// of Process, and the numbers are defined as prof_* variables in
+// gHcParms for use in PrintReport templates.
+//
+// The cuts of the block "Prefilter" of the cut file, if there is one,
+// are tested after Decode on the event type and raw hit counts
+// (<spectrometer>.<detector>.nrawhits).  The Hall C spectrometers skip
+// tracking and reconstruction of events failing any of them (see
+// THcPrefilter), and the number of skipped events is printed at the end
+// of Process.
+//
+// Given a THcHitCacheRun, the hit list detectors build their hit lists
+// from the records of the cache file (written by a THcHitCache module in
+// an earlier replay) instead of decoding the event data.
+//
+// EnableDemandDriven() switches off detector computations whose results
+// nothing reads.  Detectors declare such computations as compute blocks
+// (THcHitList::AddComputeBlock) with the global variables they fill.  At
+// Init the analyzer collects the variables named in the output
+// definition (block patterns included), the cut file and the report
+// template given with SetReportTemplate, plus AddUsedVariables, and
+// switches off the blocks none of whose variables is among them.  The
+// blocks doing real work are the single-stub double residuals of THcDC
+// (a projection of the other chamber's track per hit) and the dE/dx of
+// the hits on the tracks in THcHodoscope, which no variable shows and so
+// is always off.  The raw hit list blocks of the hodoscope and shower
+// planes only save filling the lists.  The per-plane energies of the
+// shower feed etot and the clustering, and are always computed.
+//
 //////////////////////////////////////////////////////////////////////////
 
 #include "THcAnalyzer.h"
 #include "THaRunBase.h"
 #include "THaBenchmark.h"
+#include "THaApparatus.h"
+#include "THaDetector.h"
+#include "THaCutList.h"
+#include "THaCut.h"
+#include "THcHitList.h"
+#include "THcHallCSpectrometer.h"
+#include "THcProfiler.h"
+#include "THcPrefilter.h"
+#include "THcApparatusGroup.h"
+#include "THcRun.h"
+#include "THcHitCacheRun.h"
+#include "THcEventIndex.h"
+#include "TFileMerger.h"
 #include "TList.h"
 #include "THcParmList.h"
 #include "THcFormula.h"
 #include "THcGlobals.h"
 #include "TMath.h"
+#include "TRegexp.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "THaVar.h"
+#include "THaVarList.h"
 
 #include <fstream>
+#include <sstream>
+#include <cctype>
 #include <algorithm>
 #include <iomanip>
 #include <cstring>
@@ -46,7 +129,10 @@ using namespace std;
 // do we need to "close" scalers/EPICS analysis if we reach the event limit?
 
 //_____________________________________________________________________________
-THcAnalyzer::THcAnalyzer()
+THcAnalyzer::THcAnalyzer() : fPedestalEvtype(4), fWorker(0), fNWorkers(1),
+  fSliceFirst(0), fIndexedRun(kFALSE), fProfiler(0),
+  fPrefilter(new THcPrefilter("Prefilter")), fAppThreads(1), fAppGroup(0),
+  fDemandDriven(kFALSE)
 {
 
 }
@@ -56,6 +142,500 @@ THcAnalyzer::~THcAnalyzer()
 {
   // Destructor. 
 
+  delete fProfiler;
+  delete fPrefilter;
+  delete fAppGroup;
+}
+
+//_____________________________________________________________________________
+Int_t THcAnalyzer::Init( THaRunBase* run )
+{
+  // Initialize as THaAnalyzer, then hand the detectors what they need
+  // during event processing so they do not have to look it up in the
+  // global lists for every event.
+
+  Int_t status = THaAnalyzer::Init(run);
+  if( status == 0 )
+    SetupEventContext();
+  return status;
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::SetupEventContext()
+{
+  // Give all hit list based detectors the pedestal event cut and the
+  // hit cache run, if that is the run, the spectrometers the prefilter,
+  // and register the spectrometers and detectors with the profiler.
+  // Group the spectrometers if they are to run concurrently.
+  // Cuts are reloaded by Init, so this is redone for every run.
+
+  const THaCut* pedcut = gHaCuts ? gHaCuts->FindCut("Pedestal_event") : 0;
+  THcPrefilter* prefilter = fPrefilter->Init() > 0 ? fPrefilter : 0;
+
+  // A hit cache run supplies the hit lists of the detectors
+  THcHitCacheRun* cacherun = dynamic_cast<THcHitCacheRun*>(fRun);
+  if( cacherun && cacherun->GetNDetectors() == 0 && !cacherun->IsOpen() ) {
+    cacherun->Open();			// Read the detector names
+    cacherun->Close();
+  }
+
+  delete fAppGroup;
+  fAppGroup = 0;
+  std::vector<THcHallCSpectrometer*> specs;
+
+  TIter nextapp(fApps);
+  while( THaApparatus* app = static_cast<THaApparatus*>( nextapp() )) {
+    THcHallCSpectrometer* spec = dynamic_cast<THcHallCSpectrometer*>(app);
+    if( spec ) {
+      spec->SetProfiler(fProfiler, fProfiler ? fProfiler->Register(app->GetName()) : -1);
+      spec->SetPrefilter(prefilter);
+      spec->SetApparatusGroup(0);
+      specs.push_back(spec);
+    }
+    TIter nextdet(app->GetDetectors());
+    while( THaDetector* det = static_cast<THaDetector*>( nextdet() )) {
+      THcHitList* hitlist = dynamic_cast<THcHitList*>(det);
+      if( !hitlist ) continue;
+      hitlist->SetPedestalCut(pedcut);
+      Int_t id = -1;
+      if( fProfiler )
+	id = fProfiler->Register(Form("%s.%s",app->GetName(),det->GetName()));
+      hitlist->SetProfiler(fProfiler, id);
+      if( cacherun ) {
+	const char* name = Form("%s.%s",app->GetName(),det->GetName());
+	Int_t cacheid = cacherun->FindDetector(name);
+	if( cacheid < 0 )
+	  Warning("SetupEventContext","No hits of %s in the hit cache",name);
+	hitlist->SetHitCache(cacherun, cacheid);
+      } else
+	hitlist->SetHitCache(0, -1);
+    }
+  }
+  if( fAppThreads > 1 && specs.size() > 1 ) {
+    fAppGroup = new THcApparatusGroup;
+    for( UInt_t i=0; i<specs.size(); i++ )
+      fAppGroup->AddSpectrometer(specs[i]);
+    fAppGroup->SetNThreads(TMath::Min(fAppThreads, (Int_t)specs.size()));
+    if( fVerbose > 1 )
+      fAppGroup->Print();
+  }
+  SetupComputeBlocks();
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::EnableDemandDriven( Bool_t enable )
+{
+  // Compute only the detector compute blocks whose variables are used
+
+  fDemandDriven = enable;
+  if( fIsInit )
+    SetupComputeBlocks();
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::AddUsedVariables( const char* patterns )
+{
+  // Declare global variables as used, e.g. by a macro reading them after
+  // the replay.  patterns is a space separated list of wildcard patterns.
+
+  TString s(patterns);
+  TObjArray* tokens = s.Tokenize(" ");
+  for( Int_t i=0; i<=tokens->GetLast(); i++ ) {
+    fExtraPatterns.push_back(((TObjString*)tokens->At(i))->GetString());
+  }
+  delete tokens;
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::AddUsedNames( const string& text )
+{
+  // Add the names in an expression.  Anything that looks like a variable
+  // name is taken, so the result may contain more than variables.
+
+  string::size_type i = 0;
+  while( i < text.size() ) {
+    if( isalpha(text[i]) || text[i] == '_' ) {
+      string::size_type start = i;
+      while( i < text.size() && (isalnum(text[i]) || text[i] == '_' ||
+				 text[i] == '.' || text[i] == '$') )
+	i++;
+      fUsedNames.push_back(text.substr(start,i-start));
+    } else {
+      i++;
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::FindUsedVariables()
+{
+  // Collect the variables read by the output definition file, the cut
+  // file and the report template
+
+  fUsedPatterns = fExtraPatterns;
+  fUsedNames.clear();
+
+  string line;
+  ifstream odef(fOdefFileName.Data());
+  Bool_t inepics = kFALSE;
+  while( getline(odef,line) ) {
+    string::size_type pos = line.find('#');
+    if( pos != string::npos ) line.erase(pos);
+    istringstream is(line);
+    string key, name;
+    if( !(is >> key) ) continue;
+    for( UInt_t i=0; i<key.size(); i++ ) key[i] = tolower(key[i]);
+    // EPICS variables are not global variables
+    if( key == "begin" ) { inepics = kTRUE; continue; }
+    if( key == "end" ) { inepics = kFALSE; continue; }
+    if( inepics ) continue;
+    if( key == "block" ) {
+      if( is >> name ) fUsedPatterns.push_back(name.c_str());
+    } else {
+      AddUsedNames(line);
+    }
+  }
+
+  ifstream cuts(fCutFileName.Data());
+  while( getline(cuts,line) ) {
+    string::size_type pos = line.find('#');
+    if( pos != string::npos ) line.erase(pos);
+    if( line.find("Block:") != string::npos ) continue;
+    AddUsedNames(line);
+  }
+
+  if( !fReportTemplate.IsNull() ) {
+    ifstream templ(fReportTemplate.Data());
+    while( getline(templ,line) ) {
+      string::size_type start, end = 0;
+      while( (start = line.find('{',end)) != string::npos &&
+	     (end = line.find('}',start)) != string::npos ) {
+	string expression = line.substr(start+1,end-start-1);
+	AddUsedNames(expression.substr(0,expression.find(':')));
+      }
+    }
+  }
+
+  sort(fUsedNames.begin(),fUsedNames.end());
+  fUsedNames.erase(unique(fUsedNames.begin(),fUsedNames.end()),fUsedNames.end());
+}
+
+//_____________________________________________________________________________
+static Bool_t MatchWildcard( const char* name, const char* pattern )
+{
+  // True if all of name matches the wildcard pattern
+
+  TString s(name);
+  TRegexp re(pattern, kTRUE);
+  Ssiz_t len = 0;
+  return s.Index(re, &len) == 0 && len == s.Length();
+}
+
+//_____________________________________________________________________________
+Bool_t THcAnalyzer::IsUsedVariable( const char* name ) const
+{
+  if( binary_search(fUsedNames.begin(),fUsedNames.end(),string(name)) )
+    return kTRUE;
+  for( UInt_t i=0; i<fUsedPatterns.size(); i++ ) {
+    if( MatchWildcard(name,fUsedPatterns[i].Data()) )
+      return kTRUE;
+  }
+  return kFALSE;
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::SetupComputeBlocks()
+{
+  // Switch the compute blocks of the hit list detectors on, or, in
+  // demand driven mode, off if none of their variables is used.
+
+  if( fDemandDriven )
+    FindUsedVariables();
+
+  TIter nextapp(fApps);
+  while( THaApparatus* app = static_cast<THaApparatus*>( nextapp() )) {
+    TIter nextdet(app->GetDetectors());
+    while( THaDetector* det = static_cast<THaDetector*>( nextdet() )) {
+      THcHitList* hitlist = dynamic_cast<THcHitList*>(det);
+      if( !hitlist ) continue;
+      for( Int_t ib=0; ib<hitlist->GetNComputeBlocks(); ib++ ) {
+	if( !fDemandDriven ) {
+	  hitlist->SetComputeBlock(ib, kTRUE);
+	  continue;
+	}
+	// Is any defined variable of the block used?
+	Bool_t used = kFALSE;
+	TString vars(hitlist->GetComputeBlockVars(ib));
+	TObjArray* patterns = vars.Tokenize(" ");
+	for( Int_t ip=0; ip<=patterns->GetLast() && !used; ip++ ) {
+	  TString pattern = det->GetPrefix();
+	  pattern += ((TObjString*)patterns->At(ip))->GetString();
+	  TIter nextvar(gHaVars);
+	  while( THaVar* var = static_cast<THaVar*>( nextvar() )) {
+	    if( MatchWildcard(var->GetName(),pattern.Data()) &&
+		IsUsedVariable(var->GetName()) ) {
+	      used = kTRUE;
+	      break;
+	    }
+	  }
+	}
+	delete patterns;
+	hitlist->SetComputeBlock(ib, used);
+	cout << "Demand driven: " << det->GetPrefix()
+	     << hitlist->GetComputeBlockName(ib) << (used ? " on" : " off") << endl;
+      }
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::EnableProfiling( Bool_t enable )
+{
+  // Switch the event loop profiler on or off. Takes effect at the next Init.
+
+  if( enable && !fProfiler ) {
+    fProfiler = new THcProfiler();
+  } else if( !enable && fProfiler ) {
+    delete fProfiler;
+    fProfiler = 0;
+  }
+  if( fIsInit )
+    SetupEventContext();
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::SetApparatusThreads( Int_t nthreads )
+{
+  // Run the stages of the Hall C spectrometers on nthreads threads.
+  // Takes effect at the next Init.
+
+  fAppThreads = nthreads;
+  if( fIsInit )
+    SetupEventContext();
+}
+
+//_____________________________________________________________________________
+void THcAnalyzer::SetWorker( Int_t iworker, Int_t nworkers )
+{
+  // Analyze only slice iworker (0..nworkers-1) of the event range
+
+  if( nworkers < 1 || iworker < 0 || iworker >= nworkers ) {
+    Error("SetWorker","Invalid worker %d of %d",iworker,nworkers);
+    return;
+  }
+  fWorker = iworker;
+  fNWorkers = nworkers;
+}
+
+//_____________________________________________________________________________
+TString THcAnalyzer::GetWorkerFileName( const char* outfile, Int_t iworker )
+{
+  // Output file of a worker: name.root -> name_w<iworker>.root
+
+  TString name(outfile);
+  Ssiz_t dot = name.Last('.');
+  TString suffix = Form("_w%d",iworker);
+  if( dot == kNPOS )
+    name.Append(suffix);
+  else
+    name.Insert(dot,suffix);
+  return name;
+}
+
+//_____________________________________________________________________________
+Int_t THcAnalyzer::MergeWorkerOutput( const char* outfile, Int_t nworkers )
+{
+  // Merge the output of nworkers workers into outfile.  The trees are
+  // chained in worker order, so the events stay in order.
+
+  TFileMerger merger(kFALSE);
+  if( !merger.OutputFile(outfile) ) {
+    ::Error("THcAnalyzer::MergeWorkerOutput","Cannot open %s",outfile);
+    return -1;
+  }
+  for( Int_t i=0; i<nworkers; i++ ) {
+    TString name = GetWorkerFileName(outfile,i);
+    if( !merger.AddFile(name.Data()) ) {
+      ::Error("THcAnalyzer::MergeWorkerOutput","Cannot open %s",name.Data());
+      return -1;
+    }
+  }
+  return merger.Merge() ? 0 : -1;
+}
+
+//_____________________________________________________________________________
+Int_t THcAnalyzer::Process( THaRunBase* run )
+{
+  // Process the run. In worker mode, process only this worker's slice
+  // of the event range and write to the worker's output file.  A THcRun
+  // in worker mode is given an event index, so that the worker can seek
+  // to the pedestal events before its slice and then to the slice.
+
+  THcRun* hcrun = dynamic_cast<THcRun*>(run);
+  if( hcrun && !hcrun->GetIndex() && fNWorkers > 1 &&
+      hcrun->UseIndex(kFALSE) != 0 )
+    Warning("Process","No event index, reading all events before the slice");
+  if( hcrun && hcrun->GetIndex() )
+    return IndexedProcess(hcrun);
+  if( fNWorkers <= 1 || !run )
+    return ProfiledProcess(run);
+
+  UInt_t first = run->GetFirstEvent();
+  UInt_t last = run->GetLastEvent();
+  if( last == kMaxUInt || last < first ) {
+    Error("Process","Worker mode needs a finite event range, "
+	  "set it with SetEventRange");
+    return -1;
+  }
+  ULong64_t nev = last - first + 1;
+  UInt_t myfirst = first + (UInt_t)((nev*fWorker)/fNWorkers);
+  UInt_t mylast = first + (UInt_t)((nev*(fWorker+1))/fNWorkers) - 1;
+
+  TString outfile = fOutFileName;
+  fOutFileName = GetWorkerFileName(outfile.Data(),fWorker);
+  cout << "Worker " << fWorker << " of " << fNWorkers << ": events "
+       << myfirst << " to " << mylast << " to " << fOutFileName << endl;
+  // Without an index, the lead-in is all events from the start of the
+  // range, of which only the pedestal events are analyzed
+  run->SetEventRange(first,mylast);
+  fSliceFirst = (myfirst > first) ? myfirst : 0;
+
+  Int_t status = ProfiledProcess(run);
+
+  fSliceFirst = 0;
+  run->SetEventRange(first,last);
+  fOutFileName = outfile;
+  return status;
+}
+
+//_____________________________________________________________________________
+Int_t THcAnalyzer::IndexedProcess( THcRun* run )
+{
+  // Process a run with an event index: read only the byte range of the
+  // event range, or of this worker's piece of it, after the pedestal
+  // events of the range before it.  The event range passed on is
+  // shifted by the events skipped, unless events are counted by their
+  // event number.
+
+  THcEventIndex* index = run->GetIndex();
+  UInt_t first = run->GetFirstEvent();
+  UInt_t last = run->GetLastEvent();
+  Int_t nentries = index->GetNEntries();
+  Int_t begin = index->FindEvent(first, fCountMode);
+  Int_t end = (last == kMaxUInt) ? nentries
+    : index->FindEvent(last+1, fCountMode);
+  if( fNWorkers <= 1 && begin == 0 )
+    return ProfiledProcess(run);
+
+  vector<Int_t> starts;
+  index->Split(fNWorkers, begin, end, starts);
+  Int_t mybegin = starts[fWorker];
+  Int_t myend = starts[fWorker+1];
+  UInt_t myfirst = index->GetCount(mybegin, fCountMode);
+  UInt_t mylast = (myend == end) ? last
+    : index->GetCount(myend, fCountMode) - 1;
+  // Lead-in: the pedestal events before the slice, which are physics
+  // events, so each counts as one event
+  vector<Int_t> lead;
+  index->FindType(fPedestalEvtype, begin, mybegin, lead);
+  vector<Long64_t> leadin(lead.size());
+  for( UInt_t i=0; i<lead.size(); i++ )
+    leadin[i] = index->GetOffset(lead[i]);
+  // Events counted before the slice are not seen by the analyzer, except
+  // those of the lead-in
+  UInt_t skipped = (fCountMode == kCountRaw) ? 0 : myfirst-1-lead.size();
+
+  TString outfile = fOutFileName;
+  if( fNWorkers > 1 ) {
+    fOutFileName = GetWorkerFileName(outfile.Data(),fWorker);
+    cout << "Worker " << fWorker << " of " << fNWorkers << ": ";
+  }
+  cout << "Events " << myfirst << " to " << mylast << " from bytes "
+       << index->GetOffset(mybegin) << " to " << index->GetOffset(myend)
+       << " of " << index->GetFileName() << endl;
+  if( !leadin.empty() )
+    cout << "Pedestal lead-in of " << leadin.size() << " events" << endl;
+  run->SetLeadIn(leadin);
+  run->SetByteRange(index->GetOffset(mybegin), index->GetOffset(myend));
+  // The analyzer starts counting at the first event read
+  run->SetEventRange((fCountMode == kCountRaw) ? first : 1,
+		     (mylast == kMaxUInt) ? kMaxUInt : mylast-skipped);
+  fIndexedRun = kTRUE;
+
+  Int_t status = ProfiledProcess(run);
+
+  fIndexedRun = kFALSE;
+  run->SetLeadIn(vector<Long64_t>());
+  run->SetByteRange(-1);
+  run->SetEventRange(first,last);
+  fOutFileName = outfile;
+  return status;
+}
+
+//_____________________________________________________________________________
+Int_t THcAnalyzer::MainAnalysis()
+{
+  // Analysis of one event.  In the lead-in of a worker, before its
+  // slice, analyze only the pedestal events, for the detectors to
+  // accumulate the pedestals, and fill no output.  All other events of
+  // the lead-in are skipped, so that scaler and EPICS events are only
+  // written by the worker whose slice they are in.
+
+  if( !IsLeadIn() )
+    return THaAnalyzer::MainAnalysis();
+  if( !fEvData->IsPhysicsTrigger() ||
+      fEvData->GetEvType() != fPedestalEvtype )
+    return kSkip;
+
+  THaOutput* output = fOutput;
+  TList* postprocess = fPostProcess;
+  fOutput = 0;
+  fPostProcess = 0;
+  Int_t status = THaAnalyzer::MainAnalysis();
+  fOutput = output;
+  fPostProcess = postprocess;
+  return status;
+}
+
+//_____________________________________________________________________________
+Bool_t THcAnalyzer::IsLeadIn() const
+{
+  // True if the current event is read before this worker's slice.  With
+  // an index, the run knows; else the event count tells.  Non-physics
+  // events after the last physics event of the previous slice are in
+  // this slice, unless all events are counted.
+
+  if( fIndexedRun ) {
+    const THcRun* run = dynamic_cast<const THcRun*>(fRun);
+    return run && run->IsLeadInEvent();
+  }
+  if( fSliceFirst == 0 )
+    return kFALSE;
+  if( fEvData->IsPhysicsTrigger() || fCountMode == kCountAll )
+    return fNev < fSliceFirst;
+  return fNev+1 < fSliceFirst;
+}
+
+//_____________________________________________________________________________
+Int_t THcAnalyzer::ProfiledProcess( THaRunBase* run )
+{
+  // THaAnalyzer::Process, timed by the profiler if it is enabled.
+  // Prints the prefilter counts.
+
+  fPrefilter->Clear();
+  if( !fProfiler ) {
+    Int_t status = THaAnalyzer::Process(run);
+    fPrefilter->Print();
+    return status;
+  }
+
+  fProfiler->Begin();
+  Int_t status = THaAnalyzer::Process(run);
+  fProfiler->End();
+  fProfiler->Print((ULong64_t)fNev);
+  fProfiler->DefineParms();
+  fPrefilter->Print();
+  return status;
 }
 
 //_____________________________________________________________________________
@@ -8,6 +8,13 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "THaAnalyzer.h"
+#include <vector>
+#include <string>
+
+class THcProfiler;
+class THcPrefilter;
+class THcApparatusGroup;
+class THcRun;
 
 class THcAnalyzer : public THaAnalyzer {
 
@@ -16,13 +23,71 @@ public:
   THcAnalyzer();
   virtual ~THcAnalyzer();
 
+  virtual Int_t Init( THaRunBase* run );
+  virtual Int_t Process( THaRunBase* run=NULL );
+
+  // Event type of the pedestal events, analyzed by every worker
   void SetPedestalEvtype( Int_t evtype ) { fPedestalEvtype = evtype; }
 
+  // Event parallel replay: this process analyzes slice iworker of
+  // nworkers of the run's event range
+  void SetWorker( Int_t iworker, Int_t nworkers );
+  Int_t GetWorker() const { return fWorker; }
+  Int_t GetNWorkers() const { return fNWorkers; }
+  static TString GetWorkerFileName( const char* outfile, Int_t iworker );
+  static Int_t MergeWorkerOutput( const char* outfile, Int_t nworkers );
+
+  // Time Decode and the reconstruction stages of each Hall C
+  // spectrometer and detector, printed at the end of Process
+  void EnableProfiling( Bool_t enable=kTRUE );
+  THcProfiler* GetProfiler() const { return fProfiler; }
+
+  // Tests of the cut block Prefilter, deciding after Decode whether
+  // the Hall C spectrometers reconstruct the event
+  THcPrefilter* GetPrefilter() const { return fPrefilter; }
+
+  // Run each stage of the Hall C spectrometers concurrently, on up to
+  // nthreads threads (1 = one after the other)
+  void SetApparatusThreads( Int_t nthreads );
+
+  // Demand driven computation: switch off the optional computations of
+  // the detectors (THcHitList compute blocks) whose global variables
+  // are used neither by the output definition, the cuts, the report
+  // template nor in AddUsedVariables.  Takes effect at the next Init.
+  void EnableDemandDriven( Bool_t enable=kTRUE );
+  void SetReportTemplate( const char* templatefile ) { fReportTemplate = templatefile; }
+  void AddUsedVariables( const char* patterns );
+
   void PrintReport( const char* templatefile, const char* ofile);
 
 protected:
 
   Int_t fPedestalEvtype;
+  Int_t fWorker;
+  Int_t fNWorkers;
+  UInt_t fSliceFirst;           // First event of the worker's slice after
+                                // the lead-in, 0 without lead-in
+  Bool_t fIndexedRun;           // fRun is a THcRun read with its index
+  THcProfiler* fProfiler;
+  THcPrefilter* fPrefilter;
+  Int_t fAppThreads;            // Threads for the spectrometer stages
+  THcApparatusGroup* fAppGroup; // Spectrometers run concurrently, if any
+
+  Bool_t fDemandDriven;
+  TString fReportTemplate;
+  std::vector<TString> fExtraPatterns;   // From AddUsedVariables
+  std::vector<TString> fUsedPatterns;    // Wildcard patterns of used variables
+  std::vector<std::string> fUsedNames;   // Sorted names used in expressions
+
+  void SetupEventContext();
+  void SetupComputeBlocks();
+  void FindUsedVariables();
+  void AddUsedNames( const std::string& text );
+  Bool_t IsUsedVariable( const char* name ) const;
+  virtual Int_t MainAnalysis();
+  Bool_t IsLeadIn() const;
+  Int_t ProfiledProcess( THaRunBase* run );
+  Int_t IndexedProcess( THcRun* run );
     
 private:
   //  THcAnalyzer( const THcAnalyzer& );
@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcApparatusGroup                                                         //
+//                                                                           //
+// Runs the stages of an event (Decode, CoarseTrack, CoarseReconstruct,      //
+// Track, Reconstruct) of several Hall C spectrometers, e.g. the HMS and     //
+// the SOS in coincidence running, concurrently on a THcTaskPool.  The       //
+// spectrometers share no state, so their stages can run side by side.       //
+//                                                                           //
+// THaAnalyzer calls a stage for every apparatus in turn, and only then      //
+// evaluates the cuts of the stage.  The first spectrometer of the group     //
+// called for a stage runs the stage of all of them, and gets its result;    //
+// the others get the result kept for them when they are called.  Before     //
+// decoding, THaAnalyzer clears each apparatus; the group clears the         //
+// spectrometers it decodes before THaAnalyzer gets to them, and             //
+// THcHallCSpectrometer::Clear then does nothing.  The prefilter cuts are    //
+// evaluated once all are decoded, on the calling thread, since cut results  //
+// are shared (see THcTaskPool for what the stages may do on a thread).      //
+//                                                                           //
+// THcAnalyzer::SetApparatusThreads sets up the group at Init.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcApparatusGroup.h"
+#include "THcHallCSpectrometer.h"
+#include "THcPrefilter.h"
+#include "THcTaskPool.h"
+
+#include <iostream>
+
+using namespace std;
+
+ClassImp(THcApparatusGroup)
+
+//______________________________________________________________________________
+THcApparatusGroup::THcApparatusGroup() :
+  fPool(0), fStage(-1), fTrigger(-1), fEvData(0)
+{
+  // Constructor
+}
+
+//______________________________________________________________________________
+THcApparatusGroup::~THcApparatusGroup()
+{
+  // Destructor. Stops the threads.
+
+  delete fPool;
+}
+
+//______________________________________________________________________________
+void THcApparatusGroup::AddSpectrometer( THcHallCSpectrometer* spec )
+{
+  // Add a spectrometer, which then runs its stages through the group
+
+  fSpectrometers.push_back(spec);
+  fStatus.push_back(0);
+  fPending.push_back(kFALSE);
+  spec->SetApparatusGroup(this);
+}
+
+//______________________________________________________________________________
+void THcApparatusGroup::SetNThreads( Int_t nthreads )
+{
+  // Use nthreads threads (including the calling one)
+
+  delete fPool;
+  fPool = (nthreads > 1) ? new THcTaskPool(nthreads) : 0;
+}
+
+//______________________________________________________________________________
+Int_t THcApparatusGroup::GetNThreads() const
+{
+  return fPool ? fPool->GetNThreads() : 1;
+}
+
+//______________________________________________________________________________
+Int_t THcApparatusGroup::Find( const THcHallCSpectrometer* spec ) const
+{
+  for( UInt_t i=0; i<fSpectrometers.size(); i++ ) {
+    if( fSpectrometers[i] == spec ) return i;
+  }
+  return -1;
+}
+
+//______________________________________________________________________________
+Bool_t THcApparatusGroup::IsPending( const THcHallCSpectrometer* spec,
+				     Int_t stage ) const
+{
+  Int_t i = Find(spec);
+  return i >= 0 && stage == fStage && fPending[i];
+}
+
+//______________________________________________________________________________
+void THcApparatusGroup::StageTask( void* arg, Int_t i )
+{
+  // Run the current stage of spectrometer i
+
+  THcApparatusGroup* group = static_cast<THcApparatusGroup*>(arg);
+  THcHallCSpectrometer* spec = group->fSpectrometers[i];
+  if( group->fStage == THcHallCSpectrometer::kStageDecode &&
+      i != group->fTrigger )
+    spec->Clear();
+  group->fStatus[i] = spec->RunStage(group->fStage, group->fEvData);
+}
+
+//______________________________________________________________________________
+Int_t THcApparatusGroup::Run( THcHallCSpectrometer* spec, Int_t stage,
+			      const THaEvData* evdata )
+{
+  // Result of stage for spec.  The first call for a stage runs it for
+  // all spectrometers; THaAnalyzer has just cleared spec itself.
+
+  Int_t i = Find(spec);
+  if( i < 0 ) return -1;
+  if( stage == fStage && fPending[i] ) {
+    fPending[i] = kFALSE;
+    return fStatus[i];
+  }
+
+  Int_t n = fSpectrometers.size();
+  fStage = stage;
+  fTrigger = i;
+  fEvData = evdata;
+  fPending.assign(n, kFALSE);
+  if( fPool )
+    fPool->Run(StageTask, this, 0, n);
+  else {
+    for( Int_t k=0; k<n; k++ )
+      StageTask(this, k);
+  }
+  if( stage == THcHallCSpectrometer::kStageDecode ) {
+    // Prefilter cuts, on the decoded event of all spectrometers
+    for( Int_t k=0; k<n; k++ ) {
+      THcPrefilter* prefilter = fSpectrometers[k]->GetPrefilter();
+      if( prefilter ) prefilter->NewEvent();
+    }
+    for( Int_t k=0; k<n; k++ ) {
+      THcPrefilter* prefilter = fSpectrometers[k]->GetPrefilter();
+      if( prefilter ) prefilter->Pass();
+    }
+  }
+  fPending.assign(n, kTRUE);
+  fPending[i] = kFALSE;
+  return fStatus[i];
+}
+
+//______________________________________________________________________________
+void THcApparatusGroup::Print( Option_t* ) const
+{
+  cout << "Apparatus group, " << GetNThreads() << " thread(s):";
+  for( UInt_t i=0; i<fSpectrometers.size(); i++ )
+    cout << " " << fSpectrometers[i]->GetName();
+  cout << endl;
+}
@@ -0,0 +1,58 @@
+#ifndef ROOT_THcApparatusGroup
+#define ROOT_THcApparatusGroup
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcApparatusGroup                                                         //
+//                                                                           //
+// Hall C spectrometers that run each stage of an event concurrently.        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class THaEvData;
+class THcHallCSpectrometer;
+class THcTaskPool;
+
+class THcApparatusGroup : public TObject {
+
+public:
+  THcApparatusGroup();
+  virtual ~THcApparatusGroup();
+
+  void   AddSpectrometer( THcHallCSpectrometer* spec );
+  void   SetNThreads( Int_t nthreads );
+
+  // Result of stage (THcHallCSpectrometer::EStage) for spec, running the
+  // stage of all spectrometers if spec has not yet had its result
+  Int_t  Run( THcHallCSpectrometer* spec, Int_t stage,
+	      const THaEvData* evdata=0 );
+  // spec has not yet had its result of stage
+  Bool_t IsPending( const THcHallCSpectrometer* spec, Int_t stage ) const;
+
+  Int_t  GetNSpectrometers() const { return fSpectrometers.size(); }
+  Int_t  GetNThreads() const;
+  virtual void Print( Option_t* opt="" ) const;
+
+protected:
+  std::vector<THcHallCSpectrometer*> fSpectrometers;
+  THcTaskPool* fPool;                   // Threads, 0 for one
+  Int_t   fStage;                       // Stage last run, -1 if none
+  Int_t   fTrigger;                     // Spectrometer that started it
+  const THaEvData* fEvData;
+  std::vector<Int_t>  fStatus;          // Results of the stage
+  std::vector<Bool_t> fPending;         // Results not yet returned
+
+  Int_t  Find( const THcHallCSpectrometer* spec ) const;
+  static void StageTask( void* arg, Int_t i );
+
+private:
+  THcApparatusGroup( const THcApparatusGroup& );
+  THcApparatusGroup& operator=( const THcApparatusGroup& );
+
+  ClassDef(THcApparatusGroup,0)   // Concurrent stages of spectrometers
+};
+
+#endif
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcCalibDriver                                                            //
+//                                                                           //
+// Runs the iterative calibrations (drift maps, plane alignment, hodoscope   //
+// timing, calorimeter gains) as several reconstruction passes over one run  //
+// in a single session.  The run is a hit cache (THcHitCacheRun) written by  //
+// a first replay with a THcHitCache module, and is read into memory once,   //
+// so a pass costs the reconstruction only: the CODA file is neither read    //
+// nor decoded again.  The events are read by the analyzer's copy of the     //
+// run (THaAnalyzer analyzes a copy of the run it is given) at the first     //
+// pass, and stay there for the others; the run given to Process drops any   //
+// events it holds, so they are not in memory twice.                         //
+//                                                                           //
+// Each pass is a Process of the analyzer over the run.  The detectors with  //
+// a calibration enabled accumulate it during the pass and solve for new     //
+// constants at the end, as in a normal replay (the parameter files of the   //
+// pass are written too).  Between passes ApplyCalibrations hands the new    //
+// constants directly to the detectors:                                      //
+//   THcDC::ApplyDriftMaps           drift maps (SetDriftMapCalib)           //
+//   THcDC::ApplyResidualCalib       wire positions (SetResidualCalib)       //
+//   THcHodoscope::ApplyTimeCalib    timing constants (SetTimeCalib)         //
+//   THcShower::ApplyGainCalib       gains (SetGainCalib)                    //
+// then calls the pass macro, if set, which can change other constants.      //
+// There is no solver for the drift chamber plane time zeros: the pass       //
+// macro can set them with THcDC::SetPlaneTimeZero, e.g. from the drift      //
+// time spectra of the pass.  The apparatuses are not initialized            //
+// again and no parameter file is read again, since the run does not         //
+// change; note that a new Init of the analyzer (e.g. for another run)       //
+// restores the constants of the parameter files.                            //
+//                                                                           //
+// Usage, after the setup of a replay with the calibrations enabled:         //
+//   THcHitCacheRun* run = new THcHitCacheRun("cache_50017.hc");             //
+//   THcCalibDriver* driver = new THcCalibDriver(analyzer);                  //
+//   driver->SetPassMacro("next_pass");                                      //
+//   driver->Process(run, 5);                                                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcCalibDriver.h"
+#include "THcAnalyzer.h"
+#include "THcHitCacheRun.h"
+#include "THcDC.h"
+#include "THcHodoscope.h"
+#include "THcShower.h"
+#include "THaApparatus.h"
+#include "THaDetector.h"
+#include "THaGlobals.h"
+#include "TList.h"
+#include "TROOT.h"
+#include "TMath.h"
+
+#include <iostream>
+
+using namespace std;
+
+//_____________________________________________________________________________
+THcCalibDriver::THcCalibDriver( THcAnalyzer* analyzer ) :
+  fAnalyzer(analyzer), fPass(0)
+{
+  // Constructor
+}
+
+//_____________________________________________________________________________
+THcCalibDriver::~THcCalibDriver()
+{
+  // Destructor
+}
+
+//_____________________________________________________________________________
+Int_t THcCalibDriver::Process( THcHitCacheRun* run, Int_t npasses )
+{
+  // Analyze the run npasses times, applying the new constants after each
+  // pass.  Returns the status of the last Process of the analyzer.
+
+  if( !fAnalyzer || !run ) {
+    Error("Process","Need an analyzer and a hit cache run");
+    return -1;
+  }
+
+  // The analyzer's copy of the run reads the cache into memory at the
+  // first pass, once for all passes.  Release the events of this run, so
+  // that they are not copied.
+  run->SetInMemory(kFALSE);
+  run->SetInMemory(kTRUE);
+
+  Int_t status = 0;
+  for( fPass=0; fPass<npasses; fPass++ ) {
+    cout << "THcCalibDriver: pass " << fPass+1 << " of " << npasses << endl;
+    status = fAnalyzer->Process(run);
+    if( status < 0 ) {
+      Error("Process","Pass %d failed",fPass+1);
+      break;
+    }
+    Int_t nupdated = ApplyCalibrations();
+    cout << "THcCalibDriver: new constants for " << nupdated
+	 << " detectors after pass " << fPass+1 << endl;
+    if( !fPassMacro.IsNull() )
+      gROOT->ProcessLine(Form("%s(%d)",fPassMacro.Data(),fPass));
+  }
+  return status;
+}
+
+//_____________________________________________________________________________
+Int_t THcCalibDriver::ApplyCalibrations()
+{
+  // Apply the calibrations of the Hall C detectors of all apparatuses
+
+  Int_t nupdated = 0;
+  TIter nextapp(gHaApps);
+  while( THaApparatus* app = static_cast<THaApparatus*>( nextapp() )) {
+    TIter nextdet(app->GetDetectors());
+    while( THaDetector* det = static_cast<THaDetector*>( nextdet() )) {
+      Int_t status = -1;
+      if( THcDC* dc = dynamic_cast<THcDC*>(det) ) {
+	Int_t nmaps = dc->ApplyDriftMaps();
+	Int_t nplanes = dc->ApplyResidualCalib();
+	status = TMath::Max(nmaps,nplanes);
+      } else if( THcHodoscope* hodo = dynamic_cast<THcHodoscope*>(det) )
+	status = hodo->ApplyTimeCalib();
+      else if( THcShower* shower = dynamic_cast<THcShower*>(det) )
+	status = shower->ApplyGainCalib();
+      if( status >= 0 ) nupdated++;
+    }
+  }
+  return nupdated;
+}
+
+ClassImp(THcCalibDriver)
+////////////////////////////////////////////////////////////////////////////////
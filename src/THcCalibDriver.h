@@ -0,0 +1,46 @@
+#ifndef ROOT_THcCalibDriver
+#define ROOT_THcCalibDriver
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcCalibDriver                                                            //
+//                                                                           //
+// Repeated reconstruction passes over a hit cache run, with the calibration //
+// constants of each pass used by the next.                                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include "TString.h"
+
+class THcAnalyzer;
+class THcHitCacheRun;
+
+class THcCalibDriver : public TObject {
+
+public:
+  THcCalibDriver( THcAnalyzer* analyzer );
+  virtual ~THcCalibDriver();
+
+  // Macro called as macro(pass) after each pass, once the new constants
+  // are applied, e.g. to change the drift chamber plane time zeros
+  void  SetPassMacro( const char* macro ) { fPassMacro = macro; }
+
+  // Analyze the run npasses times
+  Int_t Process( THcHitCacheRun* run, Int_t npasses );
+
+  // Give the detectors of all apparatuses the constants solved for at
+  // the end of the last pass. Returns the number of detectors updated.
+  virtual Int_t ApplyCalibrations();
+
+  Int_t GetPass() const { return fPass; }
+
+protected:
+  THcAnalyzer* fAnalyzer;
+  TString      fPassMacro;
+  Int_t        fPass;                  // Current pass, from 0
+
+  ClassDef(THcCalibDriver,0)   // Multi-pass calibration over a hit cache
+};
+
+#endif
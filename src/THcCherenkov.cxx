@@ -23,6 +23,7 @@
 ///////////////////////////////////////////////////////////////////////////////////////
 
 #include "THcCherenkov.h"
+#include "THcProfiler.h"
 #include "TClonesArray.h"
 #include "THcSignalHit.h"
 #include "THaEvData.h"
@@ -39,6 +40,7 @@
 #include "TMath.h"
 
 #include "THaTrackProj.h"
+#include "THcPedestalTracker.h"
 
 #include <cstring>
 #include <cstdio>
@@ -87,11 +89,9 @@ void THcCherenkov::InitArrays()
   fADC = NULL;
   fADC_P = NULL;
   fNPE = NULL;
-  fPedSum = NULL;
-  fPedSum2 = NULL;
   fPedLimit = NULL;
   fPedMean = NULL;
-  fPedCount = NULL;
+  fPedestals = NULL;
   fPed = NULL;
   fThresh = NULL;
 }
@@ -104,11 +104,9 @@ void THcCherenkov::DeleteArrays()
   delete [] fADC; fADC = NULL;
   delete [] fADC; fADC_P = NULL;
   delete [] fNPE; fNPE = NULL;
-  delete [] fPedSum; fPedSum = NULL;
-  delete [] fPedSum2; fPedSum2 = NULL;
   delete [] fPedLimit; fPedLimit = NULL;
   delete [] fPedMean; fPedMean = NULL;
-  delete [] fPedCount; fPedCount = NULL;
+  delete fPedestals; fPedestals = NULL;
   delete [] fPed; fPed = NULL;
   delete [] fThresh; fThresh = NULL;
 }
@@ -212,9 +210,12 @@ Int_t THcCherenkov::ReadDatabase( const TDatime& date )
     {"cer_mirror_zpos", &fCerMirrorZPos,     kDouble},                       // Ahmed
     {"cer_region",      &fCerRegionValue[0], kDouble, (UInt_t) fCerRegionsValueMax},  // Ahmed
     {"cer_threshold",   &fCerThresh,         kDouble},                       // Ahmed
+    {"cer_ped_window",  &fPedWindow,         kInt, 0, 1},
     {0}
   };
 
+  fPedWindow = 0;		// Default if not defined
+
   gHcParms->LoadParmValues((DBRequest*)&list,prefix);
 
   fIsInit = true;
@@ -257,6 +258,7 @@ Int_t THcCherenkov::DefineVariables( EMode mode )
     {"ncherhit",    "Number of Hits(Cherenkov)",                 "fNCherHit"},
     {"certrackcounter", "Tracks inside Cherenkov region",        "fCerTrackCounter"},
     {"cerfiredcounter", "Tracks with engough Cherenkov NPEs ",   "fCerFiredCounter"},
+    {"nrawhits",    "Number of raw hits after decode",           "fNRawHits"},
     { 0 }
   };
 
@@ -287,10 +289,12 @@ void THcCherenkov::Clear(Option_t* opt)
 //_____________________________________________________________________________
 Int_t THcCherenkov::Decode( const THaEvData& evdata )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kDecode);
+
   // Get the Hall C style hitlist (fRawHitList) for this event
   fNhits = DecodeToHitList(evdata);
 
-  if(gHaCuts->Result("Pedestal_event")) {
+  if(IsPedestalEvent()) {
     AccumulatePedestals(fRawHitList);
     fAnalyzePedestals = 1;	// Analyze pedestals first normal events
     return(0);
@@ -327,6 +331,8 @@ Int_t THcCherenkov::ApplyCorrections( void )
 //_____________________________________________________________________________
 Int_t THcCherenkov::CoarseProcess( TClonesArray&  ) //tracks
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseProcess);
+
   for(Int_t ihit=0; ihit < fNhits; ihit++) {
     THcCherenkovHit* hit = (THcCherenkovHit *) fRawHitList->At(ihit); // nhit = 1, hcer_tot_hits
 
@@ -368,6 +374,7 @@ Int_t THcCherenkov::CoarseProcess( TClonesArray&  ) //tracks
 //_____________________________________________________________________________
 Int_t THcCherenkov::FineProcess( TClonesArray& tracks )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kFineProcess);
 
   Double_t fCerX, fCerY;
    
@@ -426,19 +433,14 @@ Int_t THcCherenkov::FineProcess( TClonesArray& tracks )
 //_____________________________________________________________________________
 void THcCherenkov::InitializePedestals( )
 {
-  fNPedestalEvents = 0;
   fMinPeds = 500; 		// In engine, this is set in parameter file
-  fPedSum = new Int_t [fNelem];
-  fPedSum2 = new Int_t [fNelem];
-  fPedCount = new Int_t [fNelem];
+  delete fPedestals;
+  fPedestals = new THcPedestalTracker(fNelem);
+  fPedestals->Init(fMinPeds, fPedLimit);
+  fPedestals->SetWindow(fPedWindow);
 
   fPed = new Double_t [fNelem];
   fThresh = new Double_t [fNelem];
-  for(Int_t i=0;i<fNelem;i++) {
-    fPedSum[i] = 0;
-    fPedSum2[i] = 0;
-    fPedCount[i] = 0;
-  }
 
 }
 
@@ -455,19 +457,11 @@ void THcCherenkov::AccumulatePedestals(TClonesArray* rawhits)
     THcCherenkovHit* hit = (THcCherenkovHit *) rawhits->At(ihit);
 
     Int_t element = hit->fCounter - 1;
-    Int_t nadc = hit->fADC_pos;
-    if(nadc <= fPedLimit[element]) {
-      fPedSum[element] += nadc;
-      fPedSum2[element] += nadc*nadc;
-      fPedCount[element]++;
-      if(fPedCount[element] == fMinPeds/5) {
-	fPedLimit[element] = 100 + fPedSum[element]/fPedCount[element];
-      }
-    }
+    fPedestals->Fill(element, hit->fADC_pos);
     ihit++;
   }
 
-  fNPedestalEvents++;
+  fPedestals->EndEvent();
 
   return;
 }
@@ -478,10 +472,12 @@ void THcCherenkov::CalculatePedestals( )
   // Use the accumulated pedestal data to calculate pedestals
   // Later add check to see if pedestals have drifted ("Danger Will Robinson!")
   //  cout << "Plane: " << fPlaneNum << endl;
+  fPedestals->Calculate();
+
   for(Int_t i=0; i<fNelem;i++) {
     
     // PMT tubes
-    fPed[i] = ((Double_t) fPedSum[i]) / TMath::Max(1, fPedCount[i]);
+    fPed[i] = fPedestals->GetPed(i);
     fThresh[i] = fPed[i] + 15;
 
     // Just a copy for now, but allow the possibility that fXXXPedMean is set
@@ -489,7 +485,7 @@ void THcCherenkov::CalculatePedestals( )
     // pedestal events.  (So that pedestals are sensible even if the pedestal events were
     // not acquired.)
     if(fMinPeds > 0) {
-      if(fPedCount[i] > fMinPeds) {
+      if(fPedestals->GetCount(i) > fMinPeds) {
 	fPedMean[i] = fPed[i];
       }
     }
@@ -12,6 +12,8 @@
 #include "THcHitList.h"
 #include "THcCherenkovHit.h"
 
+class THcPedestalTracker;
+
 class THcCherenkov : public THaNonTrackingDetector, public THcHitList {
 
  public:
@@ -75,13 +77,11 @@ class THcCherenkov : public THaNonTrackingDetector, public THcHitList {
   TClonesArray* fADCHits;
 
   // Pedestals
-  Int_t         fNPedestalEvents;
   Int_t         fMinPeds;
-  Int_t*        fPedSum;	  /* Accumulators for pedestals */
-  Int_t*        fPedSum2;
+  Int_t         fPedWindow;       /* Running pedestal window, 0 = whole run */
   Int_t*        fPedLimit; 
   Double_t*     fPedMean; 	  /* Can be supplied in parameters and then */ 
-  Int_t*        fPedCount; 
+  THcPedestalTracker* fPedestals; /* Pedestal accumulator */
   Double_t*     fPed;
   Double_t*     fThresh;
   
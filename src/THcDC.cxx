@@ -10,6 +10,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "THcDC.h"
+#include "THcProfiler.h"
 #include "THaEvData.h"
 #include "THaDetMap.h"
 #include "THcDetectorMap.h"
@@ -17,9 +18,11 @@
 #include "THaCutList.h"
 #include "THcParmList.h"
 #include "THcDCTrack.h"
+#include "THcDCResidualCalib.h"
 #include "VarDef.h"
 #include "VarType.h"
 #include "THaTrack.h"
+#include "THaRunBase.h"
 #include "TClonesArray.h"
 #include "TMath.h"
 #include "TVectorD.h"
@@ -28,6 +31,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <iomanip>
+#include <fstream>
 
 using namespace std;
 
@@ -40,6 +45,7 @@ THcDC::THcDC(
   // Constructor
 
   fNPlanes = 0;			// No planes until we make them
+  fResidualsBlock = AddComputeBlock("residuals","residual");
 
   fXCenter = NULL;
   fYCenter = NULL;
@@ -75,6 +81,22 @@ THcDC::THcDC(
 
   fNChamHits = 0;
   fPlaneEvents = 0;
+
+  fDriftMapCalibOn = 0;
+  fDriftMapUpdate = 0;
+  fDriftMapMinEntries = 0;
+  fDriftMapEvents = 0;
+
+  fResidualCalibOn = 0;
+  fResidualMaxChi2 = 0;
+  fResidualMinEntries = 0;
+  fResidualCalib = 0;
+
+  fCounterSample = 0;
+  fCounterEvents = 0;
+
+  fHotWireOccupancy = 0;
+  fHotWireMinEvents = 0;
 }
 
 //_____________________________________________________________________________
@@ -167,6 +189,22 @@ THcDC::THcDC( ) :
   THaTrackingDetector()
 {
   // Constructor
+
+  fDriftMapCalibOn = 0;
+  fDriftMapUpdate = 0;
+  fDriftMapMinEntries = 0;
+  fDriftMapEvents = 0;
+
+  fResidualCalibOn = 0;
+  fResidualMaxChi2 = 0;
+  fResidualMinEntries = 0;
+  fResidualCalib = 0;
+
+  fCounterSample = 0;
+  fCounterEvents = 0;
+
+  fHotWireOccupancy = 0;
+  fHotWireMinEvents = 0;
 }
 
 //_____________________________________________________________________________
@@ -193,6 +231,7 @@ THaAnalysisObject::EStatus THcDC::Init( const TDatime& date )
       fChambers[chamber-1]->AddPlane(fPlanes[ip]);
     }
   }
+  ResetWireMasks();
   // Initialize chambers
   for(UInt_t ic=0;ic<fNChambers;ic++) {
     if((status = fChambers[ic]->Init ( date ))) {
@@ -322,6 +361,69 @@ Int_t THcDC::ReadDatabase( const TDatime& date )
   };
   gHcParms->LoadParmValues((DBRequest*)&list,fPrefix);
   if(fNTracksMaxFP <= 0) fNTracksMaxFP = 10;
+
+  // Drift map calibration during the replay, also enabled by
+  // SetDriftMapCalib.
+  {
+    Int_t driftmapcalib = 0;
+    fDriftMapMinEntries = 10000;
+    DBRequest list[]={
+      {"dc_driftmap_calib", &driftmapcalib, kInt, 0, 1},
+      {"dc_driftmap_update", &fDriftMapUpdate, kInt, 0, 1},
+      {"dc_driftmap_minentries", &fDriftMapMinEntries, kInt, 0, 1},
+      {0}
+    };
+    gHcParms->LoadParmValues((DBRequest*)&list,fPrefix);
+    if(driftmapcalib) fDriftMapCalibOn = 1;
+  }
+  // Residual statistics, also enabled by SetResidualCalib.
+  {
+    Int_t residualcalib = 0;
+    fResidualMaxChi2 = 10.0;
+    fResidualMinEntries = 1000;
+    DBRequest list[]={
+      {"dc_residual_calib", &residualcalib, kInt, 0, 1},
+      {"dc_residual_maxchi2", &fResidualMaxChi2, kDouble, 0, 1},
+      {"dc_residual_minentries", &fResidualMinEntries, kInt, 0, 1},
+      {0}
+    };
+    gHcParms->LoadParmValues((DBRequest*)&list,fPrefix);
+    if(residualcalib) fResidualCalibOn = 1;
+  }
+  // Sampling of the hit and efficiency counters
+  {
+    fCounterSample = 0;
+    DBRequest list[]={
+      {"dc_counter_sample", &fCounterSample, kInt, 0, 1},
+      {0}
+    };
+    gHcParms->LoadParmValues((DBRequest*)&list,fPrefix);
+  }
+  // Masked wires: the dead wire list, and the wires found hot during
+  // the replay if dc_hotwire_occupancy is set
+  {
+    Int_t ndead = 0;
+    fHotWireOccupancy = 0.0;
+    fHotWireMinEvents = 10000;
+    DBRequest list[]={
+      {"dc_num_deadwires", &ndead, kInt, 0, 1},
+      {"dc_hotwire_occupancy", &fHotWireOccupancy, kDouble, 0, 1},
+      {"dc_hotwire_minevents", &fHotWireMinEvents, kInt, 0, 1},
+      {0}
+    };
+    gHcParms->LoadParmValues((DBRequest*)&list,fPrefix);
+    fDeadWirePlane.assign(TMath::Max(ndead,0), 0);
+    fDeadWireNum.assign(TMath::Max(ndead,0), 0);
+    if(ndead > 0) {
+      DBRequest deadlist[]={
+	{"dc_deadwire_plane", &fDeadWirePlane[0], kInt, (UInt_t)ndead},
+	{"dc_deadwire_num", &fDeadWireNum[0], kInt, (UInt_t)ndead},
+	{0}
+      };
+      gHcParms->LoadParmValues((DBRequest*)&deadlist,fPrefix);
+    }
+    if(fHotWireMinEvents < 1) fHotWireMinEvents = 1;
+  }
   // if(fNTracksMaxFP > HNRACKS_MAX) fNTracksMaxFP = NHTRACKS_MAX;
   cout << "Plane counts:";
   for(Int_t i=0;i<fNPlanes;i++) {
@@ -355,6 +457,7 @@ Int_t THcDC::DefineVariables( EMode mode )
     { "xp", "XP at focal plane", "fDCTracks.THcDCTrack.GetXP()"},
     { "yp", "YP at focal plane", "fDCTracks.THcDCTrack.GetYP()"},
     { "residual", "Residuals", "fResiduals"},
+    { "nrawhits", "Number of raw hits after decode", "fNRawHits"},
     { 0 }
   };
   return DefineVarsFromList( vars, mode );
@@ -379,6 +482,9 @@ THcDC::~THcDC()
        ip != fChambers.end(); ++ip) delete *ip;
 
   delete fDCTracks;
+  delete fResidualCalib;
+  RemoveParms(fResidualParmNames);
+  RemoveParms(fCounterParmNames);
 }
 
 //_____________________________________________________________________________
@@ -439,6 +545,7 @@ void THcDC::ClearEvent()
 //_____________________________________________________________________________
 Int_t THcDC::Decode( const THaEvData& evdata )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kDecode);
 
   ClearEvent();
   Int_t num_event = evdata.GetEvNum();
@@ -446,7 +553,28 @@ Int_t THcDC::Decode( const THaEvData& evdata )
   // Get the Hall C style hitlist (fRawHitList) for this event
   fNhits = DecodeToHitList(evdata);
 
-  if(!gHaCuts->Result("Pedestal_event")) {
+  if(!IsPedestalEvent()) {
+    // Put the drift maps accumulated so far in the lookup tables
+    if(fDriftMapCalibOn && fDriftMapUpdate > 0
+       && ++fDriftMapEvents%fDriftMapUpdate == 0) {
+      Int_t nupdated = 0;
+      for(Int_t ip=0;ip<fNPlanes;ip++)
+	nupdated += fPlanes[ip]->UpdateDriftMap(fDriftMapMinEntries);
+      if(nupdated > 0)
+	cout << "THcDC: drift maps of " << nupdated << " planes updated after "
+	     << fDriftMapEvents << " events" << endl;
+    }
+
+    // Sample the counters of the previous events
+    if(fCounterSample > 0 && fCounterEvents > 0
+       && fCounterEvents%fCounterSample == 0)
+      SampleCounters();
+    // Mask the wires hit in too many of the previous events
+    if(fHotWireOccupancy > 0 && fCounterEvents > 0
+       && fCounterEvents%fHotWireMinEvents == 0)
+      MaskHotWires();
+    fCounterEvents++;
+
     // Let each plane get its hits
     Int_t nexthit = 0;
     for(Int_t ip=0;ip<fNPlanes;ip++) {
@@ -488,6 +616,8 @@ Int_t THcDC::ApplyCorrections( void )
 //_____________________________________________________________________________
 Int_t THcDC::CoarseTrack( TClonesArray& tracks )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseTrack);
+
   // Calculation of coordinates of particle track cross point with scint
   // plane in the detector coordinate system. For this, parameters of track 
   // reconstructed in THaVDC::CoarseTrack() are used.
@@ -554,6 +684,8 @@ Int_t THcDC::CoarseTrack( TClonesArray& tracks )
 //_____________________________________________________________________________
 Int_t THcDC::FineTrack( TClonesArray& tracks )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kFineTrack);
+
   // Reconstruct coordinates of particle track cross point with scintillator
   // plane, and copy the data into the following local data structure:
   //
@@ -918,7 +1050,7 @@ void THcDC::TrackFit()
   // and there was a track found in each chamber
   // Specific for two chambers.  Can/should it be generalized?
 
-  if(fSingleStub != 0) {
+  if(fSingleStub != 0 && IsComputed(fResidualsBlock)) {
     if(fNDCTracks == 2) {
       THcDCTrack *theDCTrack1 = static_cast<THcDCTrack*>( fDCTracks->At(0));
       THcDCTrack *theDCTrack2 = static_cast<THcDCTrack*>( fDCTracks->At(1));
@@ -995,7 +1127,17 @@ void THcDC::TrackFit()
       }
     }
   }
-  if(fNDCTracks>0) {
+  // Track based efficiency of the wires, from single track events
+  if(fNDCTracks==1) {
+    THcDCTrack *theDCTrack = static_cast<THcDCTrack*>( fDCTracks->At(0));
+    if(theDCTrack->GetNFree() > 0) {
+      for(Int_t ip=0;ip<fNPlanes;ip++)
+	fPlanes[ip]->CountTrack(theDCTrack->GetCoord(ip));
+    }
+    if(fResidualCalib)
+      AccumulateResiduals(theDCTrack);
+  }
+  if(fNDCTracks>0 && IsComputed(fResidualsBlock)) {
     for(Int_t ip=0;ip<fNPlanes;ip++) {
       THcDCTrack *theDCTrack = static_cast<THcDCTrack*>( fDCTracks->At(0));
       fResiduals[ip] = theDCTrack->GetResidual(ip);
@@ -1080,13 +1222,437 @@ Double_t THcDC::DpsiFun(Double_t ray[4], Int_t plane)
   return(DpsiFun);
 }	    
 
+//_____________________________________________________________________________
+void THcDC::SetDriftMapCalib(Bool_t enable, Int_t update)
+{
+  // Enable the drift map calibration.  If update > 0, the lookup tables
+  // of the planes are replaced by the drift maps accumulated so far every
+  // update events, so the rest of the run is reconstructed with them.
+
+  fDriftMapCalibOn = enable ? 1 : 0;
+  fDriftMapUpdate = update;
+}
+
+//_____________________________________________________________________________
+Int_t THcDC::ApplyDriftMaps()
+{
+  // Replace the lookup tables of the planes by the drift maps accumulated
+  // in the last run, so that a following pass over the data (see
+  // THcCalibDriver) uses them.  Planes with fewer than
+  // dc_driftmap_minentries drift times keep their table.  Returns the
+  // number of planes updated, -1 if the calibration is off.
+
+  if(!fDriftMapCalibOn) return -1;
+
+  Int_t nupdated = 0;
+  for(Int_t ip=0;ip<fNPlanes;ip++)
+    nupdated += fPlanes[ip]->UpdateDriftMap(fDriftMapMinEntries);
+  return nupdated;
+}
+
+//_____________________________________________________________________________
+void THcDC::SetPlaneTimeZero(Int_t plane, Double_t t0)
+{
+  // Set the time zero of plane (1..fNPlanes), for the hits of the
+  // following events.
+
+  if(plane < 1 || plane > fNPlanes) return;
+  fPlaneTimeZero[plane-1] = t0;
+  fPlanes[plane-1]->SetPlaneTimeZero(t0);
+}
+
+//_____________________________________________________________________________
+Int_t THcDC::Begin(THaRunBase*)
+{
+  // Start the drift time histograms of the planes, the residual
+  // statistics and the hit counters
+
+  fDriftMapEvents = 0;
+  for(Int_t ip=0;ip<fNPlanes;ip++)
+    fPlanes[ip]->SetDriftMapCalib(fDriftMapCalibOn);
+
+  delete fResidualCalib; fResidualCalib = 0;
+  if(fResidualCalibOn) {
+    fResidualCalib = new THcDCResidualCalib;
+    fResidualCalib->Init(fNPlanes);
+  }
+
+  fCounterEvents = 0;
+  for(Int_t ip=0;ip<fNPlanes;ip++)
+    fPlanes[ip]->ResetCounters();
+  DefineCounterParms();
+  // Hot wires are found again in each run
+  if(fHotWireOccupancy > 0)
+    ResetWireMasks();
+  return 0;
+}
+
 //_____________________________________________________________________________
 Int_t THcDC::End(THaRunBase* run)
 {
+  // Write the drift maps to <spectrometer>driftmap.param.<run>, in the
+  // format of hdriftmap.param, and the residual statistics to
+  // <spectrometer>dcalign.param.<run>.  The residual statistics are also
+  // defined as <spectrometer>dc_res_* variables in gHcParms.  Print the
+  // hit counters.
+
   //  EffCalc();
+  SampleCounters();
+  PrintCounters();
+  PrintWireMasks();
+
+  Int_t runnum = run ? run->GetNumber() : 0;
+  if(fResidualCalib) {
+    fResidualCalib->Print();
+    DefineResidualParms();
+    TString fname = Form("%sdcalign.param.%d",fPrefix,runnum);
+    if(fResidualCalib->WriteParam(fname, fPrefix, runnum, fCentralWire, fPitch,
+				  fResidualMinEntries) == 0)
+      cout << "THcDC::End: residuals written to " << fname << endl;
+  }
+
+  if(!fDriftMapCalibOn || fNPlanes == 0) return 0;
+
+  THcDriftChamberPlane* plane = fPlanes[0];
+  TString fname = Form("%sdriftmap.param.%d",fPrefix,runnum);
+  ofstream output(fname.Data());
+  if(!output) {
+    cout << "THcDC::End: can not open " << fname << endl;
+    return 0;
+  }
+
+  output << "; Drift maps for run " << runnum << endl;
+  output << "; Lookup table" << endl;
+  output << ";number of bins in Meek's time to distance lookup table" << endl;
+  output << fPrefix << "driftbins=" << plane->GetDriftMapNBins() << endl;
+  output << ";number of 1st bin in Meek's table in ns" << endl;
+  output << fPrefix << "drift1stbin=" << plane->GetDriftMapFirstBin() << endl;
+  output << ";bin size in ns of Meek's table" << endl;
+  output << fPrefix << "driftbinsz=" << plane->GetDriftMapBinSize() << endl;
+  // Planes with too few drift times keep their current table
+  for(Int_t ip=0;ip<fNPlanes;ip++) {
+    Int_t status = fPlanes[ip]->WriteDriftMap(output, fPrefix,
+					       fDriftMapMinEntries);
+    cout << "THcDC::End: plane " << fPlanes[ip]->GetName();
+    if(status > 0)
+      cout << " drift map from " << fPlanes[ip]->GetDriftMapEntries()
+	   << " hits" << endl;
+    else
+      cout << " has " << fPlanes[ip]->GetDriftMapEntries() << " hits, "
+	   << (status == 0 ? "current table kept" : "not written") << endl;
+  }
+  cout << "THcDC::End: drift maps written to " << fname << endl;
+
   return 0;
 }
 
+//_____________________________________________________________________________
+void THcDC::AccumulateResiduals(THcDCTrack* track)
+{
+  // Add the residuals of a track to the residual statistics, if its fit
+  // has a good chi2.  The residuals are unbiased: a hit pulls the fit
+  // towards itself, and its residual to the fit without it is r/(1-h),
+  // with h the leverage of the hit, h = a^T C a/sigma^2 for the plane
+  // coefficients a and the covariance C of the fit parameters.
+
+  if(track->GetNFree() <= 0) return;
+  if(fResidualMaxChi2 > 0 &&
+     track->GetChisq() > fResidualMaxChi2*track->GetNFree()) return;
+
+  Double_t par[THcDCResidualCalib::kNPar];
+  par[THcDCResidualCalib::kX] = track->GetX();
+  par[THcDCResidualCalib::kXp] = track->GetXP();
+  par[THcDCResidualCalib::kY] = track->GetY();
+  par[THcDCResidualCalib::kYp] = track->GetYP();
+
+  // Covariance of the fit, as in TrackFit
+  const Int_t raycoeffmap[]={4,5,2,3};
+  Int_t nhits = track->GetNHits();
+  TMatrixD cov(NUM_FPRAY,NUM_FPRAY);
+  for(Int_t ihit=0;ihit < nhits;ihit++) {
+    Int_t plane = track->GetHit(ihit)->GetPlaneNum()-1;
+    Double_t w = 1.0/(fSigma[plane]*fSigma[plane]);
+    for(Int_t irayp=0;irayp<NUM_FPRAY;irayp++)
+      for(Int_t jrayp=0;jrayp<NUM_FPRAY;jrayp++)
+	cov[irayp][jrayp] += w*fPlaneCoeffs[plane][raycoeffmap[irayp]]*
+	  fPlaneCoeffs[plane][raycoeffmap[jrayp]];
+  }
+  cov.Invert();
+
+  for(Int_t ihit=0;ihit < nhits;ihit++) {
+    Int_t plane = track->GetHit(ihit)->GetPlaneNum()-1;
+    Double_t h = 0.0;
+    for(Int_t irayp=0;irayp<NUM_FPRAY;irayp++)
+      for(Int_t jrayp=0;jrayp<NUM_FPRAY;jrayp++)
+	h += fPlaneCoeffs[plane][raycoeffmap[irayp]]*cov[irayp][jrayp]*
+	  fPlaneCoeffs[plane][raycoeffmap[jrayp]];
+    h /= fSigma[plane]*fSigma[plane];
+    // A hit the fit can not do without has no unbiased residual
+    if(h > 1.0-1e-6) continue;
+    fResidualCalib->AddResidual(plane, track->GetResidual(plane)/(1.0-h), par);
+  }
+  fResidualCalib->AddTrack();
+}
+
+//_____________________________________________________________________________
+Int_t THcDC::ApplyResidualCalib()
+{
+  // Move the wires of each plane with at least dc_residual_minentries
+  // residuals in the last run by the mean residual, so that a following
+  // pass over the data (see THcCalibDriver) uses the new positions.
+  // Returns the number of planes moved, -1 if the statistics are off.
+
+  if(!fResidualCalib) return -1;
+
+  Int_t nupdated = 0;
+  for(Int_t ip=0;ip<fNPlanes;ip++) {
+    UInt_t n = fResidualCalib->GetN(ip);
+    if(n == 0 || n < (UInt_t)fResidualMinEntries || fPitch[ip] == 0.)
+      continue;
+    fCentralWire[ip] += fResidualCalib->GetMean(ip)/fPitch[ip];
+    fPlanes[ip]->SetCentralWire(fCentralWire[ip]);
+    nupdated++;
+  }
+  return nupdated;
+}
+
+//_____________________________________________________________________________
+void THcDC::DefineResidualParms()
+{
+  // Make the residual statistics of the run available to PrintReport:
+  // <p>dc_res_n, _mean, _sigma and the correlations with the track
+  // _corr_x, _corr_xp, _corr_y, _corr_yp, arrays over the planes.
+
+  RemoveParms(fResidualParmNames);
+  enum { kN, kMean, kSigma, kCorr, kNParms = kCorr+THcDCResidualCalib::kNPar };
+  static const char* const suffix[kNParms] =
+    { "n", "mean", "sigma", "corr_x", "corr_xp", "corr_y", "corr_yp" };
+  static const char* const title[kNParms] =
+    { "Residuals per plane", "Mean residual per plane",
+      "Residual width per plane", "Residual correlation with x",
+      "Residual correlation with xp", "Residual correlation with y",
+      "Residual correlation with yp" };
+
+  fResidualParms.assign(kNParms*fNPlanes, 0.0);
+  for(Int_t ip=0;ip<fNPlanes;ip++) {
+    fResidualParms[kN*fNPlanes+ip] = fResidualCalib->GetN(ip);
+    fResidualParms[kMean*fNPlanes+ip] = fResidualCalib->GetMean(ip);
+    fResidualParms[kSigma*fNPlanes+ip] = fResidualCalib->GetSigma(ip);
+    for(Int_t k=0;k<THcDCResidualCalib::kNPar;k++)
+      fResidualParms[(kCorr+k)*fNPlanes+ip] =
+	fResidualCalib->GetCorrelation(ip,k);
+  }
+  for(Int_t k=0;k<kNParms;k++) {
+    TString name = Form("%sdc_res_%s",fPrefix,suffix[k]);
+    gHcParms->Define(Form("%s[%d]",name.Data(),fNPlanes),title[k],
+		     fResidualParms[k*fNPlanes]);
+    fResidualParmNames.push_back(name);
+  }
+}
+
+//_____________________________________________________________________________
+void THcDC::RemoveParms(vector<TString>& names)
+{
+  // Remove variables defined in gHcParms, and clear their names
+
+  if(gHcParms) {
+    for(UInt_t i=0;i<names.size();i++)
+      gHcParms->RemoveName(names[i].Data());
+  }
+  names.clear();
+}
+
+// Counters of the planes sampled into gHcParms, and their names
+static const Int_t kCounterParms[] = {
+  THcDriftChamberPlane::kEarly, THcDriftChamberPlane::kLate,
+  THcDriftChamberPlane::kInWindow, THcDriftChamberPlane::kExtra,
+  THcDriftChamberPlane::kTrackExpected, THcDriftChamberPlane::kTrackFound
+};
+static const Int_t kNCounterParms = sizeof(kCounterParms)/sizeof(Int_t);
+static const char* const kCounterNames[kNCounterParms+1] = {
+  "early", "late", "intime", "extra", "trk_expected", "trk_found", "trk_eff"
+};
+static const char* const kCounterTitles[kNCounterParms+1] = {
+  "TDC hits before the window per plane", "TDC hits after the window per plane",
+  "Wires hit in the window per plane", "Extra hits in the window per plane",
+  "Tracks crossing the plane", "Tracks with a hit in the plane",
+  "Track based plane efficiency"
+};
+
+//_____________________________________________________________________________
+void THcDC::DefineCounterParms()
+{
+  // Define the sampled counters as <p>dc_early, _late, _intime, _extra,
+  // _trk_expected, _trk_found and _trk_eff, arrays over the planes, and
+  // the number of events as <p>dc_counter_events
+
+  RemoveParms(fCounterParmNames);
+  fCounterParms.assign((kNCounterParms+1)*fNPlanes+1, 0.0);
+  for(Int_t k=0;k<=kNCounterParms;k++) {
+    TString name = Form("%sdc_%s",fPrefix,kCounterNames[k]);
+    gHcParms->Define(Form("%s[%d]",name.Data(),fNPlanes),kCounterTitles[k],
+		     fCounterParms[k*fNPlanes]);
+    fCounterParmNames.push_back(name);
+  }
+  TString name = Form("%sdc_counter_events",fPrefix);
+  gHcParms->Define(name.Data(),"Events of the DC counters",
+		   fCounterParms[(kNCounterParms+1)*fNPlanes]);
+  fCounterParmNames.push_back(name);
+}
+
+//_____________________________________________________________________________
+void THcDC::SampleCounters()
+{
+  // Copy the current counts of the planes to the gHcParms variables.
+  // Called every dc_counter_sample events, if set, and at the end of the
+  // run, so the counters can be watched during a replay (e.g. with
+  // PrintReport) without any per-event output.
+
+  if(fCounterParms.empty()) return;
+  for(Int_t ip=0;ip<fNPlanes;ip++) {
+    for(Int_t k=0;k<kNCounterParms;k++)
+      fCounterParms[k*fNPlanes+ip] = fPlanes[ip]->GetCount(kCounterParms[k]);
+    Double_t expected = fCounterParms[(kNCounterParms-2)*fNPlanes+ip];
+    Double_t found = fCounterParms[(kNCounterParms-1)*fNPlanes+ip];
+    fCounterParms[kNCounterParms*fNPlanes+ip] =
+      expected > 0 ? found/expected : 0.0;
+  }
+  fCounterParms[(kNCounterParms+1)*fNPlanes] = fCounterEvents;
+}
+
+//_____________________________________________________________________________
+void THcDC::PrintCounters() const
+{
+  // Print the sampled counters of each plane
+
+  if(fCounterParms.empty()) return;
+  streamsize prec = cout.precision();
+  cout << GetApparatus()->GetName() << "." << GetName() << " hit counters, "
+       << fCounterEvents << " events" << endl;
+  cout << "  plane";
+  for(Int_t k=0;k<=kNCounterParms;k++)
+    cout << setw(13) << kCounterNames[k];
+  cout << endl;
+  for(Int_t ip=0;ip<fNPlanes;ip++) {
+    cout << setw(7) << ip+1;
+    for(Int_t k=0;k<kNCounterParms;k++)
+      cout << setw(13) << (ULong64_t)fCounterParms[k*fNPlanes+ip];
+    cout << setw(13) << setprecision(4)
+	 << fCounterParms[kNCounterParms*fNPlanes+ip] << endl;
+  }
+  cout.precision(prec);
+}
+
+//_____________________________________________________________________________
+void THcDC::MaskWire(Int_t plane, Int_t wire, Bool_t mask)
+{
+  // Mask (or unmask) a wire of a plane (1..nplanes): its TDC hits make
+  // no hits, and so take no part in the space points and the tracking.
+  // The wire is remembered, since Init and the hot wire search of each
+  // run (Begin) reset the masks of the planes to the dead wires.
+
+  UInt_t i = 0;
+  while(i < fMaskWirePlane.size() &&
+	(fMaskWirePlane[i] != plane || fMaskWireNum[i] != wire))
+    i++;
+  if(i == fMaskWirePlane.size()) {
+    fMaskWirePlane.push_back(plane);
+    fMaskWireNum.push_back(wire);
+    fMaskWireOn.push_back(mask);
+  } else
+    fMaskWireOn[i] = mask;
+
+  if(fNPlanes == 0) {
+    Warning(Here("MaskWire"), "Called before Init, wire %d of plane %d "
+	    "is %s at Init", wire, plane, mask ? "masked" : "unmasked");
+    return;
+  }
+  if(plane < 1 || plane > fNPlanes) return;
+  fPlanes[plane-1]->MaskWire(wire, mask);
+}
+
+//_____________________________________________________________________________
+void THcDC::ClearWireMasks()
+{
+  // Forget the wires given to MaskWire, leaving the dead wires masked
+
+  fMaskWirePlane.clear();
+  fMaskWireNum.clear();
+  fMaskWireOn.clear();
+  ResetWireMasks();
+}
+
+//_____________________________________________________________________________
+void THcDC::ResetWireMasks()
+{
+  // Mask the dead wires of the parameters, then apply the masks given
+  // to MaskWire.  The wires found hot so far are unmasked.
+
+  for(Int_t ip=0;ip<fNPlanes;ip++)
+    fPlanes[ip]->ClearWireMask();
+  for(UInt_t i=0;i<fDeadWirePlane.size();i++) {
+    Int_t plane = fDeadWirePlane[i];
+    Int_t wire = fDeadWireNum[i];
+    if(plane < 1 || plane > fNPlanes || wire < 1 || wire > fNWires[plane-1]) {
+      cout << "THcDC: dead wire " << plane << "," << wire
+	   << " is not a wire, ignored" << endl;
+      continue;
+    }
+    fPlanes[plane-1]->MaskWire(wire);
+  }
+  for(UInt_t i=0;i<fMaskWirePlane.size();i++) {
+    Int_t plane = fMaskWirePlane[i];
+    Int_t wire = fMaskWireNum[i];
+    if(plane < 1 || plane > fNPlanes || wire < 1 || wire > fNWires[plane-1]) {
+      cout << "THcDC: masked wire " << plane << "," << wire
+	   << " is not a wire, ignored" << endl;
+      continue;
+    }
+    fPlanes[plane-1]->MaskWire(wire, fMaskWireOn[i]);
+  }
+}
+
+//_____________________________________________________________________________
+Int_t THcDC::MaskHotWires()
+{
+  // Mask the wires hit within the time window in more than
+  // dc_hotwire_occupancy of the events so far.  Called every
+  // dc_hotwire_minevents events.
+
+  Int_t nmasked = 0;
+  for(Int_t ip=0;ip<fNPlanes;ip++)
+    nmasked += fPlanes[ip]->MaskHotWires(fHotWireOccupancy, fCounterEvents);
+  return nmasked;
+}
+
+//_____________________________________________________________________________
+void THcDC::PrintWireMasks() const
+{
+  // Print the masked wires, in the format of the dead wire parameters
+
+  vector<Int_t> planes, wires;
+  for(Int_t ip=0;ip<fNPlanes;ip++) {
+    for(Int_t wire=1;wire<=fNWires[ip];wire++) {
+      if(fPlanes[ip]->IsWireMasked(wire)) {
+	planes.push_back(ip+1);
+	wires.push_back(wire);
+      }
+    }
+  }
+  if(planes.empty()) return;
+  cout << GetApparatus()->GetName() << "." << GetName() << " masked wires:"
+       << endl;
+  cout << fPrefix << "dc_num_deadwires = " << planes.size() << endl;
+  cout << fPrefix << "dc_deadwire_plane = ";
+  for(UInt_t i=0;i<planes.size();i++)
+    cout << (i>0 ? ", " : "") << planes[i];
+  cout << endl;
+  cout << fPrefix << "dc_deadwire_num = ";
+  for(UInt_t i=0;i<wires.size();i++)
+    cout << (i>0 ? ", " : "") << wires[i];
+  cout << endl;
+}
+
 //_____________________________________________________________________________
 void THcDC::EffInit()
 {
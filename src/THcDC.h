@@ -19,6 +19,8 @@
 
 //class THaScCalib;
 class TClonesArray;
+class THcDCTrack;
+class THcDCResidualCalib;
 
 class THcDC : public THaTrackingDetector, public THcHitList {
 
@@ -39,6 +41,8 @@ public:
   //  Int_t GetNTracks() const { return fNDCTracks; }
   //  const TClonesArray* GetTrackHits() const { return fTrackProj; }
 
+  Int_t GetNPlanes() const { return fNPlanes;}
+  THcDriftChamberPlane* GetPlane(Int_t plane) const { return fPlanes[plane-1];}
   Int_t GetNWires(Int_t plane) const { return fNWires[plane-1];}
   Int_t GetNChamber(Int_t plane) const { return fNChamber[plane-1];}
   Int_t GetWireOrder(Int_t plane) const { return fWireOrder[plane-1];}
@@ -71,6 +75,37 @@ public:
       fXCenter[chamber]*sin(fAlphaAngle[plane-1]) +
       fYCenter[chamber]*cos(fAlphaAngle[plane-1]);
   }
+  // Accumulate new drift maps during the replay, optionally replacing
+  // the lookup tables every update events
+  void SetDriftMapCalib(Bool_t enable=kTRUE, Int_t update=0);
+  // Use the drift maps accumulated in the last run
+  Int_t ApplyDriftMaps();
+  // Change the time zero of a plane, e.g. between calibration passes
+  void SetPlaneTimeZero(Int_t plane, Double_t t0);
+  // Accumulate the residual statistics of the planes from single track
+  // events during the replay, and write them with the central wire
+  // numbers corrected for the mean residuals to <p>dcalign.param.<run>
+  void SetResidualCalib(Bool_t enable=kTRUE) { fResidualCalibOn = enable ? 1 : 0; }
+  THcDCResidualCalib* GetResidualCalib() const { return fResidualCalib; }
+  // Move the wires by the mean residuals of the last run
+  Int_t ApplyResidualCalib();
+  // Copy the hit and efficiency counters of the planes to the
+  // <p>dc_early, _late, ... variables of gHcParms; print the copies
+  void SampleCounters();
+  void PrintCounters() const;
+  // Mask a wire of a plane (1..nplanes) on top of the dead wires of the
+  // parameters; masked wires make no hits.  The wires masked (or
+  // unmasked) this way are kept, and masked again at every Init and
+  // ResetWireMasks, until ClearWireMasks.
+  void MaskWire(Int_t plane, Int_t wire, Bool_t mask=kTRUE);
+  void ResetWireMasks();
+  void ClearWireMasks();
+  Int_t MaskHotWires();
+  void PrintWireMasks() const;
+
+  virtual Int_t Begin( THaRunBase* run=0 );
+  virtual Int_t End( THaRunBase* run=0 );
+
   //  friend class THaScCalib;
 
   THcDC();  // for ROOT I/O
@@ -108,6 +143,7 @@ protected:
   Int_t fN_True_RawHits;
   Int_t fNSp;                   // Number of space points
   Double_t* fResiduals;         //[fNPlanes] Array of residuals
+  Int_t fResidualsBlock;        // Compute block of the residuals
 
   Double_t fNSperChan;		/* TDC bin size */
   Double_t fWireVelocity;
@@ -152,6 +188,35 @@ protected:
   Int_t* fNChamHits;
   Int_t* fPlaneEvents;
 
+  // Drift map calibration
+  Int_t fDriftMapCalibOn;
+  Int_t fDriftMapUpdate;	// Events between table updates, 0 for none
+  Int_t fDriftMapMinEntries;	// Drift times needed to update a table
+  Int_t fDriftMapEvents;
+
+  // Residual statistics
+  Int_t fResidualCalibOn;
+  Double_t fResidualMaxChi2;	// Track chi2 per degree of freedom cut
+  Int_t fResidualMinEntries;	// Residuals needed to correct a plane
+  THcDCResidualCalib* fResidualCalib;
+  std::vector<Double_t> fResidualParms;    // End of run values in gHcParms
+  std::vector<TString> fResidualParmNames;
+
+  // Hit and efficiency counters, sampled every fCounterSample events
+  Int_t fCounterSample;
+  Int_t fCounterEvents;
+  std::vector<Double_t> fCounterParms;     // Sampled values in gHcParms
+  std::vector<TString> fCounterParmNames;
+
+  // Masked wires
+  std::vector<Int_t> fDeadWirePlane;	// Dead wires of the parameters
+  std::vector<Int_t> fDeadWireNum;
+  std::vector<Int_t> fMaskWirePlane;	// Wires given to MaskWire
+  std::vector<Int_t> fMaskWireNum;
+  std::vector<Bool_t> fMaskWireOn;	// Masked, or unmasked
+  Double_t fHotWireOccupancy;	// Hit fraction above which a wire is hot
+  Int_t fHotWireMinEvents;	// Events between the hot wire checks
+
   // Useful derived quantities
   // double tan_angle, sin_angle, cos_angle;
   
@@ -170,9 +235,12 @@ protected:
   void           LinkStubs();
   void           TrackFit();
   Double_t       DpsiFun(Double_t ray[4], Int_t plane);
-  Int_t          End(THaRunBase* run);
   void           EffInit();
   void           Eff();
+  void           AccumulateResiduals(THcDCTrack* track);
+  void           DefineResidualParms();
+  void           DefineCounterParms();
+  void           RemoveParms(std::vector<TString>& names);
 
   void Setup(const char* name, const char* description);
   void PrintSpacePoints();
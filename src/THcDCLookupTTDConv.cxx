@@ -33,6 +33,18 @@ THcDCLookupTTDConv::~THcDCLookupTTDConv()
 {
   // Destructor. Remove variables from global list.
 
+  delete [] fTable;
+}
+
+//______________________________________________________________________________
+void THcDCLookupTTDConv::SetTable(const Double_t* Table)
+{
+  // Copy a new table of fNumBins fractions.  The wires keep pointing to
+  // this converter, so the hits converted from now on use the new table.
+
+  for(Int_t i=0;i<fNumBins;i++) {
+    fTable[i] = Table[i];
+  }
 }
 
 //______________________________________________________________________________
@@ -20,6 +20,13 @@ public:
 
   virtual Double_t ConvertTimeToDist(Double_t time);
 
+  // Replace the table, e.g. with a drift map accumulated during the run
+  void     SetTable(const Double_t* Table);
+
+  Double_t GetT0() const { return fT0; }
+  Double_t GetBinSize() const { return fBinSize; }
+  Int_t    GetNumBins() const { return fNumBins; }
+  const Double_t* GetTable() const { return fTable; }
 
 protected:
 
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcDCResidualCalib                                                        //
+//                                                                           //
+// Running sums of the track residuals of each drift chamber plane, and of   //
+// their products with the focal plane track parameters (x, xp, y, yp), so   //
+// that the mean and width of the residuals and their correlations with the  //
+// track are known at the end of a replay without writing the residuals of   //
+// every event.  A mean residual is a shift of the wire positions of the     //
+// plane; a residual depending on the track position along the wires is a    //
+// rotation.  The residuals are those of THcDC::TrackFit, of the hits used   //
+// in the fit.                                                               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcDCResidualCalib.h"
+#include "TMath.h"
+#include "TString.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstring>
+
+using namespace std;
+
+static const char* const kParNames[THcDCResidualCalib::kNPar] =
+  { "x", "xp", "y", "yp" };
+
+//_____________________________________________________________________________
+THcDCResidualCalib::THcDCResidualCalib() : fNtracks(0)
+{
+  // Constructor
+}
+
+//_____________________________________________________________________________
+THcDCResidualCalib::~THcDCResidualCalib()
+{
+  // Destructor
+}
+
+//_____________________________________________________________________________
+void THcDCResidualCalib::Init( UInt_t nplanes )
+{
+  // Set up the sums for nplanes planes
+
+  fSums.resize(nplanes);
+  Clear();
+}
+
+//_____________________________________________________________________________
+void THcDCResidualCalib::Clear( Option_t* )
+{
+  // Reset the sums
+
+  if (!fSums.empty())
+    memset(&fSums[0], 0, fSums.size()*sizeof(Sums));
+  fNtracks = 0;
+}
+
+//_____________________________________________________________________________
+Double_t THcDCResidualCalib::GetMean( UInt_t plane ) const
+{
+  // Mean residual of the plane
+
+  const Sums& s = fSums[plane];
+  return s.n > 0 ? s.r/s.n : 0.;
+}
+
+//_____________________________________________________________________________
+Double_t THcDCResidualCalib::GetSigma( UInt_t plane ) const
+{
+  // RMS width of the residuals of the plane
+
+  const Sums& s = fSums[plane];
+  if (s.n < 2) return 0.;
+  Double_t mean = s.r/s.n;
+  return TMath::Sqrt(TMath::Max(s.rr/s.n - mean*mean, 0.));
+}
+
+//_____________________________________________________________________________
+Double_t THcDCResidualCalib::GetCorrelation( UInt_t plane, Int_t k ) const
+{
+  // Correlation coefficient of the residuals with track parameter k
+
+  const Sums& s = fSums[plane];
+  if (s.n < 2) return 0.;
+  Double_t mr = s.r/s.n;
+  Double_t mp = s.p[k]/s.n;
+  Double_t vr = s.rr/s.n - mr*mr;
+  Double_t vp = s.pp[k]/s.n - mp*mp;
+  if (vr <= 0. || vp <= 0.) return 0.;
+  return (s.rp[k]/s.n - mr*mp)/TMath::Sqrt(vr*vp);
+}
+
+//_____________________________________________________________________________
+Double_t THcDCResidualCalib::GetSlope( UInt_t plane, Int_t k ) const
+{
+  // Slope of the straight line fit of the residuals against track
+  // parameter k
+
+  const Sums& s = fSums[plane];
+  if (s.n < 2) return 0.;
+  Double_t mr = s.r/s.n;
+  Double_t mp = s.p[k]/s.n;
+  Double_t vp = s.pp[k]/s.n - mp*mp;
+  if (vp <= 0.) return 0.;
+  return (s.rp[k]/s.n - mr*mp)/vp;
+}
+
+//_____________________________________________________________________________
+Int_t THcDCResidualCalib::WriteParam( const char* filename, const char* prefix,
+				      Int_t run, const Double_t* centralwire,
+				      const Double_t* pitch,
+				      UInt_t minentries ) const
+{
+  // Write the residual statistics as comments, and the
+  // <prefix>dc_central_wire parameter with the wires of each plane moved
+  // by its mean residual.  The wire positions are
+  // pitch*(wire-central_wire) - center, and the residual is the hit
+  // coordinate less the track coordinate, so the central wire grows by
+  // mean/pitch.
+
+  ofstream output(filename);
+  if (!output) {
+    cout << "THcDCResidualCalib: can not open " << filename << endl;
+    return -1;
+  }
+
+  UInt_t nplanes = fSums.size();
+  output << "; Drift chamber residuals for run " << run << ", "
+	 << fNtracks << " tracks" << endl;
+  output << "; plane  residuals  mean[cm]  sigma[cm]";
+  for (Int_t k=0; k<kNPar; k++)
+    output << setw(10) << Form("slope(%s)",kParNames[k]);
+  output << endl;
+  for (UInt_t ip=0; ip<nplanes; ip++) {
+    output << ";" << setw(6) << ip+1 << setw(11) << GetN(ip)
+	   << fixed << setprecision(4) << setw(10) << GetMean(ip)
+	   << setw(11) << GetSigma(ip);
+    for (Int_t k=0; k<kNPar; k++)
+      output << setw(10) << GetSlope(ip,k);
+    output << endl;
+  }
+
+  TString name = Form("%sdc_central_wire = ",prefix);
+  TString indent(' ', name.Length());
+  output << endl;
+  for (UInt_t ip=0; ip<nplanes; ip++) {
+    Double_t cw = centralwire[ip];
+    if (GetN(ip) >= minentries && GetN(ip) > 0 && pitch[ip] != 0.)
+      cw += GetMean(ip)/pitch[ip];
+    if (ip%6 == 0) output << (ip == 0 ? name : indent);
+    output << fixed << setprecision(3) << cw;
+    if (ip%6 == 5 || ip == nplanes-1)
+      output << endl;
+    else
+      output << ", ";
+  }
+
+  return 0;
+}
+
+//_____________________________________________________________________________
+void THcDCResidualCalib::Print( Option_t* ) const
+{
+  // Print the statistics of each plane
+
+  ios_base::fmtflags flags = cout.flags();
+  streamsize prec = cout.precision();
+  cout << "Drift chamber residuals: " << fNtracks << " tracks" << endl;
+  cout << "  plane      n   mean[cm]  sigma[cm]";
+  for (Int_t k=0; k<kNPar; k++)
+    cout << setw(9) << Form("corr(%s)",kParNames[k]);
+  cout << endl;
+  for (UInt_t ip=0; ip<fSums.size(); ip++) {
+    cout << setw(7) << ip+1 << setw(7) << GetN(ip)
+	 << fixed << setprecision(4) << setw(11) << GetMean(ip)
+	 << setw(11) << GetSigma(ip) << setprecision(3);
+    for (Int_t k=0; k<kNPar; k++)
+      cout << setw(9) << GetCorrelation(ip,k);
+    cout << endl;
+  }
+  cout.flags(flags);
+  cout.precision(prec);
+}
+
+ClassImp(THcDCResidualCalib)
+////////////////////////////////////////////////////////////////////////////////
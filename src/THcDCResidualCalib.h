@@ -0,0 +1,75 @@
+#ifndef ROOT_THcDCResidualCalib
+#define ROOT_THcDCResidualCalib
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcDCResidualCalib                                                        //
+//                                                                           //
+// Drift chamber residual statistics per plane, accumulated during a replay. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class THcDCResidualCalib : public TObject {
+
+public:
+  THcDCResidualCalib();
+  virtual ~THcDCResidualCalib();
+
+  // Track parameters the residuals are correlated with
+  enum { kX, kXp, kY, kYp, kNPar };
+
+  void     Init( UInt_t nplanes );
+
+  // Add the residual of a track in plane (0..nplanes-1). track[kNPar]
+  // are the focal plane parameters of the track.
+  void     AddResidual( UInt_t plane, Double_t residual,
+			const Double_t* track ) {
+    Sums& s = fSums[plane];
+    s.n++;
+    s.r += residual;
+    s.rr += residual*residual;
+    for (Int_t k=0; k<kNPar; k++) {
+      s.p[k] += track[k];
+      s.pp[k] += track[k]*track[k];
+      s.rp[k] += residual*track[k];
+    }
+  }
+  void     AddTrack() { fNtracks++; }
+
+  UInt_t   GetNPlanes() const { return fSums.size(); }
+  UInt_t   GetNTracks() const { return fNtracks; }
+  UInt_t   GetN( UInt_t plane ) const { return fSums[plane].n; }
+  Double_t GetMean( UInt_t plane ) const;
+  Double_t GetSigma( UInt_t plane ) const;
+  // Correlation coefficient of the residual with track parameter k, and
+  // the slope of the residual as a function of it
+  Double_t GetCorrelation( UInt_t plane, Int_t k ) const;
+  Double_t GetSlope( UInt_t plane, Int_t k ) const;
+
+  // Write the statistics, and the central wire numbers centralwire[] of
+  // the planes corrected by the mean residuals, for planes with at
+  // least minentries residuals
+  Int_t    WriteParam( const char* filename, const char* prefix, Int_t run,
+		       const Double_t* centralwire, const Double_t* pitch,
+		       UInt_t minentries ) const;
+
+  virtual void Clear( Option_t* opt="" );
+  virtual void Print( Option_t* opt="" ) const;
+
+protected:
+  struct Sums {
+    UInt_t   n;
+    Double_t r, rr;
+    Double_t p[kNPar], pp[kNPar], rp[kNPar];
+  };
+
+  std::vector<Sums> fSums;     // [nplanes]
+  UInt_t   fNtracks;
+
+  ClassDef(THcDCResidualCalib,0)   // Drift chamber residual statistics
+};
+
+#endif
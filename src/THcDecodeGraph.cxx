@@ -0,0 +1,199 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcDecodeGraph                                                            //
+//                                                                           //
+// Dependency graph for the Decode step of the detectors of an apparatus.    //
+//                                                                           //
+// Detectors are added in the order the apparatus holds them, and edges      //
+// say that one detector must be decoded before another, e.g. the            //
+// hodoscope before the drift chambers, which use the hodoscope start time   //
+// in ProcessHits.  Build() sorts the detectors into levels; detectors in    //
+// a level depend only on detectors of earlier levels.  Within a level the   //
+// original order is kept, so with one thread the detectors are decoded in   //
+// the same order as by THaApparatus::Decode (as long as the edges agree     //
+// with that order).                                                         //
+//                                                                           //
+// With more than one thread, the detectors of a level are handed out to a   //
+// small pool of TThreads and the calling thread (THcTaskPool), each taking  //
+// the next undecoded detector until the level is done.  Detectors only      //
+// write their own data members during Decode and read the event data,       //
+// which THcTaskPool lists as safe, so this works for detectors that do not  //
+// share state outside the edges of the graph.  This is meant for online     //
+// replay, where the latency of an event matters.                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcDecodeGraph.h"
+#include "THaDetector.h"
+#include "THaEvData.h"
+#include "THcTaskPool.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+ClassImp(THcDecodeGraph)
+
+//______________________________________________________________________________
+THcDecodeGraph::THcDecodeGraph() :
+  fPool(0), fEvData(0)
+{
+  // Constructor
+}
+
+//______________________________________________________________________________
+THcDecodeGraph::~THcDecodeGraph()
+{
+  // Destructor. Stops the worker threads.
+
+  delete fPool;
+}
+
+//______________________________________________________________________________
+Int_t THcDecodeGraph::AddDetector(THaDetector* det)
+{
+  // Add a detector. Returns its index.
+
+  fDetectors.push_back(det);
+  return fDetectors.size()-1;
+}
+
+//______________________________________________________________________________
+Int_t THcDecodeGraph::AddEdge(Int_t before, Int_t after)
+{
+  // Detector "before" must be decoded before detector "after"
+
+  Int_t n = fDetectors.size();
+  if(before < 0 || before >= n || after < 0 || after >= n || before == after) {
+    Error("AddEdge","Invalid edge %d -> %d",before,after);
+    return -1;
+  }
+  fEdgeFrom.push_back(before);
+  fEdgeTo.push_back(after);
+  return 0;
+}
+
+//______________________________________________________________________________
+Int_t THcDecodeGraph::AddEdge(const char* before, const char* after)
+{
+  // Add an edge between detectors given by name
+
+  Int_t ib=-1, ia=-1;
+  for(UInt_t i=0;i<fDetectors.size();i++) {
+    if(strcmp(fDetectors[i]->GetName(),before)==0) ib = i;
+    if(strcmp(fDetectors[i]->GetName(),after)==0) ia = i;
+  }
+  if(ib < 0 || ia < 0) {
+    Error("AddEdge","Unknown detector in edge %s -> %s",before,after);
+    return -1;
+  }
+  return AddEdge(ib,ia);
+}
+
+//______________________________________________________________________________
+Int_t THcDecodeGraph::Build()
+{
+  // Sort the detectors into levels. Returns the number of levels,
+  // or -1 if the edges contain a cycle.
+
+  Int_t n = fDetectors.size();
+  vector<Int_t> level(n,0);
+  vector<Int_t> indegree(n,0);
+  for(UInt_t ie=0;ie<fEdgeTo.size();ie++) {
+    indegree[fEdgeTo[ie]]++;
+  }
+  // Kahn's algorithm, a detector's level being one more than the
+  // highest level of the detectors it depends on
+  vector<Int_t> ready;
+  for(Int_t i=0;i<n;i++) {
+    if(indegree[i]==0) ready.push_back(i);
+  }
+  Int_t nsorted = 0, nlevels = 0;
+  while(!ready.empty()) {
+    Int_t i = ready.back();
+    ready.pop_back();
+    nsorted++;
+    if(level[i]+1 > nlevels) nlevels = level[i]+1;
+    for(UInt_t ie=0;ie<fEdgeFrom.size();ie++) {
+      if(fEdgeFrom[ie] != i) continue;
+      Int_t j = fEdgeTo[ie];
+      if(level[i]+1 > level[j]) level[j] = level[i]+1;
+      if(--indegree[j] == 0) ready.push_back(j);
+    }
+  }
+  fOrder.clear();
+  fLevelStart.clear();
+  if(nsorted < n) {
+    Error("Build","Decode dependencies contain a cycle");
+    return -1;
+  }
+  for(Int_t l=0;l<nlevels;l++) {
+    fLevelStart.push_back(fOrder.size());
+    for(Int_t i=0;i<n;i++) {
+      if(level[i]==l) fOrder.push_back(i);
+    }
+  }
+  fLevelStart.push_back(fOrder.size());
+  return nlevels;
+}
+
+//______________________________________________________________________________
+void THcDecodeGraph::SetNThreads(Int_t nthreads)
+{
+  // Use nthreads threads (including the calling one) for decoding
+
+  delete fPool;
+  fPool = (nthreads > 1) ? new THcTaskPool(nthreads) : 0;
+}
+
+//______________________________________________________________________________
+Int_t THcDecodeGraph::GetNThreads() const
+{
+  return fPool ? fPool->GetNThreads() : 1;
+}
+
+//______________________________________________________________________________
+void THcDecodeGraph::DecodeTask(void* arg, Int_t k)
+{
+  // Decode the detector at position k of the execution order
+
+  THcDecodeGraph* graph = static_cast<THcDecodeGraph*>(arg);
+  graph->fDetectors[graph->fOrder[k]]->Decode(*graph->fEvData);
+}
+
+//______________________________________________________________________________
+Int_t THcDecodeGraph::Decode(const THaEvData& evdata)
+{
+  // Decode all detectors for this event
+
+  fEvData = &evdata;
+  Int_t nlevels = GetNLevels();
+  for(Int_t l=0;l<nlevels;l++) {
+    Int_t first = fLevelStart[l];
+    Int_t last = fLevelStart[l+1];
+    if(!fPool) {
+      for(Int_t k=first;k<last;k++) {
+	fDetectors[fOrder[k]]->Decode(evdata);
+      }
+      continue;
+    }
+    fPool->Run(DecodeTask, this, first, last);
+  }
+  return 0;
+}
+
+//______________________________________________________________________________
+void THcDecodeGraph::Print(Option_t*) const
+{
+  // Print the levels
+
+  cout << "Decode graph, " << GetNThreads() << " thread(s)" << endl;
+  for(Int_t l=0;l<GetNLevels();l++) {
+    cout << "  level " << l << ":";
+    for(Int_t k=fLevelStart[l];k<fLevelStart[l+1];k++) {
+      cout << " " << fDetectors[fOrder[k]]->GetName();
+    }
+    cout << endl;
+  }
+}
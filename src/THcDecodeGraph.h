@@ -0,0 +1,58 @@
+#ifndef ROOT_THcDecodeGraph
+#define ROOT_THcDecodeGraph
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcDecodeGraph                                                            //
+//                                                                           //
+// Decodes the detectors of an apparatus in dependency order, running        //
+// independent detectors concurrently.                                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class THaDetector;
+class THaEvData;
+class THcTaskPool;
+
+class THcDecodeGraph : public TObject {
+
+public:
+  THcDecodeGraph();
+  virtual ~THcDecodeGraph();
+
+  Int_t  AddDetector(THaDetector* det);
+  Int_t  AddEdge(Int_t before, Int_t after);
+  Int_t  AddEdge(const char* before, const char* after);
+  Int_t  Build();
+  void   SetNThreads(Int_t nthreads);
+
+  Int_t  Decode(const THaEvData& evdata);
+
+  Int_t  GetNDetectors() const { return fDetectors.size(); }
+  Int_t  GetNLevels() const    { return fLevelStart.size() > 0 ? fLevelStart.size()-1 : 0; }
+  Int_t  GetNThreads() const;
+  void   Print(Option_t* opt="") const;
+
+protected:
+  std::vector<THaDetector*> fDetectors;
+  std::vector<Int_t> fEdgeFrom;
+  std::vector<Int_t> fEdgeTo;
+
+  // Detectors in execution order, grouped into levels of detectors
+  // that only depend on detectors of earlier levels
+  std::vector<Int_t> fOrder;
+  std::vector<Int_t> fLevelStart;       // [nlevels+1] into fOrder
+
+  // Threads decoding the detectors of a level, 0 with one thread
+  THcTaskPool* fPool;
+  const THaEvData* fEvData;
+
+  static void DecodeTask(void* arg, Int_t k);
+
+  ClassDef(THcDecodeGraph,0)   // Concurrent decoding of detectors
+};
+
+#endif
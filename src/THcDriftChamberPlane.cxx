@@ -17,6 +17,7 @@
 #include "THcDC.h"
 #include "THcHodoscope.h"
 #include "TClass.h"
+#include "TMath.h"
 
 #include <cstring>
 #include <cstdio>
@@ -38,6 +39,8 @@ THcDriftChamberPlane::THcDriftChamberPlane( const char* name,
   fHits = new TClonesArray("THcDCHit",100);
   fWires = new TClonesArray("THcDCWire", 100);
   fTTDConv = NULL;
+  fDriftMapCalibOn = kFALSE;
+  fDriftMapEntries = 0;
 
   fPlaneNum = planenum;
 }
@@ -50,6 +53,8 @@ THcDriftChamberPlane::THcDriftChamberPlane() :
   fHits = NULL;
   fWires = NULL;
   fTTDConv = NULL;
+  fDriftMapCalibOn = kFALSE;
+  fDriftMapEntries = 0;
 }
 //______________________________________________________________________________
 THcDriftChamberPlane::~THcDriftChamberPlane()
@@ -88,23 +93,20 @@ Int_t THcDriftChamberPlane::ReadDatabase( const TDatime& date )
   // See what file it looks for
   
   char prefix[2];
-  UInt_t NumDriftMapBins;
-  Double_t DriftMapFirstBin;
-  Double_t DriftMapBinSize;
   
   prefix[0]=tolower(GetParent()->GetPrefix()[0]);
   prefix[1]='\0';
   DBRequest list[]={
-    {"driftbins", &NumDriftMapBins, kInt},
-    {"drift1stbin", &DriftMapFirstBin, kDouble},
-    {"driftbinsz", &DriftMapBinSize, kDouble},
+    {"driftbins", &fNDriftMapBins, kInt},
+    {"drift1stbin", &fDriftMapFirstBin, kDouble},
+    {"driftbinsz", &fDriftMapBinSize, kDouble},
     {0}
   };
   gHcParms->LoadParmValues((DBRequest*)&list,prefix);
 
-  Double_t *DriftMap = new Double_t[NumDriftMapBins];
+  Double_t *DriftMap = new Double_t[fNDriftMapBins];
   DBRequest list2[]={
-    {Form("wc%sfract",GetName()),DriftMap,kDouble,NumDriftMapBins},
+    {Form("wc%sfract",GetName()),DriftMap,kDouble,fNDriftMapBins},
     {0}
   };
   gHcParms->LoadParmValues((DBRequest*)&list2,prefix);
@@ -201,16 +203,20 @@ Int_t THcDriftChamberPlane::ReadDatabase( const TDatime& date )
 
   //  cout << fPlaneNum << " " << fNWires << " " << fWireOrder << endl;
 
-  fTTDConv = new THcDCLookupTTDConv(DriftMapFirstBin,fPitch/2,DriftMapBinSize,
-				    NumDriftMapBins,DriftMap);
+  delete fTTDConv;
+  fTTDConv = new THcDCLookupTTDConv(fDriftMapFirstBin,fPitch/2,fDriftMapBinSize,
+				    fNDriftMapBins,DriftMap);
   delete [] DriftMap;
+  fDriftMapHist.assign(fNDriftMapBins, 0);
+  fDriftMapEntries = 0;
+  fCounters.assign((fNWires+1)*kNCounters, 0);
+  fWireMask.assign(fNWires/32+1, 0);
 
   Int_t nWires = fParent->GetNWires(fPlaneNum);
   // For HMS, wire numbers start with one, but arrays start with zero.
   // So wire number is index+1
   for (int i=0; i<nWires; i++) {
-    Double_t pos = fPitch*( (fWireOrder==0?(i+1):fNWires-i) 
-			    - fCentralWire) - fCenter;
+    Double_t pos = GetWirePos(i+1);
     new((*fWires)[i]) THcDCWire( i+1, pos , 0.0, fTTDConv);
     //if( something < 0 ) wire->SetFlag(1);
   }
@@ -226,6 +232,26 @@ Int_t THcDriftChamberPlane::ReadDatabase( const TDatime& date )
 
   return kOK;
 }
+//_____________________________________________________________________________
+Double_t THcDriftChamberPlane::GetWirePos( Int_t wire ) const
+{
+  // Position of wire (1..fNWires) in the plane
+
+  return fPitch*( (fWireOrder==0?wire:fNWires+1-wire) - fCentralWire)
+    - fCenter;
+}
+
+//_____________________________________________________________________________
+void THcDriftChamberPlane::SetCentralWire( Double_t centralwire )
+{
+  // Move the wires to a new central wire number. Hits of the following
+  // events have the new positions.
+
+  fCentralWire = centralwire;
+  for (Int_t i=0; i<fWires->GetLast()+1; i++)
+    static_cast<THcDCWire*>(fWires->At(i))->SetPos(GetWirePos(i+1));
+}
+
 //_____________________________________________________________________________
 Int_t THcDriftChamberPlane::DefineVariables( EMode mode )
 {
@@ -311,27 +337,43 @@ Int_t THcDriftChamberPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
     Int_t wireNum = hit->fCounter;
     THcDCWire* wire = GetWire(wireNum);
     Int_t wire_last = -1;
+    // Counters of the wire, of slot 0 for a wire number out of range
+    UInt_t* counts = &fCounters[(wireNum>0 && wireNum<=fNWires ? wireNum : 0)
+				*kNCounters];
+    // Masked (dead or hot) wires are counted, but make no hits
+    Bool_t masked = IsWireMasked(wireNum);
     for(UInt_t mhit=0; mhit<hit->fNHits; mhit++) {
       fNRawhits++;
       /* Sort into early, late and ontime */
       Int_t rawtdc = hit->fTDC[mhit];
-      if(rawtdc < fTdcWinMin) {
-	// Increment early counter  (Actually late because TDC is backward)
-      } else if (rawtdc > fTdcWinMax) {
-	// Increment late count 
-      } else {
+      // Early is actually late because the TDC is backward
+      Int_t early = rawtdc < fTdcWinMin;
+      Int_t late = rawtdc > fTdcWinMax;
+      Int_t inwindow = (early|late)^1;
+      Int_t extra = inwindow & (wire_last == wireNum);
+      counts[kEarly] += early;
+      counts[kLate] += late;
+      counts[kInWindow] += inwindow - extra;
+      counts[kExtra] += extra;
+      if(inwindow) {
 	// A good hit
-	if(wire_last == wireNum) {
-	  // Increment extra hit counter 
+	if(extra) {
 	  // Are we choosing the correct hit in the case of multiple hits?
 	  // Are we choose the same hit that ENGINE chooses?
 	  // cout << "Extra hit " << fPlaneNum << " " << wireNum << " " << rawtdc << endl;
-	} else {
+	} else if(!masked) {
 	  Double_t time = -StartTime   // (comes from h_trans_scin
 	    - rawtdc*fNSperChan + fPlaneTimeZero;
 	  // How do we get this start time from the hodoscope to here
 	  // (or at least have it ready by coarse process)
 	  new( (*fHits)[nextHit++] ) THcDCHit(wire, rawtdc, time, this);
+	  if(fDriftMapCalibOn) {
+	    Double_t x = (time - fDriftMapFirstBin)/fDriftMapBinSize;
+	    if(x >= 0.0 && x < fNDriftMapBins) {
+	      fDriftMapHist[(UInt_t) x]++;
+	      fDriftMapEntries++;
+	    }
+	  }
 	}
 	wire_last = wireNum;
       }
@@ -341,6 +383,177 @@ Int_t THcDriftChamberPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
   return(ihit);
 }
 
-    
-  
-  
+//_____________________________________________________________________________
+Int_t THcDriftChamberPlane::GetWireNum( Double_t pos ) const
+{
+  // Number of the wire nearest to pos, 0 if outside of the plane
+
+  Double_t w = (pos + fCenter)/fPitch + fCentralWire;
+  Int_t wire = TMath::Nint(fWireOrder==0 ? w : fNWires+1-w);
+  return (wire >= 1 && wire <= fNWires) ? wire : 0;
+}
+
+//_____________________________________________________________________________
+void THcDriftChamberPlane::CountTrack( Double_t pos )
+{
+  // Track based efficiency: count the wire a track crosses at pos, and
+  // whether the plane has a hit on it or on a neighbouring wire
+
+  Int_t wire = GetWireNum(pos);
+  if(wire == 0) return;
+
+  Int_t found = 0;
+  Int_t nhits = GetNHits();
+  for(Int_t ihit=0;ihit<nhits;ihit++) {
+    Int_t dw = static_cast<THcDCHit*>(fHits->UncheckedAt(ihit))->GetWireNum()
+      - wire;
+    found |= (dw >= -1 && dw <= 1);
+  }
+  UInt_t* counts = &fCounters[wire*kNCounters];
+  counts[kTrackExpected]++;
+  counts[kTrackFound] += found;
+}
+
+//_____________________________________________________________________________
+void THcDriftChamberPlane::MaskWire( Int_t wire, Bool_t mask )
+{
+  // Mask (or unmask) a wire: its TDC hits make no THcDCHit from the next
+  // event on
+
+  if(wire < 1 || wire > fNWires) return;
+  UInt_t bit = 1U << (wire & 31);
+  if(mask)
+    fWireMask[wire >> 5] |= bit;
+  else
+    fWireMask[wire >> 5] &= ~bit;
+}
+
+//_____________________________________________________________________________
+Int_t THcDriftChamberPlane::GetNMaskedWires() const
+{
+  // Number of masked wires
+
+  Int_t n = 0;
+  for(Int_t wire=1;wire<=fNWires;wire++)
+    n += IsWireMasked(wire);
+  return n;
+}
+
+//_____________________________________________________________________________
+Int_t THcDriftChamberPlane::MaskHotWires( Double_t maxoccupancy, UInt_t nevents )
+{
+  // Mask the wires hit in the time window in more than maxoccupancy of
+  // nevents events, as counted since the last ResetCounters. Returns the
+  // number of wires newly masked.
+
+  if(nevents == 0) return 0;
+  Int_t nmasked = 0;
+  for(Int_t wire=1;wire<=fNWires;wire++) {
+    if(IsWireMasked(wire)) continue;
+    if(GetWireCount(wire,kInWindow) > maxoccupancy*nevents) {
+      MaskWire(wire);
+      nmasked++;
+      cout << "THcDriftChamberPlane: " << GetName() << " wire " << wire
+	   << " hot, " << GetWireCount(wire,kInWindow) << " hits in "
+	   << nevents << " events, masked" << endl;
+    }
+  }
+  return nmasked;
+}
+
+//_____________________________________________________________________________
+ULong64_t THcDriftChamberPlane::GetCount( Int_t counter ) const
+{
+  // Sum of a counter over the wires of the plane
+
+  ULong64_t sum = 0;
+  for(UInt_t i=counter;i<fCounters.size();i+=kNCounters)
+    sum += fCounters[i];
+  return sum;
+}
+
+//_____________________________________________________________________________
+void THcDriftChamberPlane::SetDriftMapCalib( Bool_t enable )
+{
+  // Start (or stop) histogramming the drift times for a new drift map.
+  // The histogram is reset when the calibration is enabled.
+
+  fDriftMapCalibOn = enable;
+  if(enable) {
+    fDriftMapHist.assign(fNDriftMapBins, 0);
+    fDriftMapEntries = 0;
+  }
+}
+
+//_____________________________________________________________________________
+UInt_t THcDriftChamberPlane::GetDriftMap( vector<Double_t>& fract ) const
+{
+  // Integrate the drift time histogram into the lookup table: the
+  // fraction of the drift times before the start of each bin, since
+  // THcDCLookupTTDConv takes table entry ib as the value at the start of
+  // bin ib.  This is the drift distance in units of half the wire pitch if
+  // the cell is uniformly illuminated.  Returns the number of drift times.
+
+  fract.assign(fNDriftMapBins, 0.0);
+  if(fDriftMapEntries == 0) return 0;
+
+  UInt_t sum = 0;
+  for(UInt_t ib=0;ib<fNDriftMapBins;ib++) {
+    fract[ib] = (Double_t) sum/fDriftMapEntries;
+    sum += fDriftMapHist[ib];
+  }
+  return fDriftMapEntries;
+}
+
+//_____________________________________________________________________________
+Int_t THcDriftChamberPlane::UpdateDriftMap( UInt_t minentries )
+{
+  // Replace the lookup table of the wires by the drift map accumulated so
+  // far, if it has at least minentries drift times.  Hits of the following
+  // events use the new table.  Returns 1 if the table was replaced.
+
+  THcDCLookupTTDConv* ttd = dynamic_cast<THcDCLookupTTDConv*>(fTTDConv);
+  if(!ttd || fDriftMapEntries == 0 || fDriftMapEntries < minentries)
+    return 0;
+
+  vector<Double_t> fract;
+  GetDriftMap(fract);
+  ttd->SetTable(&fract[0]);
+  return 1;
+}
+
+//_____________________________________________________________________________
+Int_t THcDriftChamberPlane::WriteDriftMap( ostream& out, const char* prefix,
+					   UInt_t minentries ) const
+{
+  // Write the drift map as the <prefix>wc<plane>fract parameter of
+  // hdriftmap.param: 8 values on the line of the name, then 10 per line.
+  // With no drift times, or fewer than minentries, the current lookup
+  // table is written instead.  Returns 1 if the drift map was written, 0
+  // for the current table.
+
+  vector<Double_t> fract;
+  Int_t status = 1;
+  THcDCLookupTTDConv* ttd = dynamic_cast<THcDCLookupTTDConv*>(fTTDConv);
+  if(fDriftMapEntries > 0 && fDriftMapEntries >= minentries) {
+    GetDriftMap(fract);
+  } else if(ttd && ttd->GetNumBins() == (Int_t)fNDriftMapBins) {
+    fract.assign(ttd->GetTable(), ttd->GetTable()+fNDriftMapBins);
+    status = 0;
+  } else {
+    return -1;
+  }
+
+  out << prefix << "wc" << GetName() << "fract=";
+  for(UInt_t ib=0;ib<fNDriftMapBins;ib++) {
+    char value[16];
+    sprintf(value, "%.4f", fract[ib]);
+    out << value;
+    if(ib+1 == fNDriftMapBins || ib%10 == 7) {
+      out << endl;
+    } else {
+      out << ",";
+    }
+  }
+  return status;
+}
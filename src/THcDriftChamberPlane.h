@@ -15,6 +15,8 @@
 #include "THaSubDetector.h"
 #include "TClonesArray.h"
 #include <cassert>
+#include <vector>
+#include <iosfwd>
 
 class THaEvData;
 class THcDCWire;
@@ -61,6 +63,11 @@ public:
   Int_t        GetReadoutX() { return fReadoutX; }
   Double_t     GetReadoutCorr() { return fReadoutCorr; }
   Double_t     GetCentralTime() { return fCentralTime; }
+  Double_t     GetPlaneTimeZero() const { return fPlaneTimeZero; }
+  void         SetPlaneTimeZero( Double_t t0 ) { fPlaneTimeZero = t0; }
+  Double_t     GetCentralWire() const { return fCentralWire; }
+  void         SetCentralWire( Double_t centralwire );
+  Double_t     GetWirePos( Int_t wire ) const;
   Int_t        GetDriftTimeSign() { return fDriftTimeSign; }
   Double_t     GetBeta() { return fBeta; }
   Double_t     GetSigma() { return fSigma; }
@@ -68,6 +75,40 @@ public:
   Double_t*    GetStubCoef() { return fStubCoef; }
   Double_t*    GetPlaneCoef() { return fPlaneCoef; }
 
+  // Drift map calibration: histogram the drift times of the good hits
+  // in the bins of the time to distance lookup table
+  void         SetDriftMapCalib( Bool_t enable );
+  UInt_t       GetDriftMapEntries() const { return fDriftMapEntries; }
+  UInt_t       GetDriftMapNBins() const { return fNDriftMapBins; }
+  Double_t     GetDriftMapFirstBin() const { return fDriftMapFirstBin; }
+  Double_t     GetDriftMapBinSize() const { return fDriftMapBinSize; }
+  UInt_t       GetDriftMap( std::vector<Double_t>& fract ) const;
+  Int_t        UpdateDriftMap( UInt_t minentries );
+  Int_t        WriteDriftMap( std::ostream& out, const char* prefix,
+			      UInt_t minentries=0 ) const;
+
+  // Hit counters of each wire: TDC hits before, after and in the time
+  // window (the first on the wire), extra hits on the wire in the
+  // window, and tracks crossing the wire and those with a hit on it
+  enum { kEarly, kLate, kInWindow, kExtra, kTrackExpected, kTrackFound,
+	 kNCounters };
+  void         ResetCounters() { fCounters.assign(fCounters.size(), 0); }
+  UInt_t       GetWireCount( Int_t wire, Int_t counter ) const
+  { return fCounters[wire*kNCounters+counter]; }
+  ULong64_t    GetCount( Int_t counter ) const;
+  Int_t        GetWireNum( Double_t pos ) const;
+  void         CountTrack( Double_t pos );
+
+  // Wire mask: TDC hits of masked (dead or hot) wires make no hits
+  void         MaskWire( Int_t wire, Bool_t mask=kTRUE );
+  void         ClearWireMask() { fWireMask.assign(fWireMask.size(), 0); }
+  Bool_t       IsWireMasked( Int_t wire ) const {
+    return (UInt_t)wire <= (UInt_t)fNWires &&
+      ((fWireMask[wire >> 5] >> (wire & 31)) & 1);
+  }
+  Int_t        GetNMaskedWires() const;
+  Int_t        MaskHotWires( Double_t maxoccupancy, UInt_t nevents );
+
   THcDriftChamberPlane(); // for ROOT I/O
 protected:
 
@@ -104,6 +145,15 @@ protected:
 
   Double_t fNSperChan;		/* TDC bin size */
 
+  UInt_t fNDriftMapBins;	// Time to distance lookup table binning
+  Double_t fDriftMapFirstBin;
+  Double_t fDriftMapBinSize;
+  Bool_t fDriftMapCalibOn;
+  std::vector<UInt_t> fDriftMapHist;  // [fNDriftMapBins] drift times
+  UInt_t fDriftMapEntries;
+  std::vector<UInt_t> fCounters;  // [(fNWires+1)*kNCounters] by wire number
+  std::vector<UInt_t> fWireMask;  // Bit per wire number, set if masked
+
   virtual Int_t  ReadDatabase( const TDatime& date );
   virtual Int_t  DefineVariables( EMode mode = kDefine );
 
@@ -0,0 +1,634 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcEventIndex                                                             //
+//                                                                           //
+// Index of the events of a CODA raw data file: for every event, the byte    //
+// offset of its first word in the file, its type, and for physics events    //
+// the event number of the event ID bank.                                    //
+//                                                                           //
+// Build() scans the file once, reading only the event headers.  Write()     //
+// saves the index as a sidecar file next to the data, <file>.idx, and       //
+// Load() reads it back as long as the size and modification time of the     //
+// data file are unchanged, rebuilding it otherwise.                         //
+//                                                                           //
+// With the index THcRun seeks to the first event of an event range          //
+// instead of reading and decoding all events before it, and the             //
+// analyzer splits a run into byte ranges of equal size for event            //
+// parallel replay (THcAnalyzer::SetWorker).  FindEvent and GetCount         //
+// convert between entries and event counts in each of the counting modes    //
+// of THaAnalyzer, so the event ranges keep their meaning.                   //
+//                                                                           //
+// The sidecar file is binary, in the byte order of the machine writing      //
+// it: a header (magic "HCEVIDX1", size and modification time of the data    //
+// file, block size, number of entries) followed by the entries.             //
+//                                                                           //
+// THcCodaStream reads the blocked CODA format directly: blocks of           //
+// GetBlockSize() words, each starting with an 8 word header (block size,    //
+// block number, header length, first event, words used, version,            //
+// reserved, magic word).  Events continue across blocks.  A file written    //
+// in the other byte order is swapped word by word, which is correct for     //
+// the all 32-bit data of the Hall C crates.                                 //
+//                                                                           //
+// Opened with map set, THcCodaStream maps the file into memory instead of   //
+// reading it, and NextEvent returns a pointer to an event that lies within   //
+// one block directly into the map, without copying it.  Only events that    //
+// continue into the next block, and the events of byte swapped files, are   //
+// copied into a buffer.  The kernel is told the map is read sequentially    //
+// (MADV_SEQUENTIAL), and as reading advances, the next SetPrefetch() bytes  //
+// are requested with MADV_WILLNEED, so that the kernel reads them in the    //
+// background, while those well behind are released.                        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcEventIndex.h"
+#include "THaRunBase.h"
+#include "TSystem.h"
+#include "TMath.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+ClassImp(THcEventIndex)
+
+static const char kIndexMagic[8] = { 'H','C','E','V','I','D','X','1' };
+static const UInt_t kBlockMagic = 0xc0da0100;
+static const UInt_t kHeaderLen = 8;
+static const Long64_t kDefaultPrefetch = 16 << 20;
+
+static inline UInt_t Swap32( UInt_t w )
+{
+  return (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+}
+
+//______________________________________________________________________________
+THcEventIndex::THcEventIndex() : fFileSize(0), fFileTime(0), fBlockSize(0)
+{
+  // Constructor
+}
+
+//______________________________________________________________________________
+THcEventIndex::~THcEventIndex()
+{
+  // Destructor
+}
+
+//______________________________________________________________________________
+void THcEventIndex::Clear( Option_t* )
+{
+  fFileName = "";
+  fFileSize = fFileTime = 0;
+  fBlockSize = 0;
+  fEntries.clear();
+  fPhysics.clear();
+}
+
+//______________________________________________________________________________
+TString THcEventIndex::GetIndexFileName( const char* codafile )
+{
+  // Sidecar index file of codafile
+
+  return TString(codafile) + ".idx";
+}
+
+//______________________________________________________________________________
+Bool_t THcEventIndex::FileInfo( const char* file, Long64_t& size,
+				Long64_t& mtime )
+{
+  struct stat st;
+  if( stat(file, &st) != 0 ) return kFALSE;
+  size = st.st_size;
+  mtime = st.st_mtime;
+  return kTRUE;
+}
+
+//______________________________________________________________________________
+Int_t THcEventIndex::Build( const char* codafile )
+{
+  // Scan the CODA file and index its events. Returns 0 on success.
+
+  Clear();
+  THcCodaStream stream;
+  if( stream.Open(codafile) != THaRunBase::READ_OK ) {
+    Error("Build","Cannot read CODA file %s",codafile);
+    return -1;
+  }
+  fFileName = codafile;
+  FileInfo(codafile, fFileSize, fFileTime);
+  fBlockSize = stream.GetBlockSize();
+
+  clock_t start = clock();
+  Long64_t offset;
+  while( (offset = stream.Tell()) >= 0 ) {
+    Entry e;
+    e.offset = offset;
+    Int_t status = stream.SkipEvent(e.type, e.evnum);
+    if( status == THaRunBase::READ_EOF ) break;
+    if( status != THaRunBase::READ_OK ) {
+      Error("Build","Read error in %s at byte %lld, index ends there",
+	    codafile, offset);
+      break;
+    }
+    if( e.type >= 1 && e.type <= kMaxPhysType )
+      fPhysics.push_back(fEntries.size());
+    else
+      e.evnum = 0;
+    fEntries.push_back(e);
+  }
+  cout << "Indexed " << fEntries.size() << " events (" << fPhysics.size()
+       << " physics) of " << codafile << " in "
+       << (Double_t)(clock()-start)/CLOCKS_PER_SEC << " s" << endl;
+  return 0;
+}
+
+//______________________________________________________________________________
+Int_t THcEventIndex::Write( const char* idxfile ) const
+{
+  // Write the index to idxfile.  The file is written under a temporary
+  // name and renamed, so that concurrent readers never see half of it.
+
+  TString tmpname = Form("%s.tmp%d", idxfile, gSystem->GetPid());
+  FILE* fp = fopen(tmpname.Data(), "wb");
+  if( !fp ) {
+    Warning("Write","Cannot write index file %s",idxfile);
+    return -1;
+  }
+  Long64_t nentries = fEntries.size();
+  Bool_t ok =
+    fwrite(kIndexMagic, sizeof(kIndexMagic), 1, fp) == 1 &&
+    fwrite(&fFileSize, sizeof(fFileSize), 1, fp) == 1 &&
+    fwrite(&fFileTime, sizeof(fFileTime), 1, fp) == 1 &&
+    fwrite(&fBlockSize, sizeof(fBlockSize), 1, fp) == 1 &&
+    fwrite(&nentries, sizeof(nentries), 1, fp) == 1 &&
+    (nentries == 0 ||
+     fwrite(&fEntries[0], sizeof(Entry), nentries, fp) == (size_t)nentries);
+  ok = (fclose(fp) == 0) && ok;
+  if( !ok || rename(tmpname.Data(), idxfile) != 0 ) {
+    Warning("Write","Cannot write index file %s",idxfile);
+    remove(tmpname.Data());
+    return -1;
+  }
+  return 0;
+}
+
+//______________________________________________________________________________
+Int_t THcEventIndex::Read( const char* idxfile )
+{
+  // Read an index written by Write. Returns 0 on success.
+
+  Clear();
+  FILE* fp = fopen(idxfile, "rb");
+  if( !fp ) return -1;
+  char magic[sizeof(kIndexMagic)];
+  Long64_t nentries = 0;
+  Bool_t ok =
+    fread(magic, sizeof(magic), 1, fp) == 1 &&
+    memcmp(magic, kIndexMagic, sizeof(magic)) == 0 &&
+    fread(&fFileSize, sizeof(fFileSize), 1, fp) == 1 &&
+    fread(&fFileTime, sizeof(fFileTime), 1, fp) == 1 &&
+    fread(&fBlockSize, sizeof(fBlockSize), 1, fp) == 1 &&
+    fread(&nentries, sizeof(nentries), 1, fp) == 1 &&
+    nentries >= 0 && nentries < kMaxInt;
+  if( ok && nentries > 0 ) {
+    fEntries.resize(nentries);
+    ok = fread(&fEntries[0], sizeof(Entry), nentries, fp) == (size_t)nentries;
+  }
+  fclose(fp);
+  if( !ok ) {
+    Warning("Read","Invalid index file %s",idxfile);
+    Clear();
+    return -1;
+  }
+  for( Int_t i=0; i<(Int_t)fEntries.size(); i++ ) {
+    if( fEntries[i].type >= 1 && fEntries[i].type <= kMaxPhysType )
+      fPhysics.push_back(i);
+  }
+  return 0;
+}
+
+//______________________________________________________________________________
+Int_t THcEventIndex::Load( const char* codafile, Bool_t write )
+{
+  // Read the sidecar index of codafile if it belongs to the current
+  // file, else scan the file and, if write is set, save the index.
+
+  TString idxfile = GetIndexFileName(codafile);
+  Long64_t size, mtime;
+  if( !FileInfo(codafile, size, mtime) ) {
+    Error("Load","Cannot find CODA file %s",codafile);
+    return -1;
+  }
+  if( Read(idxfile.Data()) == 0 && fFileSize == size && fFileTime == mtime ) {
+    fFileName = codafile;
+    return 0;
+  }
+  if( Build(codafile) != 0 ) return -1;
+  if( write ) Write(idxfile.Data());
+  return 0;
+}
+
+//______________________________________________________________________________
+Long64_t THcEventIndex::GetOffset( Int_t entry ) const
+{
+  // Byte offset of entry, the file size for the end of the index
+
+  if( entry < (Int_t)fEntries.size() )
+    return fEntries[entry].offset;
+  return fFileSize;
+}
+
+//______________________________________________________________________________
+Int_t THcEventIndex::FindEvent( UInt_t n, Int_t mode ) const
+{
+  // Entry of the first event counted as n or later in counting mode
+  // mode (physics event number, event number in the file, or the event
+  // number of the ID bank).  GetNEntries() if there is none.
+
+  Int_t nentries = fEntries.size();
+  if( n < 1 ) n = 1;
+  switch( mode ) {
+  case kCountAll:
+    return n-1 < (UInt_t)nentries ? (Int_t)(n-1) : nentries;
+  case kCountRaw:
+    for( vector<Int_t>::const_iterator it = fPhysics.begin();
+	 it != fPhysics.end(); ++it ) {
+      if( fEntries[*it].evnum >= n ) return *it;
+    }
+    return nentries;
+  default:
+    return n-1 < fPhysics.size() ? fPhysics[n-1] : nentries;
+  }
+}
+
+//______________________________________________________________________________
+UInt_t THcEventIndex::GetCount( Int_t entry, Int_t mode ) const
+{
+  // Count of the first counted event at or after entry, or the count
+  // following the last event for the end of the index
+
+  if( mode == kCountAll )
+    return entry+1;
+  vector<Int_t>::const_iterator it =
+    lower_bound(fPhysics.begin(), fPhysics.end(), entry);
+  if( mode == kCountRaw ) {
+    if( it != fPhysics.end() ) return fEntries[*it].evnum;
+    return fPhysics.empty() ? 1 : fEntries[fPhysics.back()].evnum+1;
+  }
+  return (it - fPhysics.begin()) + 1;
+}
+
+//______________________________________________________________________________
+void THcEventIndex::FindType( UInt_t type, Int_t begin, Int_t end,
+			      vector<Int_t>& entries ) const
+{
+  // Entries of event type type in [begin,end), in file order
+
+  entries.clear();
+  if( begin < 0 ) begin = 0;
+  if( end > (Int_t)fEntries.size() ) end = fEntries.size();
+  for( Int_t i=begin; i<end; i++ ) {
+    if( fEntries[i].type == type ) entries.push_back(i);
+  }
+}
+
+//______________________________________________________________________________
+static bool OffsetLess( const THcEventIndex::Entry& e, Long64_t offset )
+{
+  return e.offset < offset;
+}
+
+//______________________________________________________________________________
+void THcEventIndex::Split( Int_t n, Int_t begin, Int_t end,
+			   vector<Int_t>& starts ) const
+{
+  // Split the entries [begin,end) into n pieces with about the same
+  // number of bytes each.  The pieces end at event boundaries, and some
+  // may be empty if there are fewer events than pieces.
+
+  if( n < 1 ) n = 1;
+  if( end > (Int_t)fEntries.size() ) end = fEntries.size();
+  if( begin > end ) begin = end;
+  starts.assign(n+1, end);
+  starts[0] = begin;
+  Long64_t first = GetOffset(begin);
+  Long64_t bytes = GetOffset(end) - first;
+  for( Int_t k=1; k<n; k++ ) {
+    Long64_t target = first + (bytes*k)/n;
+    starts[k] = lower_bound(fEntries.begin()+starts[k-1], fEntries.begin()+end,
+			    target, OffsetLess) - fEntries.begin();
+  }
+}
+
+//______________________________________________________________________________
+void THcEventIndex::Print( Option_t* opt ) const
+{
+  // Print a summary. With option "all", list every event.
+
+  cout << "Event index of " << fFileName << ": " << fEntries.size()
+       << " events, " << fPhysics.size() << " physics, "
+       << fFileSize << " bytes, block size " << fBlockSize << endl;
+  if( fEntries.empty() ) return;
+  UInt_t counts[256];
+  memset(counts, 0, sizeof(counts));
+  UInt_t other = 0;
+  for( UInt_t i=0; i<fEntries.size(); i++ ) {
+    if( fEntries[i].type < 256 ) counts[fEntries[i].type]++;
+    else other++;
+  }
+  cout << "  type  events" << endl;
+  for( Int_t t=0; t<256; t++ ) {
+    if( counts[t] ) cout << setw(6) << t << setw(8) << counts[t] << endl;
+  }
+  if( other ) cout << " other" << setw(8) << other << endl;
+  if( strcmp(opt,"all") == 0 ) {
+    cout << "  entry      offset  type     evnum" << endl;
+    for( UInt_t i=0; i<fEntries.size(); i++ ) {
+      cout << setw(7) << i << setw(12) << fEntries[i].offset
+	   << setw(6) << fEntries[i].type << setw(10) << fEntries[i].evnum
+	   << endl;
+    }
+  }
+}
+
+//______________________________________________________________________________
+THcCodaStream::THcCodaStream() :
+  fFile(0), fBlockSize(0), fSwap(kFALSE), fBlockNum(-1), fPos(0), fUsed(0),
+  fData(0), fMap(0), fMapWords(0), fPrefetch(kDefaultPrefetch),
+  fPrefetched(0), fReleased(0), fNInPlace(0), fNCopied(0)
+{
+  // Constructor
+}
+
+//______________________________________________________________________________
+THcCodaStream::~THcCodaStream()
+{
+  // Destructor
+
+  Close();
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::Open( const char* filename, Bool_t map )
+{
+  // Open a CODA file, positioned at its first event.  If map is set,
+  // map it into memory; if that fails, read it with buffered reads.
+
+  Close();
+  fFile = fopen(filename, "rb");
+  if( !fFile ) return THaRunBase::READ_ERROR;
+  UInt_t header[kHeaderLen];
+  if( fread(header, sizeof(UInt_t), kHeaderLen, fFile) != kHeaderLen ) {
+    Close();
+    return THaRunBase::READ_ERROR;
+  }
+  if( header[7] == kBlockMagic )
+    fSwap = kFALSE;
+  else if( header[7] == Swap32(kBlockMagic) )
+    fSwap = kTRUE;
+  else {
+    ::Error("THcCodaStream::Open","%s is not a CODA file",filename);
+    Close();
+    return THaRunBase::READ_ERROR;
+  }
+  fBlockSize = fSwap ? Swap32(header[0]) : header[0];
+  if( fBlockSize <= kHeaderLen || fBlockSize > (1U << 24) ) {
+    ::Error("THcCodaStream::Open","Invalid block size %u in %s",
+	    fBlockSize, filename);
+    Close();
+    return THaRunBase::READ_ERROR;
+  }
+  fBlock.resize(fBlockSize);
+  fBlockNum = -1;
+  fNInPlace = fNCopied = 0;
+
+  if( map ) {
+    Long64_t bytes = 0;
+    if( fseeko(fFile, 0, SEEK_END) == 0 ) bytes = ftello(fFile);
+    void* addr = (bytes > 0) ? mmap(0, bytes, PROT_READ, MAP_PRIVATE,
+				    fileno(fFile), 0) : MAP_FAILED;
+    if( addr != MAP_FAILED ) {
+      fMap = static_cast<const UInt_t*>(addr);
+      fMapWords = bytes/sizeof(UInt_t);
+      madvise(addr, bytes, MADV_SEQUENTIAL);
+      fPrefetched = fReleased = 0;
+    } else
+      ::Warning("THcCodaStream::Open","Cannot map %s, reading it instead",
+		filename);
+  }
+
+  Int_t status = LoadBlock(0);
+  if( status != THaRunBase::READ_OK ) return status;
+  if( fData[3] >= fData[2] && fData[3] < fUsed )
+    fPos = fData[3];
+  return THaRunBase::READ_OK;
+}
+
+//______________________________________________________________________________
+void THcCodaStream::Close()
+{
+  if( fMap )
+    munmap(const_cast<UInt_t*>(fMap), fMapWords*sizeof(UInt_t));
+  fMap = 0;
+  fMapWords = 0;
+  if( fFile ) fclose(fFile);
+  fFile = 0;
+  fBlockNum = -1;
+  fPos = fUsed = 0;
+  fData = 0;
+}
+
+//______________________________________________________________________________
+void THcCodaStream::Prefetch( Long64_t offset )
+{
+  // Request the map from offset up to fPrefetch bytes ahead, in steps of
+  // a quarter of the window, and release what is more than a window
+  // behind offset
+
+  if( fPrefetch <= 0 ) return;
+  Long64_t mapbytes = fMapWords*sizeof(UInt_t);
+  Long64_t page = sysconf(_SC_PAGESIZE);
+  char* base = (char*)const_cast<UInt_t*>(fMap);
+  if( offset < fPrefetched - fPrefetch ) {
+    // Seek backwards: start over
+    fPrefetched = fReleased = offset - offset%page;
+  }
+  if( fPrefetched < offset ) fPrefetched = offset - offset%page;
+  if( offset + fPrefetch > fPrefetched && fPrefetched < mapbytes ) {
+    Long64_t len = TMath::Max(fPrefetch/4, offset + fPrefetch - fPrefetched);
+    len = TMath::Min(len, mapbytes - fPrefetched);
+    madvise(base + fPrefetched, len, MADV_WILLNEED);
+    fPrefetched += len;
+  }
+  Long64_t release = offset - fPrefetch;
+  release -= release%page;
+  if( release > fReleased ) {
+    madvise(base + fReleased, release - fReleased, MADV_DONTNEED);
+    fReleased = release;
+  }
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::LoadBlock( Long64_t n )
+{
+  // Read block n and position at its first data word
+
+  if( !fFile ) return THaRunBase::READ_ERROR;
+  Long64_t word = n*fBlockSize;
+  size_t nread;
+  if( fMap ) {
+    nread = (word < fMapWords) ?
+      (size_t)TMath::Min((Long64_t)fBlockSize, fMapWords-word) : 0;
+    fData = fMap + word;
+    if( nread > 0 ) Prefetch(word*sizeof(UInt_t));
+  } else {
+    if( fseeko(fFile, (off_t)word*sizeof(UInt_t), SEEK_SET) != 0 )
+      return THaRunBase::READ_ERROR;
+    nread = fread(&fBlock[0], sizeof(UInt_t), fBlockSize, fFile);
+    fData = &fBlock[0];
+  }
+  if( nread < kHeaderLen ) {
+    fBlockNum = n;
+    fPos = fUsed = 0;
+    return THaRunBase::READ_EOF;
+  }
+  if( fSwap ) {
+    for( size_t i=0; i<nread; i++ ) fBlock[i] = Swap32(fData[i]);
+    fData = &fBlock[0];
+  }
+  if( fData[7] != kBlockMagic || fData[2] < kHeaderLen ) {
+    ::Error("THcCodaStream::LoadBlock","Invalid header of block %lld",n);
+    return THaRunBase::READ_ERROR;
+  }
+  fBlockNum = n;
+  fUsed = TMath::Min((UInt_t)nread, fData[4]);
+  fPos = fData[2];
+  return THaRunBase::READ_OK;
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::Fill()
+{
+  // Make sure the next word is in the current block
+
+  while( fPos >= fUsed ) {
+    if( fBlockNum >= 0 && fUsed == 0 )
+      return THaRunBase::READ_EOF;		// Already at the end
+    Int_t status = LoadBlock(fBlockNum+1);
+    if( status != THaRunBase::READ_OK ) return status;
+  }
+  return THaRunBase::READ_OK;
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::Get( UInt_t* dst, UInt_t n )
+{
+  // Copy the next n words to dst, or skip them if dst is NULL
+
+  while( n > 0 ) {
+    Int_t status = Fill();
+    if( status != THaRunBase::READ_OK ) return status;
+    UInt_t k = TMath::Min(n, fUsed-fPos);
+    if( dst ) {
+      memcpy(dst, fData+fPos, k*sizeof(UInt_t));
+      dst += k;
+    }
+    fPos += k;
+    n -= k;
+  }
+  return THaRunBase::READ_OK;
+}
+
+//______________________________________________________________________________
+Long64_t THcCodaStream::Tell()
+{
+  if( Fill() != THaRunBase::READ_OK ) return -1;
+  return ((Long64_t)fBlockNum*fBlockSize + fPos)*sizeof(UInt_t);
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::Seek( Long64_t offset )
+{
+  // Position at the event starting at byte offset (from THcEventIndex)
+
+  Long64_t word = offset/sizeof(UInt_t);
+  Long64_t n = word/fBlockSize;
+  UInt_t pos = word%fBlockSize;
+  if( n != fBlockNum || fUsed == 0 ) {
+    Int_t status = LoadBlock(n);
+    if( status != THaRunBase::READ_OK ) return status;
+  }
+  if( pos < fData[2] || pos > fUsed ) {
+    ::Error("THcCodaStream::Seek","Offset %lld is not in the data",offset);
+    return THaRunBase::READ_ERROR;
+  }
+  fPos = pos;
+  return THaRunBase::READ_OK;
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::ReadEvent( UInt_t*& buf, UInt_t& size )
+{
+  // Read the next event into buf. A truncated last event is end of file.
+
+  UInt_t len;
+  Int_t status = Get(&len, 1);
+  if( status != THaRunBase::READ_OK ) return status;
+  if( len+1 > size || !buf ) {
+    delete [] buf;
+    size = len+1 + (len+1)/4;
+    buf = new UInt_t[size];
+  }
+  buf[0] = len;
+  status = Get(buf+1, len);
+  if( status == THaRunBase::READ_EOF )
+    ::Warning("THcCodaStream::ReadEvent","Truncated event at end of file");
+  return status;
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::NextEvent( const UInt_t*& evbuf, UInt_t*& buf,
+				UInt_t& size )
+{
+  // Make evbuf point to the next event. In a memory map, an event within
+  // the current block is not copied; evbuf stays valid until Close.
+
+  Int_t status = Fill();
+  if( status != THaRunBase::READ_OK ) return status;
+  UInt_t len = fData[fPos]+1;
+  if( fMap && !fSwap && len <= fUsed-fPos ) {
+    evbuf = fData+fPos;
+    fPos += len;
+    fNInPlace++;
+    return THaRunBase::READ_OK;
+  }
+  status = ReadEvent(buf, size);
+  evbuf = buf;
+  fNCopied++;
+  return status;
+}
+
+//______________________________________________________________________________
+Int_t THcCodaStream::SkipEvent( UInt_t& type, UInt_t& evnum )
+{
+  // Skip the next event. Physics events have their event number in the
+  // third word of the event ID bank following the event header.
+
+  UInt_t head[5];
+  Int_t status = Get(head, 1);
+  if( status != THaRunBase::READ_OK ) return status;
+  UInt_t nwords = head[0];		// Words after the length word
+  UInt_t nhead = TMath::Min(nwords, 4U);
+  status = Get(head+1, nhead);
+  if( status != THaRunBase::READ_OK ) return status;
+  type = nhead >= 1 ? head[1] >> 16 : 0;
+  evnum = nhead >= 4 ? head[4] : 0;
+  return Get(0, nwords-nhead);
+}
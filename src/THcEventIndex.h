@@ -0,0 +1,151 @@
+#ifndef ROOT_THcEventIndex
+#define ROOT_THcEventIndex
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcEventIndex                                                             //
+//                                                                           //
+// Byte offsets, event numbers and types of the events of a CODA file.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include "TString.h"
+#include <vector>
+#include <cstdio>
+
+class THcEventIndex : public TObject {
+
+public:
+  struct Entry {
+    Long64_t offset;           // Byte offset of the event length word
+    UInt_t   evnum;            // Event number, 0 if not a physics event
+    UInt_t   type;             // CODA event type
+  };
+  // Event counting as in THaAnalyzer::SetCountMode
+  enum ECountMode { kCountPhysics, kCountAll, kCountRaw };
+  enum { kMaxPhysType = 14 };  // Highest physics event type
+
+  THcEventIndex();
+  virtual ~THcEventIndex();
+
+  // Scan a CODA file
+  Int_t  Build( const char* codafile );
+  // Index file of codafile if it is up to date, else Build and Write it
+  Int_t  Load( const char* codafile, Bool_t write=kTRUE );
+  Int_t  Read( const char* idxfile );
+  Int_t  Write( const char* idxfile ) const;
+  static TString GetIndexFileName( const char* codafile );
+
+  Int_t    GetNEntries() const { return fEntries.size(); }
+  const Entry& GetEntry( Int_t i ) const { return fEntries[i]; }
+  Int_t    GetNPhysics() const { return fPhysics.size(); }
+  Long64_t GetOffset( Int_t entry ) const;
+  Long64_t GetFileSize() const { return fFileSize; }
+  UInt_t   GetBlockSize() const { return fBlockSize; }
+  const char* GetFileName() const { return fFileName.Data(); }
+
+  // Entry of the first event counted as n or later (GetNEntries() if
+  // there is none), and the count of the first counted event at or
+  // after entry
+  Int_t    FindEvent( UInt_t n, Int_t mode=kCountPhysics ) const;
+  UInt_t   GetCount( Int_t entry, Int_t mode=kCountPhysics ) const;
+  // Entries of event type type in [begin,end)
+  void     FindType( UInt_t type, Int_t begin, Int_t end,
+		     std::vector<Int_t>& entries ) const;
+
+  // Boundaries of n pieces of about equal size in bytes of the entries
+  // [begin,end): piece i is [starts[i],starts[i+1])
+  void   Split( Int_t n, Int_t begin, Int_t end,
+		std::vector<Int_t>& starts ) const;
+
+  virtual void Clear( Option_t* opt="" );
+  virtual void Print( Option_t* opt="" ) const;
+
+protected:
+  TString  fFileName;          // CODA file
+  Long64_t fFileSize;          // Size of the CODA file when indexed
+  Long64_t fFileTime;          // Modification time of the CODA file
+  UInt_t   fBlockSize;         // CODA block size in words
+  std::vector<Entry> fEntries; // All events in file order
+  std::vector<Int_t> fPhysics; // Entries of the physics events
+
+  static Bool_t FileInfo( const char* file, Long64_t& size, Long64_t& mtime );
+
+  ClassDef(THcEventIndex,0)   // Event offset index of a CODA file
+};
+
+#ifndef __CINT__
+//////////////////////////////////////////////////////////////////////////
+//
+// THcCodaStream
+//
+// Reads the events of a CODA (version 2) file directly, starting at any
+// event offset, either with buffered reads or from a memory map of the
+// file.  Used by THcEventIndex to scan files and by THcRun to read event
+// ranges and memory mapped files.
+//
+//////////////////////////////////////////////////////////////////////////
+
+class THcCodaStream {
+
+public:
+  THcCodaStream();
+  ~THcCodaStream();
+
+  // Open the file, memory mapped if map is set
+  Int_t    Open( const char* filename, Bool_t map=kFALSE );
+  void     Close();
+  Bool_t   IsOpen() const { return fFile != 0; }
+
+  // Byte offset of the next event, -1 at end of file
+  Long64_t Tell();
+  Int_t    Seek( Long64_t offset );
+
+  // Read the next event into buf, growing it if needed (size in words)
+  Int_t    ReadEvent( UInt_t*& buf, UInt_t& size );
+  // Skip the next event, returning its type and event number
+  Int_t    SkipEvent( UInt_t& type, UInt_t& evnum );
+  // Point evbuf to the next event: into the memory map if the event is
+  // contiguous there, else to buf, into which it is read
+  Int_t    NextEvent( const UInt_t*& evbuf, UInt_t*& buf, UInt_t& size );
+
+  UInt_t   GetBlockSize() const { return fBlockSize; }
+  Bool_t   IsSwapped() const { return fSwap; }
+  Bool_t   IsMapped() const { return fMap != 0; }
+
+  // Bytes of the memory map requested ahead of the reading position
+  void     SetPrefetch( Long64_t bytes ) { fPrefetch = bytes; }
+  // Counts of events returned in place and copied by NextEvent
+  ULong64_t GetNInPlace() const { return fNInPlace; }
+  ULong64_t GetNCopied() const { return fNCopied; }
+
+private:
+  FILE*    fFile;
+  UInt_t   fBlockSize;         // Words per block
+  Bool_t   fSwap;              // File has the other byte order
+  Long64_t fBlockNum;          // Current block
+  UInt_t   fPos;               // Next word in the current block
+  UInt_t   fUsed;              // Words used in the current block
+  const UInt_t* fData;         // Current block: fBlock or in the map
+  std::vector<UInt_t> fBlock;  // Block buffer (read or swapped)
+
+  const UInt_t* fMap;          // Memory map of the file
+  Long64_t fMapWords;          // Words in the map
+  Long64_t fPrefetch;          // Prefetch window in bytes
+  Long64_t fPrefetched;        // Map requested up to this byte
+  Long64_t fReleased;          // Map released up to this byte
+  ULong64_t fNInPlace;
+  ULong64_t fNCopied;
+
+  Int_t    LoadBlock( Long64_t n );
+  void     Prefetch( Long64_t offset );
+  Int_t    Fill();
+  Int_t    Get( UInt_t* dst, UInt_t n );
+
+  THcCodaStream( const THcCodaStream& );
+  THcCodaStream& operator=( const THcCodaStream& );
+};
+#endif
+
+#endif
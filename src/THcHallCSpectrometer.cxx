@@ -60,6 +60,10 @@
 //      and good time for plane 3 are set to the tracks in 
 //      THcHodoscope class.
 //
+//  The prune stages are a table built in SetupPrune() from the optional
+//  parameter prune_stages, so they can be reordered or extended
+//  without recompiling.
+//
 //////////////////////////////////////////////////////////////////////////
 
 #include "THcHallCSpectrometer.h"
@@ -71,12 +75,18 @@
 #include "THaTriggerTime.h"
 #include "TMath.h"
 #include "TList.h"
+#include "TSystem.h"
+#include "TObjArray.h"
+#include "TObjString.h"
 
 #include "THcRawShowerHit.h"
 #include "THcSignalHit.h"
 #include "THcShower.h"
 #include "THcHitList.h"
 #include "THcHodoscope.h"
+#include "THcDC.h"
+#include "THcPrefilter.h"
+#include "THcApparatusGroup.h"
 
 #include <vector>
 #include <cstring>
@@ -90,7 +100,9 @@ using namespace std;
 
 //_____________________________________________________________________________
 THcHallCSpectrometer::THcHallCSpectrometer( const char* name, const char* description ) :
-  THaSpectrometer( name, description )
+  THaSpectrometer( name, description ), fDecodeThreads(0), fDecodeGraph(0),
+  fProfiler(0), fProfileId(-1), fProfileReconId(-1), fPrefilter(0),
+  fGroup(0)
 {
   // Constructor. Defines the standard detectors for the HRS.
   //  AddDetector( new THaTriggerTime("trg","Trigger-based time offset"));
@@ -105,6 +117,7 @@ THcHallCSpectrometer::~THcHallCSpectrometer()
 {
   // Destructor
 
+  delete fDecodeGraph;
   DefineVariables( kDelete );
 }
 
@@ -146,7 +159,7 @@ Bool_t THcHallCSpectrometer::GetTrSorting() const
 void THcHallCSpectrometer::InitializeReconstruction()
 {
   fNReconTerms = 0;
-  fReconTerms.clear();
+  fReconMatrix.Clear();
   fAngSlope_x = 0.0;
   fAngSlope_y = 0.0;
   fAngOffset_x = 0.0;
@@ -155,6 +168,263 @@ void THcHallCSpectrometer::InitializeReconstruction()
   fDetOffset_y = 0.0;
   fZTrueFocus = 0.0;
 }
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::SetupPrune( const char* stages )
+{
+  // Build the list of golden track prune stages from a list of names,
+  // applied in the given order. The standard stages, using the
+  // prune_* parameters, are
+  //   xptar yptar ytar delta beta df npmt chibeta fptime y2 x2
+  // Further stages can be given as <feature><op><value> with op "<" or
+  // ">=" and feature one of the names above or chi2 (chi2/ndof),
+  // e.g. "chi2<20".
+
+  static const char* const names[kNPruneFeatures] = {
+    "xptar", "yptar", "ytar", "delta", "beta", "df", "npmt", "chibeta",
+    "fptime", "y2", "x2", "chi2"
+  };
+
+  fPruneStages.clear();
+  TString list(stages);
+  TObjArray* tokens = list.Tokenize(" ,");
+  Int_t ntok = tokens->GetEntries();
+  for( Int_t i=0; i<ntok; i++ ) {
+    TString tok = static_cast<TObjString*>(tokens->At(i))->GetString();
+    pruneStage st;
+    st.min = 0.0; st.max = 0.0; st.reject = 0;
+    if( tok == "xptar" ) {
+      st.feature = kPruneXptar; st.test = kPruneBelow; st.max = fPruneXp; st.reject = 1;
+    } else if( tok == "yptar" ) {
+      st.feature = kPruneYptar; st.test = kPruneBelow; st.max = fPruneYp; st.reject = 2;
+    } else if( tok == "ytar" ) {
+      st.feature = kPruneYtar; st.test = kPruneBelow; st.max = fPruneYtar; st.reject = 10;
+    } else if( tok == "delta" ) {
+      st.feature = kPruneDelta; st.test = kPruneBelow; st.max = fPruneDelta; st.reject = 20;
+    } else if( tok == "beta" ) {
+      st.feature = kPruneBeta; st.test = kPruneBelow; st.max = fPruneBeta; st.reject = 100;
+    } else if( tok == "df" ) {
+      st.feature = kPruneDf; st.test = kPruneAtLeast; st.min = fPruneDf; st.reject = 200;
+    } else if( tok == "npmt" ) {
+      st.feature = kPruneNPMT; st.test = kPruneAtLeast; st.min = fPruneNPMT; st.reject = 100000;
+    } else if( tok == "chibeta" ) {
+      st.feature = kPruneChiBeta; st.test = kPruneInside; st.min = 0.01; st.max = fPruneChiBeta; st.reject = 1000;
+    } else if( tok == "fptime" ) {
+      st.feature = kPruneFpTime; st.test = kPruneBelow; st.max = fPruneFpTime; st.reject = 2000;
+    } else if( tok == "y2" ) {
+      st.feature = kPruneY2Hit; st.test = kPruneEqual; st.min = 1.0; st.reject = 10000;
+    } else if( tok == "x2" ) {
+      st.feature = kPruneX2Hit; st.test = kPruneEqual; st.min = 1.0; st.reject = 20000;
+    } else {
+      // User stage <feature><op><value>
+      Ssiz_t iop = tok.First("<>");
+      st.feature = -1;
+      if( iop > 0 ) {
+	TString fname = tok(0,iop);
+	for( Int_t j=0; j<kNPruneFeatures; j++ ) {
+	  if( fname == names[j] ) st.feature = j;
+	}
+      }
+      if( st.feature < 0 ) {
+	delete tokens;
+	return -1;
+      }
+      TString rest = tok(iop,tok.Length()-iop);
+      if( rest.BeginsWith(">=") ) {
+	st.test = kPruneAtLeast; st.min = TString(rest(2,rest.Length()-2)).Atof();
+      } else if( rest.BeginsWith("<") ) {
+	st.test = kPruneBelow; st.max = TString(rest(1,rest.Length()-1)).Atof();
+      } else {
+	delete tokens;
+	return -1;
+      }
+    }
+    fPruneStages.push_back(st);
+  }
+  delete tokens;
+  // Stage results are kept as bits of an UInt_t
+  if( fPruneStages.size() > 32 ) return -1;
+  return fPruneStages.size();
+}
+
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::SetupDecodeGraph( const char* edges )
+{
+  // With decode_threads > 0, decode the detectors through a dependency
+  // graph, running independent detectors concurrently.  The drift
+  // chambers need the hodoscope start time, so every THcDC is decoded
+  // after every THcHodoscope.  Further dependencies can be given in the
+  // parameter decode_edges as a list of "before>after" detector names,
+  // e.g. "hod>dc cal>aero".
+
+  delete fDecodeGraph;
+  fDecodeGraph = 0;
+  if( fDecodeThreads <= 0 ) return 0;
+
+  fDecodeGraph = new THcDecodeGraph;
+  TIter next(fDetectors);
+  while( THaDetector* det = static_cast<THaDetector*>( next() )) {
+    fDecodeGraph->AddDetector(det);
+  }
+  Int_t ndet = fDecodeGraph->GetNDetectors();
+  Int_t idet = 0;
+  next.Reset();
+  while( THaDetector* det = static_cast<THaDetector*>( next() )) {
+    if( dynamic_cast<THcDC*>(det) ) {
+      TIter nexthod(fDetectors);
+      Int_t ihod = 0;
+      while( THaDetector* hod = static_cast<THaDetector*>( nexthod() )) {
+	if( dynamic_cast<THcHodoscope*>(hod) )
+	  fDecodeGraph->AddEdge(ihod, idet);
+	ihod++;
+      }
+    }
+    idet++;
+  }
+  TString list(edges);
+  TObjArray* tokens = list.Tokenize(" ,");
+  Int_t status = 0;
+  for( Int_t i=0; i<tokens->GetEntries(); i++ ) {
+    TString tok = static_cast<TObjString*>(tokens->At(i))->GetString();
+    Ssiz_t igt = tok.First('>');
+    if( igt <= 0 ) {
+      status = -1;
+      break;
+    }
+    TString before = tok(0,igt);
+    TString after = tok(igt+1,tok.Length()-igt-1);
+    if( fDecodeGraph->AddEdge(before.Data(),after.Data()) < 0 ) {
+      status = -1;
+      break;
+    }
+  }
+  delete tokens;
+  if( status < 0 || fDecodeGraph->Build() < 0 ) {
+    delete fDecodeGraph;
+    fDecodeGraph = 0;
+    return -1;
+  }
+  fDecodeGraph->SetNThreads(TMath::Min(fDecodeThreads, ndet));
+  if(fDebug)
+    fDecodeGraph->Print();
+  return 0;
+}
+
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::Decode( const THaEvData& evdata )
+{
+  // Decode the detectors, through the decode graph if there is one.  In an
+  // apparatus group, all spectrometers of the group are decoded together.
+
+  if( fGroup )
+    return fGroup->Run(this, kStageDecode, &evdata);
+  if( fPrefilter )
+    fPrefilter->NewEvent();
+  return RunStage(kStageDecode, &evdata);
+}
+
+//_____________________________________________________________________________
+void THcHallCSpectrometer::Clear( Option_t* opt )
+{
+  // Nothing to do if the apparatus group has already cleared and decoded
+  // this spectrometer for the event
+
+  if( fGroup && fGroup->IsPending(this, kStageDecode) ) return;
+  THaSpectrometer::Clear(opt);
+}
+
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::RunStage( Int_t stage, const THaEvData* evdata )
+{
+  // Run one stage of the event.  The stages are timed, and those after
+  // Decode skipped for events failing the prefilter.  Their times include
+  // those of the detectors, which are timed separately.
+
+  if( stage != kStageDecode && fPrefilter && !fPrefilter->Pass() ) return 0;
+  switch( stage ) {
+  case kStageDecode: {
+    THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kDecode);
+    if( fDecodeGraph )
+      return fDecodeGraph->Decode(*evdata);
+    return THaSpectrometer::Decode(*evdata);
+  }
+  case kStageCoarseTrack: {
+    THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseTrack);
+    return THaSpectrometer::CoarseTrack();
+  }
+  case kStageCoarseReconstruct: {
+    THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseProcess);
+    return THaSpectrometer::CoarseReconstruct();
+  }
+  case kStageTrack: {
+    THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kFineTrack);
+    return THaSpectrometer::Track();
+  }
+  case kStageReconstruct: {
+    THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kFineProcess);
+    return THaSpectrometer::Reconstruct();
+  }
+  }
+  return -1;
+}
+
+//_____________________________________________________________________________
+void THcHallCSpectrometer::SetProfiler( THcProfiler* prof, Int_t id )
+{
+  // Time the stages with entry id of prof.  FindVertices, where the
+  // reconstruction matrix is applied, gets its own entry <name>.recon.
+
+  fProfiler = prof;
+  fProfileId = id;
+  fProfileReconId = prof ? prof->Register(Form("%s.recon",GetName())) : -1;
+}
+
+//_____________________________________________________________________________
+void THcHallCSpectrometer::SetPrefilter( THcPrefilter* prefilter )
+{
+  // Skip tracking and reconstruction of events failing prefilter
+
+  fPrefilter = prefilter;
+}
+
+//_____________________________________________________________________________
+void THcHallCSpectrometer::SetApparatusGroup( THcApparatusGroup* group )
+{
+  // Run the stages through group, or on their own if group is 0
+
+  fGroup = group;
+}
+
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::CoarseTrack()
+{
+  // The tracking and reconstruction stages run through the apparatus
+  // group, if any, which runs them for all of its spectrometers at once
+
+  if( fGroup ) return fGroup->Run(this, kStageCoarseTrack);
+  return RunStage(kStageCoarseTrack);
+}
+
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::CoarseReconstruct()
+{
+  if( fGroup ) return fGroup->Run(this, kStageCoarseReconstruct);
+  return RunStage(kStageCoarseReconstruct);
+}
+
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::Track()
+{
+  if( fGroup ) return fGroup->Run(this, kStageTrack);
+  return RunStage(kStageTrack);
+}
+
+//_____________________________________________________________________________
+Int_t THcHallCSpectrometer::Reconstruct()
+{
+  if( fGroup ) return fGroup->Run(this, kStageReconstruct);
+  return RunStage(kStageReconstruct);
+}
+
 //_____________________________________________________________________________
 Int_t THcHallCSpectrometer::ReadDatabase( const TDatime& date )
 {
@@ -198,8 +468,13 @@ Int_t THcHallCSpectrometer::ReadDatabase( const TDatime& date )
   prefix[1]='\0';
 
   string reconCoeffFilename;
+  string reconCodeFilename;
+  string pruneStages = "xptar yptar ytar delta beta df npmt chibeta fptime y2 x2";
+  string decodeEdges;
+  fDecodeThreads = 0;
   DBRequest list[]={
     {"_recon_coeff_filename", &reconCoeffFilename,     kString               },
+    {"_recon_code_filename",  &reconCodeFilename,      kString,         0,  1},
     {"theta_offset",          &fThetaOffset,           kDouble               },
     {"phi_offset",            &fPhiOffset,             kDouble               },
     {"delta_offset",          &fDeltaOffset,           kDouble               },
@@ -232,6 +507,9 @@ Int_t THcHallCSpectrometer::ReadDatabase( const TDatime& date )
     {"prune_chibeta",         &fPruneChiBeta,          kDouble,         0,  1},
     {"prune_npmt",            &fPruneNPMT,           kDouble,         0,  1},
     {"prune_fptime",          &fPruneFpTime,             kDouble,         0,  1},
+    {"prune_stages",          &pruneStages,            kString,         0,  1},
+    {"decode_threads",        &fDecodeThreads,         kInt,            0,  1},
+    {"decode_edges",          &decodeEdges,            kString,         0,  1},
     {0}
   };
   gHcParms->LoadParmValues((DBRequest*)&list,prefix);
@@ -250,6 +528,7 @@ Int_t THcHallCSpectrometer::ReadDatabase( const TDatime& date )
   cout <<  "fPruneFpTime = "      <<  fPruneFpTime << endl; 
   cout <<  "fPruneNPMT = "        <<  fPruneNPMT << endl; 
   cout <<  "sel using prune = "   <<  fSelUsingPrune << endl;
+  cout <<  "prune stages = "      <<  pruneStages << endl;
   cout <<  "fPartMass = "         <<  fPartMass << endl;
   cout <<  "fPcentral = "         <<  fPcentral << " " <<fPCentralOffset << endl; 
   cout <<  "fThate_lab = "        <<  fTheta_lab << " " <<fThetaCentralOffset << endl; 
@@ -259,6 +538,25 @@ Int_t THcHallCSpectrometer::ReadDatabase( const TDatime& date )
   Double_t ph = 0.0+fPhiOffset*TMath::RadToDeg();
 
   SetCentralAngles(fTheta_lab, ph, false);
+
+  fPruneXp      = TMath::Max( 0.08, fPruneXp); 
+  fPruneYp      = TMath::Max( 0.04, fPruneYp); 
+  fPruneYtar    = TMath::Max( 4.0,  fPruneYtar); 
+  fPruneDelta   = TMath::Max( 13.0, fPruneDelta); 
+  fPruneBeta    = TMath::Max( 0.1,  fPruneBeta); 
+  fPruneDf      = TMath::Max( 1.0,  fPruneDf); 
+  fPruneChiBeta = TMath::Max( 2.0,  fPruneChiBeta); 
+  fPruneFpTime  = TMath::Max( 5.0,  fPruneFpTime); 
+  fPruneNPMT    = TMath::Max( 6.0,  fPruneNPMT); 
+  if( SetupPrune(pruneStages.c_str()) < 0 ) {
+    Error(here, "Bad prune stage list \"%s\"",pruneStages.c_str());
+    return kInitError;
+  }
+  if( SetupDecodeGraph(decodeEdges.c_str()) < 0 ) {
+    Error(here, "Bad decode dependencies \"%s\"",decodeEdges.c_str());
+    return kInitError;
+  }
+
   Double_t off_x = 0.0, off_y = 0.0, off_z = 0.0;
   fPointingOffset.SetXYZ( off_x, off_y, off_z );
   
@@ -293,19 +591,15 @@ Int_t THcHallCSpectrometer::ReadDatabase( const TDatime& date )
   good = getline(ifile,line).good();
   //  cout << line << endl;
   fNReconTerms = 0;
-  fReconTerms.clear();
-  fReconTerms.reserve(500);
+  fReconMatrix.Clear();
   //cout << "Reading matrix elements" << endl;
   while(good && line.compare(0,4," ---")!=0) {
-    fReconTerms.push_back(reconTerm());
+    Double_t coeff[4] = {0.0, 0.0, 0.0, 0.0};
+    Int_t exp[5] = {0, 0, 0, 0, 0};
     sscanf(line.c_str()," %le %le %le %le %1d%1d%1d%1d%1d"
-	   ,&fReconTerms[fNReconTerms].Coeff[0],&fReconTerms[fNReconTerms].Coeff[1]
-	   ,&fReconTerms[fNReconTerms].Coeff[2],&fReconTerms[fNReconTerms].Coeff[3]
-	   ,&fReconTerms[fNReconTerms].Exp[0]
-	   ,&fReconTerms[fNReconTerms].Exp[1]
-	   ,&fReconTerms[fNReconTerms].Exp[2]
-	   ,&fReconTerms[fNReconTerms].Exp[3]
-	   ,&fReconTerms[fNReconTerms].Exp[4]);
+	   ,&coeff[0],&coeff[1],&coeff[2],&coeff[3]
+	   ,&exp[0],&exp[1],&exp[2],&exp[3],&exp[4]);
+    fReconMatrix.AddTerm(coeff,exp);
     fNReconTerms++;
     good = getline(ifile,line).good();    
   }
@@ -314,6 +608,30 @@ Int_t THcHallCSpectrometer::ReadDatabase( const TDatime& date )
     Error(here, "Error processing reconstruction coefficient file %s",reconCoeffFilename.c_str());
     return kInitError; // Is this the right return code?
   }
+  Int_t nmono = fReconMatrix.Compile();
+  if(nmono < 0) {
+    Error(here, "Bad exponents in reconstruction coefficient file %s",reconCoeffFilename.c_str());
+    return kInitError;
+  }
+  if(fDebug)
+    cout << "Compiled to " << nmono << " monomials" << endl;
+
+  // Optionally write the matrix out as a C++ function, compile it
+  // with ACLiC and use it for the reconstruction
+  if(!reconCodeFilename.empty()) {
+    string funcname = string(prefix) + "ReconMatrix";
+    if(fReconMatrix.WriteCode(reconCodeFilename.c_str(),funcname.c_str()) == 0
+       && gSystem->CompileMacro(reconCodeFilename.c_str(),"k")) {
+      THcReconMatrix::CompiledFunc_t func = (THcReconMatrix::CompiledFunc_t)
+	gSystem->DynFindSymbol("*",funcname.c_str());
+      if(func) {
+	fReconMatrix.SetCompiledFunc(func);
+	cout << "Using compiled matrix " << funcname << " from " << reconCodeFilename << endl;
+      }
+    } else {
+      Warning(here, "Could not compile %s, using matrix table",reconCodeFilename.c_str());
+    }
+  }
   return kOK;
 }
 
@@ -326,13 +644,17 @@ Int_t THcHallCSpectrometer::FindVertices( TClonesArray& tracks )
   // In Hall C, we do the target traceback here since the traceback should
   // not depend on which tracking detectors are used.
 
+  THcProfiler::Timer timer(fProfiler, fProfileReconId, THcProfiler::kFineTrack);
   fNtracks = tracks.GetLast()+1;
 
-  for (Int_t it=0;it<tracks.GetLast()+1;it++) {
+  // Focal plane coordinates of all tracks, stored by variable, so
+  // that the matrix is evaluated for all tracks in one pass
+  fReconIn.resize(5*fNtracks);
+  fReconOut.resize(4*fNtracks);
+  for (Int_t it=0;it<fNtracks;it++) {
     THaTrack* track = static_cast<THaTrack*>( tracks[it] );
 
     Double_t hut[5];
-    Double_t hut_rot[5];
     
     hut[0] = track->GetX()/100.0 + fZTrueFocus*track->GetTheta() + fDetOffset_x;//m
     hut[1] = track->GetTheta() + fAngOffset_x;//radians
@@ -345,28 +667,24 @@ Int_t THcHallCSpectrometer::FindVertices( TClonesArray& tracks )
 
     // Retrieve the focal plane coordnates
     // Do the transpormation
-    // Stuff results into track
-    hut_rot[0] = hut[0];
-    hut_rot[1] = hut[1] + hut[0]*fAngSlope_x;
-    hut_rot[2] = hut[2];
-    hut_rot[3] = hut[3] + hut[2]*fAngSlope_y;
-    hut_rot[4] = hut[4];
-
-    // Compute COSY sums
+    fReconIn[0*fNtracks+it] = hut[0];
+    fReconIn[1*fNtracks+it] = hut[1] + hut[0]*fAngSlope_x;
+    fReconIn[2*fNtracks+it] = hut[2];
+    fReconIn[3*fNtracks+it] = hut[3] + hut[2]*fAngSlope_y;
+    fReconIn[4*fNtracks+it] = hut[4];
+  }
+
+  // Compute COSY sums
+  if(fNtracks > 0) {
+    fReconMatrix.EvalBatch(fNtracks, &fReconIn[0], &fReconOut[0]);
+  }
+
+  // Stuff results into track
+  for (Int_t it=0;it<fNtracks;it++) {
+    THaTrack* track = static_cast<THaTrack*>( tracks[it] );
     Double_t sum[4];
     for(Int_t k=0;k<4;k++) {
-      sum[k] = 0.0;
-    }
-    for(Int_t iterm=0;iterm<fNReconTerms;iterm++) {
-      Double_t term=1.0;
-      for(Int_t j=0;j<5;j++) {
-	if(fReconTerms[iterm].Exp[j]!=0) {
-	  term *= pow(hut_rot[j],fReconTerms[iterm].Exp[j]);
-	}
-      }
-      for(Int_t k=0;k<4;k++) {
-	sum[k] += term*fReconTerms[iterm].Coeff[k];
-      }
+      sum[k] = fReconOut[k*fNtracks+it];
     }
     // Transfer results to track
     // No beam raster yet
@@ -633,225 +951,103 @@ Int_t THcHallCSpectrometer::TrackCalc()
 
   if ( fSelUsingPrune == 1 ){
     
-    fPruneXp      = TMath::Max( 0.08, fPruneXp); 
-    fPruneYp      = TMath::Max( 0.04, fPruneYp); 
-    fPruneYtar    = TMath::Max( 4.0,  fPruneYtar); 
-    fPruneDelta   = TMath::Max( 13.0, fPruneDelta); 
-    fPruneBeta    = TMath::Max( 0.1,  fPruneBeta); 
-    fPruneDf      = TMath::Max( 1.0,  fPruneDf); 
-    fPruneChiBeta = TMath::Max( 2.0,  fPruneChiBeta); 
-    fPruneFpTime  = TMath::Max( 5.0,  fPruneFpTime); 
-    fPruneNPMT    = TMath::Max( 6.0,  fPruneNPMT); 
-    
-    Int_t ptrack = 0, fNGood;
+    Int_t ptrack = 0;
     Double_t fP = 0., fBetaP = 0.; // , fPartMass = 0.00051099; // 5.10989979E-04 Fix it
 
     if ( fNtracks > 0 ) {
       fChi2Min   = 10000000000.0;
       fGoodTrack = 0;    
-      fKeep      = new Bool_t [fNtracks];  
-      fReject    = new Int_t  [fNtracks];  
 
-      THaTrack *testTracks[fNtracks];
+      Int_t nstages = fPruneStages.size();
+      Double_t fptime_center = fHodo->GetStartTimeCenter();
+      fPruneFeatures.resize(fNtracks*kNPruneFeatures);
+      fPrunePass.resize(fNtracks);
+      fPruneFail.resize(fNtracks);
 
-      // ! Initialize all tracks to be good
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
-	fKeep[ptrack] = kTRUE;
-	fReject[ptrack] = 0;
-	testTracks[ptrack] = static_cast<THaTrack*>( fTracks->At(ptrack) );      
-        if (!testTracks[ptrack]) return -1;	
-      }      
-      
-      // ! Prune on xptar
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
-	if ( ( TMath::Abs( testTracks[ptrack]->GetTTheta() ) < fPruneXp ) && ( fKeep[ptrack] ) ){	  
-	  fNGood ++;
-	}	
-      }
-      if ( fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
-	  if ( TMath::Abs( testTracks[ptrack]->GetTTheta() ) >= fPruneXp ){
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 1;
-	  }
-	}
-      }
-      
-      // ! Prune on yptar
-      fNGood = 0;
+      // Fill the features of each track and evaluate all stage tests
+      // in one pass over the tracks
       for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
-	if ( ( TMath::Abs( testTracks[ptrack]->GetTPhi() ) < fPruneYp ) && ( fKeep[ptrack] ) ){
-	  fNGood ++; 
-	}
-      }
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
-	  if ( TMath::Abs( testTracks[ptrack]->GetTPhi() ) >= fPruneYp ){
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 2;
-	    
-	  }		
-	}
-      }
-      
-      // !     Prune on ytar
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	
-	if ( ( TMath::Abs( testTracks[ptrack]->GetTY() ) < fPruneYtar ) && ( fKeep[ptrack] ) ){
-	  fNGood ++; 
-	}	
-      }      
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
-	  if ( TMath::Abs( testTracks[ptrack]->GetTY() ) >= fPruneYtar ){
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 10;
-	  }
-	}
-      }
-      
-      // !     Prune on delta
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	
-	if ( ( TMath::Abs( testTracks[ptrack]->GetDp() ) < fPruneDelta ) && ( fKeep[ptrack] ) ){
-	  fNGood ++; 
-	}	
-      }            
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
-	  if ( TMath::Abs( testTracks[ptrack]->GetDp() ) >= fPruneDelta ){
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 20;
-	  }
-	}
-      }      
-            
-      // !     Prune on beta
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	fP = testTracks[ptrack]->GetP();
-	fBetaP = fP / TMath::Sqrt( fP * fP + fPartMass * fPartMass );       
-	if ( ( TMath::Abs( testTracks[ptrack]->GetBeta() - fBetaP ) < fPruneBeta ) && ( fKeep[ptrack] ) ){
-	  fNGood ++; 
-	}	
-      }
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	  fP = testTracks[ptrack]->GetP();
-	  fBetaP = fP / TMath::Sqrt( fP * fP + fPartMass * fPartMass );       
-	  if ( TMath::Abs( testTracks[ptrack]->GetBeta() - fBetaP ) >= fPruneBeta ) {	    
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 100;	          
-	  }	  
-	}	
-      }
-      
-      // !     Prune on deg. freedom for track chisq
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      	
-	if ( ( testTracks[ptrack]->GetNDoF() >= fPruneDf ) && ( fKeep[ptrack] ) ){
-	  fNGood ++; 	  
-	}		
-      }          
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	  if ( testTracks[ptrack]->GetNDoF() < fPruneDf ){	  
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 200;
-	  }
-	}
-      }
+	THaTrack* testTrack = static_cast<THaTrack*>( fTracks->At(ptrack) );      
+        if (!testTrack) return -1;	
 
-      //!     Prune on num pmt hits
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      	
-	if ( ( testTracks[ptrack]->GetNPMT() >= fPruneNPMT ) && ( fKeep[ptrack] ) ){
-	  fNGood ++; 	  
-	}	        		
-      }
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	  if ( testTracks[ptrack]->GetNPMT() < fPruneNPMT ){
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 100000;
+	Double_t* f = &fPruneFeatures[ptrack*kNPruneFeatures];
+	fP = testTrack->GetP();
+	fBetaP = fP / TMath::Sqrt( fP * fP + fPartMass * fPartMass );       
+	f[kPruneXptar]   = TMath::Abs( testTrack->GetTTheta() );
+	f[kPruneYptar]   = TMath::Abs( testTrack->GetTPhi() );
+	f[kPruneYtar]    = TMath::Abs( testTrack->GetTY() );
+	f[kPruneDelta]   = TMath::Abs( testTrack->GetDp() );
+	f[kPruneBeta]    = TMath::Abs( testTrack->GetBeta() - fBetaP );
+	f[kPruneDf]      = testTrack->GetNDoF();
+	f[kPruneNPMT]    = testTrack->GetNPMT();
+	f[kPruneChiBeta] = testTrack->GetBetaChi2();
+	f[kPruneFpTime]  = TMath::Abs( testTrack->GetFPTime() - fptime_center );
+	f[kPruneY2Hit]   = testTrack->GetGoodPlane4();
+	f[kPruneX2Hit]   = testTrack->GetGoodPlane3();
+	f[kPruneChi2]    = testTrack->GetChi2() / testTrack->GetNDoF();
+
+	// Pass and fail are tested separately so that a NaN feature
+	// neither counts as good nor gets the track dropped
+	UInt_t pass = 0, fail = 0;
+	for ( Int_t is = 0; is < nstages; is++ ){
+	  const pruneStage& st = fPruneStages[is];
+	  Double_t v = f[st.feature];
+	  UInt_t bit = 1U << is;
+	  switch ( st.test ) {
+	  case kPruneBelow:
+	    if ( v <  st.max ) pass |= bit;
+	    if ( v >= st.max ) fail |= bit;
+	    break;
+	  case kPruneAtLeast:
+	    if ( v >= st.min ) pass |= bit;
+	    if ( v <  st.min ) fail |= bit;
+	    break;
+	  case kPruneInside:
+	    if ( ( v < st.max ) && ( v > st.min ) ) pass |= bit;
+	    if ( ( v >= st.max ) || ( v <= st.min ) ) fail |= bit;
+	    break;
+	  case kPruneEqual:
+	    if ( v == st.min ) pass |= bit;
+	    if ( v != st.min ) fail |= bit;
+	    break;
 	  }
 	}
+	fPrunePass[ptrack] = pass;
+	fPruneFail[ptrack] = fail;
       }
 
-      // !     Prune on beta chisqr
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      	
-	if ( ( testTracks[ptrack]->GetBetaChi2() < fPruneChiBeta ) && 
-	     ( testTracks[ptrack]->GetBetaChi2() > 0.01 )          &&   ( fKeep[ptrack] ) ){
-	  fNGood ++; 	  
-	}	        			
-      }
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	  if ( ( testTracks[ptrack]->GetBetaChi2() >= fPruneChiBeta ) || 
-	       ( testTracks[ptrack]->GetBetaChi2() <= 0.01          ) ){
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 1000;
-	  }	  	  
-	}
+      // ! Initialize all tracks to be good
+      fKeep      = new Bool_t [fNtracks];  
+      fReject    = new Int_t  [fNtracks];  
+      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
+	fKeep[ptrack] = kTRUE;
+	fReject[ptrack] = 0;
       }
 
-      // !     Prune on fptime
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      	
-	if ( ( TMath::Abs( testTracks[ptrack]->GetFPTime() - fHodo->GetStartTimeCenter() ) < fPruneFpTime )  &&   
-	     ( fKeep[ptrack] ) ){
-	  fNGood ++; 	  
-	}	        			
-      }
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	  if ( TMath::Abs( testTracks[ptrack]->GetFPTime() - fHodo->GetStartTimeCenter() ) >= fPruneFpTime ) {
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 2000;	    	    
+      // ! Apply the stages in order. A stage drops the tracks failing it
+      // ! only if at least one track still kept passes it.
+      for ( Int_t is = 0; is < nstages; is++ ){
+	UInt_t bit = 1U << is;
+	Bool_t anygood = kFALSE;
+	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
+	  if ( fKeep[ptrack] && ( fPrunePass[ptrack] & bit ) ) {
+	    anygood = kTRUE;
+	    break;
 	  }
 	}
-      }
-      
-      // !     Prune on Y2 being hit
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      	
-	if ( ( testTracks[ptrack]->GetGoodPlane4() == 1 )  &&  fKeep[ptrack] ) {
-	  fNGood ++; 	  	  
-	}	        			
-      }
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	  if ( testTracks[ptrack]->GetGoodPlane4() != 1 ) {
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 10000;	    	    
+	if ( anygood ) {
+	  for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){
+	    if ( fPruneFail[ptrack] & bit ) {
+	      fKeep[ptrack] = kFALSE;
+	      fReject[ptrack] += fPruneStages[is].reject;
+	    }
 	  }
 	}
-      }      
-      
-      // !     Prune on X2 being hit
-      fNGood = 0;
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      	
-	if ( ( testTracks[ptrack]->GetGoodPlane3() == 1 )  &&  fKeep[ptrack] ) {
-	  fNGood ++; 	  	  
-	}	        			
       }
-      if (fNGood > 0 ) {
-	for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      
-	  if ( testTracks[ptrack]->GetGoodPlane3() != 1 ) {
-	    fKeep[ptrack] = kFALSE;
-	    fReject[ptrack] = fReject[ptrack] + 20000;	    	    	    	    
-	  }
-	}
-      }      
       
       // !     Pick track with best chisq if more than one track passed prune tests
-      Double_t fChi2PerDeg = 0.;
       for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	      	
-
-	fChi2PerDeg =  testTracks[ptrack]->GetChi2() / testTracks[ptrack]->GetNDoF();
-
+	Double_t fChi2PerDeg = fPruneFeatures[ptrack*kNPruneFeatures+kPruneChi2];
 	if ( ( fChi2PerDeg < fChi2Min ) && ( fKeep[ptrack] ) ){
 	  fGoodTrack = ptrack;
 	  fChi2Min = fChi2PerDeg;
@@ -863,11 +1059,7 @@ Int_t THcHallCSpectrometer::TrackCalc()
       fTrk         = fGoldenTrack;
       
       delete [] fKeep;             fKeep = NULL;        
-      delete [] fReject;           fKeep = NULL;        
-      for ( ptrack = 0; ptrack < fNtracks; ptrack++ ){	
-	testTracks[ptrack] = NULL;
-	delete 	testTracks[ptrack];
-      }	      
+      delete [] fReject;           fReject = NULL;        
       
     } else // Condition for fNtrack > 0
       fGoldenTrack = NULL;
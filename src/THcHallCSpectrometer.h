@@ -17,6 +17,9 @@
 #include "THcRawHodoHit.h"
 #include "THcScintillatorPlane.h"
 #include "THcShower.h"
+#include "THcReconMatrix.h"
+#include "THcDecodeGraph.h"
+#include "THcProfiler.h"
 
 //#include "THaTrackingDetector.h"
 //#include "THcHitList.h"
@@ -32,6 +35,8 @@
 
 
 //class THaScintillator;
+class THcPrefilter;
+class THcApparatusGroup;
 
 class THcHallCSpectrometer : public THaSpectrometer {
   
@@ -40,6 +45,12 @@ public:
   virtual ~THcHallCSpectrometer();
 
   virtual Int_t   ReadDatabase( const TDatime& date );
+  virtual void    Clear( Option_t* opt="" );
+  virtual Int_t   Decode( const THaEvData& evdata );
+  virtual Int_t   CoarseTrack();
+  virtual Int_t   CoarseReconstruct();
+  virtual Int_t   Track();
+  virtual Int_t   Reconstruct();
   virtual Int_t   FindVertices( TClonesArray& tracks );
   virtual Int_t   TrackCalc();
   virtual Int_t   TrackTimes( TClonesArray* tracks );
@@ -50,8 +61,25 @@ public:
   Bool_t SetTrSorting( Bool_t set = kFALSE );
   Bool_t GetTrSorting() const;
 
+  // Time the stages of this spectrometer with profiler entry id
+  void SetProfiler( THcProfiler* prof, Int_t id );
+  // Skip the stages after Decode for events failing the prefilter
+  void SetPrefilter( THcPrefilter* prefilter );
+  THcPrefilter* GetPrefilter() const { return fPrefilter; }
+
+  // Stages of an event, as run by RunStage
+  enum EStage { kStageDecode, kStageCoarseTrack, kStageCoarseReconstruct,
+		kStageTrack, kStageReconstruct };
+  // Run a stage for this spectrometer alone (the Decode stage without
+  // the prefilter's NewEvent); evdata is needed for kStageDecode only
+  Int_t RunStage( Int_t stage, const THaEvData* evdata=0 );
+  // Run the stages through group, concurrently with the other spectrometers
+  void SetApparatusGroup( THcApparatusGroup* group );
+
 protected:
   void InitializeReconstruction();
+  Int_t SetupPrune( const char* stages );
+  Int_t SetupDecodeGraph( const char* edges );
 
   Bool_t*      fKeep;
   Int_t*       fReject;
@@ -67,6 +95,25 @@ protected:
   Double_t     fPruneFpTime;
   Double_t     fPruneNPMT;
 
+  // Golden track selection by pruning. Each stage tests one per-track
+  // feature; tracks failing a stage are dropped if any kept track passes.
+  enum EPruneFeature { kPruneXptar, kPruneYptar, kPruneYtar, kPruneDelta,
+		       kPruneBeta, kPruneDf, kPruneNPMT, kPruneChiBeta,
+		       kPruneFpTime, kPruneY2Hit, kPruneX2Hit, kPruneChi2,
+		       kNPruneFeatures };
+  enum EPruneTest { kPruneBelow, kPruneAtLeast, kPruneInside, kPruneEqual };
+  struct pruneStage {
+    Int_t    feature;
+    Int_t    test;
+    Double_t min;
+    Double_t max;
+    Int_t    reject;            // Added to fReject of the dropped tracks
+  };
+  std::vector<pruneStage> fPruneStages;
+  std::vector<Double_t>   fPruneFeatures; // [fNtracks*kNPruneFeatures]
+  std::vector<UInt_t>     fPrunePass;     // Bit per stage passed, per track
+  std::vector<UInt_t>     fPruneFail;     // Bit per stage failed, per track
+
   Int_t        fGoodTrack;
   Int_t        fSelUsingScin;
   Int_t        fSelUsingPrune;
@@ -94,22 +141,20 @@ protected:
   THcShower* fShower;
   THcHodoscope* fHodo;
 
+  Int_t fDecodeThreads;         // Threads for decoding, 0 = serial
+  THcDecodeGraph* fDecodeGraph; // Detector decode dependencies
+
+  THcProfiler* fProfiler;       // Event loop profiler, if enabled
+  Int_t fProfileId;             // Entry of this spectrometer in fProfiler
+  Int_t fProfileReconId;        // Entry for the reconstruction matrix
+
+  THcPrefilter* fPrefilter;     // Reconstruction prefilter, if any
+  THcApparatusGroup* fGroup;    // Group running the stages, if any
+
   Int_t fNReconTerms;
-  struct reconTerm {
-    Double_t Coeff[4];
-    Int_t Exp[5];
-    reconTerm() {
-      for(Int_t i=0;i<4;i++) {
-	Coeff[i] = 0.0;
-      }
-      for(Int_t i=0;i<5;i++) {
-	Exp[i] = 0;
-      }
-    }
-  };
-  std::vector<reconTerm> fReconTerms;
-  //  Double_t fReconCoeff[fMaxReconElements][4];
-  //  Int_t fReconExponents[fMaxReconElements][5];
+  THcReconMatrix fReconMatrix;  // Compiled reconstruction matrix
+  std::vector<Double_t> fReconIn;   // Focal plane coordinates of all tracks
+  std::vector<Double_t> fReconOut;  // Matrix sums for all tracks
   Double_t fAngSlope_x;
   Double_t fAngSlope_y;
   Double_t fAngOffset_x;
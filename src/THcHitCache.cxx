@@ -0,0 +1,252 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcHitCache                                                               //
+//                                                                           //
+// Post-processing module that writes, for every event of a replay, the      //
+// raw hit lists the Hall C detectors built from it (THcHitList), so that    //
+// later reconstruction passes over the same run, e.g. while iterating on    //
+// drift chamber offsets or hodoscope timing, can read the hits from this    //
+// cache (THcHitCacheRun) instead of reading and decoding the CODA file.     //
+//                                                                           //
+// Each hit list detector records the channel data it adds to its hit list  //
+// while decoding: plane, counter, signal and the data words of every hit    //
+// channel.  Replaying the record through the same code rebuilds the         //
+// identical hit list, whatever the raw hit class.  Control, scaler and      //
+// EPICS events are cached verbatim.  Of physics events only the event type  //
+// and number are kept, and the reader makes a CODA event with just the     //
+// event ID bank of them, so the analyzer sees the event type and number,    //
+// but no crate data: detectors and modules that do not use THcHitList get   //
+// empty events.                                                             //
+//                                                                           //
+// The file is binary, in the byte order of the machine writing it: a       //
+// header (magic "HCHITC01", run number, run type, run date, number of       //
+// events, number of detectors, then the detector names as length and       //
+// characters), followed by chunks of events.  A chunk is the number of      //
+// events and bytes in it followed by the events, so a reader fetches many  //
+// events with a single read.  The events are coded with variable length    //
+// integers (THcHitCache::PutVarint):                                        //
+//   physics event:  type, event number, then for each detector with hits   //
+//                   its number+1, the record length in bytes and the        //
+//                   record, ending with 0                                   //
+//   other events:   type, number of words, the CODA event                   //
+//   record:         plane, counter, signal, number of data words and the   //
+//                   data words (ZigZag coded) of each hit channel          //
+// Typical hit lists need 1-2 bytes per number, so the cache is much        //
+// smaller than the raw data, which carries all crate headers.              //
+//                                                                           //
+// Usage:                                                                    //
+//   THcHitCache* cache = new THcHitCache("cache_50017.hc");                 //
+//   gHaPostProcess->Add(cache);                                             //
+//   analyzer->Process(run);                                                 //
+// and in later passes, in place of the THcRun:                              //
+//   THcHitCacheRun* run = new THcHitCacheRun("cache_50017.hc");            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcHitCache.h"
+#include "THcHitList.h"
+#include "THaApparatus.h"
+#include "THaDetector.h"
+#include "THaEvData.h"
+#include "THaRunBase.h"
+#include "THaGlobals.h"
+#include "TList.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+const char THcHitCache::kMagic[8] = { 'H','C','H','I','T','C','0','1' };
+
+//_____________________________________________________________________________
+THcHitCache::THcHitCache( const char* filename ) :
+  fFileName(filename), fFile(0), fHaveRun(kFALSE), fChunkSize(1<<20),
+  fChunkEvents(0), fNBytes(0), fNRawBytes(0)
+{
+  // Constructor
+
+  memset(&fHeader, 0, sizeof(fHeader));
+}
+
+//_____________________________________________________________________________
+THcHitCache::~THcHitCache()
+{
+  // Destructor
+
+  Close();
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCache::Init( const TDatime& run_time )
+{
+  // Open the cache file and switch on hit recording in all hit list
+  // detectors of the apparatuses in gHaApps.  A file left open by an
+  // earlier run is closed first.
+
+  Close();
+  fIsInit = kFALSE;
+
+  fFile = fopen(fFileName.Data(), "wb");
+  if( !fFile ) {
+    Error("Init","Cannot open hit cache file %s",fFileName.Data());
+    return -1;
+  }
+
+  vector<TString> names;
+  fDetectors.clear();
+  TIter nextapp(gHaApps);
+  while( THaApparatus* app = static_cast<THaApparatus*>( nextapp() )) {
+    TIter nextdet(app->GetDetectors());
+    while( THaDetector* det = static_cast<THaDetector*>( nextdet() )) {
+      THcHitList* hitlist = dynamic_cast<THcHitList*>(det);
+      if( !hitlist ) continue;
+      hitlist->SetHitRecording(kTRUE);
+      fDetectors.push_back(hitlist);
+      names.push_back(Form("%s.%s",app->GetName(),det->GetName()));
+    }
+  }
+
+  memset(&fHeader, 0, sizeof(fHeader));
+  memcpy(fHeader.magic, kMagic, sizeof(kMagic));
+  fHeader.date = run_time.Get();
+  fHeader.ndet = names.size();
+  fHaveRun = kFALSE;
+  Bool_t ok = fwrite(&fHeader, sizeof(fHeader), 1, fFile) == 1;
+  for( UInt_t i=0; i<names.size() && ok; i++ ) {
+    UInt_t len = names[i].Length();
+    ok = fwrite(&len, sizeof(len), 1, fFile) == 1 &&
+      fwrite(names[i].Data(), 1, len, fFile) == len;
+  }
+  if( !ok ) {
+    Error("Init","Cannot write hit cache file %s",fFileName.Data());
+    Close();
+    return -1;
+  }
+
+  fChunk.clear();
+  fChunk.reserve(fChunkSize + (fChunkSize>>2));
+  fChunkEvents = 0;
+  fNBytes = ftell(fFile);
+  fNRawBytes = 0;
+  fIsInit = kTRUE;
+  return 0;
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCache::Process( const THaEvData* evdata, const THaRunBase* run,
+			    Int_t )
+{
+  // Add the event to the current chunk, and write the chunk when full
+
+  if( !fFile || !evdata ) return 0;
+
+  if( !fHaveRun && run ) {
+    fHeader.run = run->GetNumber();
+    fHeader.type = run->GetType();
+    fHaveRun = kTRUE;
+  }
+
+  const UInt_t* evbuf = (const UInt_t*)evdata->GetRawDataBuffer();
+  UInt_t evtype = evdata->GetEvType();
+  UInt_t len = evbuf ? evbuf[0]+1 : 0;
+  fNRawBytes += len*sizeof(UInt_t);
+
+  PutVarint(fChunk, evtype);
+  if( evtype >= 1 && evtype <= kMaxPhysType ) {
+    Int_t evnum = evdata->GetEvNum();
+    PutVarint(fChunk, evnum);
+    for( UInt_t id=0; id<fDetectors.size(); id++ ) {
+      // Skip detectors that did not decode this event
+      if( fDetectors[id]->GetHitRecordEvent() != evnum ) continue;
+      const vector<UChar_t>& record = fDetectors[id]->GetHitRecord();
+      if( record.empty() ) continue;
+      PutVarint(fChunk, id+1);
+      PutVarint(fChunk, record.size());
+      fChunk.insert(fChunk.end(), record.begin(), record.end());
+    }
+    PutVarint(fChunk, 0);
+  } else {
+    PutVarint(fChunk, len);
+    const UChar_t* bytes = (const UChar_t*)evbuf;
+    fChunk.insert(fChunk.end(), bytes, bytes + len*sizeof(UInt_t));
+  }
+  fChunkEvents++;
+  fHeader.nevents++;
+
+  if( fChunk.size() >= fChunkSize )
+    return WriteChunk();
+  return 0;
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCache::WriteChunk()
+{
+  // Write the events collected in fChunk
+
+  if( fChunkEvents == 0 ) return 0;
+  UInt_t nbytes = fChunk.size();
+  Bool_t ok =
+    fwrite(&fChunkEvents, sizeof(fChunkEvents), 1, fFile) == 1 &&
+    fwrite(&nbytes, sizeof(nbytes), 1, fFile) == 1 &&
+    fwrite(&fChunk[0], 1, nbytes, fFile) == nbytes;
+  fNBytes += 2*sizeof(UInt_t) + nbytes;
+  fChunk.clear();
+  fChunkEvents = 0;
+  if( !ok ) {
+    Error("WriteChunk","Cannot write hit cache file %s",fFileName.Data());
+    return -1;
+  }
+  return 0;
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCache::Close()
+{
+  // Write the last chunk, complete the header and close the file.
+  // Hit recording is switched off again.
+
+  for( UInt_t id=0; id<fDetectors.size(); id++ )
+    fDetectors[id]->SetHitRecording(kFALSE);
+  fDetectors.clear();
+  if( !fFile ) return 0;
+
+  Int_t status = WriteChunk();
+  if( fseek(fFile, 0, SEEK_SET) != 0 ||
+      fwrite(&fHeader, sizeof(fHeader), 1, fFile) != 1 )
+    status = -1;
+  if( fclose(fFile) != 0 )
+    status = -1;
+  fFile = 0;
+
+  if( status != 0 )
+    Error("Close","Cannot write hit cache file %s",fFileName.Data());
+  else
+    cout << "THcHitCache: " << fHeader.nevents << " events, " << fNBytes
+	 << " bytes (" << fNRawBytes << " bytes of CODA data) written to "
+	 << fFileName << endl;
+  return status;
+}
+
+//_____________________________________________________________________________
+Bool_t THcHitCache::IsValidRecord( const UChar_t* p, UInt_t n )
+{
+  // Check that the n bytes at p are a sequence of complete hit channels:
+  // plane, counter, signal, number of data words and the data words
+
+  const UChar_t* end = p + n;
+  while( p < end ) {
+    UInt_t v, nwords;
+    if( !GetVarint(p, end, v) || !GetVarint(p, end, v) ||
+	!GetVarint(p, end, v) || !GetVarint(p, end, nwords) )
+      return kFALSE;
+    for( UInt_t i=0; i<nwords; i++ ) {
+      if( !GetVarint(p, end, v) )
+	return kFALSE;
+    }
+  }
+  return kTRUE;
+}
+
+ClassImp(THcHitCache)
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,94 @@
+#ifndef ROOT_THcHitCache
+#define ROOT_THcHitCache
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcHitCache                                                               //
+//                                                                           //
+// Writes the decoded raw hit lists of the Hall C detectors to a cache file. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THaPostProcess.h"
+#include "TString.h"
+#include <vector>
+#include <cstdio>
+
+class THcHitList;
+
+class THcHitCache : public THaPostProcess {
+
+public:
+  THcHitCache( const char* filename );
+  virtual ~THcHitCache();
+
+  virtual Int_t Init( const TDatime& run_time );
+  virtual Int_t Process( const THaEvData* evdata, const THaRunBase* run,
+			 Int_t code );
+  virtual Int_t Close();
+
+  // Bytes of events collected before they are written as one chunk
+  void    SetChunkSize( UInt_t bytes ) { fChunkSize = bytes; }
+
+  const char* GetFileName() const { return fFileName.Data(); }
+
+  // File format, shared with THcHitCacheRun
+  static const char kMagic[8];
+  enum { kMaxPhysType = 14 };          // Highest physics event type
+  struct Header {
+    char   magic[8];
+    Int_t  run;                        // Run number
+    Int_t  type;                       // Run type
+    UInt_t date;                       // Run date, TDatime::Get()
+    UInt_t nevents;                    // Events in the file
+    UInt_t ndet;                       // Detector names that follow
+  };
+
+  // Variable length unsigned integers, 7 bits per byte, and signed ones
+  // mapped to unsigned (0,-1,1,-2,... to 0,1,2,3,...)
+  static void PutVarint( std::vector<UChar_t>& buf, UInt_t v ) {
+    while( v >= 0x80 ) {
+      buf.push_back( (UChar_t)(v | 0x80) );
+      v >>= 7;
+    }
+    buf.push_back( (UChar_t)v );
+  }
+  // Read a varint at p, moving p past it.  Reads nothing at or beyond
+  // end, and returns kFALSE if the varint does not end before end or is
+  // longer than 5 bytes (corrupt data).
+  static Bool_t GetVarint( const UChar_t*& p, const UChar_t* end, UInt_t& v ) {
+    v = 0;
+    const UChar_t* q = p;
+    for( Int_t shift=0; shift<35 && q<end; shift+=7 ) {
+      UChar_t c = *q++;
+      v |= (UInt_t)(c & 0x7f) << shift;
+      if( !(c & 0x80) ) {
+	p = q;
+	return kTRUE;
+      }
+    }
+    return kFALSE;
+  }
+  static UInt_t ZigZag( Int_t v ) { return ((UInt_t)v << 1) ^ (UInt_t)(v >> 31); }
+  static Int_t  UnZigZag( UInt_t v ) { return (Int_t)(v >> 1) ^ -(Int_t)(v & 1); }
+  // Record of n bytes made of complete hit channels
+  static Bool_t IsValidRecord( const UChar_t* p, UInt_t n );
+
+protected:
+  TString  fFileName;
+  FILE*    fFile;
+  Header   fHeader;
+  Bool_t   fHaveRun;                   // Run info taken from the first event
+  UInt_t   fChunkSize;
+  UInt_t   fChunkEvents;               // Events in fChunk
+  std::vector<UChar_t>     fChunk;     // Events not yet written
+  std::vector<THcHitList*> fDetectors; // Hit list detectors, by cache id
+  ULong64_t fNBytes;                   // Bytes written
+  ULong64_t fNRawBytes;                // Bytes of the CODA events
+
+  Int_t   WriteChunk();
+
+  ClassDef(THcHitCache,0)   // Decoded hit cache writer
+};
+
+#endif
@@ -0,0 +1,319 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// THcHitCacheRun
+//
+// A run read from a hit cache file written by THcHitCache instead of
+// from the CODA file.  Control, scaler and EPICS events come back as
+// they were in the CODA file.  Physics events come back as CODA events
+// with only the event ID bank (event type and number), and the hit list
+// of each detector as the channel record it was cached with.  Given
+// this run, THcAnalyzer points the hit list detectors to it
+// (THcHitList::SetHitCache), and DecodeToHitList rebuilds the hit list
+// from the record instead of from the crate data, which are not read.
+//
+// The events are read a chunk at a time (see THcHitCache) into one
+// buffer, in which the records are used in place.
+//
+// Usage, in place of THcRun:
+//   THcHitCacheRun* run = new THcHitCacheRun("cache_50017.hc");
+//   analyzer->Process(run);
+//
+// Detectors that do not use THcHitList, and hit list detectors that
+// were not in the replay writing the cache, see no hits.
+//
+// With SetInMemory(), the first Open reads all events of the file into
+// memory, where they stay for the next Open of the run, so that repeated
+// passes over the run read the file only once.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "THcHitCacheRun.h"
+#include "THcHitCache.h"
+#include "TDatime.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+//_____________________________________________________________________________
+THcHitCacheRun::THcHitCacheRun( const char* filename, const char* description ) :
+  THaRun(filename, description), fFile(0), fNEvents(0), fInMemory(kFALSE),
+  fDataPos(0), fPos(0), fEnd(0), fChunkEvents(0), fCurrent(0), fEvNum(0),
+  fNRead(0)
+{
+  // Normal constructor
+}
+
+//_____________________________________________________________________________
+THcHitCacheRun::THcHitCacheRun( const THcHitCacheRun& rhs ) :
+  THaRun(rhs), fFile(0), fDetNames(rhs.fDetNames), fNEvents(rhs.fNEvents),
+  fInMemory(rhs.fInMemory), fData(rhs.fData), fDataFile(rhs.fDataFile),
+  fDataPos(0), fPos(0), fEnd(0), fChunkEvents(0), fCurrent(0), fEvNum(0),
+  fNRead(0)
+{
+  // Copy constructor. The file is not shared.  Events in memory are
+  // copied, so the copy does not read the file again.
+}
+
+//_____________________________________________________________________________
+THcHitCacheRun& THcHitCacheRun::operator=( const THaRunBase& rhs )
+{
+  // Assignment. Copies the detector names of the file, the memory mode
+  // and the events in memory, if rhs has any and this run does not have
+  // those of the file already.  A run without events in memory leaves
+  // the events of this run alone; Open reads the file again if they are
+  // of another file.
+
+  if( this != &rhs ) {
+    THaRun::operator=(rhs);
+    const THcHitCacheRun* run = dynamic_cast<const THcHitCacheRun*>(&rhs);
+    if( run ) {
+      fDetNames = run->fDetNames;
+      fNEvents = run->fNEvents;
+      fInMemory = run->fInMemory;
+      if( fInMemory && !run->fDataFile.IsNull() &&
+	  fDataFile != run->fDataFile ) {
+	fData = run->fData;
+	fDataFile = run->fDataFile;
+      }
+    }
+  }
+  return *this;
+}
+
+//_____________________________________________________________________________
+THcHitCacheRun::~THcHitCacheRun()
+{
+  // Destructor
+
+  Close();
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCacheRun::Open()
+{
+  // Open the cache file and read its header: the run number, type and
+  // date, and the names of the detectors.
+
+  Close();
+  fFile = fopen(GetFilename(), "rb");
+  if( !fFile ) {
+    Error("Open","Cannot open hit cache file %s",GetFilename());
+    return READ_FATAL;
+  }
+
+  THcHitCache::Header header;
+  Bool_t ok = fread(&header, sizeof(header), 1, fFile) == 1 &&
+    memcmp(header.magic, THcHitCache::kMagic, sizeof(header.magic)) == 0;
+  vector<TString> names;
+  for( UInt_t i=0; ok && i<header.ndet; i++ ) {
+    UInt_t len;
+    char name[256];
+    ok = fread(&len, sizeof(len), 1, fFile) == 1 && len < sizeof(name) &&
+      fread(name, 1, len, fFile) == len;
+    if( ok ) {
+      name[len] = 0;
+      names.push_back(name);
+    }
+  }
+  if( !ok ) {
+    Error("Open","%s is not a hit cache file",GetFilename());
+    Close();
+    return READ_FATAL;
+  }
+
+  fDetNames = names;
+  fNEvents = header.nevents;
+  SetNumber(header.run);
+  SetType(header.type);
+  SetDate(TDatime(header.date));
+
+  fDataPos = 0;
+  if( fInMemory && fDataFile != GetFilename() && LoadData() != READ_OK ) {
+    Error("Open","Cannot read hit cache file %s",GetFilename());
+    Close();
+    return READ_FATAL;
+  }
+
+  fChunkEvents = 0;
+  fPos = fEnd = 0;
+  fCurrent = 0;
+  fNRead = 0;
+  return READ_OK;
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCacheRun::Close()
+{
+  // Close the file
+
+  if( fFile ) {
+    if( fNRead > 0 )
+      cout << "THcHitCacheRun: " << fNRead << " of " << fNEvents
+	   << " events read from " << GetFilename() << endl;
+    fclose(fFile);
+    fFile = 0;
+  }
+  fChunkEvents = 0;
+  fCurrent = 0;
+  return 0;
+}
+
+//_____________________________________________________________________________
+void THcHitCacheRun::SetInMemory( Bool_t enable )
+{
+  // Keep the events in memory from the next Open on, or release them
+
+  fInMemory = enable;
+  if( !enable ) {
+    vector<UChar_t>().swap(fData);
+    fDataFile = "";
+  }
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCacheRun::LoadData()
+{
+  // Read the events, everything after the header, into fData
+
+  fDataFile = "";
+  long start = ftell(fFile);
+  if( start < 0 || fseek(fFile, 0, SEEK_END) != 0 )
+    return READ_ERROR;
+  long end = ftell(fFile);
+  if( end < start || fseek(fFile, start, SEEK_SET) != 0 )
+    return READ_ERROR;
+  size_t n = end - start;
+  fData.resize(n);
+  if( n > 0 && fread(&fData[0], 1, n, fFile) != n ) {
+    vector<UChar_t>().swap(fData);
+    return READ_ERROR;
+  }
+  fDataFile = GetFilename();
+  cout << "THcHitCacheRun: " << n << " bytes of " << fNEvents
+       << " events read into memory from " << GetFilename() << endl;
+  return READ_OK;
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCacheRun::FindDetector( const char* name ) const
+{
+  // Cache id of the detector with the full name name (e.g. "H.dc"),
+  // -1 if the cache has no hits of it
+
+  for( UInt_t i=0; i<fDetNames.size(); i++ )
+    if( fDetNames[i] == name ) return i;
+  return -1;
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCacheRun::ReadChunk()
+{
+  // Read the next chunk of events, or find it in memory
+
+  UInt_t nev = 0, nbytes = 0;
+  if( fInMemory ) {
+    while( nev == 0 ) {
+      if( fDataPos == fData.size() )
+	return READ_EOF;
+      if( fDataPos + 2*sizeof(UInt_t) > fData.size() )
+	return READ_ERROR;
+      memcpy(&nev, &fData[fDataPos], sizeof(nev));
+      memcpy(&nbytes, &fData[fDataPos+sizeof(nev)], sizeof(nbytes));
+      fDataPos += 2*sizeof(UInt_t);
+      if( fDataPos + nbytes > fData.size() )
+	return READ_ERROR;
+      fPos = &fData[0] + fDataPos;
+      fDataPos += nbytes;
+    }
+    fEnd = fPos + nbytes;
+    fChunkEvents = nev;
+    return READ_OK;
+  }
+
+  while( nev == 0 ) {
+    if( fread(&nev, sizeof(nev), 1, fFile) != 1 )
+      return feof(fFile) ? READ_EOF : READ_ERROR;
+    if( fread(&nbytes, sizeof(nbytes), 1, fFile) != 1 )
+      return READ_ERROR;
+    fChunk.resize(nbytes);
+    if( nbytes > 0 && fread(&fChunk[0], 1, nbytes, fFile) != nbytes )
+      return READ_ERROR;
+  }
+  fPos = &fChunk[0];
+  fEnd = fPos + nbytes;
+  fChunkEvents = nev;
+  return READ_OK;
+}
+
+//_____________________________________________________________________________
+Int_t THcHitCacheRun::ReadEvent()
+{
+  // Make the next event of the cache current
+
+  if( !fFile ) return READ_FATAL;
+  fCurrent = 0;
+  if( fChunkEvents == 0 ) {
+    Int_t status = ReadChunk();
+    if( status != READ_OK ) return status;
+  }
+
+  // Every number is read within the chunk, and every record checked,
+  // so that a corrupt file fails here rather than in the detectors
+  const UChar_t* p = fPos;
+  UInt_t evtype;
+  Bool_t ok = THcHitCache::GetVarint(p, fEnd, evtype);
+  fRecords.assign(fDetNames.size(), (const UChar_t*)0);
+  fRecordLen.assign(fDetNames.size(), 0);
+
+  if( ok && evtype >= 1 && evtype <= THcHitCache::kMaxPhysType ) {
+    UInt_t evnum, id, n;
+    ok = THcHitCache::GetVarint(p, fEnd, evnum);
+    fEvNum = evnum;
+    while( ok && (ok = THcHitCache::GetVarint(p, fEnd, id)) && id != 0 ) {
+      ok = THcHitCache::GetVarint(p, fEnd, n) && n <= (UInt_t)(fEnd-p) &&
+	THcHitCache::IsValidRecord(p, n);
+      if( !ok ) break;
+      if( id <= fDetNames.size() ) {
+	fRecords[id-1] = p;
+	fRecordLen[id-1] = n;
+      }
+      p += n;
+    }
+    // CODA physics event with only the event ID bank
+    fIDBank[0] = 6;
+    fIDBank[1] = (evtype << 16) | 0x10cc;
+    fIDBank[2] = 4;
+    fIDBank[3] = 0xc0000100;
+    fIDBank[4] = fEvNum;
+    fIDBank[5] = 0;
+    fIDBank[6] = 0;
+    fCurrent = fIDBank;
+  } else if( ok ) {
+    UInt_t len;
+    ok = THcHitCache::GetVarint(p, fEnd, len) &&
+      len <= (UInt_t)(fEnd-p)/sizeof(UInt_t);
+    if( ok ) {
+      fRawEvent.resize(len > 0 ? len : 1);
+      memcpy(&fRawEvent[0], p, len*sizeof(UInt_t));
+      fCurrent = &fRawEvent[0];
+      p += len*sizeof(UInt_t);
+    }
+  }
+
+  if( !ok ) {
+    Error("ReadEvent","Corrupt hit cache file %s",GetFilename());
+    fRecords.assign(fDetNames.size(), (const UChar_t*)0);
+    fRecordLen.assign(fDetNames.size(), 0);
+    fCurrent = 0;
+    return READ_ERROR;
+  }
+  fPos = p;
+  fChunkEvents--;
+  fNRead++;
+  return READ_OK;
+}
+
+ClassImp(THcHitCacheRun)
+////////////////////////////////////////////////////////////////////////////////
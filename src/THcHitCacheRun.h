@@ -0,0 +1,78 @@
+#ifndef ROOT_THcHitCacheRun
+#define ROOT_THcHitCacheRun
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcHitCacheRun                                                            //
+//                                                                           //
+// Run read from a decoded hit cache file written by THcHitCache.            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THaRun.h"
+#include <vector>
+#include <cstdio>
+
+class THcHitCacheRun : public THaRun {
+
+public:
+  THcHitCacheRun( const char* filename="", const char* description="" );
+  THcHitCacheRun( const THcHitCacheRun& run );
+  virtual ~THcHitCacheRun();
+  virtual THcHitCacheRun& operator=( const THaRunBase& rhs );
+
+  virtual Int_t  Open();
+  virtual Int_t  Close();
+  virtual Bool_t IsOpen() const { return fFile != 0; }
+  virtual Int_t  ReadEvent();
+  virtual const UInt_t* GetEvBuffer() const { return fCurrent; }
+
+  // Detectors of the cache, by the cache ids used in GetHitRecord
+  Int_t  GetNDetectors() const { return fDetNames.size(); }
+  Int_t  FindDetector( const char* name ) const;
+
+  // Channel record of detector id for the current event (n=0 if none)
+  void   GetHitRecord( Int_t id, const UChar_t*& record, UInt_t& n ) const {
+    if( id >= 0 && id < (Int_t)fRecords.size() ) {
+      record = fRecords[id]; n = fRecordLen[id];
+    } else {
+      record = 0; n = 0;
+    }
+  }
+  Int_t  GetEvNum() const { return fEvNum; }
+
+  // Keep the events of the file in memory after the first Open, so that
+  // further passes over the run (see THcCalibDriver) do not read it again
+  void   SetInMemory( Bool_t enable=kTRUE );
+  Bool_t IsInMemory() const { return fInMemory; }
+
+protected:
+  FILE*  fFile;                        //! Cache file
+  std::vector<TString>  fDetNames;     // Detector names in the file
+  UInt_t fNEvents;                     // Events in the file
+  Bool_t fInMemory;                    // Keep the events in memory
+
+  std::vector<UChar_t>  fData;         //! Events of the file, if in memory
+  TString               fDataFile;     //! File fData was read from
+  size_t                fDataPos;      //! Next chunk in fData
+
+  std::vector<UChar_t>  fChunk;        //! Current chunk
+  const UChar_t*        fPos;          //! Next event in fChunk
+  const UChar_t*        fEnd;          //! End of fChunk
+  UInt_t                fChunkEvents;  //! Events left in fChunk
+
+  UInt_t   fIDBank[7];                 //! Physics event: ID bank only
+  std::vector<UInt_t>   fRawEvent;     //! Other events: CODA event
+  const UInt_t*         fCurrent;      //! Current event buffer
+  Int_t    fEvNum;                     //! Current physics event number
+  std::vector<const UChar_t*> fRecords; //! Records of the current event
+  std::vector<UInt_t>   fRecordLen;    //! Their lengths
+  ULong64_t fNRead;                    //! Events read
+
+  Int_t  ReadChunk();
+  Int_t  LoadData();
+
+  ClassDef(THcHitCacheRun,2)   // Run read from a decoded hit cache
+};
+
+#endif
@@ -11,8 +11,11 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "THcHitList.h"
+#include "THcHitCache.h"
+#include "THcHitCacheRun.h"
 #include "TError.h"
 #include "TClass.h"
+#include "THaCut.h"
 
 using namespace std;
 
@@ -21,6 +24,13 @@ THcHitList::THcHitList()
   // Normal constructor.
 
   fRawHitList = NULL;
+  fPedestalCut = NULL;
+  fProfiler = NULL;
+  fProfileId = -1;
+  fHitRecording = kFALSE;
+  fHitRecordEvent = -1;
+  fHitCache = NULL;
+  fHitCacheId = -1;
 
 }
 
@@ -28,6 +38,27 @@ THcHitList::~THcHitList() {
   // Destructor
 }
 
+Int_t THcHitList::AddComputeBlock(const char* name, const char* vars)
+{
+  // Declare an optional computation that only fills the global
+  // variables matching vars. Returns the block number for IsComputed.
+
+  ComputeBlock block;
+  block.name = name;
+  block.vars = vars;
+  block.on = kTRUE;
+  fComputeBlocks.push_back(block);
+  return fComputeBlocks.size()-1;
+}
+
+Bool_t THcHitList::IsPedestalEvent() const
+{
+  // True if the "Pedestal_event" cut passed for the current event.
+  // Without a cut from the analyzer, no event is a pedestal event.
+
+  return fPedestalCut && fPedestalCut->GetResult();
+}
+
 void THcHitList::InitHitList(THaDetMap* detmap,
 				  const char *hitclass, Int_t maxhits) {
   // Save the electronics to detector mapping
@@ -44,6 +75,32 @@ void THcHitList::InitHitList(THaDetMap* detmap,
   fdMap = detmap;
 }
 
+THcRawHit* THcHitList::GetRawHit(Int_t plane, Int_t counter)
+{
+  // The hit of plane and counter in the hit list, added if there is none
+
+  // Search hit list for plane and counter
+  // We could do sorting 
+  THcRawHit* rawhit=0;
+  UInt_t thishit = 0;
+  while(thishit < fNRawHits) {
+    rawhit = (THcRawHit*) (*fRawHitList)[thishit];
+    if (plane == rawhit->fPlane
+	&& counter == rawhit->fCounter) {
+      // cout << "Found as " << thishit << "/" << fNRawHits << endl;
+      return rawhit;
+    }
+    thishit++;
+  }
+
+  rawhit = (THcRawHit*) (*fRawHitList)[thishit];
+  rawhit->Clear();	// Blank out hit contents
+  fNRawHits++;
+  rawhit->fPlane = plane;
+  rawhit->fCounter = counter;
+  return rawhit;
+}
+
 Int_t THcHitList::DecodeToHitList( const THaEvData& evdata ) {
   // Clear the hit list
   // Find all populated channels belonging to the detector and add
@@ -52,18 +109,51 @@ Int_t THcHitList::DecodeToHitList( const THaEvData& evdata ) {
   // multiple signal types (e.g. ADC+, ADC-, TDC+, TDC-), or multiple
   // hits for multihit tdcs.
   // The hit list is sorted (by plane, counter) after filling.
+  // With a hit cache run, the channel data come from its record of the
+  // event instead.  With hit recording on, the channel data are recorded
+  // for THcHitCache.
 
   // cout << " Clearing TClonesArray " << endl;
   fRawHitList->Clear( );
   fNRawHits = 0;
 
+  if(fHitCache) {
+    const UChar_t* p;
+    UInt_t n;
+    fHitCache->GetHitRecord(fHitCacheId, p, n);
+    const UChar_t* end = p+n;
+    if(fHitRecording) {
+      fHitRecord.assign(p, end);
+      fHitRecordEvent = evdata.GetEvNum();
+    }
+    // THcHitCacheRun has checked the record; stop at the end of it anyway
+    UInt_t plane, counter, signal, nMHits, data;
+    while(p < end) {
+      if(!THcHitCache::GetVarint(p,end,plane) ||
+	 !THcHitCache::GetVarint(p,end,counter) ||
+	 !THcHitCache::GetVarint(p,end,signal) ||
+	 !THcHitCache::GetVarint(p,end,nMHits)) break;
+      THcRawHit* rawhit = GetRawHit(plane, counter);
+      for (UInt_t mhit = 0; mhit < nMHits; mhit++) {
+	if(!THcHitCache::GetVarint(p,end,data)) break;
+	rawhit->SetData(signal,THcHitCache::UnZigZag(data));
+      }
+    }
+    fRawHitList->Sort(fNRawHits);
+    return fNRawHits;
+  }
+
+  if(fHitRecording) {
+    fHitRecord.clear();
+    fHitRecordEvent = evdata.GetEvNum();
+  }
+
   for ( Int_t i=0; i < fdMap->GetSize(); i++ ) {
     THaDetMap::Module* d = fdMap->GetModule(i);
 
     // Loop over all channels that have a hit.
     //    cout << "Crate/Slot: " << d->crate << "/" << d->slot << endl;
     for ( Int_t j=0; j < evdata.GetNumChan( d->crate, d->slot); j++) {
-      THcRawHit* rawhit=0;
       
       Int_t chan = evdata.GetNextChan( d->crate, d->slot, j );
       if( chan < d->lo || chan > d->hi ) continue;     // Not one of my channels
@@ -75,34 +165,23 @@ Int_t THcHitList::DecodeToHitList( const THaEvData& evdata ) {
       Int_t counter = d->reverse ? d->first + d->hi - chan : d->first + chan - d->lo;
       //cout << d->crate << " " << d->slot << " " << chan << " " << plane << " "
       // << counter << " " << signal << endl;
-      // Search hit list for plane and counter
-      // We could do sorting 
-      UInt_t thishit = 0;
-      while(thishit < fNRawHits) {
-	rawhit = (THcRawHit*) (*fRawHitList)[thishit];
-	if (plane == rawhit->fPlane
-	    && counter == rawhit->fCounter) {
-	  // cout << "Found as " << thishit << "/" << fNRawHits << endl;
-	  break;
-	}
-	thishit++;
-      }
-
-      if(thishit == fNRawHits) {
-	rawhit = (THcRawHit*) (*fRawHitList)[thishit];
-	rawhit->Clear();	// Blank out hit contents
-	fNRawHits++;
-	rawhit->fPlane = plane;
-	rawhit->fCounter = counter;
-      }
+      THcRawHit* rawhit = GetRawHit(plane, counter);
 	
       // Get the data from this channel
       // Allow for multiple hits
       Int_t nMHits = evdata.GetNumHits(d->crate, d->slot, chan);
+      if(fHitRecording) {
+	THcHitCache::PutVarint(fHitRecord, plane);
+	THcHitCache::PutVarint(fHitRecord, counter);
+	THcHitCache::PutVarint(fHitRecord, signal);
+	THcHitCache::PutVarint(fHitRecord, nMHits);
+      }
       for (Int_t mhit = 0; mhit < nMHits; mhit++) {
 	Int_t data = evdata.GetData( d->crate, d->slot, chan, mhit);
 	// cout << "Signal " << signal << "=" << data << endl;
 	rawhit->SetData(signal,data);
+	if(fHitRecording)
+	  THcHitCache::PutVarint(fHitRecord, THcHitCache::ZigZag(data));
       }
     }
   }
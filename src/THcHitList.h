@@ -6,6 +6,8 @@
 #include "THaEvData.h"
 #include "TClonesArray.h"
 #include "TObject.h"
+#include "TString.h"
+#include <vector>
 
 
 using namespace std;
@@ -18,6 +20,10 @@ using namespace std;
 
 //class THaDetMap;
 
+class THaCut;
+class THcProfiler;
+class THcHitCacheRun;
+
 class THcHitList {
 
 public:
@@ -32,6 +38,34 @@ public:
 
   TClonesArray* GetHitList() const {return fRawHitList; }
 
+  // Cut that flags pedestal events, set by THcAnalyzer after the cuts
+  // are loaded so that Decode need not look it up by name in gHaCuts
+  void          SetPedestalCut(const THaCut* cut) { fPedestalCut = cut; }
+  Bool_t        IsPedestalEvent() const;
+
+  // Profiler that times Decode and the processing stages, and the id
+  // of this detector in it, set by THcAnalyzer::EnableProfiling
+  void          SetProfiler(THcProfiler* prof, Int_t id) { fProfiler = prof; fProfileId = id; }
+
+  // Optional computations whose results are only used through global
+  // variables.  vars are space separated wildcard patterns, relative to
+  // the detector prefix, of those variables.  Blocks are computed unless
+  // THcAnalyzer::EnableDemandDriven finds none of their variables used.
+  Int_t         AddComputeBlock(const char* name, const char* vars);
+  Int_t         GetNComputeBlocks() const { return fComputeBlocks.size(); }
+  const char*   GetComputeBlockName(Int_t i) const { return fComputeBlocks[i].name.Data(); }
+  const char*   GetComputeBlockVars(Int_t i) const { return fComputeBlocks[i].vars.Data(); }
+  void          SetComputeBlock(Int_t i, Bool_t on) { fComputeBlocks[i].on = on; }
+  Bool_t        IsComputed(Int_t i) const { return fComputeBlocks[i].on; }
+
+  // Decoded hit cache: record the channel data added to the hit list
+  // (for THcHitCache), or build the hit list from the records of a cache
+  // run instead of the event data (id is the detector in the cache)
+  void          SetHitRecording(Bool_t on) { fHitRecording = on; fHitRecordEvent = -1; }
+  const std::vector<UChar_t>& GetHitRecord() const { return fHitRecord; }
+  Int_t         GetHitRecordEvent() const { return fHitRecordEvent; }
+  void          SetHitCache(const THcHitCacheRun* run, Int_t id) { fHitCache = run; fHitCacheId = id; }
+
   UInt_t         fNRawHits;
   Int_t         fNMaxRawHits;
   TClonesArray* fRawHitList; // List of raw hits
@@ -40,6 +74,24 @@ public:
   THaDetMap*    fdMap;
 
 protected:
+  const THaCut* fPedestalCut;
+  THcProfiler*  fProfiler;
+  Int_t         fProfileId;
+
+  struct ComputeBlock {
+    TString name;
+    TString vars;
+    Bool_t  on;
+  };
+  std::vector<ComputeBlock> fComputeBlocks;
+
+  Bool_t        fHitRecording;
+  std::vector<UChar_t> fHitRecord;   // Channel data of the last event
+  Int_t         fHitRecordEvent;     // Its event number
+  const THcHitCacheRun* fHitCache;
+  Int_t         fHitCacheId;
+
+  THcRawHit*    GetRawHit(Int_t plane, Int_t counter);
 
   ClassDef(THcHitList,0);  // List of raw hits sorted by plane, counter
 };
@@ -0,0 +1,308 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcHodoTimeCalib                                                          //
+//                                                                           //
+// Least squares fit of the hodoscope timing constants: for each PMT the     //
+// time offset and the pulse height correction coefficient, and for each     //
+// paddle the light velocity, as used by THcHodoscope::FineProcess,          //
+//                                                                           //
+//   t = tdc*tdc_to_time - phc*sqrt(max(0,adc/minph-1)) - path/vel - offset  //
+//                                                                           //
+// where t, less the flight time from the focal plane, is the same for all   //
+// the hits of a track.  This common event time is eliminated from the      //
+// normal equations event by event (the measurements of an event are         //
+// centered on their mean), so only the packed normal matrix and the right   //
+// hand side of the constants are kept, whatever the length of the run.      //
+// The offsets are fixed up to a constant: the offset of the PMT with the    //
+// most hits keeps its current value, as do the constants of PMTs with too   //
+// few hits.                                                                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcHodoTimeCalib.h"
+#include "THcSymSolver.h"
+#include "TMath.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+//_____________________________________________________________________________
+THcHodoTimeCalib::THcHodoTimeCalib() :
+  fNpaddles(0), fNpar(0), fMinHits(100)
+{
+  // Constructor
+
+  Clear();
+}
+
+//_____________________________________________________________________________
+THcHodoTimeCalib::~THcHodoTimeCalib()
+{
+  // Destructor
+}
+
+//_____________________________________________________________________________
+void THcHodoTimeCalib::Init( UInt_t npaddles )
+{
+  // Set up the sums for npaddles paddles.  Parameters: the offsets of
+  // the 2*npaddles PMTs, their pulse height coefficients, then the
+  // inverse light velocities of the paddles.
+
+  fNpaddles = npaddles;
+  fNpar = 5*npaddles;
+  Clear();
+}
+
+//_____________________________________________________________________________
+void THcHodoTimeCalib::Clear( Option_t* )
+{
+  // Reset the sums
+
+  fHits.clear();
+  fA.assign(fNpar*(fNpar+1)/2, 0.);
+  fB.assign(fNpar, 0.);
+  fNhits.assign(2*fNpaddles, 0);
+  fSumYY = 0.;
+  fNev = 0;
+  fNmeas = 0;
+  fOffset.assign(2*fNpaddles, 0.);
+  fPhc.assign(2*fNpaddles, 0.);
+  fVel.assign(fNpaddles, 0.);
+  fRMS = 0.;
+}
+
+//_____________________________________________________________________________
+void THcHodoTimeCalib::AddHit( UInt_t paddle, UInt_t side, Double_t phterm,
+			       Double_t path, Double_t time )
+{
+  // Add a PMT hit to the current event
+
+  if (paddle >= fNpaddles || side > 1) return;
+  Hit hit;
+  hit.pmt = side*fNpaddles + paddle;
+  hit.paddle = paddle;
+  hit.phterm = phterm;
+  hit.path = path;
+  hit.time = time;
+  fHits.push_back(hit);
+}
+
+//_____________________________________________________________________________
+void THcHodoTimeCalib::EndEvent()
+{
+  // Add the centered measurements of the event to the normal equations.
+  // Each measurement depends on three parameters; the centered ones
+  // depend on all parameters of the event, which are collected first.
+
+  UInt_t m = fHits.size();
+  if (m < 2) {
+    fHits.clear();
+    return;
+  }
+
+  // Parameters of the event, in ascending order
+
+  vector<UInt_t> par;
+  for (UInt_t i=0; i<m; i++) {
+    par.push_back(fHits[i].pmt);
+    par.push_back(2*fNpaddles + fHits[i].pmt);
+    par.push_back(4*fNpaddles + fHits[i].paddle);
+  }
+  sort(par.begin(), par.end());
+  par.erase(unique(par.begin(), par.end()), par.end());
+  UInt_t k = par.size();
+
+  // Centered design rows in the event's parameters
+
+  vector<Double_t> x(m*k, 0.);
+  vector<Double_t> y(m);
+  Double_t ymean = 0.;
+  vector<Double_t> xmean(k, 0.);
+  for (UInt_t i=0; i<m; i++) {
+    const Hit& h = fHits[i];
+    Double_t* xi = &x[i*k];
+    xi[lower_bound(par.begin(),par.end(),h.pmt)-par.begin()] += 1.;
+    xi[lower_bound(par.begin(),par.end(),2*fNpaddles+h.pmt)-par.begin()]
+      += h.phterm;
+    xi[lower_bound(par.begin(),par.end(),4*fNpaddles+h.paddle)-par.begin()]
+      += h.path;
+    y[i] = h.time;
+    ymean += h.time;
+    for (UInt_t j=0; j<k; j++) xmean[j] += xi[j];
+    fNhits[h.pmt]++;
+  }
+  ymean /= m;
+  for (UInt_t j=0; j<k; j++) xmean[j] /= m;
+
+  for (UInt_t i=0; i<m; i++) {
+    Double_t* xi = &x[i*k];
+    Double_t yi = y[i] - ymean;
+    for (UInt_t j=0; j<k; j++) xi[j] -= xmean[j];
+    fSumYY += yi*yi;
+    for (UInt_t a=0; a<k; a++) {
+      if (xi[a] == 0.) continue;
+      fB[par[a]] += xi[a]*yi;
+      Double_t* row = &fA[Index(par[a],par[a])] - par[a];
+      for (UInt_t b=a; b<k; b++)
+	row[par[b]] += xi[a]*xi[b];
+    }
+  }
+
+  fNev++;
+  fNmeas += m;
+  fHits.clear();
+}
+
+//_____________________________________________________________________________
+Int_t THcHodoTimeCalib::Solve( const Double_t* posoffset,
+			       const Double_t* negoffset,
+			       const Double_t* posphc, const Double_t* negphc,
+			       const Double_t* vel )
+{
+  // Solve the normal equations for the constants.  Returns the number of
+  // fitted PMTs, or -1 on failure, in which case the results are the
+  // current constants.
+
+  UInt_t n = fNpaddles;
+  vector<Double_t> theta(fNpar);
+  for (UInt_t i=0; i<n; i++) {
+    theta[i] = posoffset[i];
+    theta[n+i] = negoffset[i];
+    theta[2*n+i] = posphc[i];
+    theta[3*n+i] = negphc[i];
+    theta[4*n+i] = vel[i] != 0. ? 1./vel[i] : 0.;
+  }
+  fOffset.assign(theta.begin(), theta.begin()+2*n);
+  fPhc.assign(theta.begin()+2*n, theta.begin()+4*n);
+  fVel.assign(vel, vel+n);
+  fRMS = 0.;
+  if (fNev == 0) return -1;
+
+  // Fixed parameters: the constants of PMTs with too few hits, the
+  // velocity of paddles without a fitted PMT, any parameter the data do
+  // not constrain, and the offset of the reference PMT.
+
+  vector<Bool_t> fixed(fNpar, kFALSE);
+  UInt_t ref = 0;
+  Int_t nfit = 0;
+  for (UInt_t p=0; p<2*n; p++) {
+    if (fNhits[p] < fMinHits) {
+      fixed[p] = fixed[2*n+p] = kTRUE;
+    } else
+      nfit++;
+    if (fNhits[p] > fNhits[ref]) ref = p;
+  }
+  if (nfit == 0) return -1;
+  fixed[ref] = kTRUE;
+  for (UInt_t i=0; i<n; i++)
+    if (fixed[i] && fixed[n+i]) fixed[4*n+i] = kTRUE;
+  for (UInt_t k=0; k<fNpar; k++)
+    if (fA[Index(k,k)] <= 0.) fixed[k] = kTRUE;
+
+  // Move the fixed parameters to the right hand side
+
+  THcSymSolver A(fNpar);
+  vector<Double_t> b(fB);
+  for (UInt_t i=0; i<fNpar; i++)
+    for (UInt_t j=i; j<fNpar; j++)
+      A(i,j) = fA[Index(i,j)];
+  for (UInt_t k=0; k<fNpar; k++) {
+    if (!fixed[k]) continue;
+    for (UInt_t j=0; j<fNpar; j++) {
+      if (j == k) continue;
+      if (!fixed[j]) b[j] -= A(j,k)*theta[k];
+      A(j,k) = 0.;
+    }
+    A(k,k) = 1.;
+    b[k] = theta[k];
+  }
+
+  vector<Double_t> sol;
+  if (!A.Factorize() || !A.Solve(b,sol)) {
+    cout << "THcHodoTimeCalib::Solve: singular normal matrix" << endl;
+    return -1;
+  }
+
+  // Residual RMS: chi2 = yy - 2 theta.b + theta A theta
+
+  Double_t chi2 = fSumYY;
+  for (UInt_t i=0; i<fNpar; i++) {
+    chi2 -= 2.*sol[i]*fB[i];
+    chi2 += fA[Index(i,i)]*sol[i]*sol[i];
+    for (UInt_t j=i+1; j<fNpar; j++)
+      chi2 += 2.*fA[Index(i,j)]*sol[i]*sol[j];
+  }
+  if (fNmeas > fNev)
+    fRMS = TMath::Sqrt(TMath::Max(chi2,0.)/(fNmeas-fNev));
+
+  fOffset.assign(sol.begin(), sol.begin()+2*n);
+  fPhc.assign(sol.begin()+2*n, sol.begin()+4*n);
+  for (UInt_t i=0; i<n; i++)
+    if (!fixed[4*n+i] && sol[4*n+i] > 0.)
+      fVel[i] = 1./sol[4*n+i];
+
+  return nfit;
+}
+
+//_____________________________________________________________________________
+Int_t THcHodoTimeCalib::WriteParam( const char* filename, const char* prefix,
+				    UInt_t nplanes, Int_t run ) const
+{
+  // Write the constants as the <prefix>hodo_* parameters, one line per
+  // paddle number and one column per plane.
+
+  if (nplanes == 0) return -1;
+
+  ofstream output(filename);
+  if (!output) {
+    cout << "THcHodoTimeCalib: can not open " << filename << endl;
+    return -1;
+  }
+
+  output << "; Hodoscope timing constants for run " << run << ", "
+	 << fNev << " tracks, residual rms " << fRMS << " ns" << endl;
+
+  const char* names[5] = { "hodo_vel_light", "hodo_pos_phc_coeff",
+			   "hodo_neg_phc_coeff", "hodo_pos_time_offset",
+			   "hodo_neg_time_offset" };
+  const Double_t* values[5] = { &fVel[0], &fPhc[0], &fPhc[fNpaddles],
+				&fOffset[0], &fOffset[fNpaddles] };
+
+  for (Int_t k=0; k<5; k++) {
+    TString name = Form("%s%s = ", prefix, names[k]);
+    TString indent(' ', name.Length());
+    output << endl;
+    for (UInt_t i=0; i<fNpaddles; i++) {
+      if (i%nplanes == 0) output << (i == 0 ? name : indent);
+      output << fixed << setw(8) << setprecision(4) << values[k][i];
+      if (i%nplanes == nplanes-1 || i == fNpaddles-1)
+	output << endl;
+      else
+	output << ",";
+    }
+  }
+
+  return 0;
+}
+
+//_____________________________________________________________________________
+void THcHodoTimeCalib::Print( Option_t* ) const
+{
+  // Print the sums and the PMTs without enough hits
+
+  cout << "Hodoscope timing calibration: " << fNev << " tracks, "
+       << fNmeas << " PMT times, residual rms " << fRMS << " ns" << endl;
+  for (UInt_t p=0; p<2*fNpaddles; p++) {
+    if (fNhits[p] > 0 && fNhits[p] < fMinHits)
+      cout << "  " << (p<fNpaddles ? "Positive" : "Negative") << " PMT "
+	   << p%fNpaddles << ", " << fNhits[p] << " hits, not calibrated"
+	   << endl;
+  }
+}
+
+ClassImp(THcHodoTimeCalib)
+////////////////////////////////////////////////////////////////////////////////
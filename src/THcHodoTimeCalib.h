@@ -0,0 +1,86 @@
+#ifndef ROOT_THcHodoTimeCalib
+#define ROOT_THcHodoTimeCalib
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcHodoTimeCalib                                                          //
+//                                                                           //
+// Hodoscope timing calibration accumulated event by event during a replay.  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class THcHodoTimeCalib : public TObject {
+
+public:
+  THcHodoTimeCalib();
+  virtual ~THcHodoTimeCalib();
+
+  // Set up for npaddles paddle indices (nplanes*paddle+plane), each with
+  // a positive (side 0) and a negative (side 1) PMT
+  void     Init( UInt_t npaddles );
+
+  // Add the hits of one track: per PMT hit the paddle index and side,
+  // the pulse height term sqrt(max(0,adc/minph-1)), the light path to
+  // the PMT and the TDC time less the flight time from the focal plane.
+  void     AddHit( UInt_t paddle, UInt_t side, Double_t phterm,
+		   Double_t path, Double_t time );
+  // Add the hits since the last EndEvent/ClearEvent to the sums
+  void     EndEvent();
+  void     ClearEvent() { fHits.clear(); }
+
+  // Solve for new constants, starting from the current ones, which are
+  // kept for PMTs and paddles with too few hits.  Arrays of npaddles.
+  Int_t    Solve( const Double_t* posoffset, const Double_t* negoffset,
+		  const Double_t* posphc, const Double_t* negphc,
+		  const Double_t* vel );
+  // Write the constants in the format of the hodo.param file
+  Int_t    WriteParam( const char* filename, const char* prefix,
+		       UInt_t nplanes, Int_t run ) const;
+
+  Double_t GetTimeOffset( UInt_t paddle, UInt_t side ) const
+    { return fOffset[side*fNpaddles+paddle]; }
+  Double_t GetPhcCoeff( UInt_t paddle, UInt_t side ) const
+    { return fPhc[side*fNpaddles+paddle]; }
+  Double_t GetVelLight( UInt_t paddle ) const { return fVel[paddle]; }
+  Double_t GetRMS() const { return fRMS; }
+  UInt_t   GetNEvents() const { return fNev; }
+  void     SetMinHits( UInt_t n ) { fMinHits = n; }
+
+  virtual void Clear( Option_t* opt="" );
+  virtual void Print( Option_t* opt="" ) const;
+
+protected:
+  struct Hit {
+    UInt_t   pmt;
+    UInt_t   paddle;
+    Double_t phterm;
+    Double_t path;
+    Double_t time;
+  };
+
+  UInt_t   fNpaddles;
+  UInt_t   fNpar;             // 2 offsets, 2 phc and 1/v per paddle
+  UInt_t   fMinHits;          // Hits needed to fit a PMT
+  std::vector<Hit>      fHits;      // Hits of the current event
+  std::vector<Double_t> fA;         // Packed normal matrix [fNpar]
+  std::vector<Double_t> fB;         // Right hand side [fNpar]
+  std::vector<UInt_t>   fNhits;     // [2*fNpaddles] hits per PMT
+  Double_t fSumYY;            // For the residual RMS
+  UInt_t   fNev;
+  ULong64_t fNmeas;
+  std::vector<Double_t> fOffset;    // Results
+  std::vector<Double_t> fPhc;
+  std::vector<Double_t> fVel;
+  Double_t fRMS;
+
+  UInt_t   Index( UInt_t i, UInt_t j ) const {
+    return i*fNpar - i*(i+1)/2 + j;
+  }
+
+  ClassDef(THcHodoTimeCalib,0)   // Hodoscope timing calibration sums
+};
+
+#endif
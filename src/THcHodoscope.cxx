@@ -26,6 +26,7 @@
 #include "THaSubDetector.h"
 
 #include "THcHodoscope.h"
+#include "THcProfiler.h"
 #include "THaEvData.h"
 #include "THaDetMap.h"
 #include "THcDetectorMap.h"
@@ -40,6 +41,7 @@
 #include "TMath.h"
 
 #include "THaTrackProj.h"
+#include "THaRunBase.h"
 #include <vector>
 
 #include <cstring>
@@ -63,6 +65,16 @@ THcHodoscope::THcHodoscope( const char* name, const char* description,
   fNPlanes = 0;			// No planes until we make them
   fStartTime=-1e5;
   fGoodStartTime=kFALSE;
+
+  fHitListsBlock = AddComputeBlock("hitlists",
+	   "*.postdchits *.negtdchits *.posadchits *.negadchits");
+  // The dE/dx of the hits on the tracks is no global variable, so demand
+  // driven replay always switches it off
+  fdEdXBlock = AddComputeBlock("dedx","");
+
+  fTimeCalibOn = 0;
+  fTimeCalib = 0;
+  fTimeCalibSolved = kFALSE;
 }
 
 //_____________________________________________________________________________
@@ -70,6 +82,10 @@ THcHodoscope::THcHodoscope( ) :
   THaNonTrackingDetector()
 {
   // Constructor
+
+  fTimeCalibOn = 0;
+  fTimeCalib = 0;
+  fTimeCalibSolved = kFALSE;
 }
 
 //_____________________________________________________________________________
@@ -434,6 +450,7 @@ Int_t THcHodoscope::ReadDatabase( const TDatime& date )
   fyHiScin = new Int_t [fNHodoscopes]; 
 
   prefix[1]='\0';
+  Int_t tofcal = 0;
   DBRequest list[]={
     {"start_time_center",     &fStartTimeCenter,                      kDouble},
     {"start_time_slop",       &fStartTimeSlop,                        kDouble},
@@ -459,11 +476,15 @@ Int_t THcHodoscope::ReadDatabase( const TDatime& date )
     {"yloscin",               &fyLoScin[0],            kInt,     (UInt_t) fNHodoscopes},
     {"yhiscin",               &fyHiScin[0],            kInt,     (UInt_t) fNHodoscopes},
     {"track_eff_test_num_scin_planes",   &fTrackEffTestNScinPlanes,      kInt},
+    {"hodo_tofcal",           &tofcal,                 kInt,            0,  1},
+    {"hodo_tofcal_minhits",   &fTimeCalibMinHits,      kInt,            0,  1},
     {0}
   };
   fTofUsingInvAdc = 0;		// Default if not defined
   fTofTolerance = 3.0;		// Default if not defined
+  fTimeCalibMinHits = 100;
   gHcParms->LoadParmValues((DBRequest*)&list,prefix);
+  if (tofcal) fTimeCalibOn = 1;
 
   cout << " x1 lo = " << fxLoScin[0] 
        << " x2 lo = " << fxLoScin[1] 
@@ -548,6 +569,7 @@ Int_t THcHodoscope::DefineVariables( EMode mode )
     {"goodscinhitx",   "Hit in fid x range",                       "fGoodScinHitsX"},
     {"totscinshould",  "Total scin Hits in fid area",              "fScinShould"},
     {"totscindid",     "Total scin Hits in fid area with a track", "fScinDid"},
+    {"nrawhits",       "Number of raw hits after decode",          "fNRawHits"},
     { 0 }
   };
   return DefineVarsFromList( vars, mode );
@@ -571,6 +593,7 @@ THcHodoscope::~THcHodoscope()
     fTrackProj->Clear();
     delete fTrackProj; fTrackProj = 0;
   }
+  delete fTimeCalib; fTimeCalib = 0;
 }
 
 //_____________________________________________________________________________
@@ -668,6 +691,8 @@ void THcHodoscope::ClearEvent()
 //_____________________________________________________________________________
 Int_t THcHodoscope::Decode( const THaEvData& evdata )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kDecode);
+
   ClearEvent();
   // Get the Hall C style hitlist (fRawHitList) for this event
   Int_t nhits = DecodeToHitList(evdata);
@@ -679,7 +704,7 @@ Int_t THcHodoscope::Decode( const THaEvData& evdata )
   fCheckEvent = evdata.GetEvNum();
   fEventType =  evdata.GetEvType();
 
-  if(gHaCuts->Result("Pedestal_event")) {
+  if(IsPedestalEvent()) {
     Int_t nexthit = 0;
     for(Int_t ip=0;ip<fNPlanes;ip++) {
             
@@ -709,6 +734,7 @@ Int_t THcHodoscope::Decode( const THaEvData& evdata )
     //    nexthit = fPlanes[ip]->ProcessHits(fRawHitList, nexthit);
     // GN: select only events that have reasonable TDC values to start with
     // as per the Engine h_strip_scin.f
+    fPlanes[ip]->SetFillHitLists(IsComputed(fHitListsBlock));
     nexthit = fPlanes[ip]->ProcessHits(fRawHitList,nexthit);
     if (fPlanes[ip]->GetNScinHits()>0) {
       fPlanes[ip]->PulseHeightCorrection();
@@ -759,6 +785,7 @@ Double_t THcHodoscope::TimeWalkCorrection(const Int_t& paddle,
 //_____________________________________________________________________________
 Int_t THcHodoscope::CoarseProcess( TClonesArray&  tracks  )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseProcess);
 
   ApplyCorrections();
  
@@ -768,6 +795,7 @@ Int_t THcHodoscope::CoarseProcess( TClonesArray&  tracks  )
 //_____________________________________________________________________________
 Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kFineProcess);
 
   Int_t fNtracks = tracks.GetLast()+1; // Number of reconstructed tracks
   Int_t fJMax, fMaxHit;
@@ -779,6 +807,10 @@ Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
   Double_t hpartmass=0.00051099; // Fix it
   fGoodScinHits = 0;
 
+  // Timing calibration: only single track events are used
+  THcHodoTimeCalib* timecalib = ( fNtracks == 1 ) ? fTimeCalib : 0;
+  if (timecalib) timecalib->ClearEvent();
+
   if (tracks.GetLast()+1 > 0 ) {
 
     // **MAIN LOOP: Loop over all tracks and get corrected time, tof, beta...
@@ -797,8 +829,11 @@ Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
 	fNPlaneTime[ip] = 0;
 	fSumPlaneTime[ip] = 0.;
       }
-      std::vector<Double_t> dedx_temp;
-      fdEdX.push_back(dedx_temp); // Create array of dedx per hit
+      Bool_t dodedx = IsComputed(fdEdXBlock);
+      if (dodedx) {
+	std::vector<Double_t> dedx_temp;
+	fdEdX.push_back(dedx_temp); // Create array of dedx per hit
+      }
       
       //      Int_t fNfpTime = 0;
       Double_t betaChiSq = -3;
@@ -1024,6 +1059,15 @@ Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
 	      fTime = fTime - ( fPath / fHodoVelLight[fPIndex] );
 	      fTOFPInfo[iphit].time = fTime;
 	      fTOFPInfo[iphit].scin_pos_time = fTime - fHodoPosTimeOffset[fPIndex];
+
+	      if ( timecalib )
+		timecalib->AddHit( fPIndex, 0,
+		  TMath::Sqrt( TMath::Max( 0., ( fADCph / fHodoPosMinPh[fPIndex] ) - 1 ) ),
+		  fPath, ((THcSignalHit*)scinPosTDC->At(iphit))->GetData() * fScinTdcToTime -
+		  ( fPlanes[ip]->GetZpos() + ( paddle % 2 ) * fPlanes[ip]->GetDzpos() ) /
+		  ( 29.979 * betaP ) *
+		  TMath::Sqrt( 1. + theTrack->GetTheta() * theTrack->GetTheta() +
+			       theTrack->GetPhi() * theTrack->GetPhi() ) );
 	      
 	    } // check for good pos TDC condition
 	    
@@ -1049,6 +1093,15 @@ Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
 	      fTime = fTime - ( fPath / fHodoVelLight[fPIndex] );
 	      fTOFPInfo[iphit].time = fTime;
 	      fTOFPInfo[iphit].scin_neg_time = fTime - fHodoNegTimeOffset[fPIndex];
+
+	      if ( timecalib )
+		timecalib->AddHit( fPIndex, 1,
+		  TMath::Sqrt( TMath::Max( 0., ( fADCph / fHodoNegMinPh[fPIndex] ) - 1 ) ),
+		  fPath, ((THcSignalHit*)scinNegTDC->At(iphit))->GetData() * fScinTdcToTime -
+		  ( fPlanes[ip]->GetZpos() + ( paddle % 2 ) * fPlanes[ip]->GetDzpos() ) /
+		  ( 29.979 * betaP ) *
+		  TMath::Sqrt( 1. + theTrack->GetTheta() * theTrack->GetTheta() +
+			       theTrack->GetPhi() * theTrack->GetPhi() ) );
       
 	    } // check for good neg TDC condition
 	    
@@ -1100,27 +1153,28 @@ Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
 	      	fNPmtHit[itrack] = fNPmtHit[itrack] + 1;
 	      }
 
-	      fdEdX[itrack].push_back(0.0);
-	      
 	      // --------------------------------------------------------------------------------------------
-	      if ( fTOFCalc[ihhit].good_tdc_pos ){
-		if ( fTOFCalc[ihhit].good_tdc_neg ){
-		  fdEdX[itrack][fNScinHit[itrack]-1]=
-		    TMath::Sqrt( TMath::Max( 0., ((THcSignalHit*)scinPosADC->At(iphit))->GetData() *
-                                                 ((THcSignalHit*)scinNegADC->At(iphit))->GetData() ) );
-		}
-		else{
-		  fdEdX[itrack][fNScinHit[itrack]-1]=
-		    TMath::Max( 0., ((THcSignalHit*)scinPosADC->At(iphit))->GetData() );
-	       	}
-	      }
-	      else{
-		if ( fTOFCalc[ihhit].good_tdc_neg ){
-		  fdEdX[itrack][fNScinHit[itrack]-1]=
-		    TMath::Max( 0., ((THcSignalHit*)scinNegADC->At(iphit))->GetData() );
+	      if ( dodedx ){
+		fdEdX[itrack].push_back(0.0);
+		if ( fTOFCalc[ihhit].good_tdc_pos ){
+		  if ( fTOFCalc[ihhit].good_tdc_neg ){
+		    fdEdX[itrack][fNScinHit[itrack]-1]=
+		      TMath::Sqrt( TMath::Max( 0., ((THcSignalHit*)scinPosADC->At(iphit))->GetData() *
+						   ((THcSignalHit*)scinNegADC->At(iphit))->GetData() ) );
+		  }
+		  else{
+		    fdEdX[itrack][fNScinHit[itrack]-1]=
+		      TMath::Max( 0., ((THcSignalHit*)scinPosADC->At(iphit))->GetData() );
+		  }
 		}
 		else{
-		  fdEdX[itrack][fNScinHit[itrack]-1]=0.0;
+		  if ( fTOFCalc[ihhit].good_tdc_neg ){
+		    fdEdX[itrack][fNScinHit[itrack]-1]=
+		      TMath::Max( 0., ((THcSignalHit*)scinNegADC->At(iphit))->GetData() );
+		  }
+		  else{
+		    fdEdX[itrack][fNScinHit[itrack]-1]=0.0;
+		  }
 		}
 	      }
 	      // --------------------------------------------------------------------------------------------
@@ -1154,6 +1208,16 @@ Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
       //------------------------------------------------------------------------------
       //------------------------------------------------------------------------------
 
+      // Timing calibration sums, if there are times in the front and in
+      // the back hodoscope
+      if ( timecalib ) {
+	if ( ( fGoodPlaneTime[0] || fGoodPlaneTime[1] ) &&
+	     ( fGoodPlaneTime[2] || fGoodPlaneTime[3] ) )
+	  timecalib->EndEvent();
+	else
+	  timecalib->ClearEvent();
+      }
+
       // * * Fit beta if there are enough time measurements (one upper, one lower)
       // From h_tof_fit
       if ( ( ( fGoodPlaneTime[0] ) || ( fGoodPlaneTime[1] ) ) && 
@@ -1550,6 +1614,50 @@ Int_t THcHodoscope::FineProcess( TClonesArray& tracks )
   return 0;
   
 }
+//_____________________________________________________________________________
+Int_t THcHodoscope::Begin( THaRunBase* )
+{
+  // Set up the timing calibration sums
+
+  delete fTimeCalib; fTimeCalib = 0;
+  fTimeCalibSolved = kFALSE;
+  if (!fTimeCalibOn) return 0;
+
+  fTimeCalib = new THcHodoTimeCalib;
+  fTimeCalib->Init(fMaxHodoScin);
+  fTimeCalib->SetMinHits(fTimeCalibMinHits);
+
+  return 0;
+}
+
+//_____________________________________________________________________________
+Int_t THcHodoscope::End( THaRunBase* run )
+{
+  // Solve for the timing constants and write them to
+  // <spectrometer>hodo_tofcal.param.<run>
+
+  if (!fTimeCalib) return 0;
+
+  char prefix = tolower(GetApparatus()->GetName()[0]);
+  Int_t runnum = run ? run->GetNumber() : 0;
+
+  if (fTimeCalib->Solve(fHodoPosTimeOffset, fHodoNegTimeOffset,
+			fHodoPosPhcCoeff, fHodoNegPhcCoeff,
+			fHodoVelLight) < 0) {
+    cout << "THcHodoscope::End: no timing calibration for " << GetName()
+	 << ", " << fTimeCalib->GetNEvents() << " tracks" << endl;
+    return 0;
+  }
+  fTimeCalibSolved = kTRUE;
+  fTimeCalib->Print();
+
+  TString fname = Form("%chodo_tofcal.param.%d",prefix,runnum);
+  fTimeCalib->WriteParam(fname, Form("%c",prefix), fNPlanes, runnum);
+  cout << "THcHodoscope::End: timing constants written to " << fname << endl;
+
+  return 0;
+}
+
 //_____________________________________________________________________________
 Int_t THcHodoscope::GetScinIndex( Int_t nPlane, Int_t nPaddle ) {
   // GN: Return the index of a scintillator given the plane # and the paddle #
@@ -1566,5 +1674,25 @@ Int_t THcHodoscope::GetScinIndex( Int_t nSide, Int_t nPlane, Int_t nPaddle ) {
 Double_t THcHodoscope::GetPathLengthCentral() {
   return fPathLengthCentral;
 }
+//_____________________________________________________________________________
+Int_t THcHodoscope::ApplyTimeCalib()
+{
+  // Replace the timing constants by the ones solved for at the end of
+  // the last run, so that a following pass over the data (see
+  // THcCalibDriver) uses them.  The planes read the constants from here
+  // for every hit.  Returns -1 if there are no solved constants.
+
+  if (!fTimeCalib || !fTimeCalibSolved) return -1;
+
+  for (UInt_t i=0; i<fMaxHodoScin; i++) {
+    fHodoPosTimeOffset[i] = fTimeCalib->GetTimeOffset(i,0);
+    fHodoNegTimeOffset[i] = fTimeCalib->GetTimeOffset(i,1);
+    fHodoPosPhcCoeff[i] = fTimeCalib->GetPhcCoeff(i,0);
+    fHodoNegPhcCoeff[i] = fTimeCalib->GetPhcCoeff(i,1);
+    fHodoVelLight[i] = fTimeCalib->GetVelLight(i);
+  }
+  return 0;
+}
+
 ClassImp(THcHodoscope)
 ////////////////////////////////////////////////////////////////////////////////
@@ -16,6 +16,7 @@
 #include "THcScintillatorPlane.h"
 #include "THcShower.h"
 #include "THcCherenkov.h"
+#include "THcHodoTimeCalib.h"
 
 #include "THaTrackingDetector.h"
 #include "THcHitList.h"
@@ -72,6 +73,8 @@ public:
   Int_t GetGoodRawPad(Int_t iii){return fTOFCalc[iii].good_raw_pad;}
   Double_t GetNScinHits(Int_t iii){return fNScinHits[iii];}
 
+  Int_t GetNPlanes() const { return fNPlanes;}
+  THcScintillatorPlane* GetPlane(Int_t iii) const { return fPlanes[iii];}
   UInt_t GetNPaddles(Int_t iii) { return fNPaddle[iii];}
   Double_t GetPlaneCenter(Int_t iii) { return fPlaneCenter[iii];}
   Double_t GetPlaneSpacing(Int_t iii) { return fPlaneSpacing[iii];}
@@ -88,6 +91,18 @@ public:
 
   const TClonesArray* GetTrackHits() const { return fTrackProj; }
 
+  // Accumulate the timing calibration (time offsets, pulse height
+  // coefficients, light velocities) from the hits of single track events
+  // during the replay, and write the constants to hhodo_tofcal.param.<run>
+  // at the end.
+  void SetTimeCalib(Bool_t enable=kTRUE) { fTimeCalibOn = enable ? 1 : 0; }
+  THcHodoTimeCalib* GetTimeCalib() const { return fTimeCalib; }
+  // Use the constants solved for at the end of the last run
+  Int_t ApplyTimeCalib();
+
+  virtual Int_t Begin( THaRunBase* run=0 );
+  virtual Int_t End( THaRunBase* run=0 );
+
   friend class THaScCalib;
 
   THcHodoscope();  // for ROOT I/O
@@ -107,6 +122,8 @@ protected:
 
   // Potential Hall C parameters.  Mostly here for demonstration
   Int_t fNPlanes;		// Number of planes
+  Int_t fHitListsBlock;         // Compute block of the planes' raw hit lists
+  Int_t fdEdXBlock;             // Compute block of fdEdX, no variables
   UInt_t fMaxScinPerPlane,fMaxHodoScin; // max number of scin/plane; product of the first two 
   Double_t fStartTimeCenter, fStartTimeSlop, fScinTdcToTime;
   Double_t fTofTolerance;
@@ -137,6 +154,11 @@ protected:
 
   THcScintillatorPlane** fPlanes; // List of plane objects
 
+  Int_t fTimeCalibOn;           // Timing calibration flag
+  Int_t fTimeCalibMinHits;      // Hits needed to calibrate a PMT
+  THcHodoTimeCalib* fTimeCalib;
+  Bool_t fTimeCalibSolved;      // fTimeCalib holds solved constants
+
   TClonesArray*  fTrackProj;  // projection of track onto scintillator plane
                               // and estimated match to TOF paddle
 
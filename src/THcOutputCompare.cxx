@@ -0,0 +1,388 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcOutputCompare                                                          //
+//                                                                           //
+// Regression check of the physics output: compares the output trees of a    //
+// reference and a candidate replay of the same events, variable by          //
+// variable and entry by entry.                                              //
+//                                                                           //
+// The variables are those of an output definition file (LoadOdef), i.e.     //
+// the names of its variable, formula and cut lines and the wildcard         //
+// patterns of its block lines, matched against the branches of the         //
+// reference tree.  Arrays are compared element by element, and a            //
+// different number of elements is a divergence.                             //
+//                                                                           //
+// Two values a and b agree if                                               //
+//   |a-b| <= abstol + reltol*max(|a|,|b|)                                   //
+// with the tolerances of the first matching pattern given with              //
+// LoadTolerances or SetTolerance, default 0 (exact).  Lines of a            //
+// tolerance file are                                                        //
+//   pattern   abstol   reltol                                               //
+// NaN agrees with NaN only.                                                 //
+//                                                                           //
+// The first divergent values are printed as they are found, with the        //
+// entry and event number.  Print() gives the number of divergent entries    //
+// per variable.  A variable missing from the candidate tree, or entries     //
+// present in only one tree, make every such entry divergent.  If both       //
+// trees have the event header, the event numbers must agree, else the       //
+// comparison stops.                                                         //
+//                                                                           //
+// Only the compared branches are read, so that the comparison is fast       //
+// enough to run after every change.  See examples/regress.sh.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcOutputCompare.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TLeaf.h"
+#include "TObjArray.h"
+#include "TRegexp.h"
+#include "TStopwatch.h"
+#include "TMath.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cctype>
+#include <iostream>
+
+using namespace std;
+
+ClassImp(THcOutputCompare)
+
+//______________________________________________________________________________
+THcOutputCompare::THcOutputCompare() :
+  fMaxReport(20), fNReported(0), fNEntries(0), fNDivergent(0), fRealTime(0)
+{
+  // Constructor
+}
+
+//______________________________________________________________________________
+THcOutputCompare::~THcOutputCompare()
+{
+  // Destructor
+}
+
+//______________________________________________________________________________
+Int_t THcOutputCompare::LoadOdef( const char* odeffile )
+{
+  // Compare the variables written by the output definition file odeffile.
+  // Returns the number of names and patterns found, -1 if the file
+  // cannot be read.
+
+  ifstream ifile(odeffile);
+  if( !ifile ) {
+    Error("LoadOdef", "Cannot open %s", odeffile);
+    return -1;
+  }
+
+  Int_t nfound = 0;
+  Bool_t inepics = kFALSE;
+  string line;
+  while( getline(ifile,line) ) {
+    string::size_type pos = line.find('#');
+    if( pos != string::npos ) line.erase(pos);
+    istringstream is(line);
+    string key, name;
+    if( !(is >> key) ) continue;
+    for( UInt_t i=0; i<key.size(); i++ ) key[i] = tolower(key[i]);
+    is >> name;
+    // EPICS variables are not in the event tree
+    if( key == "begin" ) { inepics = kTRUE; continue; }
+    if( key == "end" ) { inepics = kFALSE; continue; }
+    if( inepics || name.empty() ) continue;
+    if( key == "variable" || key == "block" || key == "formula" ||
+	key == "cut" ) {
+      AddVariable(name.c_str());
+      nfound++;
+    }
+  }
+  return nfound;
+}
+
+//______________________________________________________________________________
+void THcOutputCompare::AddVariable( const char* pattern )
+{
+  // Compare the variables matching the wildcard pattern
+
+  fPatterns.push_back(pattern);
+}
+
+//______________________________________________________________________________
+Int_t THcOutputCompare::LoadTolerances( const char* tolfile )
+{
+  // Read "pattern abstol reltol" lines.  Returns the number of
+  // tolerances read, -1 if the file cannot be read.
+
+  ifstream ifile(tolfile);
+  if( !ifile ) {
+    Error("LoadTolerances", "Cannot open %s", tolfile);
+    return -1;
+  }
+
+  Int_t nfound = 0;
+  string line;
+  while( getline(ifile,line) ) {
+    string::size_type pos = line.find('#');
+    if( pos != string::npos ) line.erase(pos);
+    istringstream is(line);
+    string pattern;
+    Double_t abstol, reltol;
+    if( !(is >> pattern) ) continue;
+    if( !(is >> abstol >> reltol) ) {
+      Warning("LoadTolerances", "Bad line in %s: %s", tolfile, line.c_str());
+      continue;
+    }
+    SetTolerance(pattern.c_str(), abstol, reltol);
+    nfound++;
+  }
+  return nfound;
+}
+
+//______________________________________________________________________________
+void THcOutputCompare::SetTolerance( const char* pattern, Double_t abstol,
+				     Double_t reltol )
+{
+  Tolerance tol;
+  tol.pattern = pattern;
+  tol.abstol = abstol;
+  tol.reltol = reltol;
+  fTolerances.push_back(tol);
+}
+
+//______________________________________________________________________________
+Bool_t THcOutputCompare::Match( const char* name, const char* pattern )
+{
+  // True if all of name matches the wildcard pattern
+
+  TString s(name);
+  TRegexp re(pattern, kTRUE);
+  Ssiz_t len = 0;
+  return s.Index(re, &len) == 0 && len == s.Length();
+}
+
+//______________________________________________________________________________
+Bool_t THcOutputCompare::IsSelected( const char* name ) const
+{
+  if( fPatterns.empty() ) return kTRUE;
+  for( UInt_t i=0; i<fPatterns.size(); i++ ) {
+    if( Match(name, fPatterns[i].Data()) ) return kTRUE;
+  }
+  return kFALSE;
+}
+
+//______________________________________________________________________________
+TLeaf* THcOutputCompare::GetLeaf( TTree* tree, const char* name )
+{
+  // The leaf of the output variable name, whose branch has the same name
+
+  TBranch* branch = tree->GetBranch(name);
+  if( !branch ) return 0;
+  return static_cast<TLeaf*>(branch->GetListOfLeaves()->At(0));
+}
+
+//______________________________________________________________________________
+void THcOutputCompare::SetupVariables( TTree* ref, TTree* cand )
+{
+  // Find the compared variables in both trees, and read only those
+
+  fVars.clear();
+  fMissing.clear();
+  ref->SetBranchStatus("*", kFALSE);
+  cand->SetBranchStatus("*", kFALSE);
+
+  TObjArray* branches = ref->GetListOfBranches();
+  for( Int_t ib=0; ib<branches->GetEntriesFast(); ib++ ) {
+    TString name = branches->UncheckedAt(ib)->GetName();
+    // Array sizes are compared with the arrays
+    if( name.BeginsWith("Ndata.") || !IsSelected(name.Data()) )
+      continue;
+    CompVar var;
+    var.name = name;
+    var.ref = GetLeaf(ref, name.Data());
+    var.cand = GetLeaf(cand, name.Data());
+    if( !var.ref ) continue;
+    if( !var.cand ) {
+      fMissing.push_back(name);
+      continue;
+    }
+    var.abstol = 0;
+    var.reltol = 0;
+    for( UInt_t it=0; it<fTolerances.size(); it++ ) {
+      if( Match(name.Data(), fTolerances[it].pattern.Data()) ) {
+	var.abstol = fTolerances[it].abstol;
+	var.reltol = fTolerances[it].reltol;
+	break;
+      }
+    }
+    var.ndiff = 0;
+    var.first = -1;
+    var.maxdiff = 0;
+    fVars.push_back(var);
+
+    TString ndata = "Ndata." + name;
+    ref->SetBranchStatus(name.Data(), kTRUE);
+    cand->SetBranchStatus(name.Data(), kTRUE);
+    if( ref->GetBranch(ndata.Data()) )
+      ref->SetBranchStatus(ndata.Data(), kTRUE);
+    if( cand->GetBranch(ndata.Data()) )
+      cand->SetBranchStatus(ndata.Data(), kTRUE);
+  }
+}
+
+//______________________________________________________________________________
+Bool_t THcOutputCompare::CompareVariable( CompVar& var, Long64_t entry,
+					  Int_t evnum )
+{
+  // Compare the current entry of one variable. Reports the first
+  // divergences.
+
+  Int_t nref = var.ref->GetLen();
+  Int_t ncand = var.cand->GetLen();
+  Bool_t same = (nref == ncand);
+  if( !same && fNReported < fMaxReport ) {
+    printf("Entry %8lld event %8d  %-32s  size ref %d cand %d\n",
+	   entry, evnum, var.name.Data(), nref, ncand);
+    fNReported++;
+  }
+
+  Int_t n = TMath::Min(nref, ncand);
+  for( Int_t i=0; i<n; i++ ) {
+    Double_t a = var.ref->GetValue(i);
+    Double_t b = var.cand->GetValue(i);
+    if( a == b || (TMath::IsNaN(a) && TMath::IsNaN(b)) )
+      continue;
+    Double_t diff = TMath::Abs(a-b);
+    if( diff <= var.abstol + var.reltol*TMath::Max(TMath::Abs(a),TMath::Abs(b)) )
+      continue;
+    same = kFALSE;
+    if( TMath::IsNaN(diff) || diff > var.maxdiff ) var.maxdiff = diff;
+    if( fNReported < fMaxReport ) {
+      printf("Entry %8lld event %8d  %-32s [%3d]  ref %-14.8g cand %-14.8g\n",
+	     entry, evnum, var.name.Data(), i, a, b);
+      fNReported++;
+    }
+  }
+  if( !same ) {
+    if( var.ndiff == 0 ) var.first = entry;
+    var.ndiff++;
+  }
+  return same;
+}
+
+//______________________________________________________________________________
+Long64_t THcOutputCompare::Compare( const char* reffile, const char* candfile,
+				    Long64_t nentries, const char* treename )
+{
+  // Compare the trees treename of reffile (reference) and candfile.
+
+  static const char* const here = "Compare";
+
+  TStopwatch timer;
+  fNEntries = fNDivergent = 0;
+  fNReported = 0;
+  fRealTime = 0;
+
+  TFile* fref = TFile::Open(reffile);
+  TFile* fcand = TFile::Open(candfile);
+  if( !fref || fref->IsZombie() || !fcand || fcand->IsZombie() ) {
+    Error(here, "Cannot open %s or %s", reffile, candfile);
+    delete fref;
+    delete fcand;
+    return -1;
+  }
+  TTree* tref = dynamic_cast<TTree*>(fref->Get(treename));
+  TTree* tcand = dynamic_cast<TTree*>(fcand->Get(treename));
+  if( !tref || !tcand ) {
+    Error(here, "No tree %s in %s or %s", treename, reffile, candfile);
+    delete fref;
+    delete fcand;
+    return -1;
+  }
+
+  SetupVariables(tref, tcand);
+  for( UInt_t i=0; i<fMissing.size(); i++ ) {
+    printf("Variable %s missing in %s\n", fMissing[i].Data(), candfile);
+  }
+
+  // Event numbers, to check that the same events are compared
+  TLeaf* evref = tref->GetLeaf("fEvtHdr.fEvtNum");
+  TLeaf* evcand = tcand->GetLeaf("fEvtHdr.fEvtNum");
+  if( evref && evcand ) {
+    tref->SetBranchStatus("fEvtHdr.fEvtNum", kTRUE);
+    tcand->SetBranchStatus("fEvtHdr.fEvtNum", kTRUE);
+  } else {
+    evref = evcand = 0;
+  }
+
+  Long64_t nref = tref->GetEntries();
+  Long64_t ncand = tcand->GetEntries();
+  if( nref != ncand ) {
+    printf("%lld entries in %s, %lld in %s\n", nref, reffile, ncand, candfile);
+  }
+  Long64_t n = TMath::Min(nref, ncand);
+  if( nentries >= 0 && nentries < n ) {
+    n = nentries;
+  } else {
+    // Entries in only one of the trees
+    fNDivergent = nref > ncand ? nref - ncand : ncand - nref;
+  }
+
+  for( Long64_t entry=0; entry<n; entry++ ) {
+    tref->GetEntry(entry);
+    tcand->GetEntry(entry);
+    Int_t evnum = evref ? (Int_t)evref->GetValue() : (Int_t)entry;
+    if( evcand && (Int_t)evcand->GetValue() != evnum ) {
+      Error(here, "Entry %lld is event %d in %s, %d in %s", entry, evnum,
+	    reffile, (Int_t)evcand->GetValue(), candfile);
+      fNDivergent += n - entry;
+      break;
+    }
+    Bool_t same = fMissing.empty();
+    for( UInt_t iv=0; iv<fVars.size(); iv++ ) {
+      if( !CompareVariable(fVars[iv], entry, evnum) ) same = kFALSE;
+    }
+    if( !same ) fNDivergent++;
+    fNEntries++;
+  }
+
+  for( UInt_t iv=0; iv<fVars.size(); iv++ ) {
+    fVars[iv].ref = fVars[iv].cand = 0;
+  }
+  delete fref;
+  delete fcand;
+
+  timer.Stop();
+  fRealTime = timer.RealTime();
+  return fNDivergent;
+}
+
+//______________________________________________________________________________
+void THcOutputCompare::Print( Option_t* ) const
+{
+  // Divergences per variable, and the speed of the comparison
+
+  Int_t nbad = 0;
+  for( UInt_t iv=0; iv<fVars.size(); iv++ ) {
+    if( fVars[iv].ndiff > 0 ) nbad++;
+  }
+  cout << endl << "Compared " << fVars.size() << " variables in "
+       << fNEntries << " entries: " << fNDivergent << " divergent entries, "
+       << nbad << " divergent variables, " << fMissing.size()
+       << " missing variables" << endl;
+  if( nbad > 0 ) {
+    printf("%-32s %10s %10s %14s\n", "Variable", "Entries", "First", "Max |diff|");
+    for( UInt_t iv=0; iv<fVars.size(); iv++ ) {
+      const CompVar& var = fVars[iv];
+      if( var.ndiff == 0 ) continue;
+      printf("%-32s %10lld %10lld %14.6g\n", var.name.Data(), var.ndiff,
+	     var.first, var.maxdiff);
+    }
+  }
+  if( fRealTime > 0 ) {
+    printf("%.2f s, %.0f entries/s\n", fRealTime, fNEntries/fRealTime);
+  }
+}
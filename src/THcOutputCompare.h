@@ -0,0 +1,85 @@
+#ifndef ROOT_THcOutputCompare
+#define ROOT_THcOutputCompare
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcOutputCompare                                                          //
+//                                                                           //
+// Event by event comparison of the output trees of two replays.             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include "TString.h"
+#include <vector>
+
+class TTree;
+class TLeaf;
+
+class THcOutputCompare : public TObject {
+
+public:
+  THcOutputCompare();
+  virtual ~THcOutputCompare();
+
+  // Variables to compare: the variable, block, formula and cut names
+  // of an output definition file, or a wildcard pattern
+  Int_t  LoadOdef( const char* odeffile );
+  void   AddVariable( const char* pattern );
+
+  // Tolerances per variable.  The first matching pattern applies,
+  // variables matching none must be equal.
+  Int_t  LoadTolerances( const char* tolfile );
+  void   SetTolerance( const char* pattern, Double_t abstol, Double_t reltol );
+
+  // Number of divergent values printed
+  void   SetMaxReport( Int_t n ) { fMaxReport = n; }
+
+  // Compare the first nentries (all if <0) entries of the trees.
+  // Returns the number of divergent entries, -1 on error.
+  Long64_t Compare( const char* reffile, const char* candfile,
+		    Long64_t nentries=-1, const char* treename="T" );
+
+  Long64_t GetNEntries() const { return fNEntries; }
+  Long64_t GetNDivergent() const { return fNDivergent; }
+  Double_t GetRealTime() const { return fRealTime; }
+
+  virtual void Print( Option_t* opt="" ) const;
+
+protected:
+  struct Tolerance {
+    TString  pattern;
+    Double_t abstol;
+    Double_t reltol;
+  };
+  struct CompVar {
+    TString  name;
+    TLeaf*   ref;
+    TLeaf*   cand;
+    Double_t abstol;
+    Double_t reltol;
+    Long64_t ndiff;          // Entries in which the variable differs
+    Long64_t first;          // First such entry
+    Double_t maxdiff;        // Largest absolute difference
+  };
+
+  std::vector<TString>   fPatterns;
+  std::vector<Tolerance> fTolerances;
+  std::vector<CompVar>   fVars;
+  std::vector<TString>   fMissing;     // Compared variables not in candidate
+  Int_t    fMaxReport;
+  Int_t    fNReported;
+  Long64_t fNEntries;
+  Long64_t fNDivergent;
+  Double_t fRealTime;
+
+  static Bool_t Match( const char* name, const char* pattern );
+  static TLeaf* GetLeaf( TTree* tree, const char* name );
+  Bool_t IsSelected( const char* name ) const;
+  void   SetupVariables( TTree* ref, TTree* cand );
+  Bool_t CompareVariable( CompVar& var, Long64_t entry, Int_t evnum );
+
+  ClassDef(THcOutputCompare,0)   // Output tree regression comparison
+};
+
+#endif
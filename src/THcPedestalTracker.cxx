@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcPedestalTracker                                                        //
+//                                                                           //
+// Accumulates pedestals for a set of ADC channels, following the ENGINE     //
+// rules: a sample is used if it is at or below the channel's pedestal       //
+// limit, and the limit is tightened to 100 channels above the mean once     //
+// minpeds/5 samples are collected.                                          //
+//                                                                           //
+// The detectors number their channels, e.g. 0..nelem-1 for the positive     //
+// and nelem..2*nelem-1 for the negative tubes, call Fill for each raw hit   //
+// of a pedestal event, EndEvent at the end of the event, and Calculate      //
+// before the next physics event.                                            //
+//                                                                           //
+// Mean and variance are updated per sample (Welford), so the width does     //
+// not suffer from the overflow of an integer sum of squares. With a         //
+// window set, the pedestal follows drifts during long runs.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcPedestalTracker.h"
+#include "TMath.h"
+
+ClassImp(THcPedestalTracker)
+
+//______________________________________________________________________________
+THcPedestalTracker::THcPedestalTracker(Int_t nchan) :
+  fNChannels(nchan), fMinPeds(0), fMaxEvents(0), fWindow(0), fNEvents(0)
+{
+  // Normal constructor
+
+  fLimit = new Int_t[fNChannels];
+  fCount = new Int_t[fNChannels];
+  fSum = new Long64_t[fNChannels];
+  fMean = new Double_t[fNChannels];
+  fVar = new Double_t[fNChannels];
+  fPed = new Double_t[fNChannels];
+  fSig = new Double_t[fNChannels];
+
+  Init(0, 1000);
+}
+
+//______________________________________________________________________________
+THcPedestalTracker::~THcPedestalTracker()
+{
+  // Destructor
+
+  delete [] fLimit;
+  delete [] fCount;
+  delete [] fSum;
+  delete [] fMean;
+  delete [] fVar;
+  delete [] fPed;
+  delete [] fSig;
+}
+
+//______________________________________________________________________________
+void THcPedestalTracker::Init(Int_t minpeds, Int_t limit)
+{
+  // Reset the accumulators, using the same pedestal limit for all channels.
+
+  fMinPeds = minpeds;
+  fNEvents = 0;
+  for(Int_t i=0;i<fNChannels;i++) {
+    fLimit[i] = limit;
+    fCount[i] = 0;
+    fSum[i] = 0;
+    fMean[i] = 0;
+    fVar[i] = 0;
+    fPed[i] = 0;
+    fSig[i] = 0;
+  }
+}
+
+//______________________________________________________________________________
+void THcPedestalTracker::Init(Int_t minpeds, const Int_t* limits)
+{
+  // Reset the accumulators, with pedestal limits per channel.
+
+  Init(minpeds, 0);
+  for(Int_t i=0;i<fNChannels;i++) {
+    fLimit[i] = limits[i];
+  }
+}
+
+//______________________________________________________________________________
+void THcPedestalTracker::Calculate()
+{
+  // Calculate pedestals and widths from the accumulated samples.
+  // Without a window, the pedestal is the exact average of the samples,
+  // as the detectors used to calculate it.
+
+  for(Int_t i=0;i<fNChannels;i++) {
+    if(fWindow > 0) {
+      fPed[i] = fMean[i];
+    } else {
+      fPed[i] = ((Double_t) fSum[i]) / TMath::Max(1, fCount[i]);
+    }
+    fSig[i] = TMath::Sqrt(fVar[i]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
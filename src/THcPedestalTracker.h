@@ -0,0 +1,76 @@
+#ifndef ROOT_THcPedestalTracker
+#define ROOT_THcPedestalTracker
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcPedestalTracker                                                        //
+//                                                                           //
+// Pedestal accumulator shared by the ADC based detectors.                   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+
+class THcPedestalTracker : public TObject {
+
+public:
+  THcPedestalTracker(Int_t nchan=0);
+  virtual ~THcPedestalTracker();
+
+  void Init(Int_t minpeds, Int_t limit);
+  void Init(Int_t minpeds, const Int_t* limits);
+
+  // Stop accumulating after nmax pedestal events (0 = no limit).
+  void SetMaxEvents(Int_t nmax) { fMaxEvents = nmax; }
+  // Follow drifts with a running average over about nwindow samples per
+  // channel instead of averaging over the whole run (0 = whole run).
+  void SetWindow(Int_t nwindow) { fWindow = nwindow; }
+
+  // Add an ADC sample for channel chan, if below the channel's limit.
+  void Fill(Int_t chan, Int_t adc) {
+    if(IsFull() || adc > fLimit[chan]) return;
+    Int_t n = ++fCount[chan];
+    fSum[chan] += adc;
+    if(n == fMinPeds/5) {
+      fLimit[chan] = 100 + (Int_t) (fSum[chan]/n);
+    }
+    // Welford update of mean and variance, or its exponentially
+    // weighted version once the window is full.
+    Double_t w = (fWindow > 0 && n > fWindow) ? fWindow : n;
+    Double_t delta = adc - fMean[chan];
+    fMean[chan] += delta/w;
+    fVar[chan] += (delta*(adc - fMean[chan]) - fVar[chan])/w;
+  }
+  void EndEvent() { fNEvents++; }
+  void Calculate();
+
+  Bool_t   IsFull() const { return fMaxEvents > 0 && fNEvents >= fMaxEvents; }
+  Int_t    GetNChannels() const { return fNChannels; }
+  Int_t    GetNEvents() const { return fNEvents; }
+  Int_t    GetMinPeds() const { return fMinPeds; }
+  Int_t    GetCount(Int_t chan) const { return fCount[chan]; }
+  Double_t GetPed(Int_t chan) const { return fPed[chan]; }
+  Double_t GetSig(Int_t chan) const { return fSig[chan]; }
+
+protected:
+
+  Int_t     fNChannels;
+  Int_t     fMinPeds;    // Pedestal limits are tightened after fMinPeds/5
+  Int_t     fMaxEvents;  // Number of pedestal events to analyze, 0 = all
+  Int_t     fWindow;     // Running average window, 0 = whole run
+  Int_t     fNEvents;    // Pedestal event counter
+
+  Int_t*    fLimit;      // [fNChannels] Analyze pedestal if ADC <= limit
+  Int_t*    fCount;      // [fNChannels] Number of samples
+  Long64_t* fSum;        // [fNChannels] Sum of samples
+  Double_t* fMean;       // [fNChannels] Running mean
+  Double_t* fVar;        // [fNChannels] Running variance
+  Double_t* fPed;        // [fNChannels] Pedestals from last Calculate()
+  Double_t* fSig;        // [fNChannels] Pedestal widths
+
+  ClassDef(THcPedestalTracker,0)   // Streaming pedestal accumulator
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcPrefilter                                                              //
+//                                                                           //
+// Skips the tracking and reconstruction of events that fail cheap tests on  //
+// quantities known right after decoding: the event type and the raw hit     //
+// counts (e.g. H.dc.nrawhits, H.hod.nrawhits, H.cal.nrawhits).              //
+//                                                                           //
+// The tests are the cuts of the block "Prefilter" of the cut file, e.g.     //
+//   Block: Prefilter                                                        //
+//   hdc_enough_hits   H.dc.nrawhits >= 6                                    //
+//   hdc_not_noisy     H.dc.nrawhits < 200                                   //
+// An event passes if all cuts of the block pass.  THcAnalyzer finds the     //
+// block at Init and gives the prefilter to the Hall C spectrometers.  They  //
+// evaluate it once per event, after all apparatuses are decoded, and skip   //
+// CoarseTrack, CoarseReconstruct, Track and Reconstruct if it fails.  The   //
+// event is still written out, with the cleared values of the skipped        //
+// stages.  To drop events completely use the Decode_master cut instead.     //
+//                                                                           //
+// The number of events skipped, and failing each cut, is printed at the     //
+// end of the run.                                                           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcPrefilter.h"
+#include "THaGlobals.h"
+#include "THaCutList.h"
+#include "THaCut.h"
+#include "THaNamedList.h"
+
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+ClassImp(THcPrefilter)
+
+//______________________________________________________________________________
+THcPrefilter::THcPrefilter( const char* block ) :
+  fBlock(block), fEvaluated(kFALSE), fPass(kTRUE), fNEvents(0), fNSkipped(0)
+{
+  // Constructor. block is the name of the cut block with the tests.
+}
+
+//______________________________________________________________________________
+THcPrefilter::~THcPrefilter()
+{
+  // Destructor
+}
+
+//______________________________________________________________________________
+Int_t THcPrefilter::Init()
+{
+  // Look up the cuts of the block.  Cuts are reloaded at every analyzer
+  // Init, so this is redone for each run.
+
+  fCuts.clear();
+  const TList* block = gHaCuts ? gHaCuts->FindBlock(fBlock.Data()) : 0;
+  if( block ) {
+    TIter next(block);
+    while( THaCut* cut = static_cast<THaCut*>( next() )) {
+      fCuts.push_back(cut);
+    }
+  }
+  Clear();
+  return fCuts.size();
+}
+
+//______________________________________________________________________________
+void THcPrefilter::Clear( Option_t* )
+{
+  // Reset the counters
+
+  fNFailed.assign(fCuts.size(), 0);
+  fNEvents = fNSkipped = 0;
+  fEvaluated = kFALSE;
+  fPass = kTRUE;
+}
+
+//______________________________________________________________________________
+void THcPrefilter::Evaluate()
+{
+  // Evaluate all cuts, so that their counters are complete
+
+  fPass = kTRUE;
+  for( UInt_t i=0; i<fCuts.size(); i++ ) {
+    if( !fCuts[i]->EvalCut() ) {
+      fNFailed[i]++;
+      fPass = kFALSE;
+    }
+  }
+  fNEvents++;
+  if( !fPass ) fNSkipped++;
+  fEvaluated = kTRUE;
+}
+
+//______________________________________________________________________________
+void THcPrefilter::Print( Option_t* ) const
+{
+  // Events skipped, and failing each cut
+
+  if( !IsActive() ) return;
+  cout << endl << "Prefilter: " << fNSkipped << " of " << fNEvents
+       << " events not reconstructed" << endl;
+  for( UInt_t i=0; i<fCuts.size(); i++ ) {
+    printf("  %-24s %10llu failed\n", fCuts[i]->GetName(),
+	   (unsigned long long)fNFailed[i]);
+  }
+}
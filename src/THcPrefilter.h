@@ -0,0 +1,56 @@
+#ifndef ROOT_THcPrefilter
+#define ROOT_THcPrefilter
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcPrefilter                                                              //
+//                                                                           //
+// Cuts on decoded quantities that decide whether an event is reconstructed. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include "TString.h"
+#include <vector>
+
+class THaCut;
+
+class THcPrefilter : public TObject {
+
+public:
+  THcPrefilter( const char* block="Prefilter" );
+  virtual ~THcPrefilter();
+
+  // Find the cuts of the block in gHaCuts. Returns their number.
+  Int_t  Init();
+  Bool_t IsActive() const { return !fCuts.empty(); }
+
+  // Forget the result of the previous event. Called after decoding.
+  void   NewEvent() { fEvaluated = kFALSE; }
+  // Result for this event, evaluating the cuts on the first call
+  Bool_t Pass() {
+    if( !fEvaluated ) Evaluate();
+    return fPass;
+  }
+
+  virtual void Clear( Option_t* opt="" );
+  virtual void Print( Option_t* opt="" ) const;
+
+  ULong64_t GetNEvents() const { return fNEvents; }
+  ULong64_t GetNSkipped() const { return fNSkipped; }
+
+protected:
+  TString fBlock;
+  std::vector<THaCut*>   fCuts;
+  std::vector<ULong64_t> fNFailed;  // Events failing each cut
+  Bool_t    fEvaluated;
+  Bool_t    fPass;
+  ULong64_t fNEvents;
+  ULong64_t fNSkipped;
+
+  void   Evaluate();
+
+  ClassDef(THcPrefilter,0)   // Reconstruction prefilter
+};
+
+#endif
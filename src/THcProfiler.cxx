@@ -0,0 +1,273 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcProfiler                                                               //
+//                                                                           //
+// Times the stages of the event loop for each apparatus and detector:       //
+// Decode, CoarseTrack, CoarseProcess (CoarseReconstruct for an              //
+// apparatus), FineTrack (Track) and FineProcess (Reconstruct).              //
+//                                                                           //
+// THcAnalyzer::EnableProfiling() creates a profiler and registers the       //
+// Hall C spectrometers and hit list detectors with it.  These put a         //
+// THcProfiler::Timer at the top of each stage method, which reads the       //
+// time stamp counter on entry and exit.  Without a profiler the timer is    //
+// a test of a NULL pointer.                                                 //
+//                                                                           //
+// For each object and stage the number of calls, the total and the          //
+// maximum are kept, and a histogram with four bins per factor of two,       //
+// from which the median and 99th percentile are estimated to about 10%.     //
+// Ticks are converted to time with the tick rate measured between Begin()   //
+// and End() against the wall clock.                                         //
+//                                                                           //
+// At the end of a run THcAnalyzer prints the table and defines, for         //
+// PrintReport templates, gHcParms variables                                 //
+//   prof_<object>_<stage>_{calls,total,p50,p99,max}                         //
+// e.g. prof_H_dc_CoarseTrack_p99, with total in s, the others in us.        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcProfiler.h"
+#include "THcGlobals.h"
+#include "THcParmList.h"
+
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+ClassImp(THcProfiler)
+
+static const char* const kStageNames[THcProfiler::kNStages] = {
+  "Decode", "CoarseTrack", "CoarseProcess", "FineTrack", "FineProcess"
+};
+
+//______________________________________________________________________________
+THcProfiler::THcProfiler() :
+  fTickStart(0), fTickEnd(0), fWallStart(0), fTicksPerSec(0)
+{
+  // Constructor
+}
+
+//______________________________________________________________________________
+THcProfiler::~THcProfiler()
+{
+  // Destructor
+
+  RemoveParms();
+}
+
+//______________________________________________________________________________
+Int_t THcProfiler::Register( const char* name )
+{
+  // Add an apparatus or detector. Returns its id for Add and Timer.
+
+  for( UInt_t i=0; i<fNames.size(); i++ ) {
+    if( fNames[i] == name ) return i;
+  }
+  fNames.push_back(name);
+  ProfStat s;
+  memset(&s, 0, sizeof(s));
+  fStats.insert(fStats.end(), kNStages, s);
+  return fNames.size()-1;
+}
+
+//______________________________________________________________________________
+void THcProfiler::Clear( Option_t* )
+{
+  // Reset all counters
+
+  for( UInt_t i=0; i<fStats.size(); i++ ) {
+    memset(&fStats[i], 0, sizeof(ProfStat));
+  }
+}
+
+//______________________________________________________________________________
+Double_t THcProfiler::WallTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+//______________________________________________________________________________
+void THcProfiler::Begin()
+{
+  // Start of the timed period
+
+  Clear();
+  fWallStart = WallTime();
+  fTickStart = Now();
+}
+
+//______________________________________________________________________________
+void THcProfiler::End()
+{
+  // End of the timed period. Measures the tick rate.
+
+  fTickEnd = Now();
+  Double_t wall = WallTime() - fWallStart;
+  if( wall > 0 && fTickEnd > fTickStart )
+    fTicksPerSec = (fTickEnd - fTickStart)/wall;
+}
+
+//______________________________________________________________________________
+const char* THcProfiler::GetStageName( Int_t stage )
+{
+  return (stage >= 0 && stage < kNStages) ? kStageNames[stage] : "";
+}
+
+//______________________________________________________________________________
+Double_t THcProfiler::BinLow( Int_t bin )
+{
+  // Lowest tick count in histogram bin
+
+  if( bin < 4 ) return bin;
+  Int_t msb = bin/4 + 1;
+  return (Double_t)((ULong64_t)(4 + bin%4) << (msb-2));
+}
+
+//______________________________________________________________________________
+Double_t THcProfiler::GetCalls( Int_t id, Int_t stage ) const
+{
+  return fStats[id*kNStages+stage].n;
+}
+
+//______________________________________________________________________________
+Double_t THcProfiler::GetTotal( Int_t id, Int_t stage ) const
+{
+  // Total time in seconds
+
+  if( fTicksPerSec <= 0 ) return 0;
+  return fStats[id*kNStages+stage].sum/fTicksPerSec;
+}
+
+//______________________________________________________________________________
+Double_t THcProfiler::GetMax( Int_t id, Int_t stage ) const
+{
+  // Longest call in microseconds
+
+  if( fTicksPerSec <= 0 ) return 0;
+  return 1e6*fStats[id*kNStages+stage].max/fTicksPerSec;
+}
+
+//______________________________________________________________________________
+Double_t THcProfiler::GetQuantile( Int_t id, Int_t stage, Double_t q ) const
+{
+  // Quantile q of the call times in microseconds, from the middle of the
+  // histogram bin in which it falls
+
+  const ProfStat& s = fStats[id*kNStages+stage];
+  if( s.n == 0 || fTicksPerSec <= 0 ) return 0;
+  ULong64_t target = (ULong64_t)(q*s.n);
+  if( target >= s.n ) target = s.n-1;
+  ULong64_t cum = 0;
+  Int_t bin = 0;
+  for( ; bin<kNBins; bin++ ) {
+    cum += s.hist[bin];
+    if( cum > target ) break;
+  }
+  Double_t ticks = 0.5*(BinLow(bin) + BinLow(bin+1));
+  if( ticks > s.max ) ticks = s.max;
+  return 1e6*ticks/fTicksPerSec;
+}
+
+//______________________________________________________________________________
+void THcProfiler::Print( Option_t* ) const
+{
+  Print((ULong64_t)0);
+}
+
+//______________________________________________________________________________
+void THcProfiler::Print( ULong64_t nevents ) const
+{
+  // Print the time spent in each object and stage.  With nevents given,
+  // also the average time per event.
+
+  cout << endl << "Hall C event loop profile";
+  if( nevents > 0 ) cout << ", " << nevents << " events";
+  cout << endl;
+  printf("%-16s %-14s %10s %10s %10s %10s %10s %10s\n", "Object", "Stage",
+	 "Calls", "Total(s)", "us/event", "p50(us)", "p99(us)", "max(us)");
+  for( UInt_t id=0; id<fNames.size(); id++ ) {
+    for( Int_t stage=0; stage<kNStages; stage++ ) {
+      if( fStats[id*kNStages+stage].n == 0 ) continue;
+      Double_t total = GetTotal(id,stage);
+      printf("%-16s %-14s %10.0f %10.3f %10.2f %10.2f %10.2f %10.2f\n",
+	     fNames[id].Data(), kStageNames[stage], GetCalls(id,stage), total,
+	     nevents > 0 ? 1e6*total/nevents : 0.0,
+	     GetQuantile(id,stage,0.5), GetQuantile(id,stage,0.99),
+	     GetMax(id,stage));
+    }
+  }
+}
+
+//______________________________________________________________________________
+void THcProfiler::WriteCSVHeader( FILE* fp, const char* tagnames )
+{
+  // Column names for WriteCSV. tagnames names the columns of the tag.
+
+  fprintf(fp, "%s,object,stage,calls,total_s,us_per_event,p50_us,p99_us,max_us\n",
+	  tagnames);
+}
+
+//______________________________________________________________________________
+void THcProfiler::WriteCSV( FILE* fp, const char* tag, ULong64_t nevents ) const
+{
+  // The table of Print as comma separated values, one line per object
+  // and stage, each starting with tag (e.g. a build or configuration name)
+
+  for( UInt_t id=0; id<fNames.size(); id++ ) {
+    for( Int_t stage=0; stage<kNStages; stage++ ) {
+      if( fStats[id*kNStages+stage].n == 0 ) continue;
+      Double_t total = GetTotal(id,stage);
+      fprintf(fp, "%s,%s,%s,%.0f,%.6f,%.3f,%.3f,%.3f,%.3f\n",
+	      tag, fNames[id].Data(), kStageNames[stage], GetCalls(id,stage),
+	      total, nevents > 0 ? 1e6*total/nevents : 0.0,
+	      GetQuantile(id,stage,0.5), GetQuantile(id,stage,0.99),
+	      GetMax(id,stage));
+    }
+  }
+}
+
+//______________________________________________________________________________
+void THcProfiler::DefineParms( const char* prefix )
+{
+  // Make the results available to PrintReport as gHcParms variables
+
+  RemoveParms();
+  enum { kCalls, kTotal, kP50, kP99, kMax, kNParms };
+  static const char* const suffix[kNParms] = { "calls", "total", "p50", "p99", "max" };
+
+  fParms.assign(fNames.size()*kNStages*kNParms, 0.0);
+  for( UInt_t id=0; id<fNames.size(); id++ ) {
+    TString name = fNames[id];
+    name.ReplaceAll(".","_");
+    for( Int_t stage=0; stage<kNStages; stage++ ) {
+      if( fStats[id*kNStages+stage].n == 0 ) continue;
+      Double_t* p = &fParms[(id*kNStages+stage)*kNParms];
+      p[kCalls] = GetCalls(id,stage);
+      p[kTotal] = GetTotal(id,stage);
+      p[kP50] = GetQuantile(id,stage,0.5);
+      p[kP99] = GetQuantile(id,stage,0.99);
+      p[kMax] = GetMax(id,stage);
+      for( Int_t k=0; k<kNParms; k++ ) {
+	TString parname = Form("%s%s_%s_%s",prefix,name.Data(),kStageNames[stage],suffix[k]);
+	gHcParms->Define(parname.Data(),"Event loop profile",p[k]);
+	fParmNames.push_back(parname);
+      }
+    }
+  }
+}
+
+//______________________________________________________________________________
+void THcProfiler::RemoveParms()
+{
+  // Remove the variables defined by DefineParms
+
+  if( gHcParms ) {
+    for( UInt_t i=0; i<fParmNames.size(); i++ ) {
+      gHcParms->RemoveName(fParmNames[i].Data());
+    }
+  }
+  fParmNames.clear();
+}
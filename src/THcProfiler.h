@@ -0,0 +1,118 @@
+#ifndef ROOT_THcProfiler
+#define ROOT_THcProfiler
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcProfiler                                                               //
+//                                                                           //
+// Per apparatus/detector, per stage timing of the event loop.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include "TString.h"
+#include <vector>
+#include <cstdio>
+
+#ifndef __CINT__
+#include <sys/time.h>
+#endif
+
+class THcProfiler : public TObject {
+
+public:
+  enum EStage { kDecode, kCoarseTrack, kCoarseProcess, kFineTrack,
+		kFineProcess, kNStages };
+  enum { kNBins = 256 };       // 4 bins per factor of two in ticks
+
+  THcProfiler();
+  virtual ~THcProfiler();
+
+  Int_t  Register( const char* name );
+  Int_t  GetNEntries() const { return fNames.size(); }
+  virtual void Clear( Option_t* opt="" );
+
+  void   Begin();
+  void   End();
+
+  // Time of one call of stage of object id, in ticks
+  void   Add( Int_t id, Int_t stage, ULong64_t ticks ) {
+    ProfStat& s = fStats[id*kNStages+stage];
+    s.n++;
+    s.sum += ticks;
+    if( ticks > s.max ) s.max = ticks;
+    s.hist[Bin(ticks)]++;
+  }
+
+  Double_t GetCalls( Int_t id, Int_t stage ) const;
+  Double_t GetTotal( Int_t id, Int_t stage ) const;       // s
+  Double_t GetQuantile( Int_t id, Int_t stage, Double_t q ) const; // us
+  Double_t GetMax( Int_t id, Int_t stage ) const;         // us
+
+  void   Print( Option_t* opt="" ) const;
+  void   Print( ULong64_t nevents ) const;
+  void   WriteCSV( FILE* fp, const char* tag, ULong64_t nevents ) const;
+  static void WriteCSVHeader( FILE* fp, const char* tagnames="tag" );
+  void   DefineParms( const char* prefix="prof_" );
+  void   RemoveParms();
+
+  static const char* GetStageName( Int_t stage );
+
+#ifndef __CINT__
+  // Current time in ticks: the time stamp counter on x86, else us
+  static ULong64_t Now() {
+#if defined(__i386__) || defined(__x86_64__)
+    UInt_t lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((ULong64_t)hi << 32) | lo;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return (ULong64_t)tv.tv_sec*1000000 + tv.tv_usec;
+#endif
+  }
+
+  // Times the enclosing scope. Does nothing if the profiler is NULL.
+  class Timer {
+  public:
+    Timer( THcProfiler* prof, Int_t id, Int_t stage ) :
+      fProf(prof), fId(id), fStage(stage), fStart(prof ? Now() : 0) {}
+    ~Timer() { if( fProf ) fProf->Add(fId, fStage, Now()-fStart); }
+  private:
+    THcProfiler* fProf;
+    Int_t        fId;
+    Int_t        fStage;
+    ULong64_t    fStart;
+  };
+#endif
+
+protected:
+  struct ProfStat {
+    ULong64_t n;
+    ULong64_t sum;
+    ULong64_t max;
+    UInt_t    hist[kNBins];
+  };
+  std::vector<TString> fNames;
+  std::vector<ProfStat> fStats;         // [entry*kNStages+stage]
+  std::vector<Double_t> fParms;         // Values exported to gHcParms
+  std::vector<TString> fParmNames;
+
+  ULong64_t fTickStart;
+  ULong64_t fTickEnd;
+  Double_t  fWallStart;
+  Double_t  fTicksPerSec;
+
+  static Int_t Bin( ULong64_t ticks ) {
+    if( ticks < 4 ) return ticks;
+    Int_t msb = 63;
+    while( !(ticks >> msb) ) msb--;
+    return 4*(msb-1) + ((ticks >> (msb-2)) & 3);
+  }
+  static Double_t BinLow( Int_t bin );
+  static Double_t WallTime();
+
+  ClassDef(THcProfiler,0)   // Event loop profiler
+};
+
+#endif
@@ -12,6 +12,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "THcRaster.h"
+#include "THcProfiler.h"
 #include "THaEvData.h"
 #include "THaDetMap.h"
 
@@ -19,6 +20,7 @@
 #include "THcParmList.h"
 #include "THcGlobals.h"
 #include "THaGlobals.h"
+#include "THcPedestalTracker.h"
 
 
 //#include "THcHitList.h"
@@ -39,7 +41,6 @@ THcRaster::THcRaster( const char* name, const char* description,
 {
 
   fAnalyzePedestals = 0;
-  fNPedestalEvents = 0;
   fRawXADC = 0;
   fRawYADC = 0;
   fXADC = 0;
@@ -51,15 +52,17 @@ THcRaster::THcRaster( const char* name, const char* description,
   fFrXADCperCM = 0;
 
   for(Int_t i=0;i<2;i++){
-    fPedADC[i] = 0;
     fAvgPedADC[i] = 0;
   }
+
+  fPedestals = NULL;
 }
 
 
 //_____________________________________________________________________________
 THcRaster::~THcRaster()
 {
+  delete fPedestals;
 }
 
 
@@ -93,6 +96,12 @@ Int_t THcRaster::ReadDatabase( const TDatime& date )
   // get the calibration factors from gbeam.param file
    gHcParms->LoadParmValues((DBRequest*)&list,prefix);
 
+  // Get the pedestals from the first 1000 pedestal events, no ADC limits.
+  delete fPedestals;
+  fPedestals = new THcPedestalTracker(2);
+  fPedestals->Init(0, kMaxInt);
+  fPedestals->SetMaxEvents(1000);
+
   return kOK;
 
 }
@@ -176,17 +185,16 @@ void THcRaster::AccumulatePedestals(TClonesArray* rawhits)
   while(ihit<nrawhits) {
     THcRasterRawHit* hit = (THcRasterRawHit *) fRawHitList->At(ihit);
     if(hit->fADC_xsig>0) {
-      fPedADC[0] += hit->fADC_xsig;
-      //std::cout<<" raster x pedestal collect "<<fPedADC[0]<<std::endl;
+      fPedestals->Fill(0, hit->fADC_xsig);
     }
     if(hit->fADC_ysig>0) {
-      fPedADC[1] += hit->fADC_ysig;
-      //std::cout<<" raster y pedestal collect "<<fPedADC[1]<<std::endl;
+      fPedestals->Fill(1, hit->fADC_ysig);
     }
 
     ihit++;
   }
 
+  fPedestals->EndEvent();
 }
 
 
@@ -210,8 +218,9 @@ void THcRaster::CalculatePedestals( )
        endif
      endif
   */
+  fPedestals->Calculate();
   for(Int_t i=0;i<2;i++){
-    fAvgPedADC[i] = fPedADC[i]/ fNPedestalEvents; 
+    fAvgPedADC[i] = fPedestals->GetPed(i);
     // std::cout<<" raster pedestal "<<fAvgPedADC[i]<<std::endl;
   }
 
@@ -221,6 +230,7 @@ void THcRaster::CalculatePedestals( )
 //_____________________________________________________________________________
 Int_t THcRaster::Decode( const THaEvData& evdata )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kDecode);
 
   // loops over all channels defined in the detector map
   // copies raw data into local variables
@@ -232,10 +242,9 @@ Int_t THcRaster::Decode( const THaEvData& evdata )
   
   // Get the pedestals from the first 1000 events
   //if(fNPedestalEvents < 10) 
-  if((gHaCuts->Result("Pedestal_event")) & (fNPedestalEvents < 1000)){
+  if((IsPedestalEvent()) & (!fPedestals->IsFull())){
       AccumulatePedestals(fRawHitList);    
       fAnalyzePedestals = 1;	// Analyze pedestals first normal events
-      fNPedestalEvents++;
       
       return(0);
     }
@@ -271,8 +280,10 @@ Int_t THcRaster::Decode( const THaEvData& evdata )
 
 //_____________________________________________________________________________
 Int_t THcRaster::Process( ){
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseProcess);
 
-  Double_t eBeam = 0.001;
+  // Beam momentum (gpbeam) is read in ReadDatabase
+  Double_t eBeam = fgpbeam;
   /*
     calculate raster position from ADC value.
     From ENGINE/g_analyze_misc.f -
@@ -293,9 +304,6 @@ Int_t THcRaster::Process( ){
     gfry = (gfry_adc/gfry_adcpercm)*(gfr_cal_mom/ebeam)
   */
  
-  if(gHcParms->Find("gpbeam")){
-    eBeam=*(Double_t *)gHcParms->Find("gpbeam")->GetValuePointer();
-  }
   fXpos = (fXADC/fFrXADCperCM)*(fFrCalMom/eBeam);
   fYpos = (fYADC/fFrYADCperCM)*(fFrCalMom/eBeam);
 
@@ -15,6 +15,8 @@
 #include "THcRasterRawHit.h"
 #include "THaCutList.h"
 
+class THcPedestalTracker;
+
 class THcRaster : public THaBeamDet, public THcHitList {
 
  public:
@@ -50,7 +52,7 @@ class THcRaster : public THaBeamDet, public THcHitList {
   Double_t       fYpos;     // Y position
   
 
-  Double_t       fPedADC[2];     // ADC poedestals 
+  THcPedestalTracker* fPedestals; // ADC pedestal accumulator (X, Y)
   Double_t       fAvgPedADC[2];     // Avergage ADC poedestals 
 
   Double_t       fRawPos[2];     // current in Raster ADCs for position
@@ -59,7 +61,6 @@ class THcRaster : public THaBeamDet, public THcHitList {
 
  private:
   Bool_t    fAnalyzePedestals;
-  Int_t     fNPedestalEvents;
   Double_t  fFrCalMom;
   Double_t  fFrXADCperCM;
   Double_t  fFrYADCperCM;
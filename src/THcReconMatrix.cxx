@@ -0,0 +1,321 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcReconMatrix                                                            //
+//                                                                           //
+// COSY reconstruction matrix, compiled for fast evaluation.                 //
+//                                                                           //
+// The matrix file gives for each term four coefficients (xptar, ytar,       //
+// yptar, delta) and the exponents of the five focal plane variables.        //
+// Compile() merges terms with the same exponents into one monomial,         //
+// determines the highest exponent of each variable, and turns each          //
+// monomial into a list of entries of a power table.  Evaluation then        //
+// fills the power table by repeated multiplication once per track and       //
+// needs only a few multiplications per monomial, shared by the four         //
+// outputs, instead of a pow() call for every nonzero exponent.              //
+//                                                                           //
+// EvalBatch evaluates all tracks of an event (or any number of coordinate   //
+// sets) with the track index as the innermost loop, so the compiler can     //
+// vectorize the products and sums.                                          //
+//                                                                           //
+// WriteCode writes the matrix out as a C++ function with the monomials      //
+// unrolled.  Once compiled (e.g. with ACLiC) it can be plugged in with      //
+// SetCompiledFunc and is then used by Eval.                                 //
+//                                                                           //
+// Results agree with the direct sum over the terms up to floating point     //
+// reassociation.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcReconMatrix.h"
+
+#include <map>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+ClassImp(THcReconMatrix)
+
+//______________________________________________________________________________
+THcReconMatrix::THcReconMatrix() :
+  fNTerms(0), fIsCompiled(kFALSE), fNMonomials(0), fNPowers(0),
+  fCompiledFunc(0)
+{
+  // Constructor
+
+  for(Int_t j=0;j<kNVars;j++) {
+    fMaxExp[j] = 0;
+    fPowOffset[j] = 0;
+  }
+}
+
+//______________________________________________________________________________
+THcReconMatrix::~THcReconMatrix()
+{
+  // Destructor
+}
+
+//______________________________________________________________________________
+void THcReconMatrix::Clear( Option_t* )
+{
+  // Remove all terms
+
+  fNTerms = 0;
+  fTermCoeff.clear();
+  fTermExp.clear();
+  fIsCompiled = kFALSE;
+  fNMonomials = 0;
+  fNPowers = 0;
+  fFirstFactor.clear();
+  fFactors.clear();
+  fCoeff.clear();
+  fBatchPowers.clear();
+  fBatchTerm.clear();
+  fCompiledFunc = 0;
+}
+
+//______________________________________________________________________________
+void THcReconMatrix::AddTerm(const Double_t* coeff, const Int_t* exp)
+{
+  // Add a term with coefficients coeff[kNOut] and exponents exp[kNVars].
+
+  for(Int_t k=0;k<kNOut;k++) {
+    fTermCoeff.push_back(coeff[k]);
+  }
+  for(Int_t j=0;j<kNVars;j++) {
+    fTermExp.push_back(exp[j]);
+  }
+  fNTerms++;
+  fIsCompiled = kFALSE;
+}
+
+//______________________________________________________________________________
+Int_t THcReconMatrix::Compile()
+{
+  // Build the power table layout and the monomial list.
+  // Returns the number of distinct monomials, or -1 on a bad exponent.
+
+  fIsCompiled = kFALSE;
+  fNMonomials = 0;
+  fFirstFactor.clear();
+  fFactors.clear();
+  fCoeff.clear();
+
+  for(Int_t j=0;j<kNVars;j++) {
+    fMaxExp[j] = 0;
+  }
+  for(Int_t it=0;it<fNTerms;it++) {
+    for(Int_t j=0;j<kNVars;j++) {
+      Int_t e = fTermExp[it*kNVars+j];
+      if(e < 0 || e > kMaxExp) {
+	Error("Compile","Bad exponent %d in term %d",e,it);
+	return -1;
+      }
+      if(e > fMaxExp[j]) fMaxExp[j] = e;
+    }
+  }
+  // Power table holds x_j^0 ... x_j^maxexp for each variable
+  fNPowers = 0;
+  for(Int_t j=0;j<kNVars;j++) {
+    fPowOffset[j] = fNPowers;
+    fNPowers += fMaxExp[j]+1;
+  }
+
+  // Merge terms with the same exponents, keeping the order of first
+  // appearance
+  map<Int_t,Int_t> monomials;
+  for(Int_t it=0;it<fNTerms;it++) {
+    Int_t key=0;
+    for(Int_t j=0;j<kNVars;j++) {
+      key = key*(kMaxExp+1) + fTermExp[it*kNVars+j];
+    }
+    map<Int_t,Int_t>::iterator im = monomials.find(key);
+    if(im != monomials.end()) {
+      for(Int_t k=0;k<kNOut;k++) {
+	fCoeff[im->second*kNOut+k] += fTermCoeff[it*kNOut+k];
+      }
+      continue;
+    }
+    monomials[key] = fNMonomials;
+    fFirstFactor.push_back(fFactors.size());
+    for(Int_t j=0;j<kNVars;j++) {
+      Int_t e = fTermExp[it*kNVars+j];
+      if(e != 0) {
+	fFactors.push_back(fPowOffset[j]+e);
+      }
+    }
+    for(Int_t k=0;k<kNOut;k++) {
+      fCoeff.push_back(fTermCoeff[it*kNOut+k]);
+    }
+    fNMonomials++;
+  }
+  fFirstFactor.push_back(fFactors.size());
+
+  fBatchPowers.assign(fNPowers*kBatchSize, 0.0);
+  fBatchTerm.assign(kBatchSize, 0.0);
+
+  fIsCompiled = kTRUE;
+  return fNMonomials;
+}
+
+//______________________________________________________________________________
+void THcReconMatrix::FillPowers(const Double_t* x, Double_t* pw) const
+{
+  // Fill power table for one set of coordinates
+
+  for(Int_t j=0;j<kNVars;j++) {
+    Double_t* p = pw + fPowOffset[j];
+    p[0] = 1.0;
+    for(Int_t e=1;e<=fMaxExp[j];e++) {
+      p[e] = p[e-1]*x[j];
+    }
+  }
+}
+
+//______________________________________________________________________________
+void THcReconMatrix::Eval(const Double_t* x, Double_t* sum) const
+{
+  // Compute the four matrix sums for the coordinates x
+
+  if(fCompiledFunc) {
+    (*fCompiledFunc)(x, sum);
+    return;
+  }
+
+  for(Int_t k=0;k<kNOut;k++) {
+    sum[k] = 0.0;
+  }
+  if(!fIsCompiled) return;
+
+  Double_t pw[kNVars*(kMaxExp+1)];
+  FillPowers(x, pw);
+
+  const Double_t* c = &fCoeff[0];
+  for(Int_t im=0;im<fNMonomials;im++,c+=kNOut) {
+    Double_t term=1.0;
+    for(Int_t f=fFirstFactor[im];f<fFirstFactor[im+1];f++) {
+      term *= pw[fFactors[f]];
+    }
+    sum[0] += term*c[0];
+    sum[1] += term*c[1];
+    sum[2] += term*c[2];
+    sum[3] += term*c[3];
+  }
+}
+
+//______________________________________________________________________________
+void THcReconMatrix::EvalBatch(Int_t n, const Double_t* x, Double_t* sum) const
+{
+  // Compute the matrix sums for n sets of coordinates, stored by variable:
+  // x[j*n+i], sum[k*n+i]
+
+  for(Int_t i=0;i<kNOut*n;i++) {
+    sum[i] = 0.0;
+  }
+  if(n <= 0 || !fIsCompiled) return;
+
+  if(fCompiledFunc) {
+    Double_t xi[kNVars], si[kNOut];
+    for(Int_t i=0;i<n;i++) {
+      for(Int_t j=0;j<kNVars;j++) xi[j] = x[j*n+i];
+      (*fCompiledFunc)(xi, si);
+      for(Int_t k=0;k<kNOut;k++) sum[k*n+i] = si[k];
+    }
+    return;
+  }
+
+  // Blocks of up to kBatchSize sets, in the work space made by Compile
+  for(Int_t i0=0;i0<n;i0+=kBatchSize) {
+    Int_t m = n-i0 < kBatchSize ? n-i0 : kBatchSize;
+    Double_t* pw = &fBatchPowers[0];
+    for(Int_t j=0;j<kNVars;j++) {
+      Double_t* p = pw + fPowOffset[j]*kBatchSize;
+      for(Int_t i=0;i<m;i++) {
+	p[i] = 1.0;
+      }
+      for(Int_t e=1;e<=fMaxExp[j];e++) {
+	const Double_t* prev = p + (e-1)*kBatchSize;
+	Double_t* cur = p + e*kBatchSize;
+	const Double_t* xj = x + j*n + i0;
+	for(Int_t i=0;i<m;i++) {
+	  cur[i] = prev[i]*xj[i];
+	}
+      }
+    }
+
+    Double_t* s0 = sum + i0;
+    Double_t* s1 = sum + n + i0;
+    Double_t* s2 = sum + 2*n + i0;
+    Double_t* s3 = sum + 3*n + i0;
+    Double_t* t = &fBatchTerm[0];
+    for(Int_t im=0;im<fNMonomials;im++) {
+      for(Int_t i=0;i<m;i++) {
+	t[i] = 1.0;
+      }
+      for(Int_t f=fFirstFactor[im];f<fFirstFactor[im+1];f++) {
+	const Double_t* p = pw + fFactors[f]*kBatchSize;
+	for(Int_t i=0;i<m;i++) {
+	  t[i] *= p[i];
+	}
+      }
+      const Double_t* c = &fCoeff[im*kNOut];
+      for(Int_t i=0;i<m;i++) {
+	s0[i] += t[i]*c[0];
+	s1[i] += t[i]*c[1];
+	s2[i] += t[i]*c[2];
+	s3[i] += t[i]*c[3];
+      }
+    }
+  }
+}
+
+//______________________________________________________________________________
+Int_t THcReconMatrix::WriteCode(const char* filename, const char* funcname) const
+{
+  // Write the matrix as a C++ function
+  //   extern "C" void funcname(const double* x, double* sum)
+  // with one statement per monomial.  Returns 0 on success.
+
+  if(!fIsCompiled) {
+    Error("WriteCode","Matrix not compiled");
+    return -1;
+  }
+  FILE* fp = fopen(filename,"w");
+  if(!fp) {
+    Error("WriteCode","Cannot open %s",filename);
+    return -1;
+  }
+  fprintf(fp,"// Reconstruction matrix with %d terms, %d monomials\n",
+	  fNTerms,fNMonomials);
+  fprintf(fp,"// Written by THcReconMatrix::WriteCode\n\n");
+  fprintf(fp,"extern \"C\" void %s(const double* x, double* sum)\n{\n",funcname);
+  for(Int_t j=0;j<kNVars;j++) {
+    if(fMaxExp[j] >= 1) {
+      fprintf(fp,"  const double p%d_1 = x[%d];\n",j,j);
+    }
+    for(Int_t e=2;e<=fMaxExp[j];e++) {
+      fprintf(fp,"  const double p%d_%d = p%d_%d*x[%d];\n",j,e,j,e-1,j);
+    }
+  }
+  fprintf(fp,"  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;\n");
+  fprintf(fp,"  double t;\n");
+  for(Int_t im=0;im<fNMonomials;im++) {
+    fprintf(fp,"  t = 1.0");
+    for(Int_t f=fFirstFactor[im];f<fFirstFactor[im+1];f++) {
+      Int_t ip = fFactors[f];
+      Int_t j = kNVars-1;
+      while(j>0 && fPowOffset[j]>ip) j--;
+      fprintf(fp,"*p%d_%d",j,ip-fPowOffset[j]);
+    }
+    fprintf(fp,";\n");
+    for(Int_t k=0;k<kNOut;k++) {
+      Double_t c = fCoeff[im*kNOut+k];
+      if(c != 0.0) {
+	fprintf(fp,"  s%d += t*(%.17g);\n",k,c);
+      }
+    }
+  }
+  fprintf(fp,"  sum[0] = s0; sum[1] = s1; sum[2] = s2; sum[3] = s3;\n}\n");
+  fclose(fp);
+  return 0;
+}
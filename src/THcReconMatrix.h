@@ -0,0 +1,76 @@
+#ifndef ROOT_THcReconMatrix
+#define ROOT_THcReconMatrix
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcReconMatrix                                                            //
+//                                                                           //
+// Compiled COSY reconstruction matrix.                                      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class THcReconMatrix : public TObject {
+
+public:
+  enum { kNVars = 5, kNOut = 4, kMaxExp = 9 };
+  // Coordinate sets evaluated together by EvalBatch
+  enum { kBatchSize = 16 };
+
+  // Signature of a function written by WriteCode and compiled
+  typedef void (*CompiledFunc_t)(const Double_t* x, Double_t* sum);
+
+  THcReconMatrix();
+  virtual ~THcReconMatrix();
+
+  virtual void Clear( Option_t* opt="" );
+
+  void  AddTerm(const Double_t* coeff, const Int_t* exp);
+  Int_t Compile();
+
+  // Sums for one set of focal plane coordinates, x[kNVars] -> sum[kNOut]
+  void  Eval(const Double_t* x, Double_t* sum) const;
+  // Sums for n sets of coordinates at once. x[j*n+i] is variable j of
+  // set i, sum[k*n+i] receives output k of set i.
+  void  EvalBatch(Int_t n, const Double_t* x, Double_t* sum) const;
+
+  Int_t WriteCode(const char* filename, const char* funcname) const;
+  void  SetCompiledFunc(CompiledFunc_t func) { fCompiledFunc = func; }
+
+  Int_t GetNTerms() const     { return fNTerms; }
+  Int_t GetNMonomials() const { return fNMonomials; }
+  Int_t GetMaxExp(Int_t j) const { return fMaxExp[j]; }
+  Bool_t IsCompiled() const   { return fIsCompiled; }
+
+protected:
+
+  // Terms as read from the matrix file
+  Int_t fNTerms;
+  std::vector<Double_t> fTermCoeff;      // [fNTerms*kNOut]
+  std::vector<Int_t>    fTermExp;        // [fNTerms*kNVars]
+
+  // Compiled form: distinct monomials, each a product of entries of the
+  // power table, with the coefficients of all four outputs merged.
+  Bool_t fIsCompiled;
+  Int_t fNMonomials;
+  Int_t fNPowers;                        // Size of power table
+  Int_t fMaxExp[kNVars];                 // Highest exponent per variable
+  Int_t fPowOffset[kNVars];              // Start of variable in power table
+  std::vector<Int_t>    fFirstFactor;    // [fNMonomials+1]
+  std::vector<Int_t>    fFactors;        // Power table indices
+  std::vector<Double_t> fCoeff;          // [fNMonomials*kNOut]
+
+  // Work space of EvalBatch, sized by Compile
+  mutable std::vector<Double_t> fBatchPowers; // [fNPowers*kBatchSize]
+  mutable std::vector<Double_t> fBatchTerm;   // [kBatchSize]
+
+  CompiledFunc_t fCompiledFunc;
+
+  void FillPowers(const Double_t* x, Double_t* pw) const;
+
+  ClassDef(THcReconMatrix,0)   // Compiled reconstruction matrix
+};
+
+#endif
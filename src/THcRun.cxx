@@ -0,0 +1,472 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// THcRun
+//
+// A CODA run (THaRun) that can read events ahead.
+//
+// With SetReadAhead(n), a reader thread reads the events from the file
+// and copies them into a ring of n+1 event buffers, up to n events ahead
+// of the one the analyzer decodes and reconstructs.  File reading then
+// overlaps with the analysis, and the replay rate is set by the slower
+// of the two instead of by their sum.  The buffers are reused as the
+// ring goes around; a buffer only grows when an event does not fit.
+//
+// The ring has a single producer and a single consumer, each moving its
+// own index; the count of filled buffers is kept under a mutex.  A side
+// that finds the ring full (reader) or empty (analyzer) waits on a
+// condition until the other side moves, and counts a stall.  The
+// counters are printed by PrintReadAheadStats() when the run is closed:
+//   - reader stalls:   the analysis is the bottleneck
+//   - analyzer stalls: reading the file is the bottleneck
+//   - mean ring depth: how far ahead the reader is on average
+//
+// Usage, in place of THaRun:
+//   THcRun* run = new THcRun("daq04_50017.log.0");
+//   run->SetReadAhead(64);
+//
+// Reading is the only stage split off.  Decode, reconstruction and
+// output (THaOutput) stay one stage on the analyzer's thread: the
+// detectors keep the decoded hits and the reconstruction results of the
+// event in their data members, and THaOutput fills the tree from the
+// global variables bound to those members, so the next event cannot be
+// decoded before the current one is written.  Within an event, the
+// detectors and spectrometers can be run concurrently instead (see
+// THcDecodeGraph and THcAnalyzer::SetApparatusThreads).
+//
+// UseIndex() loads the event index of the file (THcEventIndex), building
+// and saving it as <file>.idx the first time.  THcAnalyzer::Process then
+// seeks to the first event of the run's event range with SetByteRange,
+// and splits the run into byte ranges for event parallel replay.  In a
+// byte range, events are read directly from the file (THcCodaStream)
+// instead of through THaRun.  Control, scaler and EPICS events before the
+// start of the range are skipped along with the physics events, except
+// for the scan for the run information (prestart event: run number,
+// date, prescales) by ReadInitInfo, which reads from the start of the
+// file whatever the range.  With SetLeadIn, single events at given offsets
+// before the range are read first, as THcAnalyzer does to give every
+// worker the pedestal events before its slice; IsLeadInEvent() tells the
+// analyzer which events those are.
+//
+// SetMemoryMap() reads the file through a memory map (THcCodaStream), and
+// GetEvBuffer points into the map, so the decoder works on the data in
+// place; only events continuing across a CODA block boundary are copied.
+// The kernel reads the file ahead of the analysis, which replaces the
+// reader thread: with read-ahead also set, the events are copied into
+// the ring as before.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "THcRun.h"
+#include "THcEventIndex.h"
+#include "TThread.h"
+#include "TMutex.h"
+#include "TCondition.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+//_____________________________________________________________________________
+THcRun::THcRun( const char* filename, const char* description ) :
+  THaRun(filename, description), fReadAhead(0), fIndex(0), fRangeStart(-1),
+  fRangeEnd(-1), fMemoryMap(kFALSE), fStream(0), fDirectBuf(0),
+  fDirectSize(0), fInLeadIn(kFALSE), fLeadNext(0), fLeadInEvent(kFALSE),
+  fHead(0), fTail(0),
+  fCount(0), fStop(kFALSE), fRingMutex(0), fNotFull(0), fNotEmpty(0),
+  fHolding(kFALSE), fReadDone(kFALSE), fLastStatus(READ_OK),
+  fCurrent(0), fReader(0), fNRead(0), fReaderStalls(0), fConsumerStalls(0),
+  fOccupancySum(0), fOccupancyMax(0)
+{
+  // Normal constructor
+}
+
+//_____________________________________________________________________________
+THcRun::THcRun( const THcRun& rhs ) :
+  THaRun(rhs), fReadAhead(rhs.fReadAhead),
+  fIndex(rhs.fIndex ? new THcEventIndex(*rhs.fIndex) : 0),
+  fRangeStart(rhs.fRangeStart), fRangeEnd(rhs.fRangeEnd),
+  fLeadIn(rhs.fLeadIn), fMemoryMap(rhs.fMemoryMap), fStream(0),
+  fDirectBuf(0), fDirectSize(0), fInLeadIn(kFALSE), fLeadNext(0),
+  fLeadInEvent(kFALSE), fHead(0), fTail(0),
+  fCount(0), fStop(kFALSE), fRingMutex(0), fNotFull(0), fNotEmpty(0),
+  fHolding(kFALSE), fReadDone(kFALSE), fLastStatus(READ_OK),
+  fCurrent(0), fReader(0), fNRead(0), fReaderStalls(0), fConsumerStalls(0),
+  fOccupancySum(0), fOccupancyMax(0)
+{
+  // Copy constructor. The reader state is not copied.
+}
+
+//_____________________________________________________________________________
+THcRun& THcRun::operator=( const THaRunBase& rhs )
+{
+  // Assignment. Copies the read-ahead, index and byte range settings.
+
+  if( this != &rhs ) {
+    THaRun::operator=(rhs);
+    const THcRun* run = dynamic_cast<const THcRun*>(&rhs);
+    if( run ) {
+      fReadAhead = run->fReadAhead;
+      delete fIndex;
+      fIndex = run->fIndex ? new THcEventIndex(*run->fIndex) : 0;
+      fRangeStart = run->fRangeStart;
+      fRangeEnd = run->fRangeEnd;
+      fLeadIn = run->fLeadIn;
+      fMemoryMap = run->fMemoryMap;
+    }
+  }
+  return *this;
+}
+
+//_____________________________________________________________________________
+THcRun::~THcRun()
+{
+  // Destructor
+
+  StopReader();
+  for( UInt_t i=0; i<fSlots.size(); i++ )
+    delete [] fSlots[i].buf;
+  delete fStream;
+  delete [] fDirectBuf;
+  delete fIndex;
+  delete fNotFull;
+  delete fNotEmpty;
+  delete fRingMutex;
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::Open()
+{
+  // Open the file. A reader thread from an earlier Open is stopped.
+  // With a byte range set, position at its first event.
+
+  StopReader();
+  fReadDone = kFALSE;
+  Int_t status = THaRun::Open();
+  if( status == READ_OK && IsDirect() )
+    status = OpenStream();
+  return status;
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::UseIndex( Bool_t write )
+{
+  // Load the event index of the file, building it if there is no up to
+  // date <file>.idx, and saving it there if write is set
+
+  if( !fIndex ) fIndex = new THcEventIndex;
+  if( fIndex->Load(GetFilename(), write) != 0 ) {
+    delete fIndex;
+    fIndex = 0;
+    return -1;
+  }
+  return 0;
+}
+
+//_____________________________________________________________________________
+void THcRun::SetByteRange( Long64_t start, Long64_t end )
+{
+  // Read only the events starting in [start,end). The offsets must be
+  // those of events, as given by THcEventIndex.  Takes effect at the
+  // next Open, or immediately if the run is open.
+
+  fRangeStart = start;
+  fRangeEnd = end;
+  if( !IsOpen() ) return;
+  StopReader();
+  fReadDone = kFALSE;
+  if( IsDirect() )
+    OpenStream();
+  else if( fStream )
+    fStream->Close();
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::ReadInitInfo()
+{
+  // Scan for the run information from the start of the file, as
+  // THaRun does, without byte range and read-ahead.  They apply again
+  // from the next Open.
+
+  StopReader();
+  if( fStream && fStream->IsOpen() )
+    fStream->Close();
+  Long64_t start = fRangeStart, end = fRangeEnd;
+  Int_t readahead = fReadAhead;
+  Bool_t map = fMemoryMap;
+  fRangeStart = fRangeEnd = -1;
+  fReadAhead = 0;
+  fMemoryMap = kFALSE;
+  Int_t status = THaRun::ReadInitInfo();
+  fRangeStart = start;
+  fRangeEnd = end;
+  fReadAhead = readahead;
+  fMemoryMap = map;
+  return status;
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::OpenStream()
+{
+  // Open the file for direct reading, at the start of the byte range if
+  // there is one.  A lead-in is read from ReadDirect.
+
+  if( !fStream ) fStream = new THcCodaStream;
+  Int_t status = fStream->Open(GetFilename(), fMemoryMap);
+  fInLeadIn = fRangeStart >= 0 && !fLeadIn.empty();
+  fLeadNext = 0;
+  fLeadInEvent = kFALSE;
+  if( status == READ_OK && fRangeStart >= 0 && !fInLeadIn ) {
+    status = fStream->Seek(fRangeStart);
+    if( status == READ_EOF )		// Empty range at the end of the file
+      status = READ_OK;
+  }
+  if( status != READ_OK )
+    Error("OpenStream","Cannot read %s from byte %lld",GetFilename(),fRangeStart);
+  return status;
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::Close()
+{
+  // Stop reading ahead and close the file
+
+  if( fReader ) {
+    StopReader();
+    PrintReadAheadStats();
+  }
+  if( fStream && fStream->IsOpen() ) {
+    if( fStream->IsMapped() )
+      cout << "THcRun memory map: " << fStream->GetNInPlace()
+	   << " events in place, " << fStream->GetNCopied()
+	   << " copied" << endl;
+    fStream->Close();
+  }
+  return THaRun::Close();
+}
+
+//_____________________________________________________________________________
+void THcRun::StartReader()
+{
+  // Set up the buffer ring and start the reader thread
+
+  UInt_t nslots = fReadAhead+1;
+  if( fSlots.size() != nslots ) {
+    for( UInt_t i=0; i<fSlots.size(); i++ )
+      delete [] fSlots[i].buf;
+    fSlots.assign(nslots, EventSlot());
+  }
+  if( !fRingMutex ) {
+    fRingMutex = new TMutex();
+    fNotFull = new TCondition(fRingMutex);
+    fNotEmpty = new TCondition(fRingMutex);
+  }
+  fHead = fTail = fCount = 0;
+  fStop = kFALSE;
+  fHolding = kFALSE;
+  fReadDone = kFALSE;
+  fLastStatus = READ_OK;
+  fCurrent = 0;
+  fNRead = fReaderStalls = fConsumerStalls = fOccupancySum = 0;
+  fOccupancyMax = 0;
+
+  TThread::Initialize();
+  fReader = new TThread(ReaderThread, this);
+  fReader->Run();
+}
+
+//_____________________________________________________________________________
+void THcRun::StopReader()
+{
+  // Stop the reader thread. Events read ahead are discarded.
+
+  if( !fReader ) return;
+  fRingMutex->Lock();
+  fStop = kTRUE;
+  fNotFull->Signal();
+  fRingMutex->UnLock();
+  fReader->Join();
+  delete fReader;
+  fReader = 0;
+  fHolding = kFALSE;
+  fCurrent = 0;
+}
+
+//_____________________________________________________________________________
+void* THcRun::ReaderThread( void* arg )
+{
+  static_cast<THcRun*>(arg)->ReaderLoop();
+  return 0;
+}
+
+//_____________________________________________________________________________
+void THcRun::ReaderLoop()
+{
+  // Read events into the ring until end of file, an error, or Stop
+
+  UInt_t nslots = fSlots.size();
+  while( true ) {
+    fRingMutex->Lock();
+    if( fCount == nslots && !fStop ) {
+      // Ring full: the analysis is behind
+      fReaderStalls++;
+      while( fCount == nslots && !fStop )
+	fNotFull->Wait();
+    }
+    Bool_t stop = fStop;
+    fRingMutex->UnLock();
+    if( stop ) break;
+
+    EventSlot& slot = fSlots[fHead];
+    slot.status = ReadRaw(slot.buf, slot.size);
+    slot.leadin = fInLeadIn;
+    fHead = (fHead+1) % nslots;
+    fRingMutex->Lock();
+    fCount++;
+    fNotEmpty->Signal();
+    fRingMutex->UnLock();
+    if( slot.status != READ_OK ) break;
+  }
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::ReadDirect( const UInt_t*& evbuf, UInt_t*& buf, UInt_t& size )
+{
+  // Next event from the direct reader: evbuf points into the memory
+  // map, or to buf.  The lead-in events are read one by one, then the
+  // events from the start of the byte range.
+
+  if( fInLeadIn ) {
+    Int_t status;
+    if( fLeadNext < fLeadIn.size() ) {
+      status = fStream->Seek(fLeadIn[fLeadNext++]);
+      if( status == READ_OK )
+	status = fStream->NextEvent(evbuf, buf, size);
+      return status;
+    }
+    fInLeadIn = kFALSE;
+    status = fStream->Seek(fRangeStart);
+    if( status != READ_OK ) return status;
+  }
+  if( fRangeEnd >= 0 && fStream->Tell() >= fRangeEnd )
+    return READ_EOF;
+  return fStream->NextEvent(evbuf, buf, size);
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::ReadRaw( UInt_t*& buf, UInt_t& size )
+{
+  // Read the next event into buf, growing it if needed (size in words)
+
+  if( fStream && fStream->IsOpen() ) {
+    const UInt_t* evbuf;
+    Int_t status = ReadDirect(evbuf, buf, size);
+    if( status == READ_OK && evbuf != buf ) {
+      UInt_t len = evbuf[0]+1;
+      if( len > size ) {
+	delete [] buf;
+	size = len + len/4;
+	buf = new UInt_t[size];
+      }
+      memcpy(buf, evbuf, len*sizeof(UInt_t));
+    }
+    return status;
+  }
+  Int_t status = THaRun::ReadEvent();
+  if( status == READ_OK ) {
+    const UInt_t* evbuf = THaRun::GetEvBuffer();
+    UInt_t len = evbuf[0]+1;		// First word is the event length
+    if( len > size ) {
+      delete [] buf;
+      size = len + len/4;
+      buf = new UInt_t[size];
+    }
+    memcpy(buf, evbuf, len*sizeof(UInt_t));
+  }
+  return status;
+}
+
+//_____________________________________________________________________________
+Int_t THcRun::ReadEvent()
+{
+  // Make the next event current.  Without read-ahead and byte range
+  // this is THaRun::ReadEvent.
+
+  if( fReadAhead <= 0 ) {
+    if( !fStream || !fStream->IsOpen() )
+      return THaRun::ReadEvent();
+    const UInt_t* evbuf;
+    Int_t status = ReadDirect(evbuf, fDirectBuf, fDirectSize);
+    fCurrent = (status == READ_OK) ? evbuf : 0;
+    fLeadInEvent = fInLeadIn;
+    return status;
+  }
+
+  if( !fReader ) {
+    if( fReadDone ) return fLastStatus;
+    StartReader();
+  }
+  UInt_t nslots = fSlots.size();
+  fRingMutex->Lock();
+  if( fHolding ) {
+    // Done with the previous event, give its buffer back to the reader
+    fTail = (fTail+1) % nslots;
+    fCount--;
+    fHolding = kFALSE;
+    fNotFull->Signal();
+  }
+  if( fReadDone ) {
+    fRingMutex->UnLock();
+    return fLastStatus;
+  }
+  if( fCount == 0 ) {
+    // Ring empty: reading is behind
+    fConsumerStalls++;
+    while( fCount == 0 )
+      fNotEmpty->Wait();
+  }
+  UInt_t depth = fCount;
+  fRingMutex->UnLock();
+  fOccupancySum += depth;
+  if( depth > fOccupancyMax ) fOccupancyMax = depth;
+
+  EventSlot& slot = fSlots[fTail];
+  fHolding = kTRUE;
+  if( slot.status != READ_OK ) {
+    fReadDone = kTRUE;
+    fLastStatus = slot.status;
+    fCurrent = 0;
+    return fLastStatus;
+  }
+  fCurrent = slot.buf;
+  fLeadInEvent = slot.leadin;
+  fNRead++;
+  return READ_OK;
+}
+
+//_____________________________________________________________________________
+const UInt_t* THcRun::GetEvBuffer() const
+{
+  // Buffer of the current event
+
+  if( fReadAhead <= 0 && (!fStream || !fStream->IsOpen()) )
+    return THaRun::GetEvBuffer();
+  return fCurrent;
+}
+
+//_____________________________________________________________________________
+void THcRun::PrintReadAheadStats() const
+{
+  // Print the read-ahead counters
+
+  cout << "THcRun read-ahead (" << fReadAhead << " buffers): "
+       << fNRead << " events" << endl;
+  cout << "  reader stalls (ring full)    " << fReaderStalls << endl;
+  cout << "  analyzer stalls (ring empty) " << fConsumerStalls << endl;
+  cout << "  ring depth mean/max          "
+       << (fNRead > 0 ? (Double_t)fOccupancySum/fNRead : 0.0)
+       << " / " << fOccupancyMax << endl;
+}
+
+//_____________________________________________________________________________
+ClassImp(THcRun)
@@ -0,0 +1,120 @@
+#ifndef ROOT_THcRun
+#define ROOT_THcRun
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcRun                                                                    //
+//                                                                           //
+// Hall C CODA run, optionally reading events ahead on a separate thread.    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THaRun.h"
+#include <vector>
+
+class TThread;
+class TMutex;
+class TCondition;
+class THcEventIndex;
+class THcCodaStream;
+
+class THcRun : public THaRun {
+
+public:
+  THcRun( const char* filename="", const char* description="" );
+  THcRun( const THcRun& run );
+  virtual ~THcRun();
+  virtual THcRun& operator=( const THaRunBase& rhs );
+
+  virtual Int_t  Open();
+  virtual Int_t  Close();
+  virtual Int_t  ReadEvent();
+  virtual const UInt_t* GetEvBuffer() const;
+
+  // Read up to nbuffers events ahead on a reader thread (0 = off)
+  void   SetReadAhead( Int_t nbuffers ) { fReadAhead = nbuffers; }
+  Int_t  GetReadAhead() const { return fReadAhead; }
+  void   PrintReadAheadStats() const;
+
+  // Event index of the file (see THcEventIndex), read from the sidecar
+  // file or built.  Lets the analyzer seek to event ranges.
+  Int_t  UseIndex( Bool_t write=kTRUE );
+  THcEventIndex* GetIndex() const { return fIndex; }
+
+  // Read only the events starting in the byte range [start,end) of the
+  // file (end<0: to the end), start<0 to read the whole file again
+  void   SetByteRange( Long64_t start, Long64_t end=-1 );
+  // Before the byte range, read the events at offsets (from the index),
+  // e.g. the pedestal events before it.  An empty list for none.
+  void   SetLeadIn( const std::vector<Long64_t>& offsets ) { fLeadIn = offsets; }
+  // The current event is one of the lead-in
+  Bool_t IsLeadInEvent() const { return fLeadInEvent; }
+
+  // Read the file through a memory map, passing events to the decoder
+  // in place instead of copying them
+  void   SetMemoryMap( Bool_t map=kTRUE ) { fMemoryMap = map; }
+  Bool_t GetMemoryMap() const { return fMemoryMap; }
+
+protected:
+  Int_t  fReadAhead;           // Number of events to read ahead
+  THcEventIndex* fIndex;       // Event index, if used
+  Long64_t fRangeStart;        // Byte range to read, fRangeStart<0: all
+  Long64_t fRangeEnd;
+  std::vector<Long64_t> fLeadIn; // Offsets of the lead-in events
+  Bool_t fMemoryMap;           // Read through a memory map
+
+  // Direct reading of the byte range
+  THcCodaStream*  fStream;             //! Direct reader (range or map)
+  UInt_t*         fDirectBuf;          //! Event buffer in range mode
+  UInt_t          fDirectSize;         //! Its size in words
+  Bool_t          fInLeadIn;           //! Reading the lead-in events
+  UInt_t          fLeadNext;           //! Next lead-in event to read
+  Bool_t          fLeadInEvent;        //! Current event is from the lead-in
+
+  // Ring of fReadAhead+1 event buffers between the reader thread
+  // (producer, fHead) and ReadEvent (consumer, fTail).  fCount slots
+  // are filled, including the one of the event the consumer is working
+  // on, so the reader can be fReadAhead events ahead.
+  struct EventSlot {
+    UInt_t* buf;
+    UInt_t  size;              // Allocated words
+    Int_t   status;            // THaRun::ReadEvent status
+    Bool_t  leadin;            // Event is from the lead-in
+    EventSlot() : buf(0), size(0), status(0), leadin(kFALSE) {}
+  };
+  std::vector<EventSlot> fSlots;       //! Buffer pool
+  UInt_t          fHead;               //! Next slot the reader fills
+  UInt_t          fTail;               //! Slot of the current event
+  UInt_t          fCount;              //! Filled slots
+  Bool_t          fStop;               //! Tell the reader to stop
+  TMutex*         fRingMutex;          //! Guards fCount and fStop
+  TCondition*     fNotFull;            //! A slot was given back
+  TCondition*     fNotEmpty;           //! A slot was filled
+  Bool_t          fHolding;            //! Consumer holds slot fTail
+  Bool_t          fReadDone;           //! Reader has delivered EOF/error
+  Int_t           fLastStatus;         //! Status after fReadDone
+  const UInt_t*   fCurrent;            //! Current event buffer
+  TThread*        fReader;             //! Reader thread
+
+  // Read-ahead counters
+  ULong64_t fNRead;                    //! Events passed to the analyzer
+  ULong64_t fReaderStalls;             //! Reader found the ring full
+  ULong64_t fConsumerStalls;           //! Analyzer found the ring empty
+  ULong64_t fOccupancySum;             //! Sum of ring depth per event
+  UInt_t    fOccupancyMax;             //! Highest ring depth
+
+  virtual Int_t ReadInitInfo();
+
+  Int_t  OpenStream();
+  Bool_t IsDirect() const { return fRangeStart >= 0 || fMemoryMap; }
+  Int_t  ReadDirect( const UInt_t*& evbuf, UInt_t*& buf, UInt_t& size );
+  Int_t  ReadRaw( UInt_t*& buf, UInt_t& size );
+  void   StartReader();
+  void   StopReader();
+  void   ReaderLoop();
+  static void* ReaderThread( void* arg );
+
+  ClassDef(THcRun,3)   // Hall C CODA run with read-ahead
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include "THcParmList.h"
 #include "THcHitList.h"
 #include "THcHodoscope.h"
+#include "THcPedestalTracker.h"
 #include "TClass.h"
 
 #include <cstring>
@@ -40,6 +41,7 @@ THcScintillatorPlane::THcScintillatorPlane( const char* name,
   frNegTDCHits = new TClonesArray("THcSignalHit",16);
   frPosADCHits = new TClonesArray("THcSignalHit",16);
   frNegADCHits = new TClonesArray("THcSignalHit",16);
+  fFillHitLists = kTRUE;
   fPlaneNum = planenum;
   fTotPlanes = planenum;
   fNScinHits = 0; 
@@ -50,6 +52,8 @@ THcScintillatorPlane::THcScintillatorPlane( const char* name,
   fScinTime = new Double_t [fMaxHits];
   fScinSigma = new Double_t [fMaxHits];
   fScinZpos = new Double_t [fMaxHits];
+
+  fPedestals = NULL;
 }
 //______________________________________________________________________________
 THcScintillatorPlane::THcScintillatorPlane( const char* name, 
@@ -68,6 +72,7 @@ THcScintillatorPlane::THcScintillatorPlane( const char* name,
   frNegTDCHits = new TClonesArray("THcSignalHit",16);
   frPosADCHits = new TClonesArray("THcSignalHit",16);
   frNegADCHits = new TClonesArray("THcSignalHit",16);
+  fFillHitLists = kTRUE;
   fPlaneNum = planenum;
   fTotPlanes = totplanes;
   fNScinHits = 0;
@@ -78,6 +83,8 @@ THcScintillatorPlane::THcScintillatorPlane( const char* name,
   fScinTime = new Double_t [fMaxHits];
   fScinSigma = new Double_t [fMaxHits];
   fScinZpos = new Double_t [fMaxHits];
+
+  fPedestals = NULL;
 }
 
 //______________________________________________________________________________
@@ -97,6 +104,7 @@ THcScintillatorPlane::~THcScintillatorPlane()
   delete fScinSigma;
   delete fScinZpos;
 
+  delete fPedestals;
 }
 
 //______________________________________________________________________________
@@ -170,8 +178,10 @@ Int_t THcScintillatorPlane::ReadDatabase( const TDatime& date )
      {Form("scin_%s_center",GetName()), &fPosCenter[0],kDouble,fNelem},
      // this is from Xhodo.param...
           {"hodo_slop",&tmpdouble[0],kDouble,fTotPlanes},
+     {"hodo_ped_window",&fPedWindow,kInt,0,1},
      {0}
     };
+   fPedWindow = 0;		// Default if not defined
    gHcParms->LoadParmValues((DBRequest*)&list,prefix);
    // fetch the parameter from the temporary list
    fHodoSlop=tmpdouble[fPlaneNum-1];
@@ -317,14 +327,16 @@ Int_t THcScintillatorPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
     Int_t padnum=hit->fCounter;
 
     Int_t index=padnum-1;
-    if (hit->fTDC_pos > 0) 
-      ((THcSignalHit*) frPosTDCHits->ConstructedAt(nrPosTDCHits++))->Set(padnum, hit->fTDC_pos);
-    if (hit->fTDC_neg > 0) 
-      ((THcSignalHit*) frNegTDCHits->ConstructedAt(nrNegTDCHits++))->Set(padnum, hit->fTDC_neg);
-    if ((hit->fADC_pos-fPosPed[index]) >= 50) 
-      ((THcSignalHit*) frPosADCHits->ConstructedAt(nrPosADCHits++))->Set(padnum, hit->fADC_pos-fPosPed[index]);
-    if ((hit->fADC_neg-fNegPed[index]) >= 50) 
-      ((THcSignalHit*) frNegADCHits->ConstructedAt(nrNegADCHits++))->Set(padnum, hit->fADC_neg-fNegPed[index]);
+    if (fFillHitLists) {
+      if (hit->fTDC_pos > 0) 
+	((THcSignalHit*) frPosTDCHits->ConstructedAt(nrPosTDCHits++))->Set(padnum, hit->fTDC_pos);
+      if (hit->fTDC_neg > 0) 
+	((THcSignalHit*) frNegTDCHits->ConstructedAt(nrNegTDCHits++))->Set(padnum, hit->fTDC_neg);
+      if ((hit->fADC_pos-fPosPed[index]) >= 50) 
+	((THcSignalHit*) frPosADCHits->ConstructedAt(nrPosADCHits++))->Set(padnum, hit->fADC_pos-fPosPed[index]);
+      if ((hit->fADC_neg-fNegPed[index]) >= 50) 
+	((THcSignalHit*) frNegADCHits->ConstructedAt(nrNegADCHits++))->Set(padnum, hit->fADC_neg-fNegPed[index]);
+    }
     // check TDC values
     if (((hit->fTDC_pos >= mintdc) && (hit->fTDC_pos <= maxtdc)) ||
 	((hit->fTDC_neg >= mintdc) && (hit->fTDC_neg <= maxtdc))) {
@@ -548,29 +560,14 @@ Int_t THcScintillatorPlane::AccumulatePedestals(TClonesArray* rawhits, Int_t nex
       break;
     }
     Int_t element = hit->fCounter - 1; // Should check if in range
-    Int_t adcpos = hit->fADC_pos;
-    Int_t adcneg = hit->fADC_neg;
-
-    if(adcpos <= fPosPedLimit[element]) {
-      fPosPedSum[element] += adcpos;
-      fPosPedSum2[element] += adcpos*adcpos;
-      fPosPedCount[element]++;
-      if(fPosPedCount[element] == fMinPeds/5) {
-	fPosPedLimit[element] = 100 + fPosPedSum[element]/fPosPedCount[element];
-      }
-    }
-    if(adcneg <= fNegPedLimit[element]) {
-      fNegPedSum[element] += adcneg;
-      fNegPedSum2[element] += adcneg*adcneg;
-      fNegPedCount[element]++;
-      if(fNegPedCount[element] == fMinPeds/5) {
-	fNegPedLimit[element] = 100 + fNegPedSum[element]/fNegPedCount[element];
-      }
-    }
+
+    fPedestals->Fill(element, hit->fADC_pos);
+    fPedestals->Fill(fNelem+element, hit->fADC_neg);
+
     ihit++;
   }
 
-  fNPedestalEvents++;
+  fPedestals->EndEvent();
 
   return(ihit);
 }
@@ -581,14 +578,16 @@ void THcScintillatorPlane::CalculatePedestals( )
   // Use the accumulated pedestal data to calculate pedestals
   // Later add check to see if pedestals have drifted ("Danger Will Robinson!")
   //  cout << "Plane: " << fPlaneNum << endl;
+  fPedestals->Calculate();
+
   for(UInt_t i=0; i<fNelem;i++) {
     
     // Positive tubes
-    fPosPed[i] = ((Double_t) fPosPedSum[i]) / TMath::Max(1, fPosPedCount[i]);
+    fPosPed[i] = fPedestals->GetPed(i);
     fPosThresh[i] = fPosPed[i] + 15;
 
     // Negative tubes
-    fNegPed[i] = ((Double_t) fNegPedSum[i]) / TMath::Max(1, fNegPedCount[i]);
+    fNegPed[i] = fPedestals->GetPed(fNelem+i);
     fNegThresh[i] = fNegPed[i] + 15;
 
     //    cout <<"Pedestals "<< i+1 << " " << fPosPed[i] << " " << fNegPed[i] << endl;
@@ -600,31 +599,16 @@ void THcScintillatorPlane::CalculatePedestals( )
 //_____________________________________________________________________________
 void THcScintillatorPlane::InitializePedestals( )
 {
-  fNPedestalEvents = 0;
   fMinPeds = 500; 		// In engine, this is set in parameter file
-  fPosPedSum = new Int_t [fNelem];
-  fPosPedSum2 = new Int_t [fNelem];
-  fPosPedLimit = new Int_t [fNelem];
-  fPosPedCount = new Int_t [fNelem];
-  fNegPedSum = new Int_t [fNelem];
-  fNegPedSum2 = new Int_t [fNelem];
-  fNegPedLimit = new Int_t [fNelem];
-  fNegPedCount = new Int_t [fNelem];
+  delete fPedestals;
+  fPedestals = new THcPedestalTracker(2*fNelem);
+  fPedestals->Init(fMinPeds, 1000); // In engine, this are set in parameter file
+  fPedestals->SetWindow(fPedWindow);
 
   fPosPed = new Double_t [fNelem];
   fNegPed = new Double_t [fNelem];
   fPosThresh = new Double_t [fNelem];
   fNegThresh = new Double_t [fNelem];
-  for(UInt_t i=0;i<fNelem;i++) {
-    fPosPedSum[i] = 0;
-    fPosPedSum2[i] = 0;
-    fPosPedLimit[i] = 1000;	// In engine, this are set in parameter file
-    fPosPedCount[i] = 0;
-    fNegPedSum[i] = 0;
-    fNegPedSum2[i] = 0;
-    fNegPedLimit[i] = 1000;	// In engine, this are set in parameter file
-    fNegPedCount[i] = 0;
-  }
 }
 //____________________________________________________________________________
 Int_t THcScintillatorPlane::GetNelem() 
@@ -17,6 +17,7 @@
 
 class THaEvData;
 class THaSignalHit;
+class THcPedestalTracker;
 
 class THcScintillatorPlane : public THaSubDetector {
   
@@ -61,6 +62,9 @@ class THcScintillatorPlane : public THaSubDetector {
   Double_t GetScinZpos(Int_t index) { return fScinZpos[index];};
   Int_t GetNScinGoodHits() const {return fNScinGoodHits;};
 
+  // Fill the raw hit lists (postdchits etc.), only used for output
+  void SetFillHitLists(Bool_t fill) { fFillHitLists = fill; }
+
   TClonesArray* fParentHitList;
 
   TClonesArray* GetPosADC() { return fPosADCHits;};  // Ahmed
@@ -74,6 +78,7 @@ class THcScintillatorPlane : public THaSubDetector {
   TClonesArray* frNegTDCHits;
   TClonesArray* frPosADCHits;
   TClonesArray* frNegADCHits;
+  Bool_t fFillHitLists;
   TClonesArray* fPosTDCHits;
   TClonesArray* fNegTDCHits;
   TClonesArray* fPosADCHits;
@@ -98,16 +103,10 @@ class THcScintillatorPlane : public THaSubDetector {
 
   Double_t fTolerance; /* need this for PulseHeightCorrection */
   /* Pedestal Quantities */
-  Int_t fNPedestalEvents;	/* Number of pedestal events */
   Int_t fMinPeds;		/* Only analyze/update if num events > */
-  Int_t *fPosPedSum;		/* Accumulators for pedestals */
-  Int_t *fPosPedSum2;
-  Int_t *fPosPedLimit;
-  Int_t *fPosPedCount;
-  Int_t *fNegPedSum;
-  Int_t *fNegPedSum2;
-  Int_t *fNegPedLimit;
-  Int_t *fNegPedCount;
+  Int_t fPedWindow;		/* Running pedestal window, 0 = whole run */
+  THcPedestalTracker* fPedestals; /* Pedestal accumulator, positive tubes
+				     first, then negative */
 
   Double_t *fPosPed;
   Double_t *fPosSig;
@@ -10,6 +10,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "THcShower.h"
+#include "THcProfiler.h"
 #include "THcHallCSpectrometer.h"
 #include "THaEvData.h"
 #include "THaDetMap.h"
@@ -22,6 +23,8 @@
 #include "THaTrack.h"
 #include "TClonesArray.h"
 #include "THaTrackProj.h"
+#include "THaFormula.h"
+#include "THaRunBase.h"
 #include "TMath.h"
 
 #include <cstring>
@@ -41,6 +44,13 @@ THcShower::THcShower( const char* name, const char* description,
   fNLayers = 0;			// No layers until we make them
 
   fClusterList = new THcShowerClusterList;
+
+  fGainCalibOn = 0;
+  fGainCalibFormula = 0;
+  fGainCalib = 0;
+  fGainCalibSolved = kFALSE;
+
+  fHitListsBlock = AddComputeBlock("hitlists","*.posadchits *.negadchits");
 }
 
 //_____________________________________________________________________________
@@ -48,6 +58,11 @@ THcShower::THcShower( ) :
   THaNonTrackingDetector()
 {
   // Constructor
+
+  fGainCalibOn = 0;
+  fGainCalibFormula = 0;
+  fGainCalib = 0;
+  fGainCalibSolved = kFALSE;
 }
 
 //_____________________________________________________________________________
@@ -193,6 +208,20 @@ Int_t THcShower::ReadDatabase( const TDatime& date )
     gHcParms->LoadParmValues((DBRequest*)&list, prefix);
   }
 
+  // Gain calibration during the replay, also enabled by SetGainCalib.
+  {
+    Int_t gaincalib = 0;
+    DBRequest list[]={
+      {"cal_gain_calib", &gaincalib, kInt, 0, 1},
+      {0}
+    };
+    gHcParms->LoadParmValues((DBRequest*)&list, prefix);
+    if (gaincalib) fGainCalibOn = 1;
+
+    const char* cut = gHcParms->GetString(Form("%scal_gain_calib_cut",prefix));
+    if (fGainCalibCut.IsNull() && cut) fGainCalibCut = cut;
+  }
+
   // Debug output.
   if (fdbg_init_cal) {
     cout << "---------------------------------------------------------------\n";
@@ -334,8 +363,10 @@ Int_t THcShower::ReadDatabase( const TDatime& date )
     {"cal_neg_ped_limit", fShNegPedLimit, kInt,    fNtotBlocks},
     {"cal_neg_gain_cor",  hcal_neg_gain_cor,  kDouble, fNtotBlocks},
     {"cal_min_peds", &fShMinPeds, kInt},
+    {"cal_ped_window", &fShPedWindow, kInt, 0, 1},
     {0}
   };
+  fShPedWindow = 0;           // Default if not defined
   gHcParms->LoadParmValues((DBRequest*)&list, prefix);
 
   // Debug output.
@@ -404,6 +435,11 @@ Int_t THcShower::ReadDatabase( const TDatime& date )
     fNegGain[i] = hcal_neg_cal_const[i] *  hcal_neg_gain_cor[i];
   }
 
+  // Kept for the gains of the gain calibration (ApplyGainCalib).
+
+  fPosCalConst.assign(hcal_pos_cal_const, hcal_pos_cal_const+fNtotBlocks);
+  fNegCalConst.assign(hcal_neg_cal_const, hcal_neg_cal_const+fNtotBlocks);
+
   // Debug output.
   if (fdbg_init_cal) {
 
@@ -471,6 +507,7 @@ Int_t THcShower::DefineVariables( EMode mode )
     { "etot", "Total energy",                            "fEtot" },
     { "etotnorm", "Total energy divided by Central Momentum",   "fEtotNorm" },
     { "ntracks", "Number of shower tracks",                      "fNtracks" },
+    { "nrawhits", "Number of raw hits after decode",             "fNRawHits" },
     { 0 }
   };
   return DefineVarsFromList( vars, mode );
@@ -490,6 +527,8 @@ THcShower::~THcShower()
     fTrackProj->Clear();
     delete fTrackProj; fTrackProj = 0;
   }
+  delete fGainCalibFormula; fGainCalibFormula = 0;
+  delete fGainCalib; fGainCalib = 0;
 }
 
 //_____________________________________________________________________________
@@ -535,6 +574,7 @@ void THcShower::Clear(Option_t* opt)
 //_____________________________________________________________________________
 Int_t THcShower::Decode( const THaEvData& evdata )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kDecode);
 
   Clear();
 
@@ -543,7 +583,7 @@ Int_t THcShower::Decode( const THaEvData& evdata )
 
   fEvent = evdata.GetEvNum();
 
-  if(gHaCuts->Result("Pedestal_event")) {
+  if(IsPedestalEvent()) {
     Int_t nexthit = 0;
     for(UInt_t ip=0;ip<fNLayers;ip++) {
       nexthit = fPlanes[ip]->AccumulatePedestals(fRawHitList, nexthit);
@@ -561,6 +601,7 @@ Int_t THcShower::Decode( const THaEvData& evdata )
 
   Int_t nexthit = 0;
   for(UInt_t ip=0;ip<fNLayers;ip++) {
+    fPlanes[ip]->SetFillHitLists(IsComputed(fHitListsBlock));
     nexthit = fPlanes[ip]->ProcessHits(fRawHitList, nexthit);
     fEtot += fPlanes[ip]->GetEplane();
   }
@@ -573,6 +614,8 @@ Int_t THcShower::Decode( const THaEvData& evdata )
 //_____________________________________________________________________________
 Int_t THcShower::CoarseProcess( TClonesArray& tracks)
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kCoarseProcess);
+
   // Calculation of coordinates of particle track cross point with shower
   // plane in the detector coordinate system. For this, parameters of track 
   // reconstructed in THaVDC::CoarseTrack() are used.
@@ -588,7 +631,12 @@ Int_t THcShower::CoarseProcess( TClonesArray& tracks)
 
   for(UInt_t j=0; j < fNLayers; j++) {
 
-    for (UInt_t i=0; i<fNBlocks[j]; i++) {
+    // Visit only the blocks which the plane found above threshold
+    // (ENGINE way) in ProcessHits, in ascending order.
+
+    for (Int_t k=0; k<fPlanes[j]->GetNGoodBlocks(); k++) {
+
+      Int_t i = fPlanes[j]->GetGoodBlock(k);
 
       //May be should be done this way.
       //
@@ -598,23 +646,15 @@ Int_t THcShower::CoarseProcess( TClonesArray& tracks)
       //	Double_t z = fNLayerZPos[j] + BlockThick[j]/2.;//front + thick/2
       //      	THcShowerHit* hit = new THcShowerHit(i,j,x,z,Edep);
 
-      //ENGINE way.
-      //
-      if (fPlanes[j]->GetApos(i) - fPlanes[j]->GetPosPed(i) >
-	  fPlanes[j]->GetPosThr(i) - fPlanes[j]->GetPosPed(i) ||
-	  fPlanes[j]->GetAneg(i) - fPlanes[j]->GetNegPed(i) >
-	  fPlanes[j]->GetNegThr(i) - fPlanes[j]->GetNegPed(i)) {    //hit
+      Double_t Edep = fPlanes[j]->GetEmean(i);
+      Double_t Epos = fPlanes[j]->GetEpos(i);
+      Double_t Eneg = fPlanes[j]->GetEneg(i);
+      Double_t x = XPos[j][i] + BlockThick[j]/2.;        //top + thick/2
+      Double_t z = fNLayerZPos[j] + BlockThick[j]/2.;    //front + thick/2
 
-	Double_t Edep = fPlanes[j]->GetEmean(i);
-	Double_t Epos = fPlanes[j]->GetEpos(i);
-	Double_t Eneg = fPlanes[j]->GetEneg(i);
-	Double_t x = XPos[j][i] + BlockThick[j]/2.;        //top + thick/2
-	Double_t z = fNLayerZPos[j] + BlockThick[j]/2.;    //front + thick/2
+      THcShowerHit* hit = new THcShowerHit(i,j,x,z,Edep,Epos,Eneg);
 
-	THcShowerHit* hit = new THcShowerHit(i,j,x,z,Edep,Epos,Eneg);
-
-	HitSet.insert(hit);   //<set> version
-      }
+      HitSet.insert(hit);   //<set> version
 
     }
   }
@@ -640,6 +680,10 @@ Int_t THcShower::CoarseProcess( TClonesArray& tracks)
 
   fNclust = (*fClusterList).size();   //number of clusters
 
+  // Summarize the clusters for the track matching and energy calculation.
+
+  SummarizeClusters();
+
   //Debug output, print out the cluster list.
 
   if (fdbg_clusters_cal) {
@@ -650,11 +694,12 @@ Int_t THcShower::CoarseProcess( TClonesArray& tracks)
     for (THcShowerClusterListIt ppcl = (*fClusterList).begin();
 	 ppcl != (*fClusterList).end(); ppcl++) {
 
+      THcShowerClusterSum& sum = fClusterSum[i];
       cout << "  Cluster #" << i++
-	   <<":  E=" << clE(*ppcl) 
-	   << "  Epr=" << clEpr(*ppcl)
-	   << "  X=" << clX(*ppcl)
-	   << "  Z=" << clZ(*ppcl)
+	   <<":  E=" << sum.E
+	   << "  Epr=" << sum.Epr
+	   << "  X=" << sum.X
+	   << "  Z=" << sum.Z
 	   << "  size=" << (**ppcl).size()
 	   << endl;
 
@@ -723,6 +768,49 @@ void THcShower::ClusterHits(THcShowerHitSet& HitSet) {
 
 //-----------------------------------------------------------------------------
 
+void THcShower::SummarizeClusters() {
+
+  // Fill in summaries for the clusters in the fClusterList. The summary
+  // list is not shrunk, so its per-plane buffers are reused event by event.
+
+  if (fClusterSum.size() < (UInt_t) fNclust) fClusterSum.resize(fNclust);
+
+  for (Int_t i=0; i<fNclust; i++)
+    fClusterSum[i].Fill(*(fClusterList->begin()+i), fNLayers);
+
+}
+
+//-----------------------------------------------------------------------------
+
+void THcShowerClusterSum::Fill(THcShowerCluster* cluster, UInt_t nlayers) {
+
+  // Accumulate all the summary quantities in a single pass over the cluster.
+  // The hits are summed in the same order as by the clX, clE, ... helpers,
+  // so the results are identical to theirs.
+
+  E = Epr = 0.;
+  Double_t xsum = 0.;
+  Double_t zsum = 0.;
+  Epos.assign(nlayers, 0.);
+  Eneg.assign(nlayers, 0.);
+
+  for (THcShowerClusterIt it=(*cluster).begin(); it!=(*cluster).end(); ++it) {
+    THcShowerHit* hit = *it;
+    E += hit->hitE();
+    xsum += hit->hitE() * hit->hitX();
+    zsum += hit->hitE() * hit->hitZ();
+    Int_t ip = hit->hitColumn();
+    if (ip == 0) Epr += hit->hitE();
+    Epos[ip] += hit->hitEpos();
+    Eneg[ip] += hit->hitEneg();
+  }
+
+  X = (E != 0. ? xsum/E : -75.);
+  Z = (E != 0. ? zsum/E : 0.);
+}
+
+//-----------------------------------------------------------------------------
+
 // Various helper functions to accumulate hit related quantities.
 
 Double_t addE(Double_t x, THcShowerHit* h) {
@@ -794,24 +882,23 @@ Double_t clEplane(THcShowerCluster* cluster, Int_t iplane, Int_t side) {
     return -1;
   }
 
-  THcShowerHitSet pcluster;
-  for (THcShowerHitIt it=(*cluster).begin(); it!=(*cluster).end(); ++it) {
-    if ((*it)->hitColumn() == iplane) pcluster.insert(*it);
-  }
+  // Sum over the hits of the plane in place, without copying them into
+  // a temporary set.
 
-  Double_t Eplane;
-  switch (side) {
-  case 0 :
-    Eplane = accumulate(pcluster.begin(),pcluster.end(),0.,addEpos);
-    break;
-  case 1 :
-    Eplane = accumulate(pcluster.begin(),pcluster.end(),0.,addEneg);
-    break;
-  case 2 :
-    Eplane = accumulate(pcluster.begin(),pcluster.end(),0.,addE);
-    break;
-  default :
-    Eplane = 0. ;
+  Double_t Eplane = 0.;
+  for (THcShowerHitIt it=(*cluster).begin(); it!=(*cluster).end(); ++it) {
+    if ((*it)->hitColumn() != iplane) continue;
+    switch (side) {
+    case 0 :
+      Eplane = addEpos(Eplane, *it);
+      break;
+    case 1 :
+      Eplane = addEneg(Eplane, *it);
+      break;
+    case 2 :
+      Eplane = addE(Eplane, *it);
+      break;
+    }
   }
 
   return Eplane;
@@ -875,13 +962,12 @@ Int_t THcShower::MatchCluster(THaTrack* Track,
   if (inFidVol) {
 
     // Since hits and clusters are in reverse order (with respect to Engine),
-    // search backwards to be consistent with Engine.
+    // search backwards to be consistent with Engine. Use the precomputed
+    // cluster summaries rather than traversing cluster hits for each track.
     //
     for (Int_t i=fNclust-1; i>-1; i--) {
 
-      THcShowerCluster* cluster = *(fClusterList->begin()+i);
-
-      Double_t dx = TMath::Abs( clX(cluster) - XTrFront );
+      Double_t dx = TMath::Abs( fClusterSum[i].X - XTrFront );
 
       if (dx <= (0.5*BlockThick[0] + fSlop)) {
 	fNtracks++;  // number of shower tracks (Consistent with engine)
@@ -941,9 +1027,9 @@ Float_t THcShower::GetShEnergy(THaTrack* Track) {
   Float_t Etrk = 0.;
   if (mclust >= 0) {         // if there is a matched cluster
 
-    // Get matched cluster.
+    // Get summary of the matched cluster.
 
-    THcShowerCluster* cluster = *(fClusterList->begin()+mclust);
+    THcShowerClusterSum& cluster = fClusterSum[mclust];
 
     // Correct track energy depositions for the impact coordinate.
 
@@ -963,8 +1049,8 @@ Float_t THcShower::GetShEnergy(THaTrack* Track) {
 	corneg = 0.;
       }
 
-      Etrk += clEplane(cluster,ip,0) * corpos;
-      Etrk += clEplane(cluster,ip,1) * corneg;
+      Etrk += cluster.Epos[ip] * corpos;
+      Etrk += cluster.Eneg[ip] * corneg;
 
     }   //over planes
 
@@ -992,6 +1078,7 @@ Float_t THcShower::GetShEnergy(THaTrack* Track) {
 //_____________________________________________________________________________
 Int_t THcShower::FineProcess( TClonesArray& tracks )
 {
+  THcProfiler::Timer timer(fProfiler, fProfileId, THcProfiler::kFineProcess);
 
   // Shower energy assignment to the spectrometer tracks.
   //
@@ -1007,6 +1094,11 @@ Int_t THcShower::FineProcess( TClonesArray& tracks )
 
   }       //over tracks
 
+  // Gain calibration sums from single track, single cluster events.
+
+  if (fGainCalib && Ntracks == 1 && fNclust == 1)
+    AccumulateGains(static_cast<THaTrack*>( tracks[0] ));
+
   //Debug output.
 
   if (fdbg_tracks_cal) {
@@ -1031,9 +1123,168 @@ Int_t THcShower::FineProcess( TClonesArray& tracks )
   return 0;
 }
 
+//_____________________________________________________________________________
+void THcShower::SetGainCalib(Bool_t enable, const char* cut)
+{
+  // Enable the gain calibration. The optional cut expression selects
+  // electrons, e.g. "H.cer.npesum>3.&&H.tr.beta>0.740&&H.tr.beta<0.935"
+  // as in hcal_calib/hcal_replay_cuts.def. It is evaluated in FineProcess,
+  // so it can only use the variables of detectors processed before the
+  // calorimeter.
+
+  fGainCalibOn = enable ? 1 : 0;
+  if (cut) fGainCalibCut = cut;
+}
+
+//_____________________________________________________________________________
+Int_t THcShower::Begin( THaRunBase* )
+{
+  // Set up the gain calibration, once the global variables of all
+  // detectors are defined.
+
+  delete fGainCalibFormula; fGainCalibFormula = 0;
+  delete fGainCalib; fGainCalib = 0;
+  fGainCalibSolved = kFALSE;
+
+  if (!fGainCalibOn) return 0;
+
+  if (!fGainCalibCut.IsNull()) {
+    fGainCalibFormula = new THaFormula(Form("%sgaincut",GetPrefix()),
+				       fGainCalibCut.Data(), gHaVars, gHaCuts);
+    if (fGainCalibFormula->IsError()) {
+      Error( Here("Begin()"), "Bad gain calibration cut \"%s\", gain "
+	     "calibration disabled.", fGainCalibCut.Data() );
+      delete fGainCalibFormula; fGainCalibFormula = 0;
+      return 0;
+    }
+  }
+
+  // Channels: positive side PMTs of all blocks, then the negative side
+  // PMTs of the blocks in the first fNegCols layers. Initial gains as in
+  // THcShowerCalib: 0.5 for the two-PMT blocks, 1 for the others.
+
+  UInt_t nneg = 0;
+  for (UInt_t ip=0; ip<fNegCols && ip<fNLayers; ip++)
+    nneg += fNBlocks[ip];
+
+  vector<Double_t> alpha0(fNtotBlocks+nneg, 1.);
+  for (UInt_t i=0; i<nneg; i++) {
+    alpha0[i] = 0.5;
+    alpha0[fNtotBlocks+i] = 0.5;
+  }
+
+  fGainCalib = new THcShowerGainCalib;
+  fGainCalib->Init(fNtotBlocks, nneg, &alpha0[0]);
+
+  return 0;
+}
+
+//_____________________________________________________________________________
+void THcShower::AccumulateGains(THaTrack* Track)
+{
+  // Add the PMT signals of the event with unit gains to the gain
+  // calibration, as THcShowerCalib::AccumulateVMs does for an entry of
+  // the calibration tree.
+
+  if (TMath::Abs(Track->GetDp()) >= 10.) return;
+  if (fGainCalibFormula && fGainCalibFormula->Eval() == 0.) return;
+
+  UInt_t npmts = fGainCalib->GetNPmts();
+  UInt_t nneg = npmts - fNtotBlocks;
+  fGainChannel.resize(npmts);
+  fGainSignal.resize(npmts);
+
+  // Track at the front of the calorimeter.
+
+  Double_t Yfront = Track->GetY() + Track->GetPhi()*fNLayerZPos[0];
+  Double_t Yp = Track->GetPhi();
+
+  UInt_t n = 0;
+  UInt_t nelem = 0;
+  for (UInt_t ip=0; ip<fNLayers; ip++) {
+
+    // Track at the middle of the layer.
+    Double_t y = Yfront +
+      Yp*(fNLayerZPos[ip] - fNLayerZPos[0] + BlockThick[ip]/2.);
+
+    THcShowerPlane* plane = fPlanes[ip];
+    for (Int_t k=0; k<plane->GetNGoodBlocks(); k++) {
+      Int_t i = plane->GetGoodBlock(k);
+      Double_t apos = plane->GetAposP(i);
+      Double_t aneg = plane->GetAnegP(i);
+      if (!(apos > 0. || aneg > 0.)) continue;
+
+      UInt_t nb = nelem + i;
+      if (ip < fNegCols && nb < nneg) {
+	fGainChannel[n] = nb;
+	fGainSignal[n++] = apos*Ycor(y,0);
+	fGainChannel[n] = fNtotBlocks + nb;
+	fGainSignal[n++] = aneg*Ycor(y,1);
+      }
+      else {
+	fGainChannel[n] = nb;
+	fGainSignal[n++] = apos*Ycor(y);
+      }
+    }
+    nelem += fNBlocks[ip];
+  }
+
+  fGainCalib->AddEvent(n, &fGainChannel[0], &fGainSignal[0], Track->GetP());
+}
+
+//_____________________________________________________________________________
+Int_t THcShower::End( THaRunBase* run )
+{
+  // Solve for the gains and write them to <spectrometer>cal.param.<run>.
+
+  if (!fGainCalib) return 0;
+
+  char prefix = tolower(GetApparatus()->GetName()[0]);
+  Int_t runnum = run ? run->GetNumber() : 0;
+
+  if (fGainCalib->Solve() < 0) {
+    cout << "THcShower::End: no gain calibration for " << GetName()
+	 << ", " << fGainCalib->GetNEvents() << " events" << endl;
+    return 0;
+  }
+  fGainCalibSolved = kTRUE;
+  fGainCalib->Print();
+
+  TString fname = Form("%ccal.param.%d",prefix,runnum);
+  fGainCalib->WriteParam(fname, Form("%c",prefix), fNBlocks[0], runnum);
+  cout << "THcShower::End: gains written to " << fname << endl;
+
+  return 0;
+}
+
+//_____________________________________________________________________________
 Double_t THcShower::GetNormETot( ){
   return fEtotNorm;
 } 
 
+//_____________________________________________________________________________
+Int_t THcShower::ApplyGainCalib()
+{
+  // Replace the gains by the ones solved for at the end of the last run,
+  // so that a following pass over the data (see THcCalibDriver) uses
+  // them.  As in ReadDatabase, the gains are the calibration constants
+  // times the gain corrections, which is what the calibration solves for.
+  // Returns -1 if there are no solved gains.
+
+  if (!fGainCalib || !fGainCalibSolved) return -1;
+
+  UInt_t nneg = fGainCalib->GetNPmts() - fNtotBlocks;
+  for (UInt_t i=0; i<fNtotBlocks; i++) {
+    fPosGain[i] = fPosCalConst[i] * fGainCalib->GetGain(i);
+    if (i < nneg)
+      fNegGain[i] = fNegCalConst[i] * fGainCalib->GetGain(fNtotBlocks+i);
+  }
+
+  for (UInt_t ip=0; ip<fNLayers; ip++)
+    fPlanes[ip]->UpdateGains();
+
+  return 0;
+}
+
 ClassImp(THcShower)
 ////////////////////////////////////////////////////////////////////////////////
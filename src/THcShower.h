@@ -11,8 +11,10 @@
 #include "THaNonTrackingDetector.h"
 #include "THcHitList.h"
 #include "THcShowerPlane.h"
+#include "THcShowerGainCalib.h"
 #include "TMath.h"
 
+class THaFormula;
 
 // HMS calorimeter hits, version 2
 
@@ -135,6 +137,25 @@ typedef THcShowerClusterList::iterator THcShowerClusterListIt;
 
 //______________________________________________________________________________
 
+// Summary of a cluster: energy depositions and center of gravity, calculated
+// once per event after clustering, so that track matching and track energy
+// calculation do not need to traverse the cluster's hits again.
+//
+struct THcShowerClusterSum {
+  Double_t E;              // cluster energy deposition
+  Double_t Epr;            // energy deposition in the Preshower (1st plane)
+  Double_t X;              // energy weighted X (-75 cm if no energy)
+  Double_t Z;              // energy weighted Z (0 cm if no energy)
+  vector<Double_t> Epos;   // [fNLayers] energy from positive PMTs, per plane
+  vector<Double_t> Eneg;   // [fNLayers] energy from negative PMTs, per plane
+
+  void Fill(THcShowerCluster* cluster, UInt_t nlayers);
+};
+
+typedef vector<THcShowerClusterSum> THcShowerClusterSumList;
+
+//______________________________________________________________________________
+
 class THcShower : public THaNonTrackingDetector, public THcHitList {
 
 public:
@@ -153,6 +174,8 @@ public:
   
   Int_t GetNBlocks(Int_t NLayer) const { return fNBlocks[NLayer];}
 
+  THcShowerPlane* GetPlane(Int_t NLayer) const { return fPlanes[NLayer];}
+
   Double_t GetXPos(Int_t NLayer, Int_t NRaw) const {
     return XPos[NLayer][NRaw];
   }
@@ -195,6 +218,10 @@ public:
     return fShMinPeds;
   }
 
+  Int_t GetPedWindow() {
+    return fShPedWindow;
+  }
+
   Int_t GetNLayers() {
     return fNLayers;
   }
@@ -223,6 +250,17 @@ public:
 
   Float_t GetShEnergy(THaTrack*);
 
+  // Accumulate the gain calibration of the PMTs during the replay, from
+  // events with one track, one cluster and |dp|<10% that pass the cut
+  // expression, and write the gains to hcal.param.<run> at the end.
+  void SetGainCalib(Bool_t enable=kTRUE, const char* cut=0);
+  THcShowerGainCalib* GetGainCalib() const { return fGainCalib; }
+  // Use the gains solved for at the end of the last run
+  Int_t ApplyGainCalib();
+
+  virtual Int_t Begin( THaRunBase* run=0 );
+  virtual Int_t End( THaRunBase* run=0 );
+
   THcShower();  // for ROOT I/O
 
 protected:
@@ -235,6 +273,7 @@ protected:
   Int_t* fShNegPedLimit;
 
   Int_t fShMinPeds;          // Min.number of events to analyze pedestals.
+  Int_t fShPedWindow;        // Running pedestal window, 0 for whole run.
 
   Double_t* fPosGain;        // [fNtotBlocks] Gain constants from calibration
   Double_t* fNegGain;
@@ -249,12 +288,16 @@ protected:
   Double_t fEtotNorm;             // Total energy divided by spec central momentum 
 
   THcShowerClusterList* fClusterList;   // List of hit clusters
+  THcShowerClusterSumList fClusterSum;  // [fNclust] Cluster summaries. Not
+                                        // shrunk between events to reuse
+                                        // the per-plane buffers.
 
 
   // Geometrical parameters.
 
   char** fLayerNames;
   UInt_t fNLayers;	        // Number of layers in the calorimeter
+  Int_t fHitListsBlock;         // Compute block of the planes' ADC hit lists
   Double_t* fNLayerZPos;	// Z positions of fronts of layers
   Double_t* BlockThick;		// Thickness of blocks
   UInt_t* fNBlocks;              // [fNLayers] number of blocks per layer
@@ -287,6 +330,16 @@ protected:
 
   THcShowerPlane** fPlanes;     // [fNLayers] Shower Plane objects
 
+  Int_t fGainCalibOn;           // Gain calibration flag
+  TString fGainCalibCut;        // Gain calibration event selection
+  THaFormula* fGainCalibFormula;
+  THcShowerGainCalib* fGainCalib;
+  Bool_t fGainCalibSolved;      // fGainCalib holds solved gains
+  vector<Double_t> fPosCalConst; // [fNtotBlocks] cal_pos_cal_const
+  vector<Double_t> fNegCalConst; // [fNtotBlocks] cal_neg_cal_const
+  vector<UInt_t> fGainChannel;  // Per-event PMT channels and signals
+  vector<Double_t> fGainSignal;
+
   TClonesArray*  fTrackProj;    // projection of track onto plane
 
   void           ClearEvent();
@@ -300,6 +353,8 @@ protected:
   Int_t MatchCluster(THaTrack*, Double_t&, Double_t&);
 
   void ClusterHits(THcShowerHitSet& HitSet);
+  void AccumulateGains(THaTrack* Track);
+  void SummarizeClusters();
 
   friend class THcShowerPlane;   //to access debug flags.
 
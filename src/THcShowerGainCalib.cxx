@@ -0,0 +1,267 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcShowerGainCalib                                                        //
+//                                                                           //
+// Gain calibration of the calorimeter PMTs from electron tracks, with the   //
+// method of the stand-alone hcal_calib/THcShowerCalib, but accumulated      //
+// during a replay instead of from a tree of calibration events.             //
+//                                                                           //
+// THcShowerCalib histograms the normalized energy depositions Edep/P of    //
+// all events with the initial gains, keeps the events within +/-3 RMS of   //
+// the mean, and sums the vectors qe, q0 and the matrix Q of the normal      //
+// equations over them.  Here the sums are kept separately for each of the  //
+// 500 bins of the same Edep/P histogram, so that the thresholds can be      //
+// applied at the end: a bin is used if its center is within the            //
+// thresholds.  Only bins with events take memory.                           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcShowerGainCalib.h"
+#include "THcSymSolver.h"
+#include "TMath.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+
+using namespace std;
+
+static const Double_t kEmax = 5.;     // Upper edge of the Edep/P histogram
+
+//_____________________________________________________________________________
+THcShowerGainCalib::THcShowerGainCalib() :
+  fNpos(0), fNneg(0), fNpmts(0), fBins(kNbins,(BinSums*)0)
+{
+  // Constructor
+
+  Clear();
+}
+
+//_____________________________________________________________________________
+THcShowerGainCalib::~THcShowerGainCalib()
+{
+  // Destructor
+
+  Clear();
+}
+
+//_____________________________________________________________________________
+void THcShowerGainCalib::Init( UInt_t npos, UInt_t nneg,
+			       const Double_t* alpha0 )
+{
+  // Set up the sums for npos positive and nneg negative side PMTs.
+  // Channels [0,npos) are the positive, [npos,npos+nneg) the negative
+  // side PMTs.
+
+  Clear();
+
+  fNpos = npos;
+  fNneg = nneg;
+  fNpmts = npos + nneg;
+  fAlpha0.assign(alpha0, alpha0+fNpmts);
+  fAlphaC.assign(fNpmts, 0.);
+  fHitCount.assign(fNpmts, 0);
+}
+
+//_____________________________________________________________________________
+void THcShowerGainCalib::Clear( Option_t* )
+{
+  // Reset the sums
+
+  for (UInt_t i=0; i<fBins.size(); i++) {
+    delete fBins[i];
+    fBins[i] = 0;
+  }
+  fNev = fNused = fNsum = 0;
+  fSumE = fSumE2 = 0.;
+  fLoThr = fHiThr = 0.;
+  fCondition = 0.;
+  fAlphaC.assign(fNpmts, 0.);
+  fHitCount.assign(fNpmts, 0);
+}
+
+//_____________________________________________________________________________
+void THcShowerGainCalib::AddEvent( UInt_t n, const UInt_t* channel,
+				   const Double_t* signal, Double_t P )
+{
+  // Add the sums of an event to the bin of its normalized energy
+  // deposition with the initial gains.
+
+  if (fNpmts == 0 || P <= 0.) return;
+
+  fNev++;
+
+  Double_t Enorm = 0.;
+  for (UInt_t i=0; i<n; i++)
+    Enorm += signal[i]*fAlpha0[channel[i]];
+  Enorm /= P*1000.;
+
+  if (Enorm < 0. || Enorm >= kEmax) return;
+
+  fSumE += Enorm;
+  fSumE2 += Enorm*Enorm;
+  fNsum++;
+
+  Int_t ibin = TMath::Min(Int_t(Enorm/kEmax*kNbins), kNbins-1);
+  BinSums* sums = fBins[ibin];
+  if (!sums) {
+    sums = fBins[ibin] = new BinSums;
+    sums->nev = 0;
+    sums->e0 = 0.;
+    sums->qe.assign(fNpmts, 0.);
+    sums->q0.assign(fNpmts, 0.);
+    sums->Q.assign(fNpmts*(fNpmts+1)/2, 0.);
+    sums->hitcount.assign(fNpmts, 0);
+  }
+
+  Double_t Pmev = P*1000.;
+  sums->e0 += Pmev;
+  for (UInt_t i=0; i<n; i++) {
+    UInt_t ic = channel[i];
+    sums->qe[ic] += signal[i]*Pmev;
+    sums->q0[ic] += signal[i];
+    sums->hitcount[ic]++;
+    for (UInt_t j=i; j<n; j++) {
+      UInt_t jc = channel[j];
+      sums->Q[ ic<=jc ? Index(ic,jc) : Index(jc,ic) ] += signal[i]*signal[j];
+    }
+  }
+  sums->nev++;
+}
+
+//_____________________________________________________________________________
+Int_t THcShowerGainCalib::Solve()
+{
+  // Apply the +/-3 RMS thresholds and solve for the gains as
+  // THcShowerCalib::SolveAlphas.  Returns the number of calibrated PMTs,
+  // or -1 if there are no events.
+
+  fAlphaC.assign(fNpmts, 0.);
+  fHitCount.assign(fNpmts, 0);
+  fNused = 0;
+  if (fNsum == 0) return -1;
+
+  Double_t mean = fSumE/fNsum;
+  Double_t rms = TMath::Sqrt(TMath::Max(fSumE2/fNsum - mean*mean, 0.));
+  fLoThr = mean - 3.*rms;
+  fHiThr = mean + 3.*rms;
+
+  THcSymSolver Q(fNpmts);
+  Double_t* Qp = Q.GetArray();         // Same packing as the bin sums
+  vector<Double_t> q0(fNpmts, 0.);
+  vector<Double_t> qe(fNpmts, 0.);
+  Double_t e0 = 0.;
+
+  for (Int_t ibin=0; ibin<kNbins; ibin++) {
+    const BinSums* sums = fBins[ibin];
+    if (!sums) continue;
+    Double_t center = (ibin+0.5)*kEmax/kNbins;
+    if (!(center>fLoThr && center<fHiThr)) continue;
+    fNused += sums->nev;
+    e0 += sums->e0;
+    for (UInt_t i=0; i<fNpmts; i++) {
+      qe[i] += sums->qe[i];
+      q0[i] += sums->q0[i];
+      fHitCount[i] += sums->hitcount[i];
+    }
+    for (UInt_t k=0; k<sums->Q.size(); k++)
+      Qp[k] += sums->Q[k];
+  }
+
+  if (fNused == 0) return -1;
+
+  // Low hit number channels: exclude from calculation. Assign all the
+  // correspondent elements 0, except self-correlation Q(i,i)=1.
+
+  Int_t ncalib = 0;
+  for (UInt_t i=0; i<fNpmts; i++) {
+    if (fHitCount[i] < fMinHitCount) {
+      q0[i] = 0.;
+      qe[i] = 0.;
+      for (UInt_t k=0; k<fNpmts; k++)
+	Q(i,k) = 0.;
+      Q(i,i) = 1.;
+    }
+    else
+      ncalib++;
+  }
+
+  // Solve Q x au = qe for the 'unconstrained' constants au, then
+  // constrain them to the total momentum e0. One factorization serves
+  // both solutions.
+
+  vector<Double_t> au, Qiq0;
+  if (!Q.Factorize() || !Q.Solve(qe,au) || !Q.Solve(q0,Qiq0)) {
+    cout << "THcShowerGainCalib::Solve: singular matrix, no gains" << endl;
+    return -1;
+  }
+  fCondition = Q.Condition();
+
+  Double_t t1 = e0;
+  Double_t t2 = 0.;
+  for (UInt_t i=0; i<fNpmts; i++) {
+    t1 -= au[i] * q0[i];
+    t2 += q0[i] * Qiq0[i];
+  }
+
+  for (UInt_t i=0; i<fNpmts; i++)
+    fAlphaC[i] = (t1/t2) * Qiq0[i] + au[i];
+
+  return ncalib;
+}
+
+//_____________________________________________________________________________
+Int_t THcShowerGainCalib::WriteParam( const char* filename, const char* prefix,
+				      UInt_t nrows, Int_t run ) const
+{
+  // Write the gains as the <prefix>cal_pos_gain_cor and
+  // <prefix>cal_neg_gain_cor parameters, as THcShowerCalib::SaveAlphas.
+
+  if (nrows == 0) return -1;
+
+  ofstream output(filename);
+  if (!output) {
+    cout << "THcShowerGainCalib: can not open " << filename << endl;
+    return -1;
+  }
+
+  output << "; Calibration constants for run " << run
+	 << ", " << fNused << " of " << fNev << " events used" << endl;
+  output << endl;
+
+  TString pos = TString(prefix) + "cal_pos_gain_cor=";
+  TString neg = TString(prefix) + "cal_neg_gain_cor=";
+  TString indent(' ', pos.Length());
+
+  for (UInt_t i=0; i<fNpos; i++) {
+    if (i%nrows == 0) output << (i == 0 ? pos : indent);
+    output << fixed << setw(6) << setprecision(3) << fAlphaC[i] << ",";
+    if (i%nrows == nrows-1 || i == fNpos-1) output << endl;
+  }
+  for (UInt_t i=0; i<fNpos; i++) {
+    if (i%nrows == 0) output << (i == 0 ? neg : indent);
+    Double_t alpha = i<fNneg ? fAlphaC[fNpos+i] : 0.;
+    output << fixed << setw(6) << setprecision(3) << alpha << ",";
+    if (i%nrows == nrows-1 || i == fNpos-1) output << endl;
+  }
+
+  return 0;
+}
+
+//_____________________________________________________________________________
+void THcShowerGainCalib::Print( Option_t* ) const
+{
+  // Print the thresholds and the hit counts of the PMTs
+
+  cout << "Calorimeter gain calibration: " << fNev << " events, "
+       << fNused << " within " << fLoThr << " < Edep/P < " << fHiThr
+       << ", condition number " << fCondition << endl;
+  for (UInt_t i=0; i<fNpmts; i++) {
+    if (fHitCount[i] < fMinHitCount)
+      cout << "  Channel " << i << ", " << fHitCount[i]
+	   << " hits, not calibrated" << endl;
+  }
+}
+
+ClassImp(THcShowerGainCalib)
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,87 @@
+#ifndef ROOT_THcShowerGainCalib
+#define ROOT_THcShowerGainCalib
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcShowerGainCalib                                                        //
+//                                                                           //
+// Calorimeter gain calibration accumulated event by event during a replay.  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class THcShowerGainCalib : public TObject {
+
+public:
+  THcShowerGainCalib();
+  virtual ~THcShowerGainCalib();
+
+  // Set up for npos positive and nneg negative side PMTs.  alpha0
+  // [npos+nneg] are the gains of the normalized energy deposition
+  // the +/-3 RMS thresholds are applied to.
+  void     Init( UInt_t npos, UInt_t nneg, const Double_t* alpha0 );
+
+  // Add an event: the unit gain signals of its n hit PMTs, and the
+  // track momentum in GeV
+  void     AddEvent( UInt_t n, const UInt_t* channel, const Double_t* signal,
+		     Double_t P );
+
+  // Solve for the gains of the events within the thresholds
+  Int_t    Solve();
+  // Write the gains in the format of the hcal.param file, with nrows
+  // gains per line and the negative side padded to npos gains
+  Int_t    WriteParam( const char* filename, const char* prefix, UInt_t nrows,
+		       Int_t run ) const;
+
+  UInt_t   GetNPmts() const { return fNpmts; }
+  UInt_t   GetNEvents() const { return fNev; }
+  UInt_t   GetNUsed() const { return fNused; }
+  Double_t GetLoThr() const { return fLoThr; }
+  Double_t GetHiThr() const { return fHiThr; }
+  Double_t GetGain( UInt_t i ) const { return fAlphaC[i]; }
+  Double_t GetCondition() const { return fCondition; }
+
+  virtual void Clear( Option_t* opt="" );
+  virtual void Print( Option_t* opt="" ) const;
+
+  static const UInt_t fMinHitCount = 200;   // Minimum number of hits for a PMT
+
+protected:
+  // Sums of the events of one bin of the normalized energy deposition
+  struct BinSums {
+    UInt_t   nev;
+    Double_t e0;
+    std::vector<Double_t> qe;
+    std::vector<Double_t> q0;
+    std::vector<Double_t> Q;            // Packed upper triangle
+    std::vector<UInt_t>   hitcount;
+  };
+  enum { kNbins = 500 };                // Bins of Edep/P in [0,5)
+
+  UInt_t   fNpos;
+  UInt_t   fNneg;
+  UInt_t   fNpmts;
+  std::vector<Double_t> fAlpha0;        // Threshold gains
+  std::vector<Double_t> fAlphaC;        // Calibrated gains
+  std::vector<BinSums*> fBins;          // [kNbins] 0 until filled
+  UInt_t   fNev;                        // Events added
+  UInt_t   fNused;                      // Events within the thresholds
+  Double_t fSumE;                       // Sums of Edep/P within [0,5)
+  Double_t fSumE2;
+  UInt_t   fNsum;
+  Double_t fLoThr;
+  Double_t fHiThr;
+  Double_t fCondition;                  // Of the normal equations
+  std::vector<UInt_t> fHitCount;        // Hits within the thresholds
+
+  // Index of Q[i][j], i<=j, in the packed upper triangle
+  UInt_t   Index( UInt_t i, UInt_t j ) const {
+    return i*fNpmts - i*(i+1)/2 + j;
+  }
+
+  ClassDef(THcShowerGainCalib,0)   // Calorimeter gain calibration sums
+};
+
+#endif
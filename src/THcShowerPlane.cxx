@@ -14,6 +14,7 @@
 #include "THcHitList.h"
 #include "THcShower.h"
 #include "THcRawShowerHit.h"
+#include "THcPedestalTracker.h"
 #include "TClass.h"
 #include "math.h"
 #include "THaTrack.h"
@@ -39,6 +40,7 @@ THcShowerPlane::THcShowerPlane( const char* name,
   // Normal constructor with name and description
   fPosADCHits = new TClonesArray("THcSignalHit",13);
   fNegADCHits = new TClonesArray("THcSignalHit",13);
+  fFillHitLists = kTRUE;
 
   //#if ROOT_VERSION_CODE < ROOT_VERSION(5,32,0)
   //  fPosADCHitsClass = fPosADCHits->GetClass();
@@ -46,6 +48,13 @@ THcShowerPlane::THcShowerPlane( const char* name,
   //#endif
 
   fLayerNum = layernum;
+
+  fPedestals = NULL;
+
+  fA_Pos = fA_Neg = fA_Pos_p = fA_Neg_p = NULL;
+  fEpos = fEneg = fEmean = NULL;
+  fPosGain = fNegGain = NULL;
+  fHitBlocks = fGoodBlocks = NULL;
 }
 
 //______________________________________________________________________________
@@ -63,6 +72,13 @@ THcShowerPlane::~THcShowerPlane()
   delete [] fEpos;
   delete [] fEneg;
   delete [] fEmean;
+
+  delete fPedestals;
+
+  delete [] fPosGain;
+  delete [] fNegGain;
+  delete [] fHitBlocks;
+  delete [] fGoodBlocks;
 }
 
 //_____________________________________________________________________________
@@ -136,6 +152,10 @@ Int_t THcShowerPlane::ReadDatabase( const TDatime& date )
 
   // ADC amplitudes per channel.
 
+  delete [] fA_Pos;
+  delete [] fA_Neg;
+  delete [] fA_Pos_p;
+  delete [] fA_Neg_p;
   fA_Pos = new Double_t[fNelem];
   fA_Neg = new Double_t[fNelem];
   fA_Pos_p = new Double_t[fNelem];
@@ -143,10 +163,42 @@ Int_t THcShowerPlane::ReadDatabase( const TDatime& date )
 
   // Energy depositions per block (not corrected for track coordinate)
 
+  delete [] fEpos;
+  delete [] fEneg;
+  delete [] fEmean;
   fEpos = new Double_t[fNelem];
   fEneg = new Double_t[fNelem];
   fEmean= new Double_t[fNelem];
 
+  // Clear the per block arrays once. Afterwards, only the blocks hit in the
+  // previous event are reset (see ProcessHits).
+
+  for(Int_t i=0;i<fNelem;i++) {
+    fA_Pos[i] = 0;
+    fA_Neg[i] = 0;
+    fA_Pos_p[i] = 0;
+    fA_Neg_p[i] = 0;
+    fEpos[i] = 0;
+    fEneg[i] = 0;
+    fEmean[i] = 0;
+  }
+
+  delete [] fHitBlocks;
+  delete [] fGoodBlocks;
+  fHitBlocks = new Int_t[fNelem];
+  fGoodBlocks = new Int_t[fNelem];
+  fNHitBlocks = 0;
+  fNGoodBlocks = 0;
+
+  // Cache gain constants for the layer, to avoid lookups through the parent
+  // per hit.
+
+  delete [] fPosGain;
+  delete [] fNegGain;
+  fPosGain = new Double_t[fNelem];
+  fNegGain = new Double_t[fNelem];
+  UpdateGains();
+
   // Debug output.
 
   if (fParent->fdbg_init_cal) {
@@ -173,6 +225,18 @@ Int_t THcShowerPlane::ReadDatabase( const TDatime& date )
   return kOK;
 }
 
+//_____________________________________________________________________________
+void THcShowerPlane::UpdateGains()
+{
+  // Copy the gain constants of the layer from the parent
+
+  THcShower* parent = (THcShower*) GetParent();
+  for(Int_t i=0;i<fNelem;i++) {
+    fPosGain[i] = parent->GetGain(i,fLayerNum-1,0);
+    fNegGain[i] = parent->GetGain(i,fLayerNum-1,1);
+  }
+}
+
 //_____________________________________________________________________________
 Int_t THcShowerPlane::DefineVariables( EMode mode )
 {
@@ -266,7 +330,11 @@ Int_t THcShowerPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
   fPosADCHits->Clear();
   fNegADCHits->Clear();
 
-  for(Int_t i=0;i<fNelem;i++) {
+  // Reset only the blocks hit in the previous event, the rest are still
+  // zero. Occupancy of the calorimeter is low.
+
+  for(Int_t k=0;k<fNHitBlocks;k++) {
+    Int_t i = fHitBlocks[k];
     fA_Pos[i] = 0;
     fA_Neg[i] = 0;
     fA_Pos_p[i] = 0;
@@ -275,6 +343,8 @@ Int_t THcShowerPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
     fEneg[i] = 0;
     fEmean[i] = 0;
   }
+  fNHitBlocks = 0;
+  fNGoodBlocks = 0;
 
   fEplane = 0;
   fEplane_pos = 0;
@@ -296,6 +366,12 @@ Int_t THcShowerPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
       break;
     }
     
+    // Remember the block for the reset in the next event. The hit list is
+    // sorted by counter, so a repeated counter can only be the last entry.
+
+    if(fNHitBlocks == 0 || fHitBlocks[fNHitBlocks-1] != hit->fCounter-1)
+      fHitBlocks[fNHitBlocks++] = hit->fCounter-1;
+
     // Should probably check that counter # is in range
     fA_Pos[hit->fCounter-1] = hit->fADC_pos;
     fA_Neg[hit->fCounter-1] = hit->fADC_neg;
@@ -306,14 +382,16 @@ Int_t THcShowerPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
     Double_t thresh_pos = fPosThresh[hit->fCounter -1];
     if(hit->fADC_pos >  thresh_pos) {
 
-      THcSignalHit *sighit =
-	(THcSignalHit*) fPosADCHits->ConstructedAt(nPosADCHits++);
-      sighit->Set(hit->fCounter, hit->fADC_pos);
+      if(fFillHitLists) {
+	THcSignalHit *sighit =
+	  (THcSignalHit*) fPosADCHits->ConstructedAt(nPosADCHits++);
+	sighit->Set(hit->fCounter, hit->fADC_pos);
+      }
 
       fA_Pos_p[hit->fCounter-1] = hit->fADC_pos - fPosPed[hit->fCounter -1];
 
       fEpos[hit->fCounter-1] += fA_Pos_p[hit->fCounter-1]*
-	fParent->GetGain(hit->fCounter-1,fLayerNum-1,0);
+	fPosGain[hit->fCounter-1];
     }
 
     // Sparsify negative side hits, fill the hit list, compute the
@@ -322,14 +400,16 @@ Int_t THcShowerPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
     Double_t thresh_neg = fNegThresh[hit->fCounter -1];
     if(hit->fADC_neg >  thresh_neg) {
 
-      THcSignalHit *sighit = 
-	(THcSignalHit*) fNegADCHits->ConstructedAt(nNegADCHits++);
-      sighit->Set(hit->fCounter, hit->fADC_neg);
+      if(fFillHitLists) {
+	THcSignalHit *sighit = 
+	  (THcSignalHit*) fNegADCHits->ConstructedAt(nNegADCHits++);
+	sighit->Set(hit->fCounter, hit->fADC_neg);
+      }
 
       fA_Neg_p[hit->fCounter-1] = hit->fADC_neg - fNegPed[hit->fCounter -1];
 
       fEneg[hit->fCounter-1] += fA_Neg_p[hit->fCounter-1]*
-	fParent->GetGain(hit->fCounter-1,fLayerNum-1,1);
+	fNegGain[hit->fCounter-1];
     }
 
     // Mean energy in the counter.
@@ -345,6 +425,17 @@ Int_t THcShowerPlane::ProcessHits(TClonesArray* rawhits, Int_t nexthit)
     ihit++;
   }
 
+  // List the blocks above threshold for clustering in the parent's
+  // CoarseProcess. Blocks without raw hits have zero amplitudes and
+  // can not pass the thresholds.
+
+  for(Int_t k=0;k<fNHitBlocks;k++) {
+    Int_t i = fHitBlocks[k];
+    if (fA_Pos[i] - fPosPed[i] > fPosThresh[i] - fPosPed[i] ||
+	fA_Neg[i] - fNegPed[i] > fNegThresh[i] - fNegPed[i])
+      fGoodBlocks[fNGoodBlocks++] = i;
+  }
+
   //Debug output.
 
   if (fParent->fdbg_decoded_cal) {
@@ -405,29 +496,14 @@ Int_t THcShowerPlane::AccumulatePedestals(TClonesArray* rawhits, Int_t nexthit)
       break;
     }
     Int_t element = hit->fCounter - 1; // Should check if in range
-    Int_t adcpos = hit->fADC_pos;
-    Int_t adcneg = hit->fADC_neg;
-
-    if(adcpos <= fPosPedLimit[element]) {
-      fPosPedSum[element] += adcpos;
-      fPosPedSum2[element] += adcpos*adcpos;
-      fPosPedCount[element]++;
-      if(fPosPedCount[element] == fMinPeds/5) {
-	fPosPedLimit[element] = 100 + fPosPedSum[element]/fPosPedCount[element];
-      }
-    }
-    if(adcneg <= fNegPedLimit[element]) {
-      fNegPedSum[element] += adcneg;
-      fNegPedSum2[element] += adcneg*adcneg;
-      fNegPedCount[element]++;
-      if(fNegPedCount[element] == fMinPeds/5) {
-	fNegPedLimit[element] = 100 + fNegPedSum[element]/fNegPedCount[element];
-      }
-    }
+
+    fPedestals->Fill(element, hit->fADC_pos);
+    fPedestals->Fill(fNelem+element, hit->fADC_neg);
+
     ihit++;
   }
 
-  fNPedestalEvents++;
+  fPedestals->EndEvent();
 
   // Debug output.
 
@@ -467,18 +543,18 @@ void THcShowerPlane::CalculatePedestals( )
   // Use the accumulated pedestal data to calculate pedestals
   // Later add check to see if pedestals have drifted ("Danger Will Robinson!")
 
+  fPedestals->Calculate();
+
   for(Int_t i=0; i<fNelem;i++) {
     
     // Positive tubes
-    fPosPed[i] = ((Float_t) fPosPedSum[i]) / TMath::Max(1, fPosPedCount[i]);
-    fPosSig[i] = sqrt(((Float_t)fPosPedSum2[i])/TMath::Max(1, fPosPedCount[i])
-		      - fPosPed[i]*fPosPed[i]);
+    fPosPed[i] = fPedestals->GetPed(i);
+    fPosSig[i] = fPedestals->GetSig(i);
     fPosThresh[i] = fPosPed[i] + TMath::Min(50., TMath::Max(10., 3.*fPosSig[i]));
 
     // Negative tubes
-    fNegPed[i] = ((Float_t) fNegPedSum[i]) / TMath::Max(1, fNegPedCount[i]);
-    fNegSig[i] = sqrt(((Float_t)fNegPedSum2[i])/TMath::Max(1, fNegPedCount[i])
-		      - fNegPed[i]*fNegPed[i]);
+    fNegPed[i] = fPedestals->GetPed(fNelem+i);
+    fNegSig[i] = fPedestals->GetSig(fNelem+i);
     fNegThresh[i] = fNegPed[i] + TMath::Min(50., TMath::Max(10., 3.*fNegSig[i]));
 
   }
@@ -508,13 +584,16 @@ void THcShowerPlane::CalculatePedestals( )
 //_____________________________________________________________________________
 void THcShowerPlane::InitializePedestals( )
 {
-  fNPedestalEvents = 0;
-  fPosPedSum = new Int_t [fNelem];
-  fPosPedSum2 = new Int_t [fNelem];
-  fPosPedCount = new Int_t [fNelem];
-  fNegPedSum = new Int_t [fNelem];
-  fNegPedSum2 = new Int_t [fNelem];
-  fNegPedCount = new Int_t [fNelem];
+  std::vector<Int_t> limits(2*fNelem);
+  for(Int_t i=0;i<fNelem;i++) {
+    limits[i] = fPosPedLimit[i];
+    limits[fNelem+i] = fNegPedLimit[i];
+  }
+
+  delete fPedestals;
+  fPedestals = new THcPedestalTracker(2*fNelem);
+  fPedestals->Init(fMinPeds, &limits[0]);
+  fPedestals->SetWindow(((THcShower*) GetParent())->GetPedWindow());
 
   fPosSig = new Float_t [fNelem];
   fNegSig = new Float_t [fNelem];
@@ -522,12 +601,4 @@ void THcShowerPlane::InitializePedestals( )
   fNegPed = new Float_t [fNelem];
   fPosThresh = new Float_t [fNelem];
   fNegThresh = new Float_t [fNelem];
-  for(Int_t i=0;i<fNelem;i++) {
-    fPosPedSum[i] = 0;
-    fPosPedSum2[i] = 0;
-    fPosPedCount[i] = 0;
-    fNegPedSum[i] = 0;
-    fNegPedSum2[i] = 0;
-    fNegPedCount[i] = 0;
-  }
 } 
@@ -21,6 +21,7 @@
 
 class THaEvData;
 class THaSignalHit;
+class THcPedestalTracker;
 
 class THcShowerPlane : public THaSubDetector {
   
@@ -42,6 +43,9 @@ public:
   virtual Int_t AccumulatePedestals(TClonesArray* rawhits, Int_t nexthit);
   virtual void  CalculatePedestals( );
 
+  // Copy the gains from the parent again, after they changed
+  void  UpdateGains();
+
   //  Double_t fSpacing;   not used
 
   TClonesArray* fParentHitList;
@@ -62,6 +66,9 @@ public:
     return fEplane_neg;
   };
 
+  // Fill the ADC hit lists (posadchits, negadchits), only used for output
+  void SetFillHitLists(Bool_t fill) { fFillHitLists = fill; }
+
   Double_t GetEmean(Int_t i) {
     return fEmean[i];
   };
@@ -106,6 +113,17 @@ public:
     return fNegPed[i];
   };
 
+  // Blocks above threshold on either side in the current event,
+  // in ascending order.
+
+  Int_t GetNGoodBlocks() {
+    return fNGoodBlocks;
+  };
+
+  Int_t GetGoodBlock(Int_t i) {
+    return fGoodBlocks[i];
+  };
+
 protected:
 
   Double_t*   fA_Pos;         // [fNelem] ADC amplitudes of blocks
@@ -120,22 +138,27 @@ protected:
   Double_t  fEplane_pos;   // Energy deposition in the plane from positive PMTs
   Double_t  fEplane_neg;   // Energy deposition in the plane from negative PMTs
 
+  Double_t* fPosGain;  // [fNelem] gain constants, cached from the parent
+  Double_t* fNegGain;
+
+  Int_t  fNHitBlocks;  // Number of blocks with raw hits in the event
+  Int_t* fHitBlocks;   // [fNelem] blocks with raw hits; only these are
+                       // reset at the start of the next event
+  Int_t  fNGoodBlocks; // Number of blocks above threshold
+  Int_t* fGoodBlocks;  // [fNelem] blocks above threshold on either side
+
   // These lists are not used actively for now.
   TClonesArray* fPosADCHits;    // List of positive ADC hits 
   TClonesArray* fNegADCHits;    // List of negative ADC hits
+  Bool_t fFillHitLists;
 
   Int_t fLayerNum;		// Layer # 1-4
 
-  Int_t fNPedestalEvents;	/* Pedestal event counter */
   Int_t fMinPeds;		/* Only analyze/update if num events > */
-  Int_t *fPosPedSum;		/* Accumulators for pedestals */
-  Int_t *fPosPedSum2;
   Int_t *fPosPedLimit;          // Analyze pedestal if ADC signal < PedLimit
-  Int_t *fPosPedCount;          // [fNelem] counter of pedestal analysis
-  Int_t *fNegPedSum;
-  Int_t *fNegPedSum2;
   Int_t *fNegPedLimit;          // Analyze pedestal if ADC signal < PedLimit
-  Int_t *fNegPedCount;          // [fNelem] counter of pedestal analysis
+  THcPedestalTracker* fPedestals; // Pedestal accumulator for positive
+                                  // (0..fNelem-1) and negative tubes
 
   Float_t *fPosPed;             // [fNelem] pedestal positions
   Float_t *fPosSig;             // [fNelem] pedestal rms-s
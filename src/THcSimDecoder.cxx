@@ -0,0 +1,443 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcSimDecoder                                                             //
+//                                                                           //
+// Event data for benchmarking the Hall C detectors without a CODA file.     //
+// LoadEvent generates an event and loads its hits into the crate/slot      //
+// data, so detectors decode it through their detector map exactly as a     //
+// CODA event.                                                               //
+//                                                                           //
+// The hits are generated from the geometry of initialized detectors of     //
+// the spectrometers given with AddSpectrometer(), and mapped to            //
+// electronics channels with the inverse of gHcDetectorMap:                 //
+//   - Tracks are straight lines through the focal plane, with gaussian      //
+//     x, y, x', y' (SetTrackModel) and a Poisson number per event          //
+//     (SetTracks).                                                          //
+//   - Drift chambers: the wire closest to the track in each plane fires,    //
+//     with the TDC value from the plane's own time to distance table and   //
+//     the hodoscope start time center.  SetDCEfficiency and SetMultiHit    //
+//     drop hits and add late hits.                                          //
+//   - Hodoscope: the paddles the track crosses, with ADC and TDC on both    //
+//     ends, the TDCs including light propagation to each tube.             //
+//   - Calorimeter: SetShowerEnergy deposited over the layers, shared with   //
+//     the neighbouring blocks, converted to ADC with the block gains.      //
+//   - Noise: SetNoise is the fraction of all mapped channels with a        //
+//     random hit in each event, within the TDC windows of the detectors.   //
+// The first SetPedestalEvents events are pedestal events (type 4) with     //
+// all ADC channels read out, so that the detectors can compute their       //
+// pedestals before physics events start.                                    //
+//                                                                           //
+// The crate map (db_cratemap.dat, from make_cratemap.pl) must correspond    //
+// to the detector map, as for replaying CODA data.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcSimDecoder.h"
+#include "THcGlobals.h"
+#include "THcDetectorMap.h"
+#include "THaApparatus.h"
+#include "THaSlotData.h"
+#include "THcDC.h"
+#include "THcDriftChamberPlane.h"
+#include "THcDCWire.h"
+#include "THcDCTimeToDistConv.h"
+#include "THcHodoscope.h"
+#include "THcScintillatorPlane.h"
+#include "THcShower.h"
+#include "TList.h"
+#include "TMath.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+ClassImp(THcSimDecoder)
+
+//______________________________________________________________________________
+THcSimDecoder::THcSimDecoder() :
+  fRandom(4357), fMeanTracks(1.0), fNoise(0.0), fMultiHit(0.0), fDCEff(0.98),
+  fSigmaX(10.0), fSigmaY(3.0), fSigmaXp(0.03), fSigmaYp(0.01),
+  fShowerEnergy(1.0), fNPedEvents(0), fPedMean(400.0), fPedSigma(4.0),
+  fEvNum(0), fNTracksGen(0), fSlotsReady(kFALSE)
+{
+  // Constructor
+}
+
+//______________________________________________________________________________
+THcSimDecoder::~THcSimDecoder()
+{
+  // Destructor
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::SetTrackModel( Double_t sx, Double_t sy,
+				   Double_t sxp, Double_t syp )
+{
+  // Widths of the gaussian focal plane x, y (cm), x', y' (rad)
+
+  fSigmaX = sx;
+  fSigmaY = sy;
+  fSigmaXp = sxp;
+  fSigmaYp = syp;
+}
+
+//______________________________________________________________________________
+Int_t THcSimDecoder::GetDetectorID( const char* name ) const
+{
+  // Detector id of e.g. "HDC" in the detector map
+
+  for( Int_t i=0; i<gHcDetectorMap->fNIDs; i++ ) {
+    if( strcasecmp(name,gHcDetectorMap->fIDMap[i].name) == 0 )
+      return gHcDetectorMap->fIDMap[i].id;
+  }
+  return -1;
+}
+
+//______________________________________________________________________________
+Int_t THcSimDecoder::FindChannel( Int_t did, Int_t plane, Int_t counter,
+				  Int_t signal ) const
+{
+  // Index in fChannels of a detector channel, -1 if it is not mapped
+
+  map<Int_t,Int_t>::const_iterator it = fChanIndex.find(Key(did,plane,counter,signal));
+  return it == fChanIndex.end() ? -1 : it->second;
+}
+
+//______________________________________________________________________________
+Int_t THcSimDecoder::AddSpectrometer( THaApparatus* app )
+{
+  // Generate hits for the drift chambers, hodoscope and calorimeter of
+  // app, which must be initialized.
+
+  static const char* const here = "AddSpectrometer";
+
+  if( !gHcDetectorMap || gHcDetectorMap->fNchans == 0 ) {
+    Error(here, "No detector map loaded");
+    return -1;
+  }
+  if( !app->IsInit() ) {
+    Error(here, "Apparatus %s is not initialized", app->GetName());
+    return -1;
+  }
+
+  // All channels of the detector map, so that noise covers every detector
+  if( fChannels.empty() ) {
+    for( Int_t ich=0; ich<gHcDetectorMap->fNchans; ich++ ) {
+      const THcDetectorMap::Channel& c = gHcDetectorMap->fTable[ich];
+      SimChannel sc;
+      sc.roc = c.roc;
+      sc.slot = c.slot;
+      sc.chan = c.channel;
+      sc.model = c.model;
+      sc.noiselo = 0;
+      sc.noisehi = 4000;
+      fChanIndex[Key(c.did,c.plane,c.counter,c.signal)] = fChannels.size();
+      fChannels.push_back(sc);
+    }
+  }
+
+  SimSpectrometer spec;
+  spec.dc = 0;
+  spec.hod = 0;
+  spec.cal = 0;
+  TIter next(app->GetDetectors());
+  while( TObject* obj = next() ) {
+    if( !spec.dc ) spec.dc = dynamic_cast<THcDC*>(obj);
+    if( !spec.hod ) spec.hod = dynamic_cast<THcHodoscope*>(obj);
+    if( !spec.cal ) spec.cal = dynamic_cast<THcShower*>(obj);
+  }
+  char prefix = toupper(app->GetName()[0]);
+  spec.dcid = GetDetectorID(Form("%cDC",prefix));
+  spec.hodid = GetDetectorID(Form("%cSCIN",prefix));
+  spec.calid = GetDetectorID(Form("%cCAL",prefix));
+
+  if( spec.dc ) {
+    for( Int_t ip=1; ip<=spec.dc->GetNPlanes(); ip++ ) {
+      THcDriftChamberPlane* plane = spec.dc->GetPlane(ip);
+      SimDCPlane sp;
+      sp.plane = ip;
+      sp.coef = plane->GetPlaneCoef();
+      sp.timezero = spec.dc->GetPlaneTimeZero(ip);
+      sp.tdcmin = spec.dc->GetTdcWinMin(ip);
+      sp.tdcmax = spec.dc->GetTdcWinMax(ip);
+      // Tabulate the drift distance from the plane's own conversion,
+      // until it reaches half the wire spacing
+      THcDCTimeToDistConv* ttd = plane->GetWire(1)->GetTTDConv();
+      Double_t maxdist = 0.5*spec.dc->GetPitch(ip);
+      sp.tfirst = -50.0;
+      for( Double_t t=sp.tfirst; t<1000.0; t+=1.0 ) {
+	Double_t d = ttd->ConvertTimeToDist(t);
+	sp.dist.push_back(d);
+	if( d >= 0.999*maxdist ) break;
+      }
+      spec.dcplanes.push_back(sp);
+      // Noise within the TDC window of the plane
+      for( Int_t iw=1; iw<=plane->GetNWires(); iw++ ) {
+	Int_t ich = FindChannel(spec.dcid,ip,iw,0);
+	if( ich < 0 ) continue;
+	fChannels[ich].noiselo = sp.tdcmin;
+	fChannels[ich].noisehi = sp.tdcmax;
+      }
+    }
+  }
+  if( spec.hod ) {
+    for( Int_t ip=0; ip<spec.hod->GetNPlanes(); ip++ ) {
+      for( Int_t ipad=0; ipad<spec.hod->GetPlane(ip)->GetNelem(); ipad++ ) {
+	for( Int_t sig=2; sig<4; sig++ ) {
+	  Int_t ich = FindChannel(spec.hodid,ip+1,ipad+1,sig);
+	  if( ich < 0 ) continue;
+	  fChannels[ich].noiselo = (Int_t)spec.hod->GetTdcMin();
+	  fChannels[ich].noisehi = (Int_t)spec.hod->GetTdcMax();
+	}
+      }
+    }
+  }
+  fSpectrometers.push_back(spec);
+
+  cout << "THcSimDecoder: " << app->GetName() << " with"
+       << (spec.dc ? " drift chambers" : "") << (spec.hod ? " hodoscope" : "")
+       << (spec.cal ? " calorimeter" : "") << ", " << fChannels.size()
+       << " channels mapped" << endl;
+  return 0;
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::AddHit( Int_t channel, Int_t data )
+{
+  if( channel < 0 ) return;
+  SimHit hit;
+  hit.channel = channel;
+  hit.data = data;
+  fHits.push_back(hit);
+}
+
+//______________________________________________________________________________
+Int_t THcSimDecoder::LoadEvent( const UInt_t* )
+{
+  // Generate the next event and load it into the slot data
+
+  if( !fSlotsReady ) {
+    if( init_cmap() != HED_OK || init_slotdata(fMap) != HED_OK ) {
+      Error("LoadEvent", "Cannot initialize the crate map");
+      return HED_ERR;
+    }
+    fSlotsReady = kTRUE;
+  }
+  for( UInt_t i=0; i<fLoadedSlots.size(); i++ ) {
+    crateslot[fLoadedSlots[i]]->clearEvent();
+  }
+  fLoadedSlots.clear();
+
+  fEvNum++;
+  fHits.clear();
+  fNTracksGen = 0;
+  if( fEvNum <= fNPedEvents ) {
+    event_type = 4;
+    GeneratePedestals();
+  } else {
+    event_type = 1;
+    for( UInt_t is=0; is<fSpectrometers.size(); is++ ) {
+      Int_t ntracks = fRandom.Poisson(fMeanTracks);
+      for( Int_t it=0; it<ntracks; it++ )
+	GenerateTrack(fSpectrometers[is]);
+    }
+    GenerateNoise();
+  }
+  event_num = fEvNum;
+  event_length = fHits.size();
+
+  // Hits of a channel must be loaded together, in the order generated
+  stable_sort(fHits.begin(), fHits.end());
+  for( UInt_t ih=0; ih<fHits.size(); ih++ ) {
+    const SimChannel& c = fChannels[fHits[ih].channel];
+    Int_t i = idx(c.roc,c.slot);
+    if( !crateslot[i] ) continue;	// Not in the crate map
+    if( find(fLoadedSlots.begin(), fLoadedSlots.end(), i) == fLoadedSlots.end() )
+      fLoadedSlots.push_back(i);
+    crateslot[i]->loadData(c.model == 1881 ? "adc" : "tdc", c.chan,
+			   fHits[ih].data, fHits[ih].data);
+  }
+  return HED_OK;
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::GeneratePedestals()
+{
+  // All ADC channels at the pedestal
+
+  for( UInt_t ich=0; ich<fChannels.size(); ich++ ) {
+    if( fChannels[ich].model != 1881 ) continue;
+    AddHit(ich, TMath::Nint(fRandom.Gaus(fPedMean,fPedSigma)));
+  }
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::GenerateNoise()
+{
+  // Random hits in a fraction fNoise of the channels
+
+  Int_t nnoise = fRandom.Poisson(fNoise*fChannels.size());
+  for( Int_t i=0; i<nnoise; i++ ) {
+    Int_t ich = fRandom.Integer(fChannels.size());
+    const SimChannel& c = fChannels[ich];
+    Int_t data;
+    if( c.model == 1881 )
+      data = TMath::Nint(fPedMean) + 10 + fRandom.Integer(300);
+    else
+      data = c.noiselo + fRandom.Integer(c.noisehi - c.noiselo + 1);
+    AddHit(ich, data);
+  }
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::GenerateTrack( SimSpectrometer& spec )
+{
+  // Hits of one track in all detectors of the spectrometer
+
+  Double_t ray[4];
+  ray[0] = fRandom.Gaus(0,fSigmaX);
+  ray[1] = fRandom.Gaus(0,fSigmaY);
+  ray[2] = fRandom.Gaus(0,fSigmaXp);
+  ray[3] = fRandom.Gaus(0,fSigmaYp);
+  fNTracksGen++;
+
+  Double_t t0 = spec.hod ? spec.hod->GetStartTimeCenter() : 0.0;
+  if( spec.hod ) GenerateHodoscope(spec, ray);
+  if( spec.dc ) GenerateDC(spec, ray, t0);
+  if( spec.cal ) GenerateShower(spec, ray);
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::GenerateDC( SimSpectrometer& spec, const Double_t* ray,
+				Double_t t0 )
+{
+  // Closest wire in each plane, with the TDC value of its drift time
+
+  Double_t nsperchan = spec.dc->GetNSperChan();
+  for( UInt_t ip=0; ip<spec.dcplanes.size(); ip++ ) {
+    if( fRandom.Rndm() > fDCEff ) continue;
+    const SimDCPlane& sp = spec.dcplanes[ip];
+    const Double_t* c = sp.coef;
+    // Coordinate measured by the plane, as THcDC::DpsiFun
+    Double_t denom = ray[2]*c[6] + ray[3]*c[7] + c[8];
+    if( TMath::Abs(denom) < 1e-20 ) continue;
+    Double_t psi = (ray[2]*ray[1]*c[0] + ray[3]*ray[0]*c[1] + ray[2]*c[2]
+		    + ray[3]*c[3] + ray[0]*c[4] + ray[1]*c[5])/denom;
+
+    Int_t p = sp.plane;
+    THcDriftChamberPlane* plane = spec.dc->GetPlane(p);
+    Int_t nwires = plane->GetNWires();
+    Int_t k = TMath::Nint((psi + spec.dc->GetCenter(p))/spec.dc->GetPitch(p)
+			  + spec.dc->GetCentralWire(p));
+    Int_t wire = spec.dc->GetWireOrder(p) == 0 ? k : nwires - k + 1;
+    if( wire < 1 || wire > nwires ) continue;
+    Int_t ich = FindChannel(spec.dcid,p,wire,0);
+    if( ich < 0 ) continue;
+
+    Double_t dist = TMath::Abs(psi - plane->GetWire(wire)->GetPos());
+    vector<Double_t>::const_iterator it =
+      lower_bound(sp.dist.begin(), sp.dist.end(), dist);
+    Int_t ibin = it - sp.dist.begin();
+    Double_t time = sp.tfirst + ibin;
+    if( ibin > 0 && ibin < (Int_t)sp.dist.size() ) {
+      Double_t d0 = sp.dist[ibin-1], d1 = sp.dist[ibin];
+      if( d1 > d0 ) time -= (d1 - dist)/(d1 - d0);
+    }
+    time += fRandom.Gaus(0,1.0);
+    // Inverse of THcDriftChamberPlane::ProcessHits
+    Int_t rawtdc = TMath::Nint((sp.timezero - t0 - time)/nsperchan);
+    AddHit(ich, rawtdc);
+    if( fMultiHit > 0 && fRandom.Rndm() < fMultiHit ) {
+      // Later hit, e.g. a delta ray. The TDC counts backwards.
+      Int_t late = rawtdc - TMath::Nint(fRandom.Uniform(20.0,400.0)/nsperchan);
+      AddHit(ich, TMath::Max(late, sp.tdcmin));
+    }
+  }
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::GenerateHodoscope( SimSpectrometer& spec, const Double_t* ray )
+{
+  // ADC and TDC on both ends of the paddles crossed by the track
+
+  THcHodoscope* hod = spec.hod;
+  Int_t nplanes = hod->GetNPlanes();
+  Double_t t0 = hod->GetStartTimeCenter();
+  Double_t tdctotime = hod->GetTdcToTime();
+  if( tdctotime <= 0 ) return;
+  for( Int_t ip=0; ip<nplanes; ip++ ) {
+    THcScintillatorPlane* plane = hod->GetPlane(ip);
+    Double_t z = plane->GetZpos();
+    Double_t x = ray[0] + ray[2]*z;
+    Double_t y = ray[1] + ray[3]*z;
+    // Planes 1x, 2x measure x; 1y, 2y measure y
+    Double_t trans = (ip%2 == 0) ? x : y;
+    Double_t lng = (ip%2 == 0) ? y : x;
+    Double_t tplane = t0 + z/29.979;
+    for( Int_t ipad=0; ipad<plane->GetNelem(); ipad++ ) {
+      Double_t center = plane->GetPosCenter(ipad) + plane->GetPosOffset();
+      if( TMath::Abs(center - trans) > 0.5*plane->GetSize() ) continue;
+      Int_t index = nplanes*ipad + ip;
+      Double_t vel = hod->GetHodoVelLight(index);
+      if( vel <= 0 ) vel = 15.0;
+      Double_t tpos = tplane + (plane->GetPosLeft() - lng)/vel;
+      Double_t tneg = tplane + (lng - plane->GetPosRight())/vel;
+      AddHit(FindChannel(spec.hodid,ip+1,ipad+1,0),
+	     TMath::Nint(fPedMean + TMath::Max(20.0,fRandom.Gaus(300,60))));
+      AddHit(FindChannel(spec.hodid,ip+1,ipad+1,1),
+	     TMath::Nint(fPedMean + TMath::Max(20.0,fRandom.Gaus(300,60))));
+      AddHit(FindChannel(spec.hodid,ip+1,ipad+1,2),
+	     TMath::Nint(tpos/tdctotime + fRandom.Gaus(0,1.0)));
+      AddHit(FindChannel(spec.hodid,ip+1,ipad+1,3),
+	     TMath::Nint(tneg/tdctotime + fRandom.Gaus(0,1.0)));
+    }
+  }
+}
+
+//______________________________________________________________________________
+void THcSimDecoder::GenerateShower( SimSpectrometer& spec, const Double_t* ray )
+{
+  // Shower energy over the layers, 80% in the block hit and 10% in each
+  // neighbour. Blocks read out at both ends see half on each side.
+
+  THcShower* cal = spec.cal;
+  Int_t nlayers = cal->GetNLayers();
+  // Longitudinal profile
+  vector<Double_t> frac(nlayers);
+  Double_t sum = 0;
+  for( Int_t l=0; l<nlayers; l++ ) {
+    frac[l] = (l+1)*(l+1)*TMath::Exp(-(l+1.0));
+    sum += frac[l];
+  }
+  for( Int_t l=0; l<nlayers; l++ ) {
+    Double_t thick = cal->GetBlockThick(l);
+    Double_t z = cal->GetZPos(l) + 0.5*thick;
+    Double_t x = ray[0] + ray[2]*z;
+    Int_t nblocks = cal->GetNBlocks(l);
+    Int_t block = -1;
+    for( Int_t ib=0; ib<nblocks; ib++ ) {
+      if( x >= cal->GetXPos(l,ib) && x < cal->GetXPos(l,ib) + thick ) {
+	block = ib;
+	break;
+      }
+    }
+    if( block < 0 ) continue;
+    Double_t elayer = fShowerEnergy*frac[l]/sum*fRandom.Gaus(1.0,0.05);
+    for( Int_t ib=block-1; ib<=block+1; ib++ ) {
+      if( ib < 0 || ib >= nblocks ) continue;
+      Double_t e = elayer*(ib == block ? 0.8 : 0.1);
+      Int_t ipos = FindChannel(spec.calid,l+1,ib+1,0);
+      Int_t ineg = FindChannel(spec.calid,l+1,ib+1,1);
+      if( ipos >= 0 && ineg >= 0 ) e *= 0.5;
+      for( Int_t side=0; side<2; side++ ) {
+	Int_t ich = side == 0 ? ipos : ineg;
+	Double_t gain = cal->GetGain(ib,l,side);
+	if( ich < 0 || gain <= 0 ) continue;
+	AddHit(ich, TMath::Nint(fRandom.Gaus(fPedMean,fPedSigma) + e/gain));
+      }
+    }
+  }
+}
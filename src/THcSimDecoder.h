@@ -0,0 +1,121 @@
+#ifndef ROOT_THcSimDecoder
+#define ROOT_THcSimDecoder
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcSimDecoder                                                             //
+//                                                                           //
+// Event data generated from a simple track model, for benchmarks.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THaEvData.h"
+#include "TRandom3.h"
+#include <vector>
+#include <map>
+
+class THaApparatus;
+class THcDC;
+class THcHodoscope;
+class THcShower;
+
+class THcSimDecoder : public THaEvData {
+
+public:
+  THcSimDecoder();
+  virtual ~THcSimDecoder();
+
+  // Generate the hits of the next event. The buffer is not used.
+  virtual Int_t LoadEvent( const UInt_t* evbuffer );
+
+  // Generate hits for the detectors of an initialized spectrometer
+  Int_t AddSpectrometer( THaApparatus* app );
+
+  // Mean number of tracks per event (Poisson)
+  void SetTracks( Double_t mean ) { fMeanTracks = mean; }
+  // Fraction of all channels with a random noise hit per event
+  void SetNoise( Double_t fraction ) { fNoise = fraction; }
+  // Probability of an additional, later TDC hit on a drift chamber wire
+  void SetMultiHit( Double_t prob ) { fMultiHit = prob; }
+  // Drift chamber plane efficiency
+  void SetDCEfficiency( Double_t eff ) { fDCEff = eff; }
+  // Widths of the focal plane distributions (cm and rad)
+  void SetTrackModel( Double_t sx, Double_t sy, Double_t sxp, Double_t syp );
+  // Energy deposited in the calorimeter per track (GeV)
+  void SetShowerEnergy( Double_t e ) { fShowerEnergy = e; }
+  // The first n events are pedestal events (event type 4)
+  void SetPedestalEvents( Int_t n ) { fNPedEvents = n; }
+  void SetPedestal( Double_t mean, Double_t sigma ) { fPedMean = mean; fPedSigma = sigma; }
+  void SetSeed( UInt_t seed ) { fRandom.SetSeed(seed); }
+
+  Int_t GetNTracksGenerated() const { return fNTracksGen; }
+  Int_t GetNHitsGenerated() const { return fHits.size(); }
+  Int_t GetNChannels() const { return fChannels.size(); }
+
+protected:
+  // One electronics channel of the detector map
+  struct SimChannel {
+    Int_t roc, slot, chan, model;
+    Int_t noiselo, noisehi;     // Range of noise hit values
+  };
+  // One generated hit
+  struct SimHit {
+    Int_t channel;              // Index in fChannels
+    Int_t data;
+    bool operator<( const SimHit& rhs ) const { return channel < rhs.channel; }
+  };
+  // Drift chamber plane, with the drift time as function of distance
+  struct SimDCPlane {
+    Int_t    plane;
+    Double_t* coef;             // THcDriftChamberPlane::GetPlaneCoef
+    Double_t timezero;
+    Int_t    tdcmin, tdcmax;
+    Double_t tfirst;            // Drift time of dist[0]
+    std::vector<Double_t> dist; // Drift distance at 1 ns steps
+  };
+  // Generator state for one spectrometer
+  struct SimSpectrometer {
+    THcDC*        dc;
+    THcHodoscope* hod;
+    THcShower*    cal;
+    Int_t         dcid, hodid, calid;
+    std::vector<SimDCPlane> dcplanes;
+  };
+
+  std::vector<SimChannel>      fChannels;
+  std::map<Int_t,Int_t>        fChanIndex;  // Detector key -> fChannels index
+  std::vector<SimSpectrometer> fSpectrometers;
+  std::vector<SimHit>          fHits;
+  std::vector<Int_t>           fLoadedSlots; // crateslot indices to clear
+
+  TRandom3 fRandom;
+  Double_t fMeanTracks;
+  Double_t fNoise;
+  Double_t fMultiHit;
+  Double_t fDCEff;
+  Double_t fSigmaX, fSigmaY, fSigmaXp, fSigmaYp;
+  Double_t fShowerEnergy;
+  Int_t    fNPedEvents;
+  Double_t fPedMean, fPedSigma;
+  Int_t    fEvNum;
+  Int_t    fNTracksGen;
+  Bool_t   fSlotsReady;
+
+  static Int_t Key( Int_t did, Int_t plane, Int_t counter, Int_t signal ) {
+    return ((did*100 + plane)*1000 + counter)*4 + signal;
+  }
+  Int_t  FindChannel( Int_t did, Int_t plane, Int_t counter, Int_t signal ) const;
+  void   AddHit( Int_t channel, Int_t data );
+  Int_t  GetDetectorID( const char* name ) const;
+
+  void   GeneratePedestals();
+  void   GenerateTrack( SimSpectrometer& spec );
+  void   GenerateNoise();
+  void   GenerateDC( SimSpectrometer& spec, const Double_t* ray, Double_t t0 );
+  void   GenerateHodoscope( SimSpectrometer& spec, const Double_t* ray );
+  void   GenerateShower( SimSpectrometer& spec, const Double_t* ray );
+
+  ClassDef(THcSimDecoder,0)   // Generated Hall C event data
+};
+
+#endif
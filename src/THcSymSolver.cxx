@@ -0,0 +1,305 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcSymSolver                                                              //
+//                                                                           //
+// Solves A x = b for a symmetric n x n matrix A, such as the normal         //
+// equations of the calorimeter gain calibration.  Only the upper triangle   //
+// of A is stored, packed row by row, so the size is n(n+1)/2 and rows are   //
+// contiguous.  A is factorized once as A = U^T D U, with U unit upper       //
+// triangular and D diagonal (LDL^T without pivoting, for positive definite  //
+// and well conditioned indefinite matrices), and the factorization is       //
+// reused for all right hand sides.  Each solution is improved by iterative  //
+// refinement with the residual b - A x of the unfactorized matrix, and the  //
+// condition number is estimated from the factorization (Hager's method).    //
+//                                                                           //
+// Usage:                                                                    //
+//   THcSymSolver s(n);                                                      //
+//   s(i,j) = ...;              // for j>=i, or either                      //
+//   if( s.Factorize() ) s.Solve(b, x);                                      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcSymSolver.h"
+#include "TMath.h"
+
+#include <iostream>
+
+using namespace std;
+
+//_____________________________________________________________________________
+THcSymSolver::THcSymSolver( UInt_t n ) :
+  fN(0), fFactorized(kFALSE), fResidual(0.)
+{
+  // Constructor
+
+  ResizeTo(n);
+}
+
+//_____________________________________________________________________________
+THcSymSolver::~THcSymSolver()
+{
+  // Destructor
+}
+
+//_____________________________________________________________________________
+void THcSymSolver::ResizeTo( UInt_t n )
+{
+  // Resize to n x n and zero the matrix
+
+  fN = n;
+  fA.assign(n*(n+1)/2, 0.);
+  fU.clear();
+  fD.clear();
+  fFactorized = kFALSE;
+}
+
+//_____________________________________________________________________________
+void THcSymSolver::Zero()
+{
+  // Zero the matrix
+
+  fA.assign(fA.size(), 0.);
+  fFactorized = kFALSE;
+}
+
+//_____________________________________________________________________________
+Bool_t THcSymSolver::Factorize()
+{
+  // Factorize A = U^T D U.  The elimination runs along rows of the
+  // packed triangle, skipping zero multipliers, which are common in the
+  // sparse correlation matrices of segmented detectors.  Fails if a
+  // pivot is zero or negligible with respect to the largest diagonal
+  // element.
+
+  fFactorized = kFALSE;
+  if (fN == 0) return kFALSE;
+
+  fU = fA;
+  fD.assign(fN, 0.);
+
+  Double_t amax = 0.;
+  for (UInt_t i=0; i<fN; i++)
+    amax = TMath::Max(amax, TMath::Abs(fA[Index(i,i)]));
+  Double_t tiny = amax * fN * 1.e-15;
+  if (amax == 0.) return kFALSE;
+
+  for (UInt_t k=0; k<fN; k++) {
+    Double_t* rk = &fU[Index(k,k)];      // rk[j-k] is (k,j)
+    Double_t d = rk[0];
+    if (TMath::Abs(d) <= tiny) return kFALSE;
+    fD[k] = d;
+
+    for (UInt_t i=k+1; i<fN; i++) {
+      Double_t f = rk[i-k];
+      if (f == 0.) continue;
+      f /= d;
+      Double_t* ri = &fU[Index(i,i)];
+      for (UInt_t j=i; j<fN; j++)
+	ri[j-i] -= f * rk[j-k];
+    }
+
+    rk[0] = 1.;
+    for (UInt_t j=k+1; j<fN; j++)
+      rk[j-k] /= d;
+  }
+
+  fFactorized = kTRUE;
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void THcSymSolver::LDLSolve( Double_t* x ) const
+{
+  // Overwrite x with (U^T D U)^-1 x
+
+  // U^T y = x, column k of U^T is row k of U
+  for (UInt_t k=0; k<fN; k++) {
+    Double_t xk = x[k];
+    if (xk == 0.) continue;
+    const Double_t* rk = &fU[Index(k,k)];
+    for (UInt_t j=k+1; j<fN; j++)
+      x[j] -= rk[j-k] * xk;
+  }
+
+  for (UInt_t k=0; k<fN; k++)
+    x[k] /= fD[k];
+
+  // U x = z
+  for (UInt_t k=fN; k-- > 0; ) {
+    const Double_t* rk = &fU[Index(k,k)];
+    Double_t sum = x[k];
+    for (UInt_t j=k+1; j<fN; j++)
+      sum -= rk[j-k] * x[j];
+    x[k] = sum;
+  }
+}
+
+//_____________________________________________________________________________
+void THcSymSolver::Residual( const Double_t* b, const Double_t* x,
+			     Double_t* r ) const
+{
+  // r = b - A x, accumulated in extended precision
+
+  vector<long double> ax(fN, 0.);
+  for (UInt_t i=0; i<fN; i++) {
+    const Double_t* ai = &fA[Index(i,i)];
+    long double sum = ax[i] + (long double)ai[0] * x[i];
+    for (UInt_t j=i+1; j<fN; j++) {
+      sum += (long double)ai[j-i] * x[j];
+      ax[j] += (long double)ai[j-i] * x[i];
+    }
+    ax[i] = sum;
+  }
+  for (UInt_t i=0; i<fN; i++)
+    r[i] = Double_t(b[i] - ax[i]);
+}
+
+//_____________________________________________________________________________
+Bool_t THcSymSolver::Solve( const Double_t* b, Double_t* x,
+			    Int_t nrefine ) const
+{
+  // Solve A x = b with the factorization, then refine x up to nrefine
+  // times, stopping when the correction no longer decreases.
+
+  fResidual = 0.;
+  if (!fFactorized) return kFALSE;
+
+  for (UInt_t i=0; i<fN; i++) x[i] = b[i];
+  LDLSolve(x);
+
+  Double_t bnorm = 0.;
+  for (UInt_t i=0; i<fN; i++)
+    bnorm = TMath::Max(bnorm, TMath::Abs(b[i]));
+
+  fWork.resize(fN);
+  Double_t* r = &fWork[0];
+  Double_t lastcorr = 0.;
+
+  for (Int_t it=0; ; it++) {
+    Residual(b, x, r);
+    Double_t rnorm = 0.;
+    for (UInt_t i=0; i<fN; i++)
+      rnorm = TMath::Max(rnorm, TMath::Abs(r[i]));
+    fResidual = bnorm > 0. ? rnorm/bnorm : rnorm;
+    if (it >= nrefine || rnorm == 0.) break;
+
+    LDLSolve(r);
+    Double_t corr = 0., xnorm = 0.;
+    for (UInt_t i=0; i<fN; i++) {
+      corr = TMath::Max(corr, TMath::Abs(r[i]));
+      xnorm = TMath::Max(xnorm, TMath::Abs(x[i]));
+    }
+    if (it > 0 && corr >= lastcorr) break;   // Not converging
+    for (UInt_t i=0; i<fN; i++)
+      x[i] += r[i];
+    lastcorr = corr;
+    if (corr <= 1.e-15 * xnorm) {
+      Residual(b, x, r);
+      rnorm = 0.;
+      for (UInt_t i=0; i<fN; i++)
+	rnorm = TMath::Max(rnorm, TMath::Abs(r[i]));
+      fResidual = bnorm > 0. ? rnorm/bnorm : rnorm;
+      break;
+    }
+  }
+
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t THcSymSolver::Solve( const vector<Double_t>& b, vector<Double_t>& x,
+			    Int_t nrefine ) const
+{
+  // Solve A x = b for vectors of size n
+
+  if (b.size() < fN) return kFALSE;
+  x.resize(fN);
+  if (fN == 0) return kFALSE;
+  return Solve(&b[0], &x[0], nrefine);
+}
+
+//_____________________________________________________________________________
+Double_t THcSymSolver::Condition() const
+{
+  // Estimate of the 1-norm condition number |A| |A^-1| (Hager 1984,
+  // as in LAPACK's xLACON), using a few solves with the factorization.
+  // Returns -1 if the matrix is not factorized.
+
+  if (!fFactorized) return -1.;
+
+  Double_t anorm = 0.;
+  vector<Double_t> colsum(fN, 0.);
+  for (UInt_t i=0; i<fN; i++) {
+    const Double_t* ai = &fA[Index(i,i)];
+    colsum[i] += TMath::Abs(ai[0]);
+    for (UInt_t j=i+1; j<fN; j++) {
+      colsum[i] += TMath::Abs(ai[j-i]);
+      colsum[j] += TMath::Abs(ai[j-i]);
+    }
+  }
+  for (UInt_t i=0; i<fN; i++)
+    anorm = TMath::Max(anorm, colsum[i]);
+
+  // A^-1 is symmetric, so the same solve serves for A^-T.
+
+  vector<Double_t> x(fN, 1./fN), y(fN);
+  Double_t est = 0.;
+  for (Int_t it=0; it<5; it++) {
+    y = x;
+    LDLSolve(&y[0]);
+    Double_t ynorm = 0.;
+    for (UInt_t i=0; i<fN; i++) ynorm += TMath::Abs(y[i]);
+    if (it > 0 && ynorm <= est) break;
+    est = ynorm;
+
+    for (UInt_t i=0; i<fN; i++) y[i] = y[i] >= 0. ? 1. : -1.;
+    LDLSolve(&y[0]);
+    UInt_t jmax = 0;
+    Double_t ztx = 0.;
+    for (UInt_t i=0; i<fN; i++) {
+      ztx += y[i]*x[i];
+      if (TMath::Abs(y[i]) > TMath::Abs(y[jmax])) jmax = i;
+    }
+    if (TMath::Abs(y[jmax]) <= ztx) break;
+    x.assign(fN, 0.);
+    x[jmax] = 1.;
+  }
+
+  return anorm * est;
+}
+
+//_____________________________________________________________________________
+Double_t THcSymSolver::LogDet( Int_t& sign ) const
+{
+  // log10 |det A| = sum of log10 |D(k)|, and the sign of det A
+
+  sign = 0;
+  if (!fFactorized) return 0.;
+  sign = 1;
+  Double_t logdet = 0.;
+  for (UInt_t k=0; k<fN; k++) {
+    if (fD[k] < 0.) sign = -sign;
+    logdet += TMath::Log10(TMath::Abs(fD[k]));
+  }
+  return logdet;
+}
+
+//_____________________________________________________________________________
+void THcSymSolver::Print( Option_t* ) const
+{
+  // Print the size, condition number and determinant
+
+  cout << "THcSymSolver: " << fN << " x " << fN;
+  if (fFactorized) {
+    Int_t sign;
+    Double_t logdet = LogDet(sign);
+    cout << ", cond: " << Condition()
+	 << ", det: " << (sign<0 ? "-" : "") << "10^" << logdet
+	 << ", residual: " << fResidual;
+  } else
+    cout << ", not factorized";
+  cout << endl;
+}
+
+ClassImp(THcSymSolver)
+////////////////////////////////////////////////////////////////////////////////
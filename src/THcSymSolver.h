@@ -0,0 +1,72 @@
+#ifndef ROOT_THcSymSolver
+#define ROOT_THcSymSolver
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcSymSolver                                                              //
+//                                                                           //
+// Linear equations with a symmetric matrix in packed storage.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class THcSymSolver : public TObject {
+
+public:
+  THcSymSolver( UInt_t n=0 );
+  virtual ~THcSymSolver();
+
+  // Resize to n x n and zero the matrix
+  void     ResizeTo( UInt_t n );
+  void     Zero();
+  UInt_t   GetN() const { return fN; }
+
+  // Element (i,j) of the matrix, the same as (j,i)
+  Double_t& operator()( UInt_t i, UInt_t j ) {
+    return i<=j ? fA[Index(i,j)] : fA[Index(j,i)];
+  }
+  Double_t operator()( UInt_t i, UInt_t j ) const {
+    return i<=j ? fA[Index(i,j)] : fA[Index(j,i)];
+  }
+  // The packed upper triangle, row by row: (i,j), j>=i, is at Index(i,j)
+  Double_t* GetArray() { return fN ? &fA[0] : 0; }
+  UInt_t   Index( UInt_t i, UInt_t j ) const {
+    return i*fN - i*(i+1)/2 + j;
+  }
+
+  // LDL^T factorization of the matrix, kept for any number of Solve
+  // calls.  Fails if a pivot vanishes.
+  Bool_t   Factorize();
+  Bool_t   IsFactorized() const { return fFactorized; }
+  // Solve A x = b, with up to nrefine steps of iterative refinement
+  Bool_t   Solve( const Double_t* b, Double_t* x, Int_t nrefine=2 ) const;
+  Bool_t   Solve( const std::vector<Double_t>& b, std::vector<Double_t>& x,
+		  Int_t nrefine=2 ) const;
+
+  // Estimate of the 1-norm condition number, from the factorization
+  Double_t Condition() const;
+  // log10 of |det A|, and the sign of det A
+  Double_t LogDet( Int_t& sign ) const;
+  // Relative residual |b-Ax|/|b| (infinity norm) of the last Solve
+  Double_t GetResidual() const { return fResidual; }
+
+  virtual void Print( Option_t* opt="" ) const;
+
+protected:
+  UInt_t   fN;
+  std::vector<Double_t> fA;     // Packed matrix
+  std::vector<Double_t> fU;     // Packed unit upper triangular factor
+  std::vector<Double_t> fD;     // Diagonal factor
+  Bool_t   fFactorized;
+  mutable Double_t fResidual;
+  mutable std::vector<Double_t> fWork;
+
+  void     LDLSolve( Double_t* x ) const;
+  void     Residual( const Double_t* b, const Double_t* x, Double_t* r ) const;
+
+  ClassDef(THcSymSolver,0)   // Packed symmetric LDL^T solver
+};
+
+#endif
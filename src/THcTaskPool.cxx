@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcTaskPool                                                               //
+//                                                                           //
+// A pool of nthreads-1 TThreads that, together with the calling thread,     //
+// runs the tasks of a Run call: each thread takes the next task not yet     //
+// started until none is left, and Run returns when all are finished.        //
+// Used by THcDecodeGraph for the detectors of a spectrometer and by         //
+// THcApparatusGroup for the spectrometers of an event.                      //
+//                                                                           //
+// ROOT 5 threads: the constructor calls TThread::Initialize() before the    //
+// first thread is started.  This creates gGlobalMutex, after which ROOT     //
+// guards its global lists (gROOT), the interpreter and the error handler    //
+// with mutexes.  Tasks run during event processing, and what they may       //
+// do is:                                                                    //
+//   - safe: writing the members of their own object, reading the event      //
+//     data, the parameters and the detector map; TMath and vector           //
+//     arithmetic; filling and clearing the object's own TClonesArrays       //
+//     (operator[], placement new, ConstructedAt, Clear); Error and          //
+//     Warning, which go through the guarded error handler                   //
+//   - not safe: Form() and TString::Format, which share one buffer in       //
+//     ROOT 5; creating or deleting named ROOT objects (histograms, trees,   //
+//     formulas), which register in gDirectory; defining global variables    //
+//     or cuts; evaluating cuts, whose results are kept in the THaCut        //
+//     objects of gHaCuts.  Cuts are therefore evaluated between Run calls,  //
+//     on the calling thread.                                                //
+//   - cout from several tasks interleaves, which only matters for the       //
+//     debug printout of the detectors.                                      //
+// The first use of a TClonesArray slot by ConstructedAt goes through        //
+// TClass::New, which in ROOT 5 sets a static flag of TClass (back to its    //
+// normal value on return) that only the ROOT I/O reads; the output is       //
+// written after Run returns.                                                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "THcTaskPool.h"
+#include "TThread.h"
+#include "TMutex.h"
+#include "TCondition.h"
+
+using namespace std;
+
+ClassImp(THcTaskPool)
+
+//______________________________________________________________________________
+THcTaskPool::THcTaskPool( Int_t nthreads ) :
+  fMutex(0), fWork(0), fDone(0), fFunc(0), fArg(0), fNextTask(0),
+  fLastTask(0), fPending(0), fGeneration(0), fQuit(kFALSE)
+{
+  // Start nthreads-1 threads; with nthreads <= 1, Run runs the tasks
+  // on the calling thread
+
+  if( nthreads <= 1 ) return;
+
+  TThread::Initialize();
+  fMutex = new TMutex();
+  fWork = new TCondition(fMutex);
+  fDone = new TCondition(fMutex);
+  for( Int_t i=1; i<nthreads; i++ ) {
+    TThread* thread = new TThread(WorkerThread, this);
+    thread->Run();
+    fThreads.push_back(thread);
+  }
+}
+
+//______________________________________________________________________________
+THcTaskPool::~THcTaskPool()
+{
+  // Destructor. Stops the threads.
+
+  if( fMutex ) {
+    fMutex->Lock();
+    fQuit = kTRUE;
+    fWork->Broadcast();
+    fMutex->UnLock();
+  }
+  for( UInt_t i=0; i<fThreads.size(); i++ ) {
+    fThreads[i]->Join();
+    delete fThreads[i];
+  }
+  delete fWork;
+  delete fDone;
+  delete fMutex;
+}
+
+//______________________________________________________________________________
+void* THcTaskPool::WorkerThread( void* arg )
+{
+  static_cast<THcTaskPool*>(arg)->WorkerLoop();
+  return 0;
+}
+
+//______________________________________________________________________________
+void THcTaskPool::WorkerLoop()
+{
+  // Wait for tasks to be published, help running them, repeat
+
+  fMutex->Lock();
+  UInt_t seen = fGeneration;
+  while( true ) {
+    while( !fQuit && fGeneration == seen )
+      fWork->Wait();
+    if( fQuit ) break;
+    seen = fGeneration;
+    RunTasks();
+  }
+  fMutex->UnLock();
+}
+
+//______________________________________________________________________________
+void THcTaskPool::RunTasks()
+{
+  // Run tasks until none is left. Called with fMutex locked.
+
+  while( fNextTask < fLastTask ) {
+    Int_t i = fNextTask++;
+    fMutex->UnLock();
+    fFunc(fArg, i);
+    fMutex->Lock();
+    if( --fPending == 0 ) fDone->Broadcast();
+  }
+}
+
+//______________________________________________________________________________
+void THcTaskPool::Run( TaskFunc func, void* arg, Int_t first, Int_t last )
+{
+  // Run func(arg,i) for i = first..last-1, concurrently if the pool has
+  // threads, and return when all are done
+
+  if( fThreads.empty() || last-first <= 1 ) {
+    for( Int_t i=first; i<last; i++ )
+      func(arg, i);
+    return;
+  }
+  fMutex->Lock();
+  fFunc = func;
+  fArg = arg;
+  fNextTask = first;
+  fLastTask = last;
+  fPending = last-first;
+  fGeneration++;
+  fWork->Broadcast();
+  RunTasks();
+  while( fPending > 0 )
+    fDone->Wait();
+  fMutex->UnLock();
+}
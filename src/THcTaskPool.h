@@ -0,0 +1,58 @@
+#ifndef ROOT_THcTaskPool
+#define ROOT_THcTaskPool
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// THcTaskPool                                                               //
+//                                                                           //
+// Small pool of TThreads running numbered tasks together with the calling   //
+// thread.                                                                   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TObject.h"
+#include <vector>
+
+class TThread;
+class TMutex;
+class TCondition;
+
+class THcTaskPool : public TObject {
+
+public:
+  // Task i of a call to Run, with the argument given to Run
+  typedef void (*TaskFunc)( void* arg, Int_t i );
+
+  THcTaskPool( Int_t nthreads=1 );
+  virtual ~THcTaskPool();
+
+  // Run tasks first..last-1 and return when all are done
+  void   Run( TaskFunc func, void* arg, Int_t first, Int_t last );
+
+  Int_t  GetNThreads() const { return fThreads.size()+1; }
+
+protected:
+  std::vector<TThread*> fThreads;
+  TMutex*     fMutex;
+  TCondition* fWork;                    // New tasks to work on
+  TCondition* fDone;                    // All tasks finished
+  TaskFunc fFunc;
+  void*    fArg;
+  Int_t    fNextTask;
+  Int_t    fLastTask;
+  Int_t    fPending;
+  UInt_t   fGeneration;
+  Bool_t   fQuit;
+
+  void   RunTasks();
+  void   WorkerLoop();
+  static void* WorkerThread( void* arg );
+
+private:
+  THcTaskPool( const THcTaskPool& );
+  THcTaskPool& operator=( const THcTaskPool& );
+
+  ClassDef(THcTaskPool,0)   // Thread pool for per-event tasks
+};
+
+#endif